@@ -1,17 +1,50 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "allocators.h"
+#include "newstring.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define CB_TEMP_ALLOCATOR_ASAN
+#elif defined(CB_TEMP_ALLOCATOR_CHECKS)
+#define CB_TEMP_ALLOCATOR_PATTERN
+#endif
 
 StandardAllocator g_standardAllocator;
 TempAllocator g_tempAllocator;
 
+#ifdef CB_TEMP_ALLOCATOR_PATTERN
+static const uint8_t rolledBackMemoryPattern = 0xDD;
+#endif
+
+/** Marks memory as rolled back, does nothing unless temporary allocator checks are enabled. */
+inline void poisonMemory(void* from, void* to)
+{
+#if defined(CB_TEMP_ALLOCATOR_ASAN)
+    ASAN_POISON_MEMORY_REGION(from, (uintptr_t)to - (uintptr_t)from);
+#elif defined(CB_TEMP_ALLOCATOR_PATTERN)
+    memset(from, rolledBackMemoryPattern, (uintptr_t)to - (uintptr_t)from);
+#else
+    (void)from; (void)to;
+#endif
+}
 
-inline uintptr_t bytesRequiredToAlignPointer(void* pointer, uintptr_t alignment)
+inline void unpoisonMemory(void* from, void* to)
 {
-	return (uintptr_t)pointer % alignment;
+#if defined(CB_TEMP_ALLOCATOR_ASAN)
+    if (from < to)
+        ASAN_UNPOISON_MEMORY_REGION(from, (uintptr_t)to - (uintptr_t)from);
+#else
+    (void)from; (void)to;
+#endif
 }
 
-inline void* AlignPointer(void* pointer, uintptr_t alignment)
+
+/** Rounds pointer up to specified alignment, which must be power of two. */
+inline void* alignPointer(void* pointer, uintptr_t alignment)
 {
-	return (void*)((uintptr_t)pointer + ((uintptr_t)pointer % alignment));
+	return (void*)(((uintptr_t)pointer + alignment - 1) & ~(alignment - 1));
 }
 
 inline void* addBytesToPointer(void* pointer, uintptr_t size)
@@ -19,37 +52,66 @@ inline void* addBytesToPointer(void* pointer, uintptr_t size)
 	return (void*)((uintptr_t)pointer + size);
 }
 
+uintptr_t TempAllocatorPolicy::GetSizeFor(uintptr_t usedBytes) const
+{
+    uintptr_t size = minSize;
+    while (size < usedBytes * 2 && size < maxSize)
+        size *= 2;
+
+    return size < maxSize ? size : maxSize;
+}
+
 bool TempAllocator::SetSize(uintptr_t size)
 {
-	Dispose();
+	Reset();
 
 	if (size == 0)
+    {
+        Dispose();
 		return true;
+    }
 
-	start = ::malloc(size);
-	if (start == nullptr)
+    // Previous arena is kept if new one can't be allocated.
+	void* newStart = ::malloc(size);
+	if (newStart == nullptr)
     {
         SetLastError(ERROR_OUTOFMEMORY);
 		return false;
     }
 
-	current = start;
+    unpoisonMemory(start, end);
+    free(start);
+
+	start = current = poisonedEnd = newStart;
 	end = addBytesToPointer(start, size);
+#ifdef CB_TEMP_ALLOCATOR_ASAN
+    poisonMemory(start, end);
+#endif
 
 	return true;
 }
 
+uintptr_t TempAllocator::GetSize() const
+{
+    return (uintptr_t)end - (uintptr_t)start;
+}
+
 void* TempAllocator::Allocate(uintptr_t size)
+{
+    return AllocateBytes(size, true);
+}
+
+void* TempAllocator::AllocateBytes(uintptr_t size, bool checkRolledBackMemory)
 {
     assert(start);
     assert(current);
 
-	uintptr_t requiredAlignment = bytesRequiredToAlignPointer(current, sizeof(void*));
-	void* alignedPointer = addBytesToPointer(current, requiredAlignment);
+	void* alignedPointer = alignPointer(current, sizeof(void*));
 	if ((uintptr_t)alignedPointer + size > (uintptr_t)end)
 	{
-        // @TODO: this thing doesn't respect alignment?
-		UnfitAllocation* unfit = (UnfitAllocation*)::malloc(sizeof(UnfitAllocation) + size + sizeof(void*));
+        // Header size is multiple of pointer size and malloc result is aligned at least to pointer size,
+        // so data after header is aligned too.
+		UnfitAllocation* unfit = (UnfitAllocation*)::malloc(sizeof(UnfitAllocation) + size);
 
 		if (unfit == nullptr)
         {
@@ -58,15 +120,31 @@ void* TempAllocator::Allocate(uintptr_t size)
         }
 
         unfit->next = nullptr;
+        unfit->size = size;
 		AddUnfit(unfit);
 
-		return AlignPointer((void*)((uintptr_t)unfit + sizeof(UnfitAllocation)), sizeof(void*));
-	}
-	else
-	{
-		current = (void*)((uintptr_t)current + size + (uintptr_t)requiredAlignment);
-		return alignedPointer;
+        frameSpillBytes += size;
+        ++statistics.spillCount;
+        statistics.spillBytes += size;
+
+		return unfit + 1;
 	}
+
+    void* newCurrent = addBytesToPointer(alignedPointer, size);
+#ifdef CB_TEMP_ALLOCATOR_PATTERN
+    if (checkRolledBackMemory)
+    {
+        // Everything between current and poisonedEnd was filled with pattern when it was rolled back.
+        for (uint8_t* byte = (uint8_t*)current; byte < (uint8_t*)newCurrent && byte < (uint8_t*)poisonedEnd; ++byte)
+            assert(*byte == rolledBackMemoryPattern && "Temporary memory was modified after it was rolled back.");
+    }
+#else
+    (void)checkRolledBackMemory;
+#endif
+    unpoisonMemory(current, newCurrent);
+
+	current = newCurrent;
+	return alignedPointer;
 }
 
 void TempAllocator::Deallocate(void* ptr)
@@ -76,31 +154,185 @@ void TempAllocator::Deallocate(void* ptr)
 
 void* TempAllocator::Reallocate(void* block, uintptr_t size)
 {
-    // @TODO
-    void* new_block = Allocate(size);
-    if (block)
-        memcpy(new_block, block, size);
-    return new_block;
+    // Size of arena allocations is not stored, but block can't extend past current position.
+    uintptr_t copySize = 0;
+    if (block >= start && block < current)
+        copySize = (uintptr_t)current - (uintptr_t)block;
+    else if (block != nullptr)
+        copySize = ((UnfitAllocation*)block - 1)->size;
+
+    void* newBlock = Allocate(size);
+    if (newBlock && block)
+        memcpy(newBlock, block, copySize < size ? copySize : size);
+    return newBlock;
+}
+
+TempAllocatorMarker TempAllocator::Save() const
+{
+    TempAllocatorMarker marker;
+    marker.position = current;
+    marker.unfitCount = unfitCount;
+    marker.generation = generation;
+    return marker;
+}
+
+void TempAllocator::Restore(const TempAllocatorMarker& marker)
+{
+    void* rolledBackEnd = current;
+    UnfitAllocation* rolledBackUnfits = nullptr;
+    if (!RollBack(marker, &rolledBackUnfits))
+        return;
+
+    Poison(current, rolledBackEnd);
+    FreeUnfits(rolledBackUnfits);
+}
+
+void* TempAllocator::RestoreKeeping(const TempAllocatorMarker& marker, const void* data, uintptr_t size, uintptr_t allocationSize)
+{
+    assert(size <= allocationSize);
+
+    void* rolledBackEnd = current;
+    UnfitAllocation* rolledBackUnfits = nullptr;
+    bool isRolledBack = RollBack(marker, &rolledBackUnfits);
+
+    // Rolled back memory is neither poisoned nor freed yet, so data can be copied even if it was released.
+    // If data was allocated in arena, copy is placed at marker, which may overlap data.
+    void* copy = AllocateBytes(allocationSize, !isRolledBack);
+    if (copy != nullptr && size > 0)
+        memmove(copy, data, size);
+
+    if (isRolledBack)
+    {
+        Poison(current, rolledBackEnd);
+        FreeUnfits(rolledBackUnfits);
+    }
+
+    return copy;
+}
+
+bool TempAllocator::RollBack(const TempAllocatorMarker& marker, UnfitAllocation** rolledBackUnfits)
+{
+    // Marker is stale if allocator was reset after it was saved, or if marker saved before it was already restored.
+    bool isValid = marker.generation == generation
+        && marker.position >= start && marker.position <= current
+        && marker.unfitCount <= unfitCount;
+    assert(isValid && "Temporary allocator marker is restored out of order or after reset.");
+    if (!isValid)
+        return false;
+
+    uintptr_t usedBytes = (uintptr_t)current - (uintptr_t)start;
+    if (usedBytes > framePeakBytes)
+        framePeakBytes = usedBytes;
+
+    current = marker.position;
+
+    UnfitAllocation* lastKept = nullptr;
+    UnfitAllocation* firstReleased = firstUnfit;
+    for (uint32_t i = 0; i < marker.unfitCount; ++i)
+    {
+        lastKept = firstReleased;
+        firstReleased = firstReleased->next;
+    }
+
+    if (lastKept != nullptr)
+        lastKept->next = nullptr;
+    else
+        firstUnfit = nullptr;
+
+    lastUnfit = lastKept;
+    unfitCount = marker.unfitCount;
+
+    *rolledBackUnfits = firstReleased;
+    return true;
+}
+
+void TempAllocator::Poison(void* from, void* to)
+{
+    if (from >= to)
+        return;
+
+    poisonMemory(from, to);
+    if (to > poisonedEnd)
+        poisonedEnd = to;
 }
 
 void TempAllocator::Reset()
 {
 	if (start != nullptr)
+    {
+        Poison(start, current);
 		current = start;
+    }
     ClearUnfits();
+
+    ++generation;
+    frameSpillBytes = 0;
+    framePeakBytes = 0;
+}
+
+void TempAllocator::EndFrame()
+{
+    uintptr_t arenaBytes = (uintptr_t)current - (uintptr_t)start;
+    uintptr_t usedBytes = (arenaBytes > framePeakBytes ? arenaBytes : framePeakBytes) + frameSpillBytes;
+    bool isSpilled = frameSpillBytes > 0;
+
+    TempAllocatorStatistics& s = statistics;
+    ++s.frameCount;
+    if (isSpilled)                  ++s.spilledFrameCount;
+    if (usedBytes > s.highWaterMark)  s.highWaterMark = usedBytes;
+
+    if (usedBytes > periodHighWaterMark)
+        periodHighWaterMark = usedBytes;
+    ++periodFrameCount;
+
+    Reset();
+
+    uintptr_t size = GetSize();
+    uintptr_t newSize = size;
+    if (isSpilled && size < policy.maxSize)
+    {
+        newSize = policy.GetSizeFor(usedBytes);
+    }
+    else if (periodFrameCount >= policy.shrinkPeriod)
+    {
+        // Shrink only if arena is at least four times larger than needed, so its size doesn't flip back and forth.
+        uintptr_t fittingSize = policy.GetSizeFor(periodHighWaterMark);
+        if (fittingSize * 2 <= size)
+            newSize = fittingSize;
+
+        periodHighWaterMark = 0;
+        periodFrameCount = 0;
+    }
+
+    if (newSize != size && SetSize(newSize))
+    {
+        ++s.resizeCount;
+        periodHighWaterMark = 0;
+        periodFrameCount = 0;
+    }
 }
 
 void TempAllocator::Dispose()
 {
 	Reset();
 
+    unpoisonMemory(start, end);
     free(start);
-	start = current = end = nullptr;
+	start = current = end = poisonedEnd = nullptr;
 }
 
 void TempAllocator::ClearUnfits()
 {
-	UnfitAllocation* current = firstUnfit;
+    FreeUnfits(firstUnfit);
+
+	firstUnfit = nullptr;
+    lastUnfit  = nullptr;
+    unfitCount = 0;
+}
+
+void TempAllocator::FreeUnfits(UnfitAllocation* first)
+{
+	UnfitAllocation* current = first;
 
 	while (current != nullptr)
 	{
@@ -108,9 +340,6 @@ void TempAllocator::ClearUnfits()
         free(current);
 		current = next;
 	}
-
-	firstUnfit = nullptr;
-    lastUnfit  = nullptr;
 }
 
 void TempAllocator::AddUnfit(UnfitAllocation* newUnfit)
@@ -126,6 +355,26 @@ void TempAllocator::AddUnfit(UnfitAllocation* newUnfit)
         lastUnfit->next = newUnfit;
         lastUnfit = newUnfit;
     }
+    ++unfitCount;
+}
+
+Newstring TempAllocatorScope::Keep(const Newstring& string)
+{
+    if (Newstring::IsNullOrEmpty(string))
+    {
+        allocator->Restore(marker);
+        return Newstring::Empty();
+    }
+
+    uintptr_t size = string.count * sizeof(wchar_t);
+    wchar_t* copy = (wchar_t*)allocator->RestoreKeeping(marker, string.data, size, size + sizeof(wchar_t));
+    marker = allocator->Save();
+
+    if (copy == nullptr)
+        return Newstring::Empty();
+
+    copy[string.count] = L'\0';
+    return Newstring::WrapWChar(copy, string.count);
 }
 
 void* StandardAllocator::Allocate(uintptr_t size)
@@ -137,7 +386,8 @@ void* StandardAllocator::Allocate(uintptr_t size)
         return nullptr;
     }
 
-    allocated += size;
+    allocated.fetch_add(static_cast<uintptr_t>(_msize(block)), std::memory_order_relaxed);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
     return block;
 }
 
@@ -146,8 +396,8 @@ void StandardAllocator::Deallocate(void* block)
     if (block == nullptr) return;
 
     uintptr_t blockSize = static_cast<uintptr_t>(_msize(block));
-    assert(allocated >= blockSize);
-    allocated -= blockSize;
+    assert(allocated.load(std::memory_order_relaxed) >= blockSize);
+    allocated.fetch_sub(blockSize, std::memory_order_relaxed);
 
     ::free(block);
 }
@@ -163,7 +413,8 @@ void* StandardAllocator::Reallocate(void* block, uintptr_t size)
     }
     uintptr_t newSize = static_cast<uintptr_t>(_msize(newBlock));
 
-    allocated = allocated - oldSize + newSize;
+    allocated.fetch_add(newSize - oldSize, std::memory_order_relaxed);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
     return newBlock;
 }
 
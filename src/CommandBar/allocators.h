@@ -1,10 +1,20 @@
 #pragma once
 #include "allocators.h"
 #include <assert.h>
+#include <atomic>
 #include <new>
 
 #include "common.h"
 
+// Temporary allocator fills rolled back memory with a pattern and checks that it wasn't modified when it's allocated
+// again, to catch use of memory after it was rolled back. Enabled in debug builds. When built with AddressSanitizer,
+// rolled back memory is poisoned instead, so any access to it is reported.
+#if defined(_DEBUG) && !defined(CB_TEMP_ALLOCATOR_CHECKS)
+#define CB_TEMP_ALLOCATOR_CHECKS
+#endif
+
+struct Newstring;
+
 struct IAllocator
 {
 	virtual void* Allocate(uintptr_t size) = 0;
@@ -12,29 +22,122 @@ struct IAllocator
     virtual void* Reallocate(void* block, uintptr_t size) = 0;
 };
 
+/**
+ * Allocates memory with malloc. Statistics are updated atomically, so allocator is used by several threads.
+ */
 struct StandardAllocator : public IAllocator
 {
-    uintptr_t allocated = 0;
+    std::atomic<uintptr_t> allocated{ 0 };
+    std::atomic<uintptr_t> allocationCount{ 0 }; // Number of Allocate() and Reallocate() calls, used by benchmarks.
 
 	virtual void* Allocate(uintptr_t size) override;
 	virtual void  Deallocate(void* block) override;
     virtual void* Reallocate(void* block, uintptr_t size) override;
 };
 
+/**
+ * Controls how TempAllocator adapts arena size to memory used by frames.
+ */
+struct TempAllocatorPolicy
+{
+    /** Arena is never shrunk below this size. */
+    uintptr_t minSize = 4096;
+
+    /** Arena is never grown above this size, frames that use more memory keep spilling. */
+    uintptr_t maxSize = 1024 * 1024;
+
+    /** Number of frames after which arena is shrunk if its high-water mark during these frames is much lower than its size. */
+    uint32_t shrinkPeriod = 1024;
+
+    /**
+     * Returns arena size for frames which use up to specified amount of memory: twice as much, rounded up
+     * to power of two and clamped to [minSize, maxSize].
+     */
+    uintptr_t GetSizeFor(uintptr_t usedBytes) const;
+};
+
+struct TempAllocatorStatistics
+{
+    uint64_t frameCount = 0;
+
+    /** Frames which didn't fit into arena. */
+    uint64_t spilledFrameCount = 0;
+
+    /** Allocations which didn't fit into arena, so they were allocated separately. */
+    uint64_t spillCount = 0;
+    uint64_t spillBytes = 0;
+
+    /** Largest amount of memory used by single frame, including spills. */
+    uintptr_t highWaterMark = 0;
+
+    /** Number of times arena was grown or shrunk. */
+    uint32_t resizeCount = 0;
+};
+
+/**
+ * Position of TempAllocator, see TempAllocator::Save().
+ */
+struct TempAllocatorMarker
+{
+    void* position = nullptr;
+    uint32_t unfitCount = 0;
+    uint32_t generation = 0;
+};
+
+/**
+ * Arena for short-lived allocations. Memory is released all at once by Reset() or EndFrame(), Deallocate() does nothing.
+ * Allocations that don't fit into arena "spill": they are allocated with malloc and freed on reset.
+ */
 struct TempAllocator : public IAllocator
 {
+    TempAllocatorPolicy policy;
+    TempAllocatorStatistics statistics;
+
 	bool SetSize(uintptr_t size);
 
+    /** Returns size of arena, not including spilled allocations. */
+    uintptr_t GetSize() const;
+
 	virtual void* Allocate(uintptr_t size) override;
 	virtual void  Deallocate(void* ptr) override;
     virtual void* Reallocate(void* block, uintptr_t size) override;
 
+    /**
+     * Releases all allocations without updating statistics or arena size.
+     */
 	void Reset();
+
+    /**
+     * Ends frame, e.g. batch of window messages: records memory used since previous frame, releases all allocations
+     * and resizes arena according to policy. Arena is grown when frame spilled, and shrunk when frames of last
+     * policy.shrinkPeriod frames used much less than arena size.
+     */
+    void EndFrame();
+
+    /**
+     * Returns current position of allocator. Restoring it releases everything allocated after it, so nested
+     * temporary allocations can reuse the same memory before the frame ends.
+     */
+    TempAllocatorMarker Save() const;
+
+    /**
+     * Releases allocations made after specified marker was saved. Markers must be restored in reverse order of saving
+     * and during the frame they were saved in, otherwise nothing is released.
+     */
+    void Restore(const TempAllocatorMarker& marker);
+
+    /**
+     * Same as Restore(), but keeps copy of specified data, which may be one of released allocations. Copy is
+     * allocationSize bytes long and starts with size bytes of data. Returns null pointer if copy couldn't be allocated.
+     */
+    void* RestoreKeeping(const TempAllocatorMarker& marker, const void* data, uintptr_t size, uintptr_t allocationSize);
+
 	void Dispose();
 private:
     struct UnfitAllocation
     {
         UnfitAllocation* next = nullptr;
+        uintptr_t size = 0;
     };
 
     void* current = nullptr;
@@ -42,14 +145,67 @@ private:
     void* end = nullptr;
     UnfitAllocation* firstUnfit = nullptr;
     UnfitAllocation* lastUnfit  = nullptr;
+    uint32_t unfitCount = 0;
+
+    /** Incremented on every reset, markers saved before it are no longer valid. */
+    uint32_t generation = 0;
+
+    /** End of memory after current which is filled with rolled back memory pattern. */
+    void* poisonedEnd = nullptr;
+
+    /** Bytes spilled during current frame. */
+    uintptr_t frameSpillBytes = 0;
+
+    /** Largest amount of arena memory used during current frame before it was rolled back. */
+    uintptr_t framePeakBytes = 0;
+
+    /** Largest amount of memory used by single frame since arena was last resized or shrink period started. */
+    uintptr_t periodHighWaterMark = 0;
+    uint32_t periodFrameCount = 0;
+
+    void* AllocateBytes(uintptr_t size, bool checkRolledBackMemory);
+
+    /** Moves allocator back to marker, spilled allocations made after marker are detached, but not freed. */
+    bool RollBack(const TempAllocatorMarker& marker, UnfitAllocation** rolledBackUnfits);
+    void Poison(void* from, void* to);
 
 	void ClearUnfits();
 	void AddUnfit(UnfitAllocation* unfit);
+    static void FreeUnfits(UnfitAllocation* first);
 };
 
 extern StandardAllocator g_standardAllocator;
 extern TempAllocator g_tempAllocator;
 
+/**
+ * Saves position of temporary allocator and restores it when scope ends, so memory allocated within the scope
+ * is reused by following allocations. Result that must outlive the scope is copied out by Keep().
+ */
+struct TempAllocatorScope
+{
+    TempAllocator* allocator;
+    TempAllocatorMarker marker;
+
+    explicit TempAllocatorScope(TempAllocator* allocator = &g_tempAllocator)
+        : allocator(allocator)
+        , marker(allocator->Save())
+    { }
+
+    ~TempAllocatorScope()
+    {
+        allocator->Restore(marker);
+    }
+
+    TempAllocatorScope(const TempAllocatorScope&) = delete;
+    TempAllocatorScope& operator=(const TempAllocatorScope&) = delete;
+
+    /**
+     * Releases memory allocated within the scope, except for zero-terminated copy of specified string, which is
+     * returned. Scope continues after the copy.
+     */
+    Newstring Keep(const Newstring& string);
+};
+
 void* operator new(size_t size, IAllocator* allocator);
 void  operator delete(void* block, IAllocator* allocator);
 
@@ -0,0 +1,248 @@
+#include <assert.h>
+#include <math.h>
+
+#include "animation.h"
+
+
+float ApplyEasing(Easing easing, float progress)
+{
+    float t = progress < 0.0f ? 0.0f : (progress > 1.0f ? 1.0f : progress);
+
+    switch (easing)
+    {
+        case Easing::EaseInQuad:
+            return t * t;
+        case Easing::EaseOutQuad:
+            return t * (2.0f - t);
+        case Easing::EaseInOutCubic:
+        {
+            if (t < 0.5f)
+                return 4.0f * t * t * t;
+
+            float u = 2.0f * t - 2.0f;
+            return 0.5f * u * u * u + 1.0f;
+        }
+        default:
+            return t;
+    }
+}
+
+bool AnimationTrack::AddKeyframe(double time, float value, Easing easing)
+{
+    if (keyframeCount >= MaxKeyframes)
+        return false;
+
+    if (keyframeCount > 0 && time < keyframes[keyframeCount - 1].time)
+        return false;
+
+    AnimationKeyframe& keyframe = keyframes[keyframeCount++];
+    keyframe.time = time;
+    keyframe.value = value;
+    keyframe.easing = easing;
+
+    return true;
+}
+
+double AnimationTrack::GetDuration() const
+{
+    return keyframeCount > 0 ? keyframes[keyframeCount - 1].time : 0.0;
+}
+
+float AnimationTrack::Evaluate(double time) const
+{
+    if (keyframeCount == 0)
+        return 0.0f;
+
+    // Checked first, so zero-length track evaluates to its last keyframe.
+    if (time >= keyframes[keyframeCount - 1].time)
+        return keyframes[keyframeCount - 1].value;
+
+    if (time <= keyframes[0].time)
+        return keyframes[0].value;
+
+    for (uint32_t i = 1; i < keyframeCount; ++i)
+    {
+        const AnimationKeyframe& from = keyframes[i - 1];
+        const AnimationKeyframe& to = keyframes[i];
+        if (time >= to.time)
+            continue;
+
+        float progress = static_cast<float>((time - from.time) / (to.time - from.time));
+        return from.value + (to.value - from.value) * ApplyEasing(to.easing, progress);
+    }
+
+    return keyframes[keyframeCount - 1].value;
+}
+
+bool AnimationScheduler::Start(const void* key, const AnimationTrack& track, AnimationApplyCallback apply,
+    AnimationCompletedCallback completed, void* userdata, double now)
+{
+    assert(key);
+    assert(apply);
+    assert(track.keyframeCount > 0);
+
+    Animation* animation = Find(key);
+    if (animation != nullptr)
+    {
+        ++statistics.interruptedCount;
+    }
+    else
+    {
+        if (animationCount >= Capacity)
+            return false;
+
+        animation = &animations[animationCount++];
+    }
+
+    animation->id = nextId++;
+    animation->key = key;
+    animation->track = track;
+    animation->startTime = now;
+    animation->value = track.keyframes[0].value;
+    animation->isApplied = false;
+    animation->apply = apply;
+    animation->completed = completed;
+    animation->userdata = userdata;
+
+    ++statistics.startedCount;
+    return true;
+}
+
+bool AnimationScheduler::AnimateTo(const void* key, float from, float target, double duration, Easing easing,
+    AnimationApplyCallback apply, AnimationCompletedCallback completed, void* userdata, double now)
+{
+    float current = from;
+    if (const Animation* animation = Find(key))
+        current = animation->track.Evaluate(now - animation->startTime);
+
+    float range = fabsf(target - from);
+    if (range > 0.0f)
+    {
+        float remaining = fabsf(target - current);
+        duration *= remaining < range ? remaining / range : 1.0f;
+    }
+
+    AnimationTrack track;
+    track.AddKeyframe(0.0, current);
+    track.AddKeyframe(duration, target, easing);
+
+    return Start(key, track, apply, completed, userdata, now);
+}
+
+bool AnimationScheduler::Stop(const void* key)
+{
+    Animation* animation = Find(key);
+    if (animation == nullptr)
+        return false;
+
+    ++statistics.interruptedCount;
+    Remove(animation);
+    return true;
+}
+
+bool AnimationScheduler::IsAnimating(const void* key) const
+{
+    return Find(key) != nullptr;
+}
+
+bool AnimationScheduler::GetValue(const void* key, float* value) const
+{
+    assert(value);
+
+    const Animation* animation = Find(key);
+    if (animation == nullptr)
+        return false;
+
+    *value = animation->value;
+    return true;
+}
+
+bool AnimationScheduler::Tick(double now)
+{
+    ++statistics.tickCount;
+
+    // Callbacks may start or stop animations, which moves them in the array, so animations that were running
+    // when tick started are looked up by id.
+    uint32_t ids[Capacity];
+    uint32_t idCount = animationCount;
+    for (uint32_t i = 0; i < animationCount; ++i)
+        ids[i] = animations[i].id;
+
+    for (uint32_t i = 0; i < idCount; ++i)
+    {
+        Animation* animation = FindById(ids[i]);
+        if (animation == nullptr)
+            continue;
+
+        double elapsed = now - animation->startTime;
+        float value = animation->track.Evaluate(elapsed);
+        bool isCompleted = elapsed >= animation->track.GetDuration();
+
+        if (!animation->isApplied || value != animation->value)
+        {
+            animation->value = value;
+            animation->isApplied = true;
+            ++statistics.applyCount;
+            animation->apply(animation->key, value, animation->userdata);
+
+            animation = FindById(ids[i]);
+            if (animation == nullptr)
+                continue;
+        }
+
+        if (isCompleted)
+        {
+            const void* key = animation->key;
+            AnimationCompletedCallback completed = animation->completed;
+            void* userdata = animation->userdata;
+
+            Remove(animation);
+            ++statistics.completedCount;
+
+            if (completed != nullptr)
+                completed(key, userdata);
+        }
+    }
+
+    return animationCount > 0;
+}
+
+uint32_t AnimationScheduler::GetAnimationCount() const
+{
+    return animationCount;
+}
+
+AnimationScheduler::Animation* AnimationScheduler::Find(const void* key)
+{
+    for (uint32_t i = 0; i < animationCount; ++i)
+    {
+        if (animations[i].key == key)
+            return &animations[i];
+    }
+
+    return nullptr;
+}
+
+const AnimationScheduler::Animation* AnimationScheduler::Find(const void* key) const
+{
+    return const_cast<AnimationScheduler*>(this)->Find(key);
+}
+
+AnimationScheduler::Animation* AnimationScheduler::FindById(uint32_t id)
+{
+    for (uint32_t i = 0; i < animationCount; ++i)
+    {
+        if (animations[i].id == id)
+            return &animations[i];
+    }
+
+    return nullptr;
+}
+
+void AnimationScheduler::Remove(Animation* animation)
+{
+    assert(animation >= animations && animation < animations + animationCount);
+
+    *animation = animations[animationCount - 1];
+    --animationCount;
+}
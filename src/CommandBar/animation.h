@@ -0,0 +1,144 @@
+#pragma once
+#include <stdint.h>
+
+
+/**
+ * Describes how value changes between two keyframes.
+ */
+enum class Easing
+{
+    Linear = 0,
+    EaseInQuad,
+    EaseOutQuad,
+    EaseInOutCubic,
+};
+
+/**
+ * Maps linear progress in [0, 1] to eased progress in [0, 1].
+ */
+float ApplyEasing(Easing easing, float progress);
+
+struct AnimationKeyframe
+{
+    /** Time since animation start, in seconds. */
+    double time = 0.0;
+    float value = 0.0f;
+
+    /** Easing of segment that ends at this keyframe. */
+    Easing easing = Easing::Linear;
+};
+
+/**
+ * Value of animated property over time, defined by keyframes in increasing order of time.
+ */
+struct AnimationTrack
+{
+    static const uint32_t MaxKeyframes = 4;
+
+    AnimationKeyframe keyframes[MaxKeyframes];
+    uint32_t keyframeCount = 0;
+
+    /**
+     * Appends keyframe. Returns false if track is full or keyframe is earlier than last one.
+     */
+    bool AddKeyframe(double time, float value, Easing easing = Easing::Linear);
+
+    /** Returns time of last keyframe. */
+    double GetDuration() const;
+
+    /**
+     * Returns value at specified time since animation start. Before first keyframe returns its value,
+     * after last keyframe returns its value.
+     */
+    float Evaluate(double time) const;
+};
+
+typedef void(*AnimationApplyCallback)(const void* key, float value, void* userdata);
+typedef void(*AnimationCompletedCallback)(const void* key, void* userdata);
+
+struct AnimationStatistics
+{
+    uint32_t startedCount = 0;
+    uint32_t completedCount = 0;
+
+    /** Animations that were stopped or replaced by another animation of the same key before they completed. */
+    uint32_t interruptedCount = 0;
+    uint32_t tickCount = 0;
+    uint32_t applyCount = 0;
+};
+
+/**
+ * Runs animations of properties identified by key (for example, window handle) without blocking: owner calls Tick()
+ * from a single timer or vsync tick while animations are running, and scheduler applies current values through
+ * callbacks. Time is passed in by caller in seconds, so scheduler doesn't depend on platform clock.
+ *
+ * Every key has at most one animation. Starting animation of a key that is already animated replaces running
+ * animation, so it can be retargeted in flight, e.g. window that is fading out can fade in again from its current
+ * alpha. Replaced and stopped animations don't call their completion callback.
+ *
+ * Callbacks may start and stop animations, including their own.
+ */
+struct AnimationScheduler
+{
+    static const uint32_t Capacity = 16;
+
+    AnimationStatistics statistics;
+
+    /**
+     * Starts animation of specified key, replacing its running animation. Value at start time is applied by next
+     * Tick() call. Returns false if there are no free slots.
+     */
+    bool Start(const void* key, const AnimationTrack& track, AnimationApplyCallback apply,
+        AnimationCompletedCallback completed, void* userdata, double now);
+
+    /**
+     * Animates key to target value from its current value if it is already animated, or from specified value
+     * otherwise. Duration is time of animation over whole [from, target] range: it is shortened in proportion
+     * to the remaining distance, so retargeted animation keeps its speed.
+     */
+    bool AnimateTo(const void* key, float from, float target, double duration, Easing easing,
+        AnimationApplyCallback apply, AnimationCompletedCallback completed, void* userdata, double now);
+
+    /**
+     * Stops animation of specified key where it is, without calling completion callback.
+     * Returns false if key is not animated.
+     */
+    bool Stop(const void* key);
+
+    bool IsAnimating(const void* key) const;
+
+    /**
+     * Retrieves current value of animated key. Returns false if key is not animated.
+     */
+    bool GetValue(const void* key, float* value) const;
+
+    /**
+     * Applies values of all animations at specified time and completes animations that reached their last keyframe.
+     * Returns true if there are still running animations, so owner should keep ticking.
+     */
+    bool Tick(double now);
+
+    uint32_t GetAnimationCount() const;
+private:
+    struct Animation
+    {
+        uint32_t id;
+        const void* key;
+        AnimationTrack track;
+        double startTime;
+        float value;
+        bool isApplied;
+        AnimationApplyCallback apply;
+        AnimationCompletedCallback completed;
+        void* userdata;
+    };
+
+    Animation animations[Capacity];
+    uint32_t animationCount = 0;
+    uint32_t nextId = 1;
+
+    Animation* Find(const void* key);
+    const Animation* Find(const void* key) const;
+    Animation* FindById(uint32_t id);
+    void Remove(Animation* animation);
+};
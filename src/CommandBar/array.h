@@ -1,6 +1,7 @@
 #pragma once
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "common.h"
 #include "allocators.h"
@@ -94,7 +95,7 @@ struct Array
         }
         else
         {
-            memcpy(&data[index], &data[index + 1], sizeof(T) * (count - 1 - index));
+            memmove(&data[index], &data[index + 1], sizeof(T) * (count - 1 - index));
             --count;
         }
     }
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <string.h>
+
+#include "autocompletion_list.h"
+
+
+void AutocompletionList::SetCandidates(Command* const* candidates, uint32_t count)
+{
+    assert(candidates || count == 0);
+
+    // Candidate array may be already modified in place, so selected command is taken from copy of visible rows.
+    Command* selected = GetSelected();
+    this->candidates = candidates;
+    candidateCount = count;
+
+    // Look for selected command only among visible rows, so update doesn't depend on candidate count.
+    uint32_t visibleEnd = firstVisibleIndex + visibleRowLimit;
+    if (visibleEnd > count)
+        visibleEnd = count;
+
+    for (uint32_t i = firstVisibleIndex; i < visibleEnd; ++i)
+    {
+        if (candidates[i] == selected)
+        {
+            Select(i);
+            return;
+        }
+    }
+
+    firstVisibleIndex = 0;
+    Select(0);
+}
+
+void AutocompletionList::Clear()
+{
+    SetCandidates(nullptr, 0);
+}
+
+bool AutocompletionList::SelectNext()
+{
+    if (candidateCount == 0)
+        return false;
+
+    Select(selectedIndex + 1 < candidateCount ? selectedIndex + 1 : 0);
+    return true;
+}
+
+bool AutocompletionList::SelectPrev()
+{
+    if (candidateCount == 0)
+        return false;
+
+    Select(selectedIndex > 0 ? selectedIndex - 1 : candidateCount - 1);
+    return true;
+}
+
+bool AutocompletionList::SelectRow(uint32_t row)
+{
+    if (row >= rowCount)
+        return false;
+
+    Select(firstVisibleIndex + row);
+    return true;
+}
+
+Command* AutocompletionList::GetSelected() const
+{
+    return rowCount > 0 ? rows[selectedIndex - firstVisibleIndex] : nullptr;
+}
+
+uint32_t AutocompletionList::GetSelectedRow() const
+{
+    assert(candidateCount > 0);
+    return selectedIndex - firstVisibleIndex;
+}
+
+void AutocompletionList::Select(uint32_t index)
+{
+    assert(index == 0 || index < candidateCount);
+    assert(visibleRowLimit > 0 && visibleRowLimit <= MaxVisibleRows);
+
+    uint32_t previousSelectedIndex = selectedIndex;
+    uint32_t previousFirstVisibleIndex = firstVisibleIndex;
+
+    selectedIndex = index;
+
+    if (selectedIndex < firstVisibleIndex)
+        firstVisibleIndex = selectedIndex;
+    else if (selectedIndex >= firstVisibleIndex + visibleRowLimit)
+        firstVisibleIndex = selectedIndex - visibleRowLimit + 1;
+
+    // List that has fewer candidates after update doesn't stay scrolled past the last one.
+    if (firstVisibleIndex + visibleRowLimit > candidateCount)
+        firstVisibleIndex = candidateCount > visibleRowLimit ? candidateCount - visibleRowLimit : 0;
+
+    bool isChanged = UpdateRows();
+    if (isChanged || selectedIndex != previousSelectedIndex || firstVisibleIndex != previousFirstVisibleIndex)
+        ++revision;
+}
+
+bool AutocompletionList::UpdateRows()
+{
+    uint32_t count = candidateCount - firstVisibleIndex;
+    if (count > visibleRowLimit)
+        count = visibleRowLimit;
+
+    if (count == rowCount && (count == 0 || memcmp(rows, candidates + firstVisibleIndex, count * sizeof(rows[0])) == 0))
+        return false;
+
+    if (count > 0)
+        memcpy(rows, candidates + firstVisibleIndex, count * sizeof(rows[0]));
+    rowCount = count;
+
+    return true;
+}
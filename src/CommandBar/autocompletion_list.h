@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+
+
+struct Command;
+
+/**
+ * Dropdown of ranked autocompletion candidates with keyboard navigation. Only a window of visible rows is kept
+ * outside of candidate array, so showing a few rows of a large amount of candidates costs the same as showing one.
+ * Doesn't depend on window or graphics API.
+ */
+struct AutocompletionList
+{
+    static const uint32_t MaxVisibleRows = 16;
+
+    /**
+     * Maximum number of rows that are shown at the same time, not greater than MaxVisibleRows.
+     */
+    uint32_t visibleRowLimit = 8;
+
+    /**
+     * Ranked candidates, see CommandEngine::FindAutocompletionCandidates(). Owned by command engine.
+     */
+    Command* const* candidates = nullptr;
+    uint32_t candidateCount = 0;
+
+    /** Index of selected candidate. */
+    uint32_t selectedIndex = 0;
+
+    /** Index of candidate that is shown at the first row. */
+    uint32_t firstVisibleIndex = 0;
+
+    /** Candidates that are shown, starting from firstVisibleIndex. */
+    Command* rows[MaxVisibleRows];
+    uint32_t rowCount = 0;
+
+    /**
+     * Incremented every time shown rows or selection change.
+     */
+    uint32_t revision = 0;
+
+    /**
+     * Replaces candidates. Selection stays at the same command if it is still visible, otherwise first candidate is selected.
+     */
+    void SetCandidates(Command* const* candidates, uint32_t count);
+
+    /**
+     * Removes all candidates, hiding the list.
+     */
+    void Clear();
+
+    /**
+     * Moves selection to next or previous candidate, wrapping around at the ends, and scrolls list to keep it visible.
+     * Returns false if list is empty.
+     */
+    bool SelectNext();
+    bool SelectPrev();
+
+    /**
+     * Selects candidate shown at specified row. Returns false if there is no such row.
+     */
+    bool SelectRow(uint32_t row);
+
+    /**
+     * Returns selected candidate, or null pointer if list is empty.
+     */
+    Command* GetSelected() const;
+
+    /**
+     * Returns row of selected candidate. List must not be empty.
+     */
+    uint32_t GetSelectedRow() const;
+private:
+    void Select(uint32_t index);
+
+    /** Copies visible candidates to rows, returns true if rows changed. */
+    bool UpdateRows();
+};
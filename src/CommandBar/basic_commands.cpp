@@ -1,9 +1,12 @@
 #include <assert.h>
 
 #include "basic_commands.h"
+#include "command_line.h"
 #include "command_loader.h"
 #include "command_window.h"
 #include "parse_utils.h"
+#include "process_launcher.h"
+#include "string_format.h"
 #include "defer.h"
 
 Command* runApp_createCommand(CreateCommandState* state, Array<Newstring>& keys, Array<Newstring>& values);
@@ -13,7 +16,9 @@ Command* quit_createCommand(CreateCommandState* state, Array<Newstring>& keys, A
 
 Command* openDir_createCommand(CreateCommandState* state, Array<Newstring>& keys, Array<Newstring>& values)
 {
+    assert(state->stringPool);
     OpenDirCommand* cmd = Memnew(OpenDirCommand);
+    Newstring argDirPath;
 
     for (uint32_t i = 0; i < keys.count; ++i)
     {
@@ -22,7 +27,7 @@ Command* openDir_createCommand(CreateCommandState* state, Array<Newstring>& keys
 
         if (key == L"path")
         {
-            cmd->dirPath = value;
+            argDirPath = value;
             break;
         }
         else
@@ -31,23 +36,60 @@ Command* openDir_createCommand(CreateCommandState* state, Array<Newstring>& keys
         }
     }
 
-    assert(!Newstring::IsNullOrEmpty(cmd->dirPath));
-    cmd->dirPath = cmd->dirPath.Clone();
+    assert(!Newstring::IsNullOrEmpty(argDirPath));
+    bool ok = state->stringPool->Add(argDirPath, &cmd->dirPath);
+    assert(ok);
 
     return cmd;
 }
 
 OpenDirCommand::~OpenDirCommand()
 {
-    dirPath.Dispose();
+}
+
+/**
+ * Opens Explorer window with specified folder selected. Error message is set if folder can't be opened.
+ */
+static bool selectFolder(ExecuteCommandState* state, wchar_t* folder)
+{
+    if (!OSUtils::DirectoryExists(folder))
+    {
+        state->SetErrorMessage(FORMAT_STRING(state->allocator, L"Folder \"{}\" does not exist.", folder));
+
+        return false;
+    }
+
+    PIDLIST_ABSOLUTE itemID = ::ILCreateFromPathW(folder);
+    if (itemID == nullptr)
+    {
+        Newstring osError = OSUtils::FormatErrorCode(GetLastError(), 0, state->allocator);
+        state->SetErrorMessage(FORMAT_STRING(state->allocator, L"Cannot get directory identifier: {}", osError));
+
+        return false;
+    }
+    defer(ILFree(itemID));
+
+    HRESULT result = ::SHOpenFolderAndSelectItems(itemID, 1, (LPCITEMIDLIST*)&itemID, 0);
+    if (FAILED(result))
+    {
+        state->SetErrorMessage(FORMAT_STRING(state->allocator, L"Cannot select directory, error code was 0x{:08X}.", static_cast<uint32_t>(result)));
+
+        return false;
+    }
+
+    return true;
 }
 
 bool OpenDirCommand::Execute(ExecuteCommandState* state, Array<Newstring>& args)
 {
+    assert(engine);
+
+    // Path and strings used to format error message are released when folder is opened, only error message is kept.
+    TempAllocatorScope pathScope(state->allocator);
     Newstring folder;
     Newstring subfolder;
 
-    if (Newstring::IsNullOrEmpty(dirPath))
+    if (dirPath.size == 0)
     {
         if (args.count == 0)
             return false;
@@ -56,7 +98,7 @@ bool OpenDirCommand::Execute(ExecuteCommandState* state, Array<Newstring>& args)
     }
     else
     {
-        folder = this->dirPath;
+        folder = set->stringPool.Decode(dirPath, state->allocator);
         if (args.count > 0)
         {
             subfolder = args.data[0];
@@ -70,7 +112,7 @@ bool OpenDirCommand::Execute(ExecuteCommandState* state, Array<Newstring>& args)
 
     if (!Newstring::IsNullOrEmpty(subfolder))
     {
-        wchar_t* result = (wchar_t*)g_tempAllocator.Allocate(sizeof(wchar_t) * (folder.count + 1 + subfolder.count + 1));
+        wchar_t* result = (wchar_t*)state->allocator->Allocate(sizeof(wchar_t) * (folder.count + 1 + subfolder.count + 1));
         uint32_t now = 0;
 
         memcpy(&result[now], folder.data, folder.count * sizeof(wchar_t));
@@ -89,37 +131,21 @@ bool OpenDirCommand::Execute(ExecuteCommandState* state, Array<Newstring>& args)
 
         actualFolder = result;
     }
-    else
-    {
-        actualFolder = folder.CloneAsCString(&g_tempAllocator);
-    }
-
-    if (!OSUtils::DirectoryExists(actualFolder))
+    else if (dirPath.size > 0)
     {
-        state->FormatErrorMessage(L"Folder \"%s\" does not exist.", actualFolder);
-
-        return false;
+        // Decoded path is already zero-terminated.
+        actualFolder = folder.data;
     }
-
-    PIDLIST_ABSOLUTE itemID = ::ILCreateFromPathW(actualFolder);
-    if (itemID == nullptr)
+    else
     {
-        Newstring osError = OSUtils::FormatErrorCode(GetLastError(), 0, &g_tempAllocator);
-        state->FormatErrorMessage(L"Cannot get directory identifier: %.*s", osError.count, osError.data);
-
-        return false;
+        actualFolder = folder.CloneAsCString(state->allocator);
     }
-    defer(ILFree(itemID));
 
-    HRESULT result = ::SHOpenFolderAndSelectItems(itemID, 1, (LPCITEMIDLIST*)&itemID, 0);
-    if (FAILED(result))
-    {
-        state->FormatErrorMessage(L"Cannot select directory, error code was 0x%08X.", result);
+    bool isSelected = selectFolder(state, actualFolder);
+    if (!isSelected)
+        state->errorMessage = pathScope.Keep(state->errorMessage);
 
-        return false;
-    }
-
-    return true;
+    return isSelected;
 }
 
 void RegisterBuiltinCommands(CommandLoader* loader)
@@ -129,7 +155,7 @@ void RegisterBuiltinCommands(CommandLoader* loader)
     Array<CommandInfo*>& cmds = loader->commandInfoArray;
 
     static CommandInfo bc[] = {
-        CommandInfo(Newstring::WrapConstWChar(L"open_dir"), CI_None, openDir_createCommand),
+        CommandInfo(Newstring::WrapConstWChar(L"open_dir"), CI_OwnerThreadOnly, openDir_createCommand),
         CommandInfo(Newstring::WrapConstWChar(L"run_app"),  CI_None, runApp_createCommand)
     };
 
@@ -141,6 +167,7 @@ void RegisterBuiltinCommands(CommandLoader* loader)
 bool parseShowType(const Newstring& value, int* showType);
 Command* runApp_createCommand(CreateCommandState* state, Array<Newstring>& keys, Array<Newstring>& values)
 {
+    assert(state->stringPool);
     RunAppCommand* cmd = Memnew(RunAppCommand);
     if (cmd == nullptr) return nullptr;
 
@@ -186,120 +213,71 @@ Command* runApp_createCommand(CreateCommandState* state, Array<Newstring>& keys,
     if (cmd->asAdmin == true)
         assert(cmd->shellExec);
 
-    // Reallocate strings, because right now they are references to data that may be deleted or modified.
-    cmd->appPath = argAppPath.Trimmed().CloneAsCString();
-    cmd->appArgs = argAppArgs.Trimmed().CloneAsCString();
-    cmd->workDir = argWorkDir.Trimmed().CloneAsCString();
+    // Copy strings to pool, because right now they are references to data that may be deleted or modified.
+    Utf8StringPool* pool = state->stringPool;
+    bool ok = pool->Add(argAppPath.Trimmed(), &cmd->appPath)
+        && pool->Add(argAppArgs.Trimmed(), &cmd->appArgs)
+        && pool->Add(argWorkDir.Trimmed(), &cmd->workDir);
+    assert(ok);
 
     return cmd;
 }
 
-static bool runProcess(const wchar_t* path, wchar_t* commandLine);
-static bool shellExecute(const wchar_t* path, const wchar_t* verb, const wchar_t* params, const wchar_t* workDir, int nShow);
-
 RunAppCommand::~RunAppCommand()
 {
-    auto a = &g_standardAllocator;
-    a->Deallocate(appPath);
-    a->Deallocate(appArgs);
-    a->Deallocate(workDir);
 }
 
 bool RunAppCommand::Execute(ExecuteCommandState* state, Array<Newstring>& args)
 {
-    // @TODO: Test 'runProcess' with args.
-    // @TODO: Make workDir work with 'runProcess'.
-
-    wchar_t* workDir = this->workDir;
-    wchar_t* execAppParamsStr = nullptr;
-    bool shouldDeallocateAppParams = false;
-
-    if (args.count == 0 && (appArgs == nullptr || wcslen(appArgs) == 0))
-    {
-        // We don't have any params to pass.
-        execAppParamsStr = nullptr;
-    }
-    else if (args.count == 0 && (appArgs != nullptr && wcslen(appArgs) != 0))
-    {
-        execAppParamsStr = appArgs;
-    }
-    else
+    assert(engine);
+
+    // Strings are decoded to temporary memory, launch request copies them.
+    const Utf8StringPool& pool = set->stringPool;
+    Newstring path = pool.Decode(appPath, state->allocator);
+    Newstring workDirectory = pool.Decode(workDir, state->allocator);
+    Newstring arguments = pool.Decode(appArgs, state->allocator);
+    if (path.count == 0 || (workDir.size > 0 && workDirectory.count == 0) || (appArgs.size > 0 && arguments.count == 0))
     {
-        // @TODO: Rewrite with NewstringBuilder.
-
-        int dataSize = 1; // Terminating zero.
-        if (appArgs != nullptr && wcslen(appArgs) != 0)
-            dataSize += wcslen(appArgs) + 1; // Include one space character for user-defined app args.
-        for (uint32_t i = 0; i < args.count; ++i)
-            dataSize += args.data[i].count;
-        dataSize += args.count * 3; // Include one space character and two brackets for each arg.
-        dataSize *= sizeof(wchar_t);
-
-        assert(dataSize >= 1);
-        
-        execAppParamsStr = static_cast<wchar_t*>(g_standardAllocator.Allocate(dataSize));
-        assert(execAppParamsStr);
-        shouldDeallocateAppParams = true;
-
-        int i = 0;
-        if (appArgs != nullptr && wcslen(appArgs) != 0)
-        {
-            memcpy(&execAppParamsStr[i], appArgs, wcslen(appArgs) * sizeof(wchar_t));
-            i += wcslen(appArgs);
-            execAppParamsStr[i] = L' ';
-            i += 1;
-        }
-
-        for (uint32_t argIndex = 0; argIndex < args.count; ++argIndex)
-        {
-            const Newstring& arg = args.data[argIndex];
-
-            execAppParamsStr[i] = L'"';
-            i += 1;
-
-            memcpy(&execAppParamsStr[i], arg.data, arg.count * sizeof(wchar_t));
-            i += arg.count;
-
-            execAppParamsStr[i] = L'"';
-            i += 1;
-            execAppParamsStr[i] = L' ';
-            i += 1;
-        }
-
-        execAppParamsStr[i] = L'\0';
-        i += 1;
-
-        assert(i * sizeof(wchar_t) == dataSize);
+        state->SetErrorMessage(Newstring::WrapConstWChar(L"Unable to run application: out of memory."));
+        return false;
     }
 
-    bool result = false;
-    if (shellExec)
+    Newstring parameters = CommandLine::BuildWindowsCommandLine(arguments, args.data, args.count, state->allocator);
+    if (parameters.count == 0 && (arguments.count > 0 || args.count > 0))
     {
-        result = shellExecute(appPath, asAdmin ? L"runas" : nullptr, execAppParamsStr, workDir, this->shellExec_nShow);
+        state->SetErrorMessage(Newstring::WrapConstWChar(L"Unable to run application: out of memory."));
+        return false;
     }
-    else
-    {
-        assert(workDir == nullptr);
 
-        result = runProcess(appPath, execAppParamsStr);
+    LaunchRequest* request = ProcessLauncher::CreateRequest(path.data, parameters.data, workDirectory.data);
+    if (request == nullptr)
+    {
+        state->SetErrorMessage(Newstring::WrapConstWChar(L"Unable to run application: out of memory."));
+        return false;
     }
 
-    DWORD error = GetLastError();
-    if (error == ERROR_CANCELLED)
-        result = true;
+    request->shellExec = shellExec;
+    request->asAdmin = asAdmin;
+    request->nShow = shellExec_nShow;
 
-    if (!result)
+    if (state->isLaunchDeferred)
     {
-        Newstring osError = OSUtils::FormatErrorCode(error, 0, &g_tempAllocator);
-        state->FormatErrorMessage(L"Unable to run application: %.*s", osError.count, osError.data);
+        // Engine submits request to launcher, result of command arrives when launch is completed.
+        state->launch = request;
+        return true;
     }
 
-    if (shouldDeallocateAppParams)
+    LaunchProcess(request);
+    defer(ProcessLauncher::DestroyRequest(request));
+
+    if (!request->succeeded)
     {
-        g_standardAllocator.Deallocate(execAppParamsStr);
+        Newstring osError = OSUtils::FormatErrorCode(request->errorCode, 0, state->allocator);
+        state->SetErrorMessage(FORMAT_STRING(state->allocator, L"Unable to run application: {}", osError));
+        return false;
     }
 
-    return result;
+    return true;
 }
 
 bool parseShowType(const Newstring& value, int* showType)
@@ -315,52 +293,6 @@ bool parseShowType(const Newstring& value, int* showType)
     return false;
 }
 
-static bool runProcess(const wchar_t* path, wchar_t* commandLine)
-{
-    assert(path);
-
-    STARTUPINFOW startupInfo = { sizeof(startupInfo), 0 };
-    PROCESS_INFORMATION processInfo = { 0 };
-
-    SetLastError(0);
-    bool success = 0 != CreateProcessW(
-        path,
-        commandLine,
-        nullptr,
-        nullptr,
-        true,
-        NORMAL_PRIORITY_CLASS,
-        nullptr,
-        nullptr,
-        &startupInfo,
-        &processInfo);
-
-    if (success)
-    {
-        CloseHandle(processInfo.hThread);
-        CloseHandle(processInfo.hProcess);
-    }
-
-    return success;
-}
-
-static bool shellExecute(const wchar_t* path, const wchar_t* verb, const wchar_t* params, const wchar_t* workDir, int nShow)
-{
-    assert(path);
-
-    SHELLEXECUTEINFOW info = { 0 };
-    info.cbSize = sizeof(info);
-    info.lpVerb = verb;
-    info.lpFile = path;
-    info.hwnd = 0;
-    info.lpParameters = params;
-    info.nShow = nShow;
-    info.lpDirectory = workDir;
-
-    SetLastError(0);
-    return !!ShellExecuteExW(&info);
-}
-
 Command* quit_createCommand(CreateCommandState* state, Array<Newstring>& keys, Array<Newstring>& values)
 {
     return Memnew(QuitCommand);
@@ -20,9 +20,10 @@ struct QuitCommand : public Command
     virtual bool Execute(ExecuteCommandState* state, Array<Newstring>& args) override;
 };
 
+/** Strings of built-in commands are stored in string pool of command set and decoded when command is executed. */
 struct OpenDirCommand : public Command
 {
-    Newstring dirPath;
+    Utf8StringRef dirPath;
 
     virtual ~OpenDirCommand() override;
 
@@ -31,9 +32,11 @@ struct OpenDirCommand : public Command
 
 struct RunAppCommand : public Command
 {
-    wchar_t* appPath;
-    wchar_t* appArgs;
-    wchar_t* workDir;
+    Utf8StringRef appPath;
+    Utf8StringRef workDir;
+
+    /** Arguments from commands file. They are already quoted, so they are copied to command line as is. */
+    Utf8StringRef appArgs;
 
     bool shellExec = false;
     bool asAdmin = false;
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+#include "bench.h"
+#include "command_set.h"
+#include "string_format.h"
+#include "unicode.h"
+#include "defer.h"
+
+
+namespace Bench
+{
+
+uint64_t GetTimeNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+bool LatencyHistogram::Reserve(uint32_t sampleCount)
+{
+    return samples.Reserve(sampleCount);
+}
+
+void LatencyHistogram::Add(uint64_t sampleNs)
+{
+    samples.Append(sampleNs);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile)
+{
+    if (samples.count == 0)  return 0;
+
+    std::sort(samples.data, samples.data + samples.count);
+
+    double rank = percentile / 100.0 * (samples.count - 1);
+    uint32_t index = static_cast<uint32_t>(rank + 0.5);
+    if (index >= samples.count)
+        index = samples.count - 1;
+
+    return samples.data[index];
+}
+
+uint64_t LatencyHistogram::GetMax() const
+{
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < samples.count; ++i)
+        result = std::max(result, samples.data[i]);
+
+    return result;
+}
+
+void LatencyHistogram::Print(const char* name)
+{
+    printf("%-24s n=%-8u p50=%10.3f us  p99=%10.3f us  max=%10.3f us  allocs=%llu\n",
+        name,
+        samples.count,
+        GetPercentile(50.0) / 1000.0,
+        GetPercentile(99.0) / 1000.0,
+        GetMax() / 1000.0,
+        static_cast<unsigned long long>(allocationCount));
+}
+
+void LatencyHistogram::Clear()
+{
+    samples.Clear();
+    allocationCount = 0;
+}
+
+void LatencyHistogram::Dispose()
+{
+    samples.Dispose();
+    allocationCount = 0;
+}
+
+void Sample::Begin(LatencyHistogram* histogram)
+{
+    assert(histogram);
+
+    this->histogram = histogram;
+    startAllocationCount = g_standardAllocator.allocationCount;
+    startTime = GetTimeNs();
+}
+
+void Sample::End()
+{
+    uint64_t endTime = GetTimeNs();
+    assert(histogram);
+
+    histogram->allocationCount += g_standardAllocator.allocationCount - startAllocationCount;
+    histogram->Add(endTime - startTime);
+    histogram = nullptr;
+}
+
+Newstring ReadTextFile(const char* fileName)
+{
+    assert(fileName);
+
+    FILE* file = fopen(fileName, "rb");
+    if (!file)  return Newstring::Empty();
+    defer(fclose(file));
+
+    if (fseek(file, 0, SEEK_END) != 0)  return Newstring::Empty();
+    long size = ftell(file);
+    if (size <= 0 || fseek(file, 0, SEEK_SET) != 0)  return Newstring::Empty();
+
+    void* data = g_standardAllocator.Allocate(static_cast<uintptr_t>(size));
+    if (!data)  return Newstring::Empty();
+    defer(g_standardAllocator.Deallocate(data));
+
+    if (fread(data, 1, static_cast<size_t>(size), file) != static_cast<size_t>(size))
+        return Newstring::Empty();
+
+    return Unicode::DecodeString(data, static_cast<uint32_t>(size), Encoding::UTF8);
+}
+
+void Checks::Check(bool condition, const char* description)
+{
+    ++checkCount;
+    if (condition)  return;
+
+    ++failedCount;
+    printf("FAILED: %s\n", description);
+}
+
+void Checks::Print() const
+{
+    printf("checks: %u passed, %u failed\n", checkCount - failedCount, failedCount);
+}
+
+const wchar_t* const ProbeWords[] = { L"notepad", L"chrome", L"terminal", L"steam", L"\u043F\u0430\u043F\u043A\u0430", L"explorer", L"calc" };
+const uint32_t ProbeWordCount = sizeof(ProbeWords) / sizeof(ProbeWords[0]);
+
+Newstring FormatProbeCommandName(uint32_t index, IAllocator* allocator)
+{
+    return FORMAT_STRING(allocator, L"{}-{}", ProbeWords[index % ProbeWordCount], index);
+}
+
+bool ProbeCommand::Execute(ExecuteCommandState* state, Array<Newstring>& args)
+{
+    if (args.count == 0 || args.data[0] != L"fail")
+        return true;
+
+    state->SetErrorMessage(FORMAT_STRING(state->allocator, L"{} failed with {} arguments.", name, args.count));
+    return false;
+}
+
+bool RegisterProbeCommands(CommandEngine* engine, CommandSet* set, uint32_t commandCount)
+{
+    assert(engine);
+    assert(set);
+
+    for (uint32_t i = 0; i < commandCount; ++i)
+    {
+        ProbeCommand* command = Memnew(ProbeCommand);
+        command->name = FormatProbeCommandName(i);
+        if (!engine->RegisterCommand(set, command))
+        {
+            Memdelete(command);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CommandSet* BuildProbeCommandSet(CommandEngine* engine, uint32_t commandCount)
+{
+    CommandSet* set = Memnew(CommandSet);
+    if (!RegisterProbeCommands(engine, set, commandCount))
+    {
+        set->Dispose();
+        Memdelete(set);
+        return nullptr;
+    }
+
+    return set;
+}
+
+void AppendProbeCommandsSource(NewstringBuilder* source, uint32_t commandCount)
+{
+    assert(source);
+
+    for (uint32_t i = 0; i < commandCount; ++i)
+    {
+        const wchar_t* word = ProbeWords[i % ProbeWordCount];
+        FORMAT_APPEND(source, L"[run_app]\nname={}-{}\npath=C:\\Program Files\\{}\\{}.exe\nargs=--profile {}\nwork_dir=C:\\Users\\user\\{}\n",
+            word, i, word, word, i, word);
+    }
+}
+
+} // namespace Bench
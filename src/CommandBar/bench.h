@@ -0,0 +1,144 @@
+#pragma once
+#include <stdint.h>
+
+#include "array.h"
+#include "newstring.h"
+#include "newstring_builder.h"
+#include "command_engine.h"
+
+
+/** Contains utilities shared by benchmark suites of CommandBarBench. */
+namespace Bench
+{
+
+/**
+ * Returns monotonic clock value in nanoseconds.
+ */
+uint64_t GetTimeNs();
+
+/**
+ * Collects latency samples and reports their distribution.
+ */
+struct LatencyHistogram
+{
+    /**
+     * Recorded samples, in nanoseconds.
+     */
+    Array<uint64_t> samples;
+
+    /**
+     * Number of allocations made by standard allocator while samples were recorded.
+     */
+    uint64_t allocationCount = 0;
+
+    /**
+     * Reserves storage for specified amount of samples, so recording them does not allocate.
+     */
+    bool Reserve(uint32_t sampleCount);
+
+    /**
+     * Records single sample.
+     */
+    void Add(uint64_t sampleNs);
+
+    /**
+     * Returns sample value at specified percentile (0..100). Sorts recorded samples.
+     * If there are no samples, returns 0.
+     */
+    uint64_t GetPercentile(double percentile);
+
+    /**
+     * Returns maximum recorded sample. If there are no samples, returns 0.
+     */
+    uint64_t GetMax() const;
+
+    /**
+     * Prints p50/p99/max and allocation count to standard output.
+     */
+    void Print(const char* name);
+
+    /**
+     * Resets recorded samples and allocation count.
+     */
+    void Clear();
+
+    /**
+     * Deallocates sample storage.
+     */
+    void Dispose();
+};
+
+/**
+ * Measures time and standard allocator allocations between Begin() and End() and records them to histogram.
+ */
+struct Sample
+{
+    LatencyHistogram* histogram = nullptr;
+    uint64_t startTime = 0;
+    uintptr_t startAllocationCount = 0;
+
+    void Begin(LatencyHistogram* histogram);
+    void End();
+};
+
+/**
+ * Reads UTF-8 text file and decodes it to UTF-16 string using standard allocator.
+ * In case of error, returns empty string.
+ */
+Newstring ReadTextFile(const char* fileName);
+
+/**
+ * Counts self-checks of suite and prints descriptions of failed ones. Suite exits with code 1 if any check failed.
+ */
+struct Checks
+{
+    uint32_t checkCount = 0;
+    uint32_t failedCount = 0;
+
+    void Check(bool condition, const char* description);
+
+    /**
+     * Prints number of passed and failed checks to standard output.
+     */
+    void Print() const;
+
+    int GetExitCode() const { return failedCount == 0 ? 0 : 1; }
+};
+
+/**
+ * Words that names of generated commands are made of: mostly ASCII and one Cyrillic word, as in real commands files.
+ */
+extern const wchar_t* const ProbeWords[];
+extern const uint32_t ProbeWordCount;
+
+/**
+ * Returns name of generated command with specified index, e.g. "calc-6" for index 6.
+ */
+Newstring FormatProbeCommandName(uint32_t index, IAllocator* allocator = &g_standardAllocator);
+
+/**
+ * Generated command. Execution does nothing and succeeds, unless first argument is "fail": then error message is
+ * formatted using allocator of execution state and execution fails.
+ */
+struct ProbeCommand : public Command
+{
+    virtual bool Execute(ExecuteCommandState* state, Array<Newstring>& args) override;
+};
+
+/**
+ * Registers generated commands with indices from 0 to commandCount - 1 within command set.
+ * Returns false if memory couldn't be allocated.
+ */
+bool RegisterProbeCommands(CommandEngine* engine, CommandSet* set, uint32_t commandCount);
+
+/**
+ * Builds command set of generated commands. Returns null pointer if memory couldn't be allocated.
+ */
+CommandSet* BuildProbeCommandSet(CommandEngine* engine, uint32_t commandCount);
+
+/**
+ * Appends commands file source of generated run_app commands with paths, arguments and working directories.
+ */
+void AppendProbeCommandsSource(NewstringBuilder* source, uint32_t commandCount);
+
+} // namespace Bench
@@ -0,0 +1,3315 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "bench.h"
+#include "headless_driver.h"
+#include "gap_buffer.h"
+#include "text_edit.h"
+#include "process_launcher.h"
+#include "software_renderer.h"
+#include "render_state.h"
+#include "autocompletion_list.h"
+#include "animation.h"
+#include "string_format.h"
+#include "parse_utils.h"
+#include "unicode.h"
+#include "command_engine.h"
+#include "command_loader.h"
+#include "command_image.h"
+#include "command_line.h"
+#include "mapped_file.h"
+#include "trace.h"
+#include "defer.h"
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+
+/**
+ * Replays keystroke trace against commands file and reports per-stage latencies.
+ * Usage: engine <cmds.ini> [trace.txt] [iterations]
+ * If trace is not specified or is "-", trace of 10000 keystrokes is generated from commands.
+ */
+static int runEngineBenchmark(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: engine <cmds.ini> [trace.txt] [iterations]\n");
+        return 1;
+    }
+
+    Newstring commandsSource = Bench::ReadTextFile(argv[0]);
+    defer(commandsSource.Dispose());
+    if (Newstring::IsNullOrEmpty(commandsSource))
+    {
+        fprintf(stderr, "cannot read commands file \"%s\"\n", argv[0]);
+        return 1;
+    }
+
+    HeadlessDriver driver;
+    defer(driver.Dispose());
+
+    if (!driver.Initialize(commandsSource))
+    {
+        fprintf(stderr, "no commands were loaded from \"%s\"\n", argv[0]);
+        return 1;
+    }
+
+    Newstring trace;
+    defer(trace.Dispose());
+
+    if (argc >= 2 && strcmp(argv[1], "-") != 0)
+    {
+        trace = Bench::ReadTextFile(argv[1]);
+        if (Newstring::IsNullOrEmpty(trace))
+        {
+            fprintf(stderr, "cannot read trace file \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        trace = driver.GenerateTrace(10000);
+    }
+
+    int iterations = argc >= 3 ? atoi(argv[2]) : 10;
+    if (iterations < 1)  iterations = 1;
+
+    // Warm up caches and history, then measure.
+    if (!driver.RunTrace(trace))
+    {
+        fprintf(stderr, "trace contains invalid instruction\n");
+        return 1;
+    }
+
+    driver.ClearStatistics();
+    for (uint32_t i = 0; i < HeadlessDriver::Stage_Count; ++i)
+        driver.stages[i].Reserve(trace.count * iterations);
+
+    for (int i = 0; i < iterations; ++i)
+        driver.RunTrace(trace);
+
+    printf("commands: %u, iterations: %d\n", driver.engine.commandSet->commands.count, iterations);
+    driver.PrintReport();
+
+    return 0;
+}
+
+/** Returns true if text of gap buffer is equal to specified string. */
+static bool isGapBufferText(GapBuffer* buffer, const wchar_t* expected)
+{
+    return buffer->GetText() == expected;
+}
+
+/** Checks insertion and removal of gap buffer, including removals that are clamped or out of range. */
+static void checkGapBuffer(Bench::Checks* checks)
+{
+    GapBuffer buffer;
+    defer(buffer.Dispose());
+
+    checks->Check(buffer.Insert(0, Newstring::WrapConstWChar(L"hello world")) && isGapBufferText(&buffer, L"hello world"),
+        "gap buffer: text is inserted");
+    checks->Check(buffer.Insert(5, L',') && buffer.Insert(1000, L'!') && isGapBufferText(&buffer, L"hello, world!"),
+        "gap buffer: insertion out of range appends");
+
+    // Gap is at the end now, removal in the middle moves it.
+    buffer.Remove(0, 7);
+    checks->Check(isGapBufferText(&buffer, L"world!") && buffer.gapStart == buffer.GetCount(),
+        "gap buffer: removal before gap");
+    buffer.Insert(0, Newstring::WrapConstWChar(L"hello, "));
+    buffer.Remove(5, 2);
+    checks->Check(isGapBufferText(&buffer, L"helloworld!"), "gap buffer: removal in the middle");
+
+    buffer.Remove(7, 1000);
+    checks->Check(isGapBufferText(&buffer, L"hellowo"), "gap buffer: removal count is clamped to end of text");
+    buffer.Remove(7, 1);
+    buffer.Remove(1000, 1);
+    buffer.Remove(0, 0);
+    checks->Check(isGapBufferText(&buffer, L"hellowo"), "gap buffer: removal out of range does nothing");
+
+    // Removal that ends at gap start extends the gap backwards without moving text.
+    buffer.Insert(3, L'x');
+    buffer.Remove(3, 1);
+    uint32_t gapEnd = buffer.gapEnd;
+    buffer.Remove(1, 2);
+
+    // Spans are read before GetText(), which moves gap to the end.
+    Newstring before;
+    Newstring after;
+    buffer.GetSpans(&before, &after);
+    checks->Check(buffer.gapEnd == gapEnd && before == L"h" && after == L"lowo", "gap buffer: removal before gap extends gap");
+    checks->Check(isGapBufferText(&buffer, L"hlowo"), "gap buffer: text after removal before gap");
+
+    buffer.Remove(0, buffer.GetCount());
+    checks->Check(buffer.GetCount() == 0 && isGapBufferText(&buffer, L""), "gap buffer: whole text is removed");
+}
+
+/** Types specified text character by character at caret of text edit. */
+static void typeText(TextEdit* textEdit, const wchar_t* text)
+{
+    for (const wchar_t* c = text; *c != L'\0'; ++c)
+        textEdit->InsertCharacterAtCaret(*c);
+}
+
+/** Returns number of edits that can be undone, undoing all of them. */
+static uint32_t undoAll(TextEdit* textEdit)
+{
+    uint32_t count = 0;
+    while (textEdit->Undo())
+        ++count;
+
+    return count;
+}
+
+/** Checks that edit journal undoes and redoes edits, coalesces them and forgets oldest ones when its rings are full. */
+static void checkEditJournal(Bench::Checks* checks)
+{
+    {
+        TextEdit textEdit;
+        defer(textEdit.Dispose());
+        checks->Check(textEdit.Initialize(), "edit journal: text edit is initialized");
+
+        // Typing is coalesced by words: space after word starts new entry.
+        typeText(&textEdit, L"hello world");
+        bool isUndone = textEdit.Undo() && textEdit.GetText() == L"hello" && textEdit.caretPos == 5;
+        isUndone = isUndone && textEdit.Undo() && textEdit.GetText() == L"" && !textEdit.Undo();
+        checks->Check(isUndone, "edit journal: typed words are undone one by one");
+
+        bool isRedone = textEdit.Redo() && textEdit.GetText() == L"hello" && textEdit.caretPos == 5;
+        isRedone = isRedone && textEdit.Redo() && textEdit.GetText() == L"hello world" && textEdit.caretPos == 11 && !textEdit.Redo();
+        checks->Check(isRedone, "edit journal: undone words are redone");
+
+        textEdit.Undo();
+        typeText(&textEdit, L"!");
+        checks->Check(!textEdit.Redo() && textEdit.GetText() == L"hello!", "edit journal: new edit drops undone edits");
+    }
+
+    {
+        TextEdit textEdit;
+        defer(textEdit.Dispose());
+        textEdit.Initialize();
+
+        // Removed characters of backspace are stored in reversed order.
+        textEdit.InsertTextAtCaret(Newstring::WrapConstWChar(L"abcdef"));
+        textEdit.RemovePrevCharacter();
+        textEdit.RemovePrevCharacter();
+        textEdit.RemovePrevCharacter();
+        bool isRestored = textEdit.GetText() == L"abc" && textEdit.Undo() && textEdit.GetText() == L"abcdef" && textEdit.caretPos == 6;
+        checks->Check(isRestored, "edit journal: held backspace is undone at once in original order");
+
+        textEdit.ClearSelection(1);
+        textEdit.RemoveNextCharacter();
+        textEdit.RemoveNextCharacter();
+        isRestored = textEdit.GetText() == L"adef" && textEdit.Undo() && textEdit.GetText() == L"abcdef" && textEdit.caretPos == 1;
+        checks->Check(isRestored, "edit journal: held delete is undone at once");
+
+        checks->Check(textEdit.Undo() && textEdit.GetText() == L"" && !textEdit.Undo(), "edit journal: paste is undone");
+    }
+
+    {
+        TextEdit textEdit;
+        defer(textEdit.Dispose());
+        textEdit.Initialize();
+
+        // Pastes are never coalesced, so every paste takes an entry.
+        const uint32_t pasteCount = EditJournal::MaxEntries + 44;
+        for (uint32_t i = 0; i < pasteCount; ++i)
+            textEdit.InsertTextAtCaret(Newstring::WrapConstWChar(L"x"));
+
+        uint32_t undoCount = undoAll(&textEdit);
+        checks->Check(undoCount == EditJournal::MaxEntries && textEdit.GetTextLength() == pasteCount - EditJournal::MaxEntries,
+            "edit journal: oldest entries are forgotten when entry ring is full");
+    }
+
+    {
+        TextEdit textEdit;
+        defer(textEdit.Dispose());
+        textEdit.Initialize();
+
+        // Three pastes don't fit into text ring together, so the first one is forgotten.
+        const uint32_t pasteLength = EditJournal::TextCapacity * 3 / 8;
+        Newstring paste = Newstring::New(pasteLength);
+        defer(paste.Dispose());
+        for (uint32_t i = 0; i < pasteLength; ++i)
+            paste.data[i] = static_cast<wchar_t>(L'a' + i % 26);
+
+        for (int i = 0; i < 3; ++i)
+            textEdit.InsertTextAtCaret(paste);
+
+        uint32_t undoCount = undoAll(&textEdit);
+        checks->Check(undoCount == 2 && textEdit.GetText() == paste, "edit journal: oldest entries are forgotten when text ring is full");
+
+        // Edit that doesn't fit into text ring can't be undone, and neither can edits before it.
+        Newstring longPaste = Newstring::New(EditJournal::TextCapacity + 1);
+        defer(longPaste.Dispose());
+        for (uint32_t i = 0; i < longPaste.count; ++i)
+            longPaste.data[i] = L'y';
+
+        textEdit.InsertTextAtCaret(longPaste);
+        checks->Check(!textEdit.Undo() && textEdit.GetTextLength() == pasteLength + longPaste.count, "edit journal: too long edit clears journal");
+    }
+}
+
+/**
+ * Text editor that keeps text in flat NewstringBuilder like TextEdit did before gap buffer, so every edit moves the
+ * rest of the line, but reading text is free. Supports only edits of editing trace, it's the baseline of textedit suite.
+ */
+struct FlatTextEdit
+{
+    NewstringBuilder buffer;
+    uint32_t caretPos = 0;
+    uint32_t selectionStartPos = TextEdit::NoSelection;
+    uint32_t revision = 0;
+
+    Newstring GetText() { return buffer.string; }
+
+    bool IsTextSelected() const
+    {
+        return selectionStartPos != TextEdit::NoSelection && caretPos != selectionStartPos;
+    }
+
+    void ClearSelection(uint32_t newCaretPos)
+    {
+        selectionStartPos = TextEdit::NoSelection;
+        caretPos = newCaretPos < buffer.count ? newCaretPos : buffer.count;
+    }
+
+    void RemoveSelectedText()
+    {
+        uint32_t start = caretPos < selectionStartPos ? caretPos : selectionStartPos;
+        uint32_t end = caretPos < selectionStartPos ? selectionStartPos : caretPos;
+        buffer.Remove(start, end - start);
+        ++revision;
+        ClearSelection(start);
+    }
+
+    void InsertTextAtCaret(const Newstring& text)
+    {
+        if (IsTextSelected())
+            RemoveSelectedText();
+
+        buffer.Insert(caretPos, text);
+        ++revision;
+        ClearSelection(caretPos + text.count);
+    }
+
+    void InsertCharacterAtCaret(wchar_t c)
+    {
+        InsertTextAtCaret(Newstring(&c, 1));
+    }
+
+    void RemovePrevCharacter()
+    {
+        if (caretPos == 0)
+            return;
+
+        buffer.Remove(caretPos - 1, 1);
+        ++revision;
+        --caretPos;
+    }
+
+    void RemoveNextCharacter()
+    {
+        if (caretPos >= buffer.count)
+            return;
+
+        buffer.Remove(caretPos, 1);
+        ++revision;
+    }
+
+    void AddPrevCharacterToSelection()
+    {
+        if (caretPos == 0)
+            return;
+
+        if (!IsTextSelected())
+            selectionStartPos = caretPos;
+        --caretPos;
+    }
+
+    void AddNextCharacterToSelection()
+    {
+        if (caretPos >= buffer.count)
+            return;
+
+        if (!IsTextSelected())
+            selectionStartPos = caretPos;
+        ++caretPos;
+    }
+};
+
+/**
+ * Replays editing trace through specified text editor and measures every keystroke up to the frame drawn after it, doing
+ * the same work with text as HeadlessDriver: autocompletion reads text after every keystroke, and caret positions are
+ * recomputed when text changed. 'textLatency' gets edit and text reads, 'frameLatency' also gets caret positions.
+ * Caret X of every frame is added to 'caretXSum'. Returns false if trace has instruction that is not supported.
+ */
+template<typename Editor>
+static bool replayEditingTrace(Editor* editor, const Newstring& trace, Bench::LatencyHistogram* textLatency,
+    Bench::LatencyHistogram* frameLatency, double* caretXSum)
+{
+    FixedPitchTextMetrics metrics;
+    GlyphAdvanceCache advances;
+    defer(advances.Dispose());
+
+    auto keystroke = [&](auto edit)
+    {
+        Bench::Sample frame;
+        frame.Begin(frameLatency);
+        Bench::Sample textSample;
+        textSample.Begin(textLatency);
+        edit();
+
+        Newstring text = editor->GetText();
+        bool isCommandName = text.IndexOf(L' ') == -1;
+        text = editor->GetText();
+        textSample.End();
+
+        advances.Update(&metrics, text, editor->revision);
+        *caretXSum += advances.GetCaretX(editor->caretPos) + isCommandName;
+        frame.End();
+    };
+
+    Newstring rest = trace;
+    while (!Newstring::IsNullOrEmpty(rest))
+    {
+        Newstring line;
+        int lineBreakLength;
+        ParseUtils::GetLine(rest, &line, &lineBreakLength);
+
+        uint32_t consumed = line.count + lineBreakLength;
+        rest = consumed < rest.count ? Newstring(rest.data + consumed, rest.count - consumed) : Newstring::Empty();
+
+        Newstring argument;
+        if (line.StartsWith(Newstring::WrapConstWChar(L"type ")))
+        {
+            for (uint32_t i = 5; i < line.count; ++i)
+                keystroke([&] { editor->InsertCharacterAtCaret(line.data[i]); });
+        }
+        else if (line.StartsWith(Newstring::WrapConstWChar(L"paste ")))
+        {
+            argument = line.RefSubstring(6, line.count - 6);
+            keystroke([&] { editor->InsertTextAtCaret(argument); });
+        }
+        else if (line.StartsWith(Newstring::WrapConstWChar(L"caret ")))
+        {
+            argument = line.RefSubstring(6, line.count - 6);
+            int32_t pos;
+            if (!ParseUtils::ParseInt32(argument, &pos).IsComplete(argument) || pos < 0)
+                return false;
+
+            keystroke([&] { editor->ClearSelection(static_cast<uint32_t>(pos)); });
+        }
+        else if (line == L"key back" || line == L"key delete")
+        {
+            bool isBack = line == L"key back";
+            keystroke([&]
+            {
+                if (editor->IsTextSelected())  editor->RemoveSelectedText();
+                else  isBack ? editor->RemovePrevCharacter() : editor->RemoveNextCharacter();
+            });
+        }
+        else if (line == L"key shift+left")
+        {
+            keystroke([&] { editor->AddPrevCharacterToSelection(); });
+        }
+        else if (line == L"key shift+right")
+        {
+            keystroke([&] { editor->AddNextCharacterToSelection(); });
+        }
+        else if (line.count > 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Checks gap buffer and edit journal, then replays editing trace of a long line and reports per-keystroke latencies of TextEdit.
+ * Then compares whole keystroke up to the frame drawn after it with flat text buffer that TextEdit used before gap buffer.
+ * Usage: textedit [line_length] [keystrokes]
+ * Exit code is 1 if any check fails.
+ */
+static int runTextEditBenchmark(int argc, char** argv)
+{
+    int lineLength = argc >= 1 ? atoi(argv[0]) : 2000;
+    int keystrokes = argc >= 2 ? atoi(argv[1]) : 10000;
+    if (lineLength < 1)  lineLength = 1;
+    if (keystrokes < 1)  keystrokes = 1;
+
+    Bench::Checks checks;
+    checkGapBuffer(&checks);
+    checkEditJournal(&checks);
+
+    HeadlessDriver driver;
+    defer(driver.Dispose());
+
+    if (!driver.Initialize(Newstring::WrapConstWChar(L"[run_app]\nname=app\npath=app.exe\n")))
+    {
+        fprintf(stderr, "unable to initialize driver\n");
+        return 1;
+    }
+
+    Newstring trace = driver.GenerateEditingTrace(keystrokes, lineLength);
+    defer(trace.Dispose());
+
+    // Warm up, then measure.
+    driver.RunTrace(trace);
+    driver.textEdit.ClearText();
+    driver.ClearStatistics();
+    driver.RunTrace(trace);
+
+    // Both editors replay the trace to warm up, then replay it again to measure.
+    Bench::LatencyHistogram gapTextLatency;
+    Bench::LatencyHistogram gapFrameLatency;
+    Bench::LatencyHistogram flatTextLatency;
+    Bench::LatencyHistogram flatFrameLatency;
+    defer({
+        gapTextLatency.Dispose();
+        gapFrameLatency.Dispose();
+        flatTextLatency.Dispose();
+        flatFrameLatency.Dispose();
+    });
+
+    TextEdit gapEdit;
+    defer(gapEdit.Dispose());
+    gapEdit.Initialize();
+    FlatTextEdit flatEdit;
+    defer(flatEdit.buffer.Dispose());
+    flatEdit.buffer.Reserve(512);
+
+    bool isReplayed = true;
+    double gapCaretXSum = 0.0;
+    double flatCaretXSum = 0.0;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        gapEdit.ClearText();
+        flatEdit.buffer.count = 0;
+        flatEdit.ClearSelection(0);
+        gapTextLatency.Clear();
+        gapFrameLatency.Clear();
+        flatTextLatency.Clear();
+        flatFrameLatency.Clear();
+        gapCaretXSum = 0.0;
+        flatCaretXSum = 0.0;
+
+        isReplayed = isReplayed && replayEditingTrace(&gapEdit, trace, &gapTextLatency, &gapFrameLatency, &gapCaretXSum);
+        isReplayed = isReplayed && replayEditingTrace(&flatEdit, trace, &flatTextLatency, &flatFrameLatency, &flatCaretXSum);
+    }
+
+    checks.Check(isReplayed && gapEdit.GetText() == flatEdit.GetText() && gapCaretXSum == flatCaretXSum,
+        "gap buffer and flat buffer replay trace to the same text and caret positions");
+    checks.Print();
+
+    printf("line length: %d, final text length: %u\n", lineLength, driver.textEdit.GetTextLength());
+    driver.stages[HeadlessDriver::Stage_TextEdit].Print(HeadlessDriver::GetStageName(HeadlessDriver::Stage_TextEdit));
+    driver.stages[HeadlessDriver::Stage_Keystroke].Print(HeadlessDriver::GetStageName(HeadlessDriver::Stage_Keystroke));
+    gapTextLatency.Print("edit and read, gap");
+    flatTextLatency.Print("edit and read, flat");
+    gapFrameLatency.Print("frame, gap");
+    flatFrameLatency.Print("frame, flat");
+
+    return checks.GetExitCode();
+}
+
+/** Checks change flags of render state for every kind of input change, and frame statistics. */
+static void checkRenderState(Bench::Checks* checks)
+{
+    const uint32_t allChanges = RC_Text | RC_Selection | RC_Caret | RC_Candidate | RC_Surface | RC_Dropdown | RC_Frame;
+
+    RenderState state;
+    RenderInputs inputs;
+    inputs.textRevision = 1;
+    inputs.isCaretVisible = true;
+
+    checks->Check(state.GetChanges(inputs) == allChanges, "render state: first frame changes everything");
+    checks->Check(state.BeginFrame(inputs) == allChanges && state.GetChanges(inputs) == RC_None, "render state: drawn inputs have no changes");
+
+    // Every input is changed alone, GetChanges() doesn't remember inputs.
+    RenderInputs changed = inputs;
+    changed.caretPos = 1;
+    checks->Check(state.GetChanges(changed) == RC_Caret && state.GetChanges(changed) == RC_Caret
+        && RenderState::IsCaretOnlyFrame(RC_Caret), "render state: moved caret");
+    changed = inputs;
+    changed.isCaretVisible = false;
+    checks->Check(state.GetChanges(changed) == RC_Caret, "render state: blinked caret");
+    changed = inputs;
+    changed.textRevision = 2;
+    checks->Check(state.GetChanges(changed) == RC_Text && RenderState::IsTextLayoutAffected(RC_Text)
+        && RenderState::IsAutocompletionLayoutAffected(RC_Text), "render state: changed text");
+    changed = inputs;
+    changed.selectionStart = 1;
+    changed.selectionLength = 2;
+    checks->Check(state.GetChanges(changed) == RC_Selection && !RenderState::IsCaretOnlyFrame(RC_Selection)
+        && !RenderState::IsTextLayoutAffected(RC_Selection), "render state: changed selection");
+    changed = inputs;
+    changed.candidate = &state;
+    checks->Check(state.GetChanges(changed) == RC_Candidate && !RenderState::IsTextLayoutAffected(RC_Candidate)
+        && RenderState::IsAutocompletionLayoutAffected(RC_Candidate), "render state: changed candidate");
+    changed = inputs;
+    changed.dropdownRevision = 1;
+    checks->Check(state.GetChanges(changed) == RC_Dropdown && !RenderState::IsAutocompletionLayoutAffected(RC_Dropdown),
+        "render state: changed dropdown");
+
+    state.InvalidateFrame();
+    checks->Check(state.GetChanges(inputs) == RC_Frame && !RenderState::IsTextLayoutAffected(RC_Frame)
+        && !RenderState::IsAutocompletionLayoutAffected(RC_Frame), "render state: lost frame is redrawn without rebuilding layouts");
+    state.BeginFrame(inputs);
+    state.Invalidate();
+    checks->Check(state.GetChanges(inputs) == allChanges && RenderState::IsTextLayoutAffected(RC_Surface), "render state: invalidated surface");
+    state.BeginFrame(inputs);
+
+    // First frame, lost frame and invalidated surface are full frames, then caret blinks.
+    changed = inputs;
+    changed.isCaretVisible = false;
+    state.BeginFrame(changed);
+    const RenderStatistics& statistics = state.statistics;
+    checks->Check(statistics.fullFrameCount == 3 && statistics.caretFrameCount == 1 && statistics.textLayoutBuildCount == 2
+        && statistics.autocompletionLayoutBuildCount == 2, "render state: frames are counted by kind of work");
+}
+
+/** Checks selection, wrapping and scrolling of autocompletion list, and selection kept across candidate updates. */
+static void checkAutocompletionList(Bench::Checks* checks)
+{
+    Bench::ProbeCommand commands[20];
+    Command* candidates[20];
+    for (uint32_t i = 0; i < 20; ++i)
+        candidates[i] = &commands[i];
+
+    AutocompletionList list;
+    list.visibleRowLimit = 8;
+    checks->Check(!list.SelectNext() && !list.SelectPrev() && list.GetSelected() == nullptr && list.rowCount == 0,
+        "autocompletion list: empty list has no selection");
+
+    list.SetCandidates(candidates, 20);
+    checks->Check(list.GetSelected() == candidates[0] && list.rowCount == 8 && list.firstVisibleIndex == 0,
+        "autocompletion list: first candidate is selected");
+
+    // Selection below last visible row scrolls list by one row.
+    for (int i = 0; i < 8; ++i)
+        list.SelectNext();
+    checks->Check(list.selectedIndex == 8 && list.firstVisibleIndex == 1 && list.GetSelectedRow() == 7 && list.rows[0] == candidates[1],
+        "autocompletion list: list scrolls to selection");
+
+    list.SelectPrev();
+    checks->Check(list.selectedIndex == 7 && list.firstVisibleIndex == 1, "autocompletion list: list doesn't scroll while selection is visible");
+
+    list.Clear();
+    list.SetCandidates(candidates, 20);
+    list.SelectPrev();
+    checks->Check(list.selectedIndex == 19 && list.firstVisibleIndex == 12 && list.GetSelectedRow() == 7,
+        "autocompletion list: selection wraps to last candidate");
+    list.SelectNext();
+    checks->Check(list.selectedIndex == 0 && list.firstVisibleIndex == 0, "autocompletion list: selection wraps to first candidate");
+
+    checks->Check(list.SelectRow(3) && list.GetSelected() == candidates[3] && !list.SelectRow(8) && list.selectedIndex == 3,
+        "autocompletion list: only shown rows are selected");
+
+    // Selected command stays selected when candidates change, and list doesn't scroll past last candidate.
+    list.SelectPrev();
+    list.SelectPrev();
+    list.SelectPrev();
+    list.SelectPrev();
+    list.SetCandidates(candidates + 6, 14);
+    checks->Check(list.GetSelected() == candidates[19] && list.selectedIndex == 13 && list.firstVisibleIndex == 6 && list.rowCount == 8,
+        "autocompletion list: list doesn't scroll past last candidate");
+
+    list.SetCandidates(candidates, 4);
+    checks->Check(list.selectedIndex == 0 && list.firstVisibleIndex == 0 && list.rowCount == 4,
+        "autocompletion list: first candidate is selected when selected command is gone");
+
+    uint32_t revision = list.revision;
+    list.SetCandidates(candidates, 4);
+    bool isUnchanged = list.revision == revision;
+    list.SelectNext();
+    checks->Check(isUnchanged && list.revision == revision + 1, "autocompletion list: revision changes only with rows or selection");
+
+    list.Clear();
+    checks->Check(list.GetSelected() == nullptr && list.rowCount == 0 && !list.SelectRow(0), "autocompletion list: cleared list is empty");
+}
+
+/**
+ * Checks caret positions and hit-testing of glyph advance cache with fixed pitch metrics: clusters of surrogate pairs and
+ * combining marks, and recomputing positions after font change.
+ */
+static void checkTextMetrics(Bench::Checks* checks)
+{
+    FixedPitchTextMetrics metrics;
+    GlyphAdvanceCache cache;
+    defer(cache.Dispose());
+
+    checks->Check(cache.GetCaretX(3) == 0.0f && cache.HitTest(15.0f) == 0, "text metrics: empty cache");
+
+    const Newstring plain = Newstring::WrapConstWChar(L"abc");
+    float advances[3] = {};
+    checks->Check(metrics.GetAdvances(plain, advances) && advances[0] == 10.0f && advances[1] == 10.0f && advances[2] == 10.0f,
+        "text metrics: every character has the same advance");
+
+    cache.Update(&metrics, plain, 1);
+    checks->Check(cache.GetCaretX(0) == 0.0f && cache.GetCaretX(2) == 20.0f && cache.GetCaretX(3) == 30.0f && cache.GetCaretX(10) == 30.0f,
+        "text metrics: caret X is sum of advances, index past the end is end of text");
+    checks->Check(cache.HitTest(-5.0f) == 0 && cache.HitTest(4.0f) == 0 && cache.HitTest(6.0f) == 1 && cache.HitTest(15.0f) == 2
+        && cache.HitTest(100.0f) == 3, "text metrics: hit test returns nearest caret position");
+
+    // Surrogate pair takes indices 1 and 2, caret is never placed between them.
+    const Newstring surrogates = Newstring::WrapConstWChar(L"a\xD83D\xDE00" L"b");
+    cache.Update(&metrics, surrogates, 2);
+    bool isPairSplit = false;
+    for (float x = -5.0f; x <= 45.0f; x += 1.0f)
+        isPairSplit |= cache.HitTest(x) == 2;
+    checks->Check(cache.GetCaretX(1) == 10.0f && cache.GetCaretX(2) == 10.0f && cache.GetCaretX(3) == 20.0f && cache.GetCaretX(4) == 30.0f
+        && cache.HitTest(12.0f) == 1 && !isPairSplit, "text metrics: surrogate pair is one cluster");
+
+    // Combining mark at index 1 is joined with previous character.
+    const Newstring combining = Newstring::WrapConstWChar(L"e\x0301" L"x");
+    cache.Update(&metrics, combining, 3);
+    bool isMarkSplit = false;
+    for (float x = -5.0f; x <= 35.0f; x += 1.0f)
+        isMarkSplit |= cache.HitTest(x) == 1;
+    checks->Check(cache.GetCaretX(1) == 0.0f && cache.GetCaretX(2) == 10.0f && cache.GetCaretX(3) == 20.0f && cache.HitTest(2.0f) == 0
+        && !isMarkSplit, "text metrics: combining mark is joined with previous character");
+
+    // Positions are kept while text revision is the same, font change must invalidate them.
+    metrics.advance = 20.0f;
+    cache.Update(&metrics, combining, 3);
+    bool isCached = cache.GetCaretX(3) == 20.0f;
+    cache.Invalidate();
+    cache.Update(&metrics, combining, 3);
+    checks->Check(isCached && cache.GetCaretX(2) == 20.0f && cache.GetCaretX(3) == 40.0f && cache.HitTest(25.0f) == 2,
+        "text metrics: positions are recomputed after font change");
+}
+
+/**
+ * Checks render state, autocompletion list and text metrics, then replays generated trace painting every frame with software renderer and reports paint
+ * latencies and frame rate. Then paints reference frame and compares it with golden image, or writes golden image
+ * if it doesn't exist.
+ * Usage: render <cmds.ini> [keystrokes] [golden.ppm]
+ * Exit code is 1 if any check fails or any pixel differs.
+ */
+static int runRenderBenchmark(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: render <cmds.ini> [keystrokes] [golden.ppm]\n");
+        return 1;
+    }
+
+    Newstring commandsSource = Bench::ReadTextFile(argv[0]);
+    defer(commandsSource.Dispose());
+
+    HeadlessDriver driver;
+    defer(driver.Dispose());
+
+    if (!driver.Initialize(commandsSource))
+    {
+        fprintf(stderr, "no commands were loaded from \"%s\"\n", argv[0]);
+        return 1;
+    }
+
+    int keystrokes = argc >= 2 ? atoi(argv[1]) : 10000;
+    if (keystrokes < 1)  keystrokes = 1;
+
+    Bench::Checks checks;
+    checkRenderState(&checks);
+    checkAutocompletionList(&checks);
+    checkTextMetrics(&checks);
+    checks.Print();
+
+    SoftwareRenderer renderer;
+    defer(renderer.Dispose());
+    if (!renderer.Initialize(static_cast<uint32_t>(driver.frameWidth), static_cast<uint32_t>(driver.GetMaxFrameHeight()), &driver.textMetrics))
+    {
+        fprintf(stderr, "unable to allocate frame buffer\n");
+        return 1;
+    }
+    driver.renderer = &renderer;
+
+    Newstring trace = driver.GenerateTrace(keystrokes);
+    defer(trace.Dispose());
+
+    // Warm up, then measure.
+    driver.RunTrace(trace);
+    driver.ClearStatistics();
+    driver.stages[HeadlessDriver::Stage_Paint].Reserve(trace.count);
+
+    uint64_t start = Bench::GetTimeNs();
+    driver.RunTrace(trace);
+    uint64_t elapsed = Bench::GetTimeNs() - start;
+
+    Bench::LatencyHistogram& paint = driver.stages[HeadlessDriver::Stage_Paint];
+    uint64_t paintTotal = 0;
+    for (uint32_t i = 0; i < paint.samples.count; ++i)
+        paintTotal += paint.samples.data[i];
+
+    printf("frame: %ux%u, keystrokes: %d\n", renderer.width, renderer.height, keystrokes);
+    driver.PrintReport();
+    printf("paint: %.0f frames/s, total %.3f ms of %.3f ms\n",
+        paintTotal > 0 ? paint.samples.count * 1e9 / paintTotal : 0.0, paintTotal / 1e6, elapsed / 1e6);
+
+    if (argc < 3)
+        return checks.GetExitCode();
+
+    // Reference frame: typed command with argument, selection and autocompletion are all visible.
+    const Newstring& name = driver.engine.commandSet->commands.data[0]->name;
+    Newstring referenceTrace = Newstring::Join({ Newstring::WrapConstWChar(L"key escape\ntype "), name.RefSubstring(0, 2),
+        Newstring::WrapConstWChar(L"\nkey shift+left\n") });
+    defer(referenceTrace.Dispose());
+
+    driver.renderState.Invalidate();
+    driver.RunTrace(referenceTrace);
+
+    uint32_t differentPixelCount = 0;
+    if (renderer.CompareWithImage(argv[2], &differentPixelCount))
+    {
+        printf("golden image %s: %u different pixels\n", argv[2], differentPixelCount);
+        return differentPixelCount == 0 ? checks.GetExitCode() : 1;
+    }
+
+    if (!renderer.SaveImage(argv[2]))
+    {
+        fprintf(stderr, "cannot write \"%s\"\n", argv[2]);
+        return 1;
+    }
+
+    printf("golden image written to %s\n", argv[2]);
+    return checks.GetExitCode();
+}
+
+/**
+ * Launcher backend that holds launches until bench allows them, so bench controls when launches are completed.
+ * Launches of applications named "fail" fail.
+ */
+struct GatedLaunchBackend
+{
+    std::mutex mutex;
+    std::condition_variable allowed;
+    uint32_t allowedCount = 0;
+    uint32_t launchedCount = 0;
+
+    /** Allows specified number of launches to complete. */
+    void Allow(uint32_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        allowedCount += count;
+        allowed.notify_all();
+    }
+
+    static void Launch(LaunchRequest* request);
+};
+
+static GatedLaunchBackend g_gatedLaunchBackend;
+
+void GatedLaunchBackend::Launch(LaunchRequest* request)
+{
+    GatedLaunchBackend& backend = g_gatedLaunchBackend;
+    std::unique_lock<std::mutex> lock(backend.mutex);
+    backend.allowed.wait(lock, [&] { return backend.allowedCount > 0; });
+    --backend.allowedCount;
+    ++backend.launchedCount;
+
+    request->succeeded = wcscmp(request->path, L"fail") != 0;
+    request->errorCode = request->succeeded ? 0 : 2;
+}
+
+/** Leaves launch of application with the same name as command to engine. */
+struct LaunchProbeCommand : public Command
+{
+    virtual bool Execute(ExecuteCommandState* state, Array<Newstring>&) override
+    {
+        assert(state->isLaunchDeferred);
+
+        wchar_t* path = name.CloneAsCString(state->allocator);
+        state->launch = path != nullptr ? ProcessLauncher::CreateRequest(path, nullptr, nullptr) : nullptr;
+        return state->launch != nullptr;
+    }
+};
+
+/** Completes launches of launcher with gated backend, returns false if any evaluation reported failure. */
+static bool completeGatedLaunches(CommandEngine* engine, uint32_t count)
+{
+    g_gatedLaunchBackend.Allow(count);
+    engine->launcher->WaitForPending();
+
+    bool isSucceeded = true;
+    auto context = std::make_pair(engine, &isSucceeded);
+    engine->launcher->DrainCompleted([](LaunchRequest* request, void* userdata)
+    {
+        auto* context = static_cast<std::pair<CommandEngine*, bool*>*>(userdata);
+        bool isCompleted = context->first->CompleteLaunch(request, Newstring::WrapConstWChar(L"launch failed"));
+        *context->second = *context->second && isCompleted;
+    }, &context);
+
+    return isSucceeded;
+}
+
+/** Returns statuses of results of execution state as string: S (succeeded), F (failed), K (skipped), P (pending). */
+static Newstring getResultStatuses(const ExecuteCommandState& state)
+{
+    NewstringBuilder sb;
+    sb.allocator = &g_tempAllocator;
+    for (uint32_t i = 0; i < state.results.count; ++i)
+    {
+        CommandResultStatus status = state.results.data[i].status;
+        sb.Append(status == CommandResultStatus::Succeeded ? L'S' : status == CommandResultStatus::Failed ? L'F' : status == CommandResultStatus::Skipped ? L'K' : L'P');
+    }
+
+    return sb.string;
+}
+
+/**
+ * Checks that evaluation on thread that owns engine doesn't wait for launches: commands after '&&' run when launch of
+ * previous command is completed, results of launched commands are pending until then.
+ */
+static void checkChainedLaunches(Bench::Checks* checks)
+{
+    ProcessLauncherBackend backend = { GatedLaunchBackend::Launch, nullptr, nullptr };
+    ProcessLauncher launcher;
+    defer(launcher.Dispose());
+    if (!launcher.Initialize(1, &backend))
+    {
+        checks->Check(false, "gated launcher is started");
+        return;
+    }
+
+    CommandEngine engine;
+    defer(engine.Dispose());
+    engine.launcher = &launcher;
+
+    const wchar_t* names[] = { L"first", L"second", L"third", L"fail" };
+    bool isRegistered = true;
+    for (const wchar_t* name : names)
+    {
+        LaunchProbeCommand* command = Memnew(LaunchProbeCommand);
+        command->name = Newstring::NewFromWChar(name);
+        isRegistered = engine.RegisterCommand(command) && isRegistered;
+    }
+    checks->Check(isRegistered, "launch commands are registered");
+
+    TempAllocatorScope scope;
+    const ExecuteCommandState& state = *engine.GetExecutionState();
+    auto evaluate = [&](const wchar_t* expression) { return engine.Evaluate(Newstring::WrapConstWChar(expression)); };
+
+    // Launches are held by backend, so evaluation that waited for them would never return.
+    bool isSucceeded = evaluate(L"first && second");
+    checks->Check(isSucceeded && getResultStatuses(state) == L"P" && launcher.GetPendingCount() == 1,
+        "command after '&&' doesn't run before launch is completed");
+    isSucceeded = completeGatedLaunches(&engine, 1);
+    checks->Check(isSucceeded && getResultStatuses(state) == L"SP" && launcher.GetPendingCount() == 1,
+        "command after '&&' runs when launch is completed");
+    isSucceeded = completeGatedLaunches(&engine, 1);
+    checks->Check(isSucceeded && getResultStatuses(state) == L"SS" && launcher.GetPendingCount() == 0,
+        "evaluation is completed when last launch is completed");
+
+    isSucceeded = evaluate(L"second");
+    checks->Check(isSucceeded && getResultStatuses(state) == L"P", "standalone launch is pending until it's completed");
+    isSucceeded = completeGatedLaunches(&engine, 1);
+    checks->Check(isSucceeded && getResultStatuses(state) == L"S", "standalone launch succeeds when it's completed");
+
+    isSucceeded = evaluate(L"fail && second; third");
+    checks->Check(isSucceeded && getResultStatuses(state) == L"P", "failing launch is pending");
+    isSucceeded = completeGatedLaunches(&engine, 1);
+    checks->Check(!isSucceeded && getResultStatuses(state) == L"FKP" && state.errorMessage == L"fail: launch failed",
+        "failed launch skips command after '&&' and runs command after ';'");
+    isSucceeded = completeGatedLaunches(&engine, 1);
+    checks->Check(isSucceeded && getResultStatuses(state) == L"FKS" && state.errorMessage.count == 0,
+        "failure is reported once");
+
+    // Commands that wait for launch belong to replaced set, so they don't run.
+    isSucceeded = evaluate(L"first && second");
+    engine.UnregisterAllCommands();
+    isSucceeded = completeGatedLaunches(&engine, 1) && isSucceeded;
+    checks->Check(isSucceeded && getResultStatuses(state) == L"SK" && g_gatedLaunchBackend.launchedCount == 6,
+        "commands of replaced set don't run after launch is completed");
+}
+
+/**
+ * Compares time that launching thread is blocked by synchronous launches and by submitting them to ProcessLauncher.
+ * On POSIX also checks that launcher doesn't reap child processes that it didn't spawn.
+ * Also checks that evaluations on thread that owns engine don't wait for launches of chained commands.
+ * Usage: launch [program] [count] [workers]
+ * Program defaults to /bin/true (cmd.exe /c exit on Windows).
+ * Exit code is 1 if any launch or check fails.
+ */
+static int runLaunchBenchmark(int argc, char** argv)
+{
+#ifdef _WIN32
+    const char* program = argc >= 1 ? argv[0] : "C:\\Windows\\System32\\cmd.exe";
+    const wchar_t* parameters = argc >= 1 ? nullptr : L"/c exit";
+#else
+    const char* program = argc >= 1 ? argv[0] : "/bin/true";
+    const wchar_t* parameters = nullptr;
+#endif
+    int count = argc >= 2 ? atoi(argv[1]) : 200;
+    int workerCount = argc >= 3 ? atoi(argv[2]) : 4;
+    if (count < 1)        count = 1;
+    if (workerCount < 1)  workerCount = 1;
+
+    Newstring path = Unicode::DecodeString(program, static_cast<uint32_t>(strlen(program)), Encoding::UTF8);
+    defer(path.Dispose());
+    wchar_t* pathCString = path.CloneAsCString();
+    defer(g_standardAllocator.Deallocate(pathCString));
+
+    Bench::LatencyHistogram syncLaunches;
+    Bench::LatencyHistogram submits;
+    defer(syncLaunches.Dispose());
+    defer(submits.Dispose());
+    syncLaunches.Reserve(count);
+    submits.Reserve(count);
+
+    Bench::Checks checks;
+    uint32_t failedCount = 0;
+
+#ifndef _WIN32
+    // Child of bench itself exits while launcher reaps its own processes, bench must still be able to wait for it.
+    pid_t ownChild = 0;
+    char* ownChildArgv[] = { const_cast<char*>("true"), nullptr };
+    checks.Check(posix_spawnp(&ownChild, "true", nullptr, nullptr, ownChildArgv, environ) == 0, "bench spawns its own child");
+#endif
+
+    uint64_t syncStart = Bench::GetTimeNs();
+    for (int i = 0; i < count; ++i)
+    {
+        LaunchRequest* request = ProcessLauncher::CreateRequest(pathCString, parameters, nullptr);
+
+        uint64_t start = Bench::GetTimeNs();
+        LaunchProcess(request);
+        syncLaunches.Add(Bench::GetTimeNs() - start);
+
+        if (!request->succeeded)  ++failedCount;
+        ProcessLauncher::DestroyRequest(request);
+    }
+    uint64_t syncElapsed = Bench::GetTimeNs() - syncStart;
+
+    ProcessLauncher launcher;
+    defer(launcher.Dispose());
+    if (!launcher.Initialize(workerCount))
+    {
+        fprintf(stderr, "unable to start launcher threads\n");
+        return 1;
+    }
+
+    uint64_t asyncStart = Bench::GetTimeNs();
+    for (int i = 0; i < count; ++i)
+    {
+        LaunchRequest* request = ProcessLauncher::CreateRequest(pathCString, parameters, nullptr);
+
+        uint64_t start = Bench::GetTimeNs();
+        launcher.Submit(request);
+        submits.Add(Bench::GetTimeNs() - start);
+    }
+    launcher.WaitForPending();
+    uint64_t asyncElapsed = Bench::GetTimeNs() - asyncStart;
+
+    launcher.DrainCompleted([](LaunchRequest* request, void* userdata)
+    {
+        if (!request->succeeded)  ++*static_cast<uint32_t*>(userdata);
+    }, &failedCount);
+
+#ifndef _WIN32
+    int status = 0;
+    checks.Check(ownChild > 0 && waitpid(ownChild, &status, 0) == ownChild && WIFEXITED(status),
+        "child that launcher didn't spawn is not reaped by launcher");
+#endif
+
+    checks.Check(failedCount == 0, "every launch succeeds");
+    checkChainedLaunches(&checks);
+    checks.Print();
+    printf("launches: %d, workers: %d, failed: %u\n", count, workerCount, failedCount);
+    syncLaunches.Print("sync_launch");
+    submits.Print("async_submit");
+    printf("total: sync %.3f ms, async %.3f ms\n", syncElapsed / 1e6, asyncElapsed / 1e6);
+
+    return checks.GetExitCode();
+}
+
+/** Splits command line to unquoted arguments, which are allocated using temporary allocator. */
+static Array<Newstring> splitCommandLine(const Newstring& commandLine)
+{
+    Array<Newstring> args{ &g_tempAllocator };
+    if (commandLine.count == 0)
+        return args;
+
+    const wchar_t* cursor = commandLine.data;
+    const wchar_t* end = commandLine.data + commandLine.count;
+    const wchar_t* start = cursor;
+    uint32_t count = 0;
+
+    while (CommandLine::ReadArgument(&cursor, end, nullptr, &count))
+    {
+        wchar_t* data = static_cast<wchar_t*>(g_tempAllocator.Allocate(sizeof(wchar_t) * (count + 1)));
+        CommandLine::ReadArgument(&start, end, data, &count);
+        data[count] = L'\0';
+        args.Append(Newstring(data, count));
+        start = cursor;
+    }
+
+    return args;
+}
+
+/** Returns true if arguments are equal to specified strings. */
+static bool areArgumentsEqual(const Array<Newstring>& args, const Newstring* expected, uint32_t expectedCount)
+{
+    if (args.count != expectedCount)
+        return false;
+
+    for (uint32_t i = 0; i < expectedCount; ++i)
+    {
+        if (args.data[i] != expected[i])
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Checks that arguments quoted by CommandLine are split back to the same arguments by Windows rules and to the same
+ * UTF-8 argv on POSIX, then measures building of command lines.
+ * Usage: cmdline [iterations]
+ * Exit code is 1 if any check fails.
+ */
+static int runCommandLineBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+    auto str = [](const wchar_t* s) { return Newstring::WrapConstWChar(s); };
+
+    struct ArgumentsCase
+    {
+        const char* name;
+        const wchar_t* args[4];
+        uint32_t argCount;
+    };
+
+    const ArgumentsCase cases[] = {
+        { "plain arguments", { L"a", L"--flag=1" }, 2 },
+        { "arguments with spaces", { L"with space", L"x" }, 2 },
+        { "embedded quotes", { L"say \"hi\"", L"\"", L"\"\"" }, 3 },
+        { "trailing backslashes", { L"C:\\dir\\", L"C:\\dir with space\\", L"\\", L"\\\\" }, 4 },
+        { "backslashes before quotes", { L"a\\\"b", L"a\\\\\"b", L"\\\\server\\share" }, 3 },
+        { "empty arguments", { L"", L"x", L"" }, 3 },
+        { "tabs", { L"tab\there", L"\t", L"a\tb c" }, 3 },
+        { "supplementary plane", { L"\U0001F600 smile", L"\u043F\u0430\u043F\u043A\u0430" }, 2 },
+    };
+    const uint32_t caseCount = sizeof(cases) / sizeof(cases[0]);
+    const Newstring program = str(L"C:\\Program Files\\app.exe");
+
+    for (const ArgumentsCase& testCase : cases)
+    {
+        TempAllocatorScope scope;
+        char description[128];
+        Newstring args[4];
+        for (uint32_t i = 0; i < testCase.argCount; ++i)
+            args[i] = str(testCase.args[i]);
+        
+        Newstring commandLine = CommandLine::BuildWindowsCommandLine(Newstring::Empty(), args, testCase.argCount);
+        snprintf(description, sizeof(description), "%s are split back", testCase.name);
+        checks.Check(areArgumentsEqual(splitCommandLine(commandLine), args, testCase.argCount), description);
+
+        // Prefix is copied as is and is followed by arguments.
+        Newstring prefixed = CommandLine::BuildWindowsCommandLine(str(L"--profile \"my profile\""), args, testCase.argCount);
+        Array<Newstring> prefixedArgs = splitCommandLine(prefixed);
+        snprintf(description, sizeof(description), "%s follow quoted prefix", testCase.name);
+        checks.Check(prefixedArgs.count == testCase.argCount + 2 && prefixedArgs.data[1] == L"my profile"
+            && std::equal(args, args + testCase.argCount, prefixedArgs.data + 2), description);
+
+        // Process is created with program as the first token.
+        uint32_t length = CommandLine::GetProcessCommandLineLength(program, commandLine);
+        wchar_t* processCommandLine = static_cast<wchar_t*>(g_tempAllocator.Allocate(sizeof(wchar_t) * (length + 1)));
+        wchar_t* end = CommandLine::WriteProcessCommandLine(processCommandLine, program, commandLine);
+        Array<Newstring> processArgs = splitCommandLine(Newstring(processCommandLine, length));
+        snprintf(description, sizeof(description), "%s follow program", testCase.name);
+        checks.Check(end == processCommandLine + length && processArgs.count == testCase.argCount + 1 && processArgs.data[0] == program
+            && std::equal(args, args + testCase.argCount, processArgs.data + 1), description);
+
+        // POSIX argv is UTF-8 encoded arguments with program as argv[0].
+        uintptr_t argvSize = CommandLine::GetPosixArgvSize(program, commandLine);
+        char** posixArgv = CommandLine::WritePosixArgv(g_tempAllocator.Allocate(argvSize), program, commandLine);
+        bool isArgvEqual = posixArgv[testCase.argCount + 1] == nullptr;
+        for (uint32_t i = 0; i <= testCase.argCount && isArgvEqual; ++i)
+        {
+            uint32_t size = 0;
+            const Newstring& arg = i == 0 ? program : args[i - 1];
+            char* encoded = static_cast<char*>(Unicode::EncodeString(arg, &size, Encoding::UTF8, &g_tempAllocator));
+            isArgvEqual = strlen(posixArgv[i]) == size && (size == 0 || memcmp(posixArgv[i], encoded, size) == 0);
+        }
+        snprintf(description, sizeof(description), "%s are written to POSIX argv", testCase.name);
+        checks.Check(isArgvEqual, description);
+    }
+
+    {
+        TempAllocatorScope scope;
+        const Newstring doubled[] = { str(L"a\"b c"), str(L"d") };
+        checks.Check(areArgumentsEqual(splitCommandLine(str(L"\"a\"\"b c\" d")), doubled, 2), "two quotes inside group produce quote and group continues");
+        checks.Check(splitCommandLine(str(L" \t ")).count == 0 && CommandLine::BuildWindowsCommandLine(Newstring::Empty(), nullptr, 0).data == nullptr,
+            "empty command line has no arguments");
+
+        uint32_t size = CommandLine::GetProcessCommandLineLength(program, Newstring::Empty());
+        wchar_t* processCommandLine = static_cast<wchar_t*>(g_tempAllocator.Allocate(sizeof(wchar_t) * (size + 1)));
+        CommandLine::WriteProcessCommandLine(processCommandLine, program, Newstring::Empty());
+        checks.Check(Newstring(processCommandLine, size) == L"\"C:\\Program Files\\app.exe\"", "process without arguments gets quoted program");
+    }
+
+    checks.Print();
+
+    int iterations = argc >= 1 ? atoi(argv[0]) : 100000;
+    if (iterations < 1)  iterations = 1;
+
+    Bench::LatencyHistogram buildLatency;
+    Bench::LatencyHistogram splitLatency;
+    defer({
+        buildLatency.Dispose();
+        splitLatency.Dispose();
+    });
+    buildLatency.Reserve(iterations);
+    splitLatency.Reserve(iterations);
+
+    // Command lines of every case are built to temporary memory, so building doesn't touch standard allocator.
+    uint64_t checksum = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        TempAllocatorScope scope;
+        const ArgumentsCase& testCase = cases[i % caseCount];
+        Newstring args[4];
+        for (uint32_t k = 0; k < testCase.argCount; ++k)
+            args[k] = str(testCase.args[k]);
+        Bench::Sample sample;
+
+        sample.Begin(&buildLatency);
+        Newstring commandLine = CommandLine::BuildWindowsCommandLine(str(L"--profile 1"), args, testCase.argCount);
+        sample.End();
+
+        sample.Begin(&splitLatency);
+        uintptr_t argvSize = CommandLine::GetPosixArgvSize(program, commandLine);
+        char** posixArgv = CommandLine::WritePosixArgv(g_tempAllocator.Allocate(argvSize), program, commandLine);
+        sample.End();
+
+        checksum += commandLine.count + static_cast<uint8_t>(posixArgv[1][0]);
+    }
+
+    printf("cases: %u, iterations: %d, checksum: %llx\n", caseCount, iterations, static_cast<unsigned long long>(checksum));
+    buildLatency.Print("build command line");
+    splitLatency.Print("write POSIX argv");
+
+    return checks.GetExitCode();
+}
+
+/** Records values and completions of animations ticked by runAnimationBenchmark. */
+struct AnimationProbe
+{
+    float lastValue = -1.0f;
+    uint32_t applyCount = 0;
+    uint32_t completedCount = 0;
+    bool isMonotonic = true;
+    float direction = 1.0f;
+
+    /** Animation started by completion callback, if set. */
+    AnimationScheduler* scheduler = nullptr;
+    double now = 0.0;
+};
+
+static void animationProbeApply(const void*, float value, void* userdata)
+{
+    AnimationProbe* probe = static_cast<AnimationProbe*>(userdata);
+    if (probe->applyCount > 0 && (value - probe->lastValue) * probe->direction < 0.0f)
+        probe->isMonotonic = false;
+
+    probe->lastValue = value;
+    ++probe->applyCount;
+}
+
+static void animationProbeCompleted(const void* key, void* userdata)
+{
+    AnimationProbe* probe = static_cast<AnimationProbe*>(userdata);
+    ++probe->completedCount;
+
+    // First completion chains fade back to 0, started from inside of the callback.
+    if (probe->scheduler != nullptr && probe->completedCount == 1)
+    {
+        probe->direction = -1.0f;
+        probe->scheduler->AnimateTo(key, 255.0f, 0.0f, 0.05, Easing::Linear, animationProbeApply, animationProbeCompleted, probe, probe->now);
+    }
+}
+
+/**
+ * Checks AnimationScheduler timing against a virtual clock: fades, retargeting in flight, stopping, callbacks that
+ * start animations and easing, then measures Tick() latency with every slot animated.
+ * Usage: animation [ticks]
+ * Exit code is 1 if any check fails.
+ */
+static int runAnimationBenchmark(int argc, char** argv)
+{
+    const double frameTime = 1.0 / 60.0;
+    Bench::Checks checks;
+
+    int key = 0;
+
+    // Fade in over 3 frames: values grow, last one is exact and completion is reported once, on the last frame.
+    {
+        AnimationScheduler scheduler;
+        AnimationProbe probe;
+        scheduler.AnimateTo(&key, 0.0f, 255.0f, 0.05, Easing::Linear, animationProbeApply, animationProbeCompleted, &probe, 0.0);
+
+        uint32_t frame = 0;
+        while (scheduler.Tick(frame * frameTime))
+            ++frame;
+
+        checks.Check(frame == 3, "fade completes on the frame that reaches its duration");
+        checks.Check(probe.isMonotonic && probe.lastValue == 255.0f, "fade reaches end value monotonically");
+        checks.Check(probe.applyCount == 4 && probe.completedCount == 1, "fade applies every frame and completes once");
+    }
+
+    // Fade out is retargeted in flight: it continues from current value, keeps its speed and doesn't complete.
+    {
+        AnimationScheduler scheduler;
+        AnimationProbe hide;
+        AnimationProbe show;
+        scheduler.AnimateTo(&key, 255.0f, 0.0f, 0.1, Easing::Linear, animationProbeApply, animationProbeCompleted, &hide, 0.0);
+        scheduler.Tick(0.02);
+        scheduler.AnimateTo(&key, 0.0f, 255.0f, 0.1, Easing::Linear, animationProbeApply, animationProbeCompleted, &show, 0.04);
+
+        float value = 0.0f;
+        checks.Check(scheduler.Tick(0.04) && scheduler.GetValue(&key, &value) && value == 153.0f, "retargeted animation starts from current value");
+        checks.Check(scheduler.Tick(0.079), "retargeted animation is shortened by covered distance");
+        checks.Check(!scheduler.Tick(0.081) && show.lastValue == 255.0f, "retargeted animation reaches new target");
+        checks.Check(hide.completedCount == 0 && show.completedCount == 1, "replaced animation doesn't complete");
+        checks.Check(scheduler.statistics.interruptedCount == 1, "replaced animation is counted as interrupted");
+    }
+
+    // Stopped animation keeps its value and doesn't complete.
+    {
+        AnimationScheduler scheduler;
+        AnimationProbe probe;
+        scheduler.AnimateTo(&key, 0.0f, 255.0f, 0.1, Easing::Linear, animationProbeApply, animationProbeCompleted, &probe, 0.0);
+        scheduler.Tick(0.05);
+        checks.Check(scheduler.Stop(&key) && !scheduler.IsAnimating(&key), "animation is stopped");
+        checks.Check(!scheduler.Tick(0.2) && probe.applyCount == 1 && probe.completedCount == 0, "stopped animation isn't applied or completed");
+    }
+
+    // Completion callback starts next animation of the same key.
+    {
+        AnimationScheduler scheduler;
+        AnimationProbe probe;
+        probe.scheduler = &scheduler;
+        probe.now = 0.05;
+        scheduler.AnimateTo(&key, 0.0f, 255.0f, 0.05, Easing::Linear, animationProbeApply, animationProbeCompleted, &probe, 0.0);
+
+        checks.Check(scheduler.Tick(0.05), "animation started by completion callback keeps scheduler running");
+        checks.Check(!scheduler.Tick(0.1) && probe.completedCount == 2 && probe.lastValue == 0.0f, "chained animation completes");
+    }
+
+    // Zero duration animation is applied and completed by the first tick.
+    {
+        AnimationScheduler scheduler;
+        AnimationProbe probe;
+        scheduler.AnimateTo(&key, 0.0f, 255.0f, 0.0, Easing::Linear, animationProbeApply, animationProbeCompleted, &probe, 1.0);
+        checks.Check(!scheduler.Tick(1.0) && probe.lastValue == 255.0f && probe.completedCount == 1, "zero duration animation completes at once");
+    }
+
+    // Keyframes and easing.
+    {
+        AnimationTrack track;
+        track.AddKeyframe(0.0, 0.0f);
+        track.AddKeyframe(1.0, 100.0f);
+        track.AddKeyframe(2.0, 50.0f, Easing::EaseInQuad);
+        checks.Check(!track.AddKeyframe(1.5, 0.0f), "keyframes must be in order of time");
+        checks.Check(track.Evaluate(-1.0) == 0.0f && track.Evaluate(0.5) == 50.0f && track.Evaluate(1.5) == 87.5f && track.Evaluate(3.0) == 50.0f,
+            "track interpolates between keyframes");
+
+        const Easing easings[] = { Easing::Linear, Easing::EaseInQuad, Easing::EaseOutQuad, Easing::EaseInOutCubic };
+        for (Easing easing : easings)
+        {
+            bool isMonotonic = true;
+            for (int i = 1; i <= 100; ++i)
+                isMonotonic = isMonotonic && ApplyEasing(easing, i / 100.0f) >= ApplyEasing(easing, (i - 1) / 100.0f);
+
+            checks.Check(ApplyEasing(easing, 0.0f) == 0.0f && ApplyEasing(easing, 1.0f) == 1.0f && isMonotonic, "easing maps [0, 1] onto [0, 1]");
+        }
+    }
+
+    checks.Print();
+
+    // Every slot animated by long fade, so every tick applies every animation.
+    int ticks = argc >= 1 ? atoi(argv[0]) : 100000;
+    if (ticks < 1)  ticks = 1;
+
+    AnimationScheduler scheduler;
+    AnimationProbe probes[AnimationScheduler::Capacity];
+    for (uint32_t i = 0; i < AnimationScheduler::Capacity; ++i)
+        scheduler.AnimateTo(&probes[i], 0.0f, 1000000.0f, ticks * frameTime, Easing::EaseInOutCubic, animationProbeApply, nullptr, &probes[i], 0.0);
+
+    Bench::LatencyHistogram tickLatency;
+    defer(tickLatency.Dispose());
+    tickLatency.Reserve(ticks);
+
+    for (int i = 0; i < ticks; ++i)
+    {
+        Bench::Sample sample;
+        sample.Begin(&tickLatency);
+        scheduler.Tick(i * frameTime);
+        sample.End();
+    }
+
+    printf("animations: %u, ticks: %d, applied values: %u\n", scheduler.GetAnimationCount(), ticks, scheduler.statistics.applyCount);
+    tickLatency.Print("tick");
+
+    return checks.GetExitCode();
+}
+
+/**
+ * Checks FORMAT_TEMP output against Newstring::FormatTemp and compares their latencies on messages that the
+ * application formats: string, hexadecimal code, floating point timings and mixed arguments.
+ * Usage: format [iterations]
+ * Exit code is 1 if outputs differ.
+ */
+static int runFormatBenchmark(int argc, char** argv)
+{
+    int iterations = argc >= 1 ? atoi(argv[0]) : 100000;
+    if (iterations < 1)  iterations = 1;
+
+    const Newstring commandName = Newstring::WrapConstWChar(L"open-downloads");
+    const uint32_t errorCode = 0x80070005;
+    const double firstFrame = 12.34567;
+    const double average = 8.0627;
+    const int processed = -42;
+
+    enum { CaseCount = 4 };
+    const char* names[CaseCount] = { "string", "hex", "float", "mixed" };
+
+    auto formatPrintf = [&](int index) -> Newstring
+    {
+        switch (index)
+        {
+            case 0:  return Newstring::FormatTemp(L"Command \"%.*ls\" is not found.", commandName.count, commandName.data);
+            case 1:  return Newstring::FormatTemp(L"Cannot select directory, error code was 0x%08X.", errorCode);
+            case 2:  return Newstring::FormatTemp(L"Show to first frame: %.3f ms, average %.3f ms", firstFrame, average);
+            default: return Newstring::FormatTemp(L"%ls: %d of %u items, %.2f%% {done}", commandName.data, processed, errorCode, average);
+        }
+    };
+
+    auto formatTyped = [&](int index) -> Newstring
+    {
+        switch (index)
+        {
+            case 0:  return FORMAT_TEMP(L"Command \"{}\" is not found.", commandName);
+            case 1:  return FORMAT_TEMP(L"Cannot select directory, error code was 0x{:08X}.", errorCode);
+            case 2:  return FORMAT_TEMP(L"Show to first frame: {:.3} ms, average {:.3} ms", firstFrame, average);
+            default: return FORMAT_TEMP(L"{}: {} of {} items, {:.2}% {{done}}", commandName, processed, errorCode, average);
+        }
+    };
+
+    Bench::Checks checks;
+    for (int i = 0; i < CaseCount; ++i)
+    {
+        Newstring expected = formatPrintf(i);
+        Newstring actual = formatTyped(i);
+
+        bool isEqual = actual.count == expected.count && actual.data[actual.count] == L'\0' && actual.Equals(expected, StringComparison::CaseSensitive);
+        checks.Check(isEqual, names[i]);
+        if (!isEqual)
+            printf("  \"%ls\" != \"%ls\"\n", actual.data, expected.data);
+
+        g_tempAllocator.Reset();
+    }
+
+    checks.Print();
+    printf("iterations: %d\n", iterations);
+
+    for (int i = 0; i < CaseCount; ++i)
+    {
+        Bench::LatencyHistogram printfLatency;
+        Bench::LatencyHistogram typedLatency;
+        defer(printfLatency.Dispose());
+        defer(typedLatency.Dispose());
+        printfLatency.Reserve(iterations);
+        typedLatency.Reserve(iterations);
+
+        for (int j = 0; j < iterations; ++j)
+        {
+            Bench::Sample sample;
+            sample.Begin(&printfLatency);
+            formatPrintf(i);
+            sample.End();
+
+            sample.Begin(&typedLatency);
+            formatTyped(i);
+            sample.End();
+
+            g_tempAllocator.Reset();
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s FormatTemp", names[i]);
+        printfLatency.Print(name);
+        snprintf(name, sizeof(name), "%s FORMAT_TEMP", names[i]);
+        typedLatency.Print(name);
+    }
+
+    return checks.GetExitCode();
+}
+
+enum class ParseValueKind
+{
+    Int,
+    Float,
+    Color,
+    Duration,
+    Bool,
+    Count,
+};
+
+/** Parses value of specified kind, returns its bits, so results can be summed. */
+static uint64_t parseValue(ParseValueKind kind, const Newstring& value, bool* isValid)
+{
+    ParseResult result;
+    uint64_t bits = 0;
+
+    switch (kind)
+    {
+        case ParseValueKind::Int:
+        {
+            int32_t parsed = 0;
+            result = ParseUtils::ParseInt32(value, &parsed);
+            bits = static_cast<uint32_t>(parsed);
+            break;
+        }
+        case ParseValueKind::Float:
+        {
+            float parsed = 0.0f;
+            result = ParseUtils::ParseFloat(value, &parsed);
+            memcpy(&bits, &parsed, sizeof(parsed));
+            break;
+        }
+        case ParseValueKind::Color:
+        {
+            uint32_t parsed = 0;
+            result = ParseUtils::ParseColor(value, &parsed);
+            bits = parsed;
+            break;
+        }
+        case ParseValueKind::Duration:
+        {
+            double parsed = 0.0;
+            result = ParseUtils::ParseDuration(value, &parsed);
+            memcpy(&bits, &parsed, sizeof(parsed));
+            break;
+        }
+        default:
+        {
+            bool parsed = false;
+            result = ParseUtils::ParseBool(value, &parsed);
+            bits = parsed;
+            break;
+        }
+    }
+
+    *isValid = result.IsComplete(value);
+    return bits;
+}
+
+/** Parses value using CRT, as config values were parsed before. Value must be zero-terminated. */
+static uint64_t parseValueWithCrt(ParseValueKind kind, const Newstring& value)
+{
+    if (kind == ParseValueKind::Int)
+    {
+        int parsed = 0;
+        swscanf(value.data, L"%i", &parsed);
+        return static_cast<uint32_t>(parsed);
+    }
+
+    float parsed = static_cast<float>(wcstod(value.data, nullptr));
+    uint64_t bits = 0;
+    memcpy(&bits, &parsed, sizeof(parsed));
+    return bits;
+}
+
+/**
+ * Checks config value parsing (integers, floats, colors, durations, booleans) on valid and invalid values, then
+ * measures throughput on generated values and compares integers and floats with swscanf and wcstod.
+ * Usage: parse [iterations]
+ * Exit code is 1 if any check fails.
+ */
+static int runParseBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    auto str = [](const wchar_t* s) { return Newstring::WrapConstWChar(s); };
+
+    {
+        int32_t value = 0;
+        checks.Check(ParseUtils::ParseInt32(str(L"-2147483648"), &value).IsComplete(str(L"-2147483648")) && value == INT32_MIN, "minimum integer");
+        checks.Check(ParseUtils::ParseInt32(str(L"0x7fffFFFF"), &value).IsComplete(str(L"0x7fffFFFF")) && value == INT32_MAX, "hexadecimal integer");
+        checks.Check(ParseUtils::ParseInt32(str(L"2147483648"), &value).error == ParseError::OutOfRange, "integer overflow");
+        checks.Check(ParseUtils::ParseInt32(str(L"99999999999999999999"), &value).count == 20, "out of range integer is consumed");
+        checks.Check(ParseUtils::ParseInt32(str(L"12px"), &value).count == 2 && value == 12, "parsing stops after integer");
+        checks.Check(!ParseUtils::ParseInt32(str(L"12px"), &value).IsComplete(str(L"12px")), "integer with trailing characters is not complete");
+        checks.Check(ParseUtils::ParseInt32(str(L"010"), &value).IsComplete(str(L"010")) && value == 10, "leading zero is not octal prefix");
+        checks.Check(ParseUtils::ParseInt32(str(L"0x"), &value).count == 1 && value == 0, "hexadecimal prefix without digits");
+        checks.Check(ParseUtils::ParseInt32(str(L" 1"), &value).error == ParseError::InvalidValue, "whitespace is not skipped");
+        checks.Check(ParseUtils::ParseInt32(str(L"-"), &value).error == ParseError::InvalidValue, "sign without digits");
+        checks.Check(ParseUtils::ParseInt32(Newstring(), &value).error == ParseError::InvalidValue, "empty integer");
+    }
+
+    {
+        float value = 0.0f;
+        double precise = 0.0;
+        checks.Check(ParseUtils::ParseFloat(str(L"22.5"), &value).IsComplete(str(L"22.5")) && value == 22.5f, "float");
+        checks.Check(ParseUtils::ParseFloat(str(L"-.25"), &value).IsComplete(str(L"-.25")) && value == -0.25f, "float without integer part");
+        checks.Check(ParseUtils::ParseFloat(str(L"4."), &value).IsComplete(str(L"4.")) && value == 4.0f, "float without fraction");
+        checks.Check(ParseUtils::ParseFloat(str(L"1.5e3"), &value).IsComplete(str(L"1.5e3")) && value == 1500.0f, "float with exponent");
+        checks.Check(ParseUtils::ParseFloat(str(L"2em"), &value).count == 1 && value == 2.0f, "exponent without digits is not consumed");
+        checks.Check(ParseUtils::ParseFloat(str(L"1e39"), &value).error == ParseError::OutOfRange, "float overflow");
+        checks.Check(ParseUtils::ParseFloat(str(L"1,5"), &value).count == 1, "decimal separator doesn't depend on locale");
+        checks.Check(ParseUtils::ParseFloat(str(L"."), &value).error == ParseError::InvalidValue, "float without digits");
+        checks.Check(ParseUtils::ParseDouble(str(L"0.1"), &precise).count == 3 && precise == 0.1, "double is correctly rounded");
+        checks.Check(ParseUtils::ParseDouble(str(L"123456789012345678901234"), &precise).count == 24 && precise == 1.2345678901234568e23, "long mantissa");
+        checks.Check(ParseUtils::ParseDouble(str(L"1e-320"), &precise).count == 6 && precise > 0.0 && precise < 1e-319, "denormal double");
+    }
+
+    {
+        uint32_t rgba = 0;
+        checks.Check(ParseUtils::ParseColor(str(L"#D9D9D9"), &rgba).IsComplete(str(L"#D9D9D9")) && rgba == 0xD9D9D9FF, "color without alpha");
+        checks.Check(ParseUtils::ParseColor(str(L"#11223344"), &rgba).IsComplete(str(L"#11223344")) && rgba == 0x11223344, "color with alpha");
+        checks.Check(ParseUtils::ParseColor(str(L"#f0a"), &rgba).IsComplete(str(L"#f0a")) && rgba == 0xFF00AAFF, "short color");
+        checks.Check(ParseUtils::ParseColor(str(L"#f0a8"), &rgba).IsComplete(str(L"#f0a8")) && rgba == 0xFF00AA88, "short color with alpha");
+        checks.Check(ParseUtils::ParseColor(str(L"#12345"), &rgba).error == ParseError::InvalidValue, "color with wrong number of digits");
+        checks.Check(ParseUtils::ParseColor(str(L"#123456789"), &rgba).error == ParseError::InvalidValue, "color with too many digits");
+        checks.Check(ParseUtils::ParseColor(str(L"112233"), &rgba).error == ParseError::InvalidValue, "color without #");
+    }
+
+    {
+        double seconds = 0.0;
+        checks.Check(ParseUtils::ParseDuration(str(L"150ms"), &seconds).IsComplete(str(L"150ms")) && seconds == 0.15, "milliseconds");
+        checks.Check(ParseUtils::ParseDuration(str(L"0.5s"), &seconds).IsComplete(str(L"0.5s")) && seconds == 0.5, "seconds");
+        checks.Check(ParseUtils::ParseDuration(str(L"2min"), &seconds).IsComplete(str(L"2min")) && seconds == 120.0, "minutes");
+        checks.Check(ParseUtils::ParseDuration(str(L"10"), &seconds).error == ParseError::InvalidValue, "duration without unit");
+        checks.Check(ParseUtils::ParseDuration(str(L"-1s"), &seconds).error == ParseError::OutOfRange, "negative duration");
+    }
+
+    {
+        bool value = false;
+        checks.Check(ParseUtils::StringToBool(str(L"Yes"), &value) && value, "boolean is case-insensitive");
+        checks.Check(ParseUtils::StringToBool(str(L"off"), &value) && !value, "off");
+        checks.Check(ParseUtils::StringToBool(str(L"no"), &value) && !value, "no is not parsed as n");
+        checks.Check(!ParseUtils::StringToBool(str(L"nope"), &value), "boolean with trailing characters");
+        checks.Check(!ParseUtils::StringToBool(str(L"tru"), &value), "truncated boolean");
+    }
+
+    checks.Print();
+
+    int iterations = argc >= 1 ? atoi(argv[0]) : 100;
+    if (iterations < 1)  iterations = 1;
+
+    // Values are zero-terminated, so they can be parsed by CRT.
+    const uint32_t valueCount = 10000;
+    const char* kindNames[] = { "int", "float", "color", "duration", "bool" };
+    Array<Newstring> values[static_cast<int>(ParseValueKind::Count)];
+    NewstringBuilder text[static_cast<int>(ParseValueKind::Count)];
+    defer({
+        for (int kind = 0; kind < static_cast<int>(ParseValueKind::Count); ++kind)
+        {
+            values[kind].Dispose();
+            text[kind].Dispose();
+        }
+    });
+
+    uint32_t seed = 12345;
+    auto random = [&seed]() -> uint32_t
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    const wchar_t* booleans[] = { L"true", L"false", L"yes", L"no", L"on", L"off", L"1", L"0" };
+    for (int kind = 0; kind < static_cast<int>(ParseValueKind::Count); ++kind)
+    {
+        Array<uint32_t> offsets;
+        defer(offsets.Dispose());
+        offsets.Reserve(valueCount);
+        values[kind].Reserve(valueCount);
+
+        for (uint32_t i = 0; i < valueCount; ++i)
+        {
+            offsets.Append(text[kind].count);
+            switch (static_cast<ParseValueKind>(kind))
+            {
+                case ParseValueKind::Int:       FORMAT_APPEND(&text[kind], L"{}", static_cast<int>(random()) - 0x400000); break;
+                case ParseValueKind::Float:     FORMAT_APPEND(&text[kind], L"{:.3}", (random() % 100000) / 7.0); break;
+                case ParseValueKind::Color:     FORMAT_APPEND(&text[kind], L"#{:08X}", random() << 8 | (random() & 0xFF)); break;
+                case ParseValueKind::Duration:  FORMAT_APPEND(&text[kind], L"{}ms", random() % 1000); break;
+                default:                        FORMAT_APPEND(&text[kind], L"{}", booleans[random() % 8]); break;
+            }
+            text[kind].Append(L'\0');
+        }
+
+        for (uint32_t i = 0; i < valueCount; ++i)
+        {
+            uint32_t end = i + 1 < valueCount ? offsets.data[i + 1] : text[kind].count;
+            values[kind].Append(Newstring(text[kind].data + offsets.data[i], end - offsets.data[i] - 1));
+        }
+    }
+
+    printf("values: %u per kind, iterations: %d\n", valueCount, iterations);
+
+    uint64_t checksum = 0;
+    for (int kind = 0; kind < static_cast<int>(ParseValueKind::Count); ++kind)
+    {
+        const Array<Newstring>& kindValues = values[kind];
+        uint64_t characterCount = 0;
+        for (uint32_t i = 0; i < kindValues.count; ++i)
+            characterCount += kindValues.data[i].count;
+
+        bool allValid = true;
+        uint64_t start = Bench::GetTimeNs();
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            for (uint32_t i = 0; i < kindValues.count; ++i)
+            {
+                bool isValid;
+                checksum += parseValue(static_cast<ParseValueKind>(kind), kindValues.data[i], &isValid);
+                allValid = allValid && isValid;
+            }
+        }
+        uint64_t elapsed = Bench::GetTimeNs() - start;
+
+        checks.Check(allValid, "generated values are valid");
+
+        double valuesParsed = static_cast<double>(kindValues.count) * iterations;
+        printf("%-8s ParseUtils  %8.2f ns/value  %8.1f M chars/s\n", kindNames[kind], elapsed / valuesParsed,
+            characterCount * iterations * 1000.0 / elapsed);
+
+        if (kind != static_cast<int>(ParseValueKind::Int) && kind != static_cast<int>(ParseValueKind::Float))
+            continue;
+
+        uint32_t mismatchCount = 0;
+        for (uint32_t i = 0; i < kindValues.count; ++i)
+        {
+            bool isValid;
+            if (parseValue(static_cast<ParseValueKind>(kind), kindValues.data[i], &isValid) != parseValueWithCrt(static_cast<ParseValueKind>(kind), kindValues.data[i]))
+                ++mismatchCount;
+        }
+        checks.Check(mismatchCount == 0, "values are the same as parsed by CRT");
+
+        start = Bench::GetTimeNs();
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            for (uint32_t i = 0; i < kindValues.count; ++i)
+                checksum += parseValueWithCrt(static_cast<ParseValueKind>(kind), kindValues.data[i]);
+        }
+        elapsed = Bench::GetTimeNs() - start;
+
+        printf("%-8s %-10s  %8.2f ns/value  %8.1f M chars/s\n", kindNames[kind], kind == 0 ? "swscanf" : "wcstod",
+            elapsed / valuesParsed, characterCount * iterations * 1000.0 / elapsed);
+    }
+
+    printf("checksum: %llx\n", static_cast<unsigned long long>(checksum));
+    if (checks.failedCount > 0)
+        printf("checks: %u failed\n", checks.failedCount);
+
+    return checks.GetExitCode();
+}
+
+/** Case-insensitive prefix comparison through CRT, as command names were matched before case folding table. */
+static bool legacyStartsWithIgnoreCase(const Newstring& string, const Newstring& prefix)
+{
+    return prefix.count <= string.count && _wcsnicmp(string.data, prefix.data, prefix.count) == 0;
+}
+
+/**
+ * Checks full case folding (Cyrillic, German sharp s, Greek sigma, Turkish dotted I, supplementary planes) and
+ * command lookup by folded names, then compares latency of matching a query against command names through CRT,
+ * through folding on the fly and by comparing pre-folded names.
+ * Usage: casefold [iterations]
+ * Exit code is 1 if any check fails.
+ */
+static int runCaseFoldBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    auto str = [](const wchar_t* s) { return Newstring::WrapConstWChar(s); };
+
+    checks.Check(Unicode::EqualsIgnoreCase(str(L"STRASSE"), str(L"stra\u00DFe")), "sharp s is folded to ss");
+    checks.Check(Unicode::EqualsIgnoreCase(str(L"\u041F\u0420\u0418\u0412\u0415\u0422"), str(L"\u043F\u0440\u0438\u0432\u0435\u0442")), "Cyrillic");
+    checks.Check(Unicode::EqualsIgnoreCase(str(L"\U00010400"), str(L"\U00010428")), "supplementary plane");
+    checks.Check(Unicode::EqualsIgnoreCase(str(L"\u03C2"), str(L"\u03A3")) && Unicode::EqualsIgnoreCase(str(L"\u03C3"), str(L"\u03A3")), "Greek sigma");
+    checks.Check(!Unicode::EqualsIgnoreCase(str(L"\u0130"), str(L"i")), "dotted capital I is not folded to i");
+    checks.Check(!Unicode::EqualsIgnoreCase(str(L"abc"), str(L"ab")) && !Unicode::EqualsIgnoreCase(str(L"ab"), str(L"abc")), "different lengths");
+    checks.Check(Unicode::StartsWithIgnoreCase(str(L"stra\u00DFe"), str(L"STRAS")), "prefix ends inside folded codepoint");
+    checks.Check(!Unicode::StartsWithIgnoreCase(str(L"stra\u00DFe"), str(L"STRASSEN")), "prefix is longer than string");
+    checks.Check(str(L"\u00C0\u00C9").Equals(str(L"\u00E0\u00E9"), StringComparison::CaseInsensitive), "Newstring::Equals folds case");
+    checks.Check(!str(L"A").Equals(str(L"a"), StringComparison::CaseSensitive), "case-sensitive comparison doesn't fold case");
+
+    {
+        Newstring folded = Unicode::FoldCase(str(L"Stra\u00DFe-\u00D6ffnen \U00010400"));
+        defer(folded.Dispose());
+        checks.Check(folded == str(L"strasse-\u00F6ffnen \U00010428"), "string is folded");
+
+        uint32_t codepoint = 0;
+        const wchar_t surrogates[] = { 0xD801, 0xDC00, 0xD801 };
+        const wchar_t* next = Unicode::Decode16(surrogates, surrogates + 3, &codepoint);
+        checks.Check((next == surrogates + 2 && codepoint == 0x10400) || WCHAR_MAX > 0xFFFF, "surrogate pair is decoded");
+        next = Unicode::Decode16(next, surrogates + 3, &codepoint);
+        checks.Check(next == surrogates + 3 && codepoint == 0xD801, "unpaired surrogate is not read past the end");
+    }
+
+    const wchar_t* words[][2] = {
+        { L"open", L"OPEN" },
+        { L"folder", L"FOLDER" },
+        { L"\u043F\u0430\u043F\u043A\u0430", L"\u041F\u0410\u041F\u041A\u0410" },
+        { L"\u043E\u0442\u043A\u0440\u044B\u0442\u044C", L"\u041E\u0422\u041A\u0420\u042B\u0422\u042C" },
+        { L"stra\u00DFe", L"STRASSE" },
+        { L"gr\u00F6\u00DFe", L"GR\u00D6SSE" },
+        { L"\u03C3\u03B5\u03BB\u03AF\u03B4\u03B1", L"\u03A3\u0395\u039B\u038A\u0394\u0391" },
+        { L"notepad", L"NotePad" },
+    };
+    const uint32_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    CommandEngine engine;
+    defer({
+        engine.UnregisterAllCommands();
+        engine.Dispose();
+    });
+
+    // Every pair of words with number, e.g. "open-folder-8".
+    const uint32_t commandCount = 1000;
+    for (uint32_t i = 0; i < commandCount; ++i)
+    {
+        Bench::ProbeCommand* command = Memnew(Bench::ProbeCommand);
+        command->name = FORMAT_STRING(&g_standardAllocator, L"{}-{}-{}", words[i % wordCount][0], words[(i / wordCount) % wordCount][0], i);
+        if (!engine.RegisterCommand(command))
+        {
+            Memdelete(command);
+            fprintf(stderr, "unable to register command\n");
+            return 1;
+        }
+    }
+
+    {
+        uint32_t count = 0;
+        engine.FindAutocompletionCandidates(str(L"STRASSE-\u041F\u0410\u041F"), &count);
+        checks.Check(count == commandCount / wordCount / wordCount + 1, "autocompletion matches folded names");
+        checks.Check(engine.FindCommandByName(str(L"GR\u00D6SSE-OPEN-5")) != nullptr, "command is found by folded name");
+        checks.Check(engine.FindCommandByName(str(L"gr\u00F6\u00DFe-open-6")) == nullptr, "command with different name is not found");
+    }
+
+    checks.Print();
+
+    int iterations = argc >= 1 ? atoi(argv[0]) : 1000;
+    if (iterations < 1)  iterations = 1;
+
+    Bench::LatencyHistogram legacyLatency;
+    Bench::LatencyHistogram foldingLatency;
+    Bench::LatencyHistogram foldedLatency;
+    defer({
+        legacyLatency.Dispose();
+        foldingLatency.Dispose();
+        foldedLatency.Dispose();
+    });
+    legacyLatency.Reserve(iterations * wordCount);
+    foldingLatency.Reserve(iterations * wordCount);
+    foldedLatency.Reserve(iterations * wordCount);
+
+    uint32_t legacyMatchCount = 0;
+    uint32_t foldingMatchCount = 0;
+    uint32_t foldedMatchCount = 0;
+
+    NewstringBuilder foldedQuery;
+    Utf8StringPool encodedQuery;
+    defer({
+        foldedQuery.Dispose();
+        encodedQuery.Dispose();
+    });
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (uint32_t word = 0; word < wordCount; ++word)
+        {
+            Newstring query = str(words[word][1]);
+            Bench::Sample sample;
+
+            sample.Begin(&legacyLatency);
+            for (uint32_t i = 0; i < engine.commandSet->commands.count; ++i)
+                legacyMatchCount += legacyStartsWithIgnoreCase(engine.commandSet->commands.data[i]->name, query);
+            sample.End();
+
+            sample.Begin(&foldingLatency);
+            for (uint32_t i = 0; i < engine.commandSet->commands.count; ++i)
+                foldingMatchCount += engine.commandSet->commands.data[i]->name.StartsWith(query, StringComparison::CaseInsensitive);
+            sample.End();
+
+            sample.Begin(&foldedLatency);
+            foldedQuery.count = 0;
+            Unicode::AppendFoldedCase(&foldedQuery, query);
+            encodedQuery.Clear();
+            Utf8StringRef encodedQueryRef;
+            encodedQuery.Add(foldedQuery.string, &encodedQueryRef);
+            for (uint32_t i = 0; i < engine.commandSet->commands.count; ++i)
+                foldedMatchCount += engine.commandSet->stringPool.StartsWith(engine.commandSet->table.foldedNames.data[i], encodedQuery, encodedQueryRef);
+            sample.End();
+        }
+    }
+
+    checks.Check(foldingMatchCount == foldedMatchCount && foldedMatchCount == commandCount * iterations, "every command matches its first word");
+
+    printf("commands: %u, queries: %u, iterations: %d\n", commandCount, wordCount, iterations);
+    printf("matches: CRT %u, folding %u, pre-folded %u\n", legacyMatchCount / iterations, foldingMatchCount / iterations, foldedMatchCount / iterations);
+    legacyLatency.Print("query CRT");
+    foldingLatency.Print("query folding");
+    foldedLatency.Print("query pre-folded");
+
+    return checks.GetExitCode();
+}
+
+/**
+ * Checks that command names are found by text typed in wrong keyboard layout, then compares latency of
+ * autocompletion without layout maps, with QWERTY and JCUKEN maps and with query typed in wrong layout.
+ * Usage: layout [iterations]
+ * Exit code is 1 if any check fails.
+ */
+static int runLayoutBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    auto str = [](const wchar_t* s) { return Newstring::WrapConstWChar(s); };
+
+    {
+        KeyboardLayoutMap map;
+        defer(map.Dispose());
+        checks.Check(!map.Initialize(str(L"ab"), str(L"a")), "keys of different length are rejected");
+        checks.Check(map.Initialize(str(L"aab"), str(L"xyz")) && map.Map(L'a') == L'x' && map.Map(L'b') == L'z' && map.Map(L'c') == L'c',
+            "first pair of repeated key is used");
+    }
+
+    // Names and the same keys typed in other layout.
+    const wchar_t* words[][2] = {
+        { L"open", L"\u0449\u0437\u0443\u0442" },
+        { L"folder", L"\u0430\u0449\u0434\u0432\u0443\u043A" },
+        { L"\u043F\u0430\u043F\u043A\u0430", L"gfgrf" },
+        { L"\u043E\u0442\u043A\u0440\u044B\u0442\u044C", L"jnrhsnm" },
+        { L"notepad", L"\u0442\u0449\u0435\u0443\u0437\u0444\u0432" },
+        { L"ya.ru", L"\u043D\u0444\u044E\u043A\u0433" },
+    };
+    const uint32_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    CommandEngine plainEngine;
+    CommandEngine layoutEngine;
+    defer({
+        plainEngine.UnregisterAllCommands();
+        plainEngine.Dispose();
+        layoutEngine.UnregisterAllCommands();
+        layoutEngine.Dispose();
+    });
+    checks.Check(layoutEngine.AddDefaultKeyboardLayoutMaps(), "default maps are added");
+
+    // Every pair of words with number, e.g. "open-folder-6".
+    const uint32_t commandCount = 1000;
+    for (uint32_t i = 0; i < commandCount * 2; ++i)
+    {
+        CommandEngine* engine = i < commandCount ? &plainEngine : &layoutEngine;
+        uint32_t index = i % commandCount;
+
+        Bench::ProbeCommand* command = Memnew(Bench::ProbeCommand);
+        command->name = FORMAT_STRING(&g_standardAllocator, L"{}-{}-{}", words[index % wordCount][0], words[(index / wordCount) % wordCount][0], index);
+        if (!engine->RegisterCommand(command))
+        {
+            Memdelete(command);
+            fprintf(stderr, "unable to register command\n");
+            return 1;
+        }
+    }
+
+    {
+        const uint32_t firstWordMatchCount = (commandCount + wordCount - 1) / wordCount;
+        uint32_t count = 0;
+
+        layoutEngine.FindAutocompletionCandidates(str(L"\u0449\u0437\u0443\u0442"), &count);
+        checks.Check(count == firstWordMatchCount, "English name is found by text typed in Russian layout");
+        layoutEngine.FindAutocompletionCandidates(str(L"GFGRF"), &count);
+        checks.Check(count == firstWordMatchCount, "Russian name is found by upper case text typed in English layout");
+        layoutEngine.FindAutocompletionCandidates(str(L"\u043D\u0444\u044E\u043A\u0433-\u0449"), &count);
+        checks.Check(count == firstWordMatchCount / wordCount + 1, "punctuation keys are mapped");
+        layoutEngine.FindAutocompletionCandidates(str(L"open-\u0430\u0449\u0434"), &count);
+        checks.Check(count == 0, "query typed in two layouts doesn't match");
+        plainEngine.FindAutocompletionCandidates(str(L"\u0449\u0437\u0443\u0442"), &count);
+        checks.Check(count == 0, "names are not mapped without maps");
+
+        // Name mapped back to its own layout is the same name, so it's not stored.
+        checks.Check(layoutEngine.commandSet->table.layoutNameCounts.data[0] == 1, "layout name equal to folded name is not stored");
+        checks.Check(layoutEngine.FindCommandByName(str(L"\u0449\u0437\u0443\u0442-\u0449\u0437\u0443\u0442-0")) == nullptr, "command name must be exact");
+    }
+
+    checks.Print();
+
+    int iterations = argc >= 1 ? atoi(argv[0]) : 1000;
+    if (iterations < 1)  iterations = 1;
+
+    Bench::LatencyHistogram plainLatency;
+    Bench::LatencyHistogram layoutLatency;
+    Bench::LatencyHistogram wrongLayoutLatency;
+    defer({
+        plainLatency.Dispose();
+        layoutLatency.Dispose();
+        wrongLayoutLatency.Dispose();
+    });
+    plainLatency.Reserve(iterations * wordCount);
+    layoutLatency.Reserve(iterations * wordCount);
+    wrongLayoutLatency.Reserve(iterations * wordCount);
+
+    uint32_t plainMatchCount = 0;
+    uint32_t layoutMatchCount = 0;
+    uint32_t wrongLayoutMatchCount = 0;
+
+    // Consecutive queries don't narrow each other, so every query scans all commands.
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (uint32_t word = 0; word < wordCount; ++word)
+        {
+            uint32_t count = 0;
+            Bench::Sample sample;
+
+            sample.Begin(&plainLatency);
+            plainEngine.FindAutocompletionCandidates(str(words[word][0]), &count);
+            sample.End();
+            plainMatchCount += count;
+
+            sample.Begin(&layoutLatency);
+            layoutEngine.FindAutocompletionCandidates(str(words[word][0]), &count);
+            sample.End();
+            layoutMatchCount += count;
+
+            sample.Begin(&wrongLayoutLatency);
+            layoutEngine.FindAutocompletionCandidates(str(words[word][1]), &count);
+            sample.End();
+            wrongLayoutMatchCount += count;
+        }
+    }
+
+    checks.Check(plainMatchCount == layoutMatchCount && layoutMatchCount == wrongLayoutMatchCount, "every layout finds the same commands");
+
+    {
+        uint32_t count = 0;
+        checks.Check(plainEngine.AddDefaultKeyboardLayoutMaps(), "maps are added after commands are registered");
+        plainEngine.FindAutocompletionCandidates(str(L"\u0449\u0437\u0443\u0442"), &count);
+        checks.Check(count == (commandCount + wordCount - 1) / wordCount, "registered commands are mapped when map is added");
+    }
+
+    printf("commands: %u, queries: %u, iterations: %d\n", commandCount, wordCount, iterations);
+    printf("matches: without maps %u, with maps %u, wrong layout %u\n", plainMatchCount / iterations, layoutMatchCount / iterations, wrongLayoutMatchCount / iterations);
+    plainLatency.Print("query without maps");
+    layoutLatency.Print("query with maps");
+    wrongLayoutLatency.Print("query wrong layout");
+
+    return checks.GetExitCode();
+}
+
+/** Command with strings in string pool of command set, like built-in run_app command. */
+struct PooledAppCommand : public Command
+{
+    Utf8StringRef appPath;
+    Utf8StringRef workDir;
+    Utf8StringRef appArgs;
+    bool shellExec = false;
+    bool asAdmin = false;
+    int shellExec_nShow = 1;
+
+    bool Execute(ExecuteCommandState*, Array<Newstring>&) override { return true; }
+};
+
+static Command* pooledApp_createCommand(CreateCommandState* state, Array<Newstring>& keys, Array<Newstring>& values)
+{
+    PooledAppCommand* cmd = Memnew(PooledAppCommand);
+    for (uint32_t i = 0; i < keys.count; ++i)
+    {
+        Utf8StringRef* ref = nullptr;
+        if (keys.data[i] == L"path")
+            ref = &cmd->appPath;
+        else if (keys.data[i] == L"args")
+            ref = &cmd->appArgs;
+        else if (keys.data[i] == L"work_dir")
+            ref = &cmd->workDir;
+
+        if (ref != nullptr && !state->stringPool->Add(values.data[i], ref))
+        {
+            Memdelete(cmd);
+            return nullptr;
+        }
+    }
+
+    return cmd;
+}
+
+/**
+ * Command as it was stored before string pool: every string is separate UTF-16 allocation, layout names are
+ * kept in array of every command.
+ */
+struct LegacyAppCommand
+{
+    CommandInfo* info = nullptr;
+    CommandEngine* engine = nullptr;
+    Newstring name;
+    Newstring foldedName;
+    Array<Newstring> layoutNames;
+    wchar_t* appPath = nullptr;
+    wchar_t* workDir = nullptr;
+    Newstring appArgs;
+    bool shellExec = false;
+    bool asAdmin = false;
+    int shellExec_nShow = 1;
+
+    virtual ~LegacyAppCommand()
+    {
+        name.Dispose();
+        foldedName.Dispose();
+        for (uint32_t i = 0; i < layoutNames.count; ++i)
+            layoutNames.data[i].Dispose();
+        layoutNames.Dispose();
+        g_standardAllocator.Deallocate(appPath);
+        g_standardAllocator.Deallocate(workDir);
+        appArgs.Dispose();
+    }
+};
+
+/** Indexes legacy command name like command engine did before string pool. */
+static bool indexLegacyCommand(LegacyAppCommand* command, const Array<KeyboardLayoutMap>& maps)
+{
+    command->foldedName = Unicode::FoldCase(command->name);
+    if (command->foldedName.count == 0)
+        return false;
+
+    TempAllocatorScope scope;
+    for (uint32_t i = 0; i < maps.count; ++i)
+    {
+        NewstringBuilder mapped;
+        mapped.allocator = &g_tempAllocator;
+        if (!maps.data[i].AppendMapped(&mapped, command->foldedName))
+            return false;
+
+        Newstring layoutName = Unicode::FoldCase(mapped.string);
+        bool isDuplicate = Unicode::EqualsFolded(layoutName, command->foldedName);
+        for (uint32_t j = 0; j < command->layoutNames.count && !isDuplicate; ++j)
+            isDuplicate = Unicode::EqualsFolded(layoutName, command->layoutNames.data[j]);
+
+        if (isDuplicate || !command->layoutNames.Append(layoutName))
+            layoutName.Dispose();
+    }
+
+    return true;
+}
+
+/**
+ * Loads generated commands with paths, arguments and working directories, and compares memory they take in
+ * string pool of command set with memory they took as separate UTF-16 strings. Memory is measured as heap
+ * bytes allocated by standard allocator, including allocation overhead that allocator reports.
+ * Usage: memory [commandCount]
+ * Exit code is 1 if any check fails.
+ */
+static int runMemoryBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    int commandCount = argc >= 1 ? atoi(argv[0]) : 100000;
+    if (commandCount < 1)  commandCount = 1;
+
+    NewstringBuilder source;
+    defer(source.Dispose());
+    Bench::AppendProbeCommandsSource(&source, commandCount);
+
+    Array<KeyboardLayoutMap> maps;
+    defer({
+        for (uint32_t i = 0; i < maps.count; ++i)
+            maps.data[i].Dispose();
+        maps.Dispose();
+    });
+    {
+        const Newstring qwerty = Newstring::WrapConstWChar(KeyboardLayoutMap::QwertyKeys);
+        const Newstring jcuken = Newstring::WrapConstWChar(KeyboardLayoutMap::JcukenKeys);
+        KeyboardLayoutMap map;
+        map.Initialize(qwerty, jcuken);
+        maps.Append(map);
+        map = KeyboardLayoutMap();
+        map.Initialize(jcuken, qwerty);
+        maps.Append(map);
+    }
+
+    // Legacy commands are created from the same strings that commands file has.
+    Array<LegacyAppCommand*> legacyCommands;
+    defer({
+        for (uint32_t i = 0; i < legacyCommands.count; ++i)
+            Memdelete(legacyCommands.data[i]);
+        legacyCommands.Dispose();
+    });
+
+    uintptr_t allocatedBefore = g_standardAllocator.allocated;
+    uint64_t start = Bench::GetTimeNs();
+    for (int i = 0; i < commandCount; ++i)
+    {
+        const wchar_t* word = Bench::ProbeWords[i % Bench::ProbeWordCount];
+        // Strings are cloned to exact size, as command loader did.
+        TempAllocatorScope scope;
+        LegacyAppCommand* command = Memnew(LegacyAppCommand);
+        command->name = FORMAT_TEMP(L"{}-{}", word, i).Clone();
+        command->appPath = FORMAT_TEMP(L"C:\\Program Files\\{}\\{}.exe", word, word).CloneAsCString();
+        command->appArgs = FORMAT_TEMP(L"--profile {}", i).Clone();
+        command->workDir = FORMAT_TEMP(L"C:\\Users\\user\\{}", word).CloneAsCString();
+
+        if (!indexLegacyCommand(command, maps) || !legacyCommands.Append(command))
+        {
+            Memdelete(command);
+            fprintf(stderr, "unable to create legacy command\n");
+            return 1;
+        }
+    }
+    uint64_t legacyTime = Bench::GetTimeNs() - start;
+    uintptr_t legacyBytes = g_standardAllocator.allocated - allocatedBefore;
+
+    CommandEngine engine;
+    defer({
+        engine.UnregisterAllCommands();
+        engine.Dispose();
+    });
+
+    allocatedBefore = g_standardAllocator.allocated;
+    start = Bench::GetTimeNs();
+    engine.AddDefaultKeyboardLayoutMaps();
+    {
+        static CommandInfo info(Newstring::WrapConstWChar(L"run_app"), CI_None, pooledApp_createCommand);
+
+        CommandSet* set = Memnew(CommandSet);
+        CommandLoader loader;
+        loader.stringPool = &set->stringPool;
+        loader.commandInfoArray.Append(&info);
+
+        Array<Command*> commands = loader.LoadFromString(source.string);
+        for (uint32_t i = 0; i < commands.count; ++i)
+        {
+            if (!engine.RegisterCommand(set, commands.data[i]))
+                Memdelete(commands.data[i]);
+        }
+
+        commands.Dispose();
+        loader.commandInfoArray.Dispose();
+        engine.PublishCommandSet(set);
+    }
+    uint64_t pooledTime = Bench::GetTimeNs() - start;
+    uintptr_t pooledBytes = g_standardAllocator.allocated - allocatedBefore;
+
+    checks.Check(engine.commandSet->commands.count == legacyCommands.count, "every command is loaded");
+
+    uint32_t mismatchCount = 0;
+    for (uint32_t i = 0; i < engine.commandSet->commands.count && i < legacyCommands.count; ++i)
+    {
+        TempAllocatorScope scope;
+        const PooledAppCommand* pooled = static_cast<const PooledAppCommand*>(engine.commandSet->commands.data[i]);
+        const LegacyAppCommand* legacy = legacyCommands.data[i];
+
+        Newstring path = engine.commandSet->stringPool.Decode(pooled->appPath);
+        Newstring workDir = engine.commandSet->stringPool.Decode(pooled->workDir);
+        if (path != Newstring::WrapConstWChar(legacy->appPath) || workDir != Newstring::WrapConstWChar(legacy->workDir)
+            || engine.commandSet->stringPool.Decode(pooled->appArgs) != legacy->appArgs || engine.commandSet->table.layoutNameCounts.data[i] != legacy->layoutNames.count
+            || path.data[path.count] != L'\0')
+        {
+            ++mismatchCount;
+        }
+    }
+    checks.Check(mismatchCount == 0, "strings are decoded from pool as they were loaded");
+
+    {
+        // "gfgrf" is "\u043F\u0430\u043F\u043A\u0430" typed in English layout.
+        uint32_t count = 0;
+        engine.FindAutocompletionCandidates(Newstring::WrapConstWChar(L"gfgrf-1"), &count);
+
+        NewstringBuilder folded;
+        defer(folded.Dispose());
+        Unicode::AppendFoldedCase(&folded, Newstring::WrapConstWChar(L"gfgrf-1"));
+        uint32_t legacyCount = 0;
+        for (uint32_t i = 0; i < legacyCommands.count; ++i)
+        {
+            const LegacyAppCommand* legacy = legacyCommands.data[i];
+            bool isMatch = Unicode::StartsWithFolded(legacy->foldedName, folded.string);
+            for (uint32_t j = 0; j < legacy->layoutNames.count && !isMatch; ++j)
+                isMatch = Unicode::StartsWithFolded(legacy->layoutNames.data[j], folded.string);
+            legacyCount += isMatch;
+        }
+        checks.Check(count > 0 && count == legacyCount, "pooled names are matched like legacy names");
+    }
+
+    checks.Print();
+    printf("commands: %d\n", commandCount);
+    printf("legacy UTF-16: %10llu bytes, %6.1f bytes/command, load %8.2f ms\n", static_cast<unsigned long long>(legacyBytes),
+        static_cast<double>(legacyBytes) / commandCount, legacyTime / 1e6);
+    printf("UTF-8 pool:    %10llu bytes, %6.1f bytes/command, load %8.2f ms\n", static_cast<unsigned long long>(pooledBytes),
+        static_cast<double>(pooledBytes) / commandCount, pooledTime / 1e6);
+    printf("string pool: %u bytes used, %u bytes capacity\n", engine.commandSet->stringPool.size, engine.commandSet->stringPool.capacity);
+    printf("pooled/legacy: %.2f\n", static_cast<double>(pooledBytes) / legacyBytes);
+
+    return checks.GetExitCode();
+}
+
+/** Command that also keeps its folded names in command object, as command engine did before command table. */
+struct TableProbeCommand : public Bench::ProbeCommand
+{
+    Utf8StringRef foldedName;
+    uint32_t firstLayoutName = 0;
+    uint32_t layoutNameCount = 0;
+};
+
+/** Finds autocompletion candidates following pointer to every command, as command engine did before command table. */
+static uint32_t findCandidatesByPointers(const CommandEngine& engine, const Utf8StringPool& queryPool, Utf8StringRef query, Array<Command*>* matches)
+{
+    const Array<Utf8StringRef>& layoutNames = engine.commandSet->table.layoutNames;
+    uint32_t matchCount = 0;
+    for (uint32_t i = 0; i < engine.commandSet->commands.count; ++i)
+    {
+        const TableProbeCommand* command = static_cast<const TableProbeCommand*>(engine.commandSet->commands.data[i]);
+        bool isMatch = engine.commandSet->stringPool.StartsWith(command->foldedName, queryPool, query);
+        for (uint32_t j = 0; j < command->layoutNameCount && !isMatch; ++j)
+            isMatch = engine.commandSet->stringPool.StartsWith(layoutNames.data[command->firstLayoutName + j], queryPool, query);
+
+        if (isMatch)
+            matches->data[matchCount++] = engine.commandSet->commands.data[i];
+    }
+
+    std::stable_sort(matches->data, matches->data + matchCount, [](const Command* a, const Command* b) { return a->name.count < b->name.count; });
+    matches->count = matchCount;
+    return matchCount;
+}
+
+/**
+ * Compares throughput of autocompletion and lookup by name that scan command table columns with scans that follow
+ * pointer to every command object.
+ * Usage: table [commandCount] [iterations]
+ * Exit code is 1 if any check fails.
+ */
+static int runTableBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    int commandCount = argc >= 1 ? atoi(argv[0]) : 100000;
+    if (commandCount < 1)  commandCount = 1;
+    int iterations = argc >= 2 ? atoi(argv[1]) : 20;
+    if (iterations < 1)  iterations = 1;
+
+    CommandEngine engine;
+    defer({
+        engine.UnregisterAllCommands();
+        engine.Dispose();
+    });
+    engine.AddDefaultKeyboardLayoutMaps();
+
+    for (int i = 0; i < commandCount; ++i)
+    {
+        TableProbeCommand* command = Memnew(TableProbeCommand);
+        command->name = Bench::FormatProbeCommandName(i);
+        if (!engine.RegisterCommand(command))
+        {
+            Memdelete(command);
+            fprintf(stderr, "unable to register command\n");
+            return 1;
+        }
+
+        uint32_t row = engine.commandSet->commands.count - 1;
+        command->foldedName = engine.commandSet->table.foldedNames.data[row];
+        command->firstLayoutName = engine.commandSet->table.firstLayoutNames.data[row];
+        command->layoutNameCount = engine.commandSet->table.layoutNameCounts.data[row];
+    }
+
+    // Consecutive queries don't extend each other, so every query scans all commands.
+    const wchar_t* queries[] = { L"chrome-1", L"gfgrf", L"notepad-7", L"TERMINAL-99", L"zzz", L"c", L"\u0441\u0440\u043A\u0449\u044C\u0443" };
+    const uint32_t queryCount = sizeof(queries) / sizeof(queries[0]);
+
+    Utf8StringPool queryPool;
+    Array<Command*> pointerMatches;
+    defer({
+        queryPool.Dispose();
+        pointerMatches.Dispose();
+    });
+    pointerMatches.Reserve(engine.commandSet->commands.count);
+
+    Array<Utf8StringRef> queryRefs;
+    defer(queryRefs.Dispose());
+    for (uint32_t i = 0; i < queryCount; ++i)
+    {
+        TempAllocatorScope scope;
+        Utf8StringRef ref;
+        queryPool.Add(Unicode::FoldCase(Newstring::WrapConstWChar(queries[i]), &g_tempAllocator), &ref);
+        queryRefs.Append(ref);
+    }
+
+    uint32_t mismatchCount = 0;
+    for (uint32_t i = 0; i < queryCount; ++i)
+    {
+        uint32_t count = 0;
+        Command* const* matches = engine.FindAutocompletionCandidates(Newstring::WrapConstWChar(queries[i]), &count);
+        uint32_t pointerCount = findCandidatesByPointers(engine, queryPool, queryRefs.data[i], &pointerMatches);
+        if (count != pointerCount || (count > 0 && memcmp(matches, pointerMatches.data, sizeof(Command*) * count) != 0))
+            ++mismatchCount;
+    }
+    checks.Check(mismatchCount == 0, "table and pointer scans find the same ranked candidates");
+    checks.Check(engine.FindCommandByName(Newstring::WrapConstWChar(L"CALC-6")) == engine.commandSet->commands.data[6], "command is found by name");
+    checks.Check(engine.FindCommandByName(Newstring::WrapConstWChar(L"calc-7")) == nullptr, "command with different name is not found");
+
+    checks.Print();
+
+    Bench::LatencyHistogram tableLatency;
+    Bench::LatencyHistogram pointerLatency;
+    Bench::LatencyHistogram tableLookupLatency;
+    Bench::LatencyHistogram pointerLookupLatency;
+    defer({
+        tableLatency.Dispose();
+        pointerLatency.Dispose();
+        tableLookupLatency.Dispose();
+        pointerLookupLatency.Dispose();
+    });
+    tableLatency.Reserve(iterations * queryCount);
+    pointerLatency.Reserve(iterations * queryCount);
+    tableLookupLatency.Reserve(iterations * queryCount);
+    pointerLookupLatency.Reserve(iterations * queryCount);
+
+    uint64_t tableTime = 0;
+    uint64_t pointerTime = 0;
+    uint32_t foundCount = 0;
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (uint32_t i = 0; i < queryCount; ++i)
+        {
+            uint32_t count = 0;
+            Bench::Sample sample;
+
+            uint64_t start = Bench::GetTimeNs();
+            sample.Begin(&tableLatency);
+            engine.FindAutocompletionCandidates(Newstring::WrapConstWChar(queries[i]), &count);
+            sample.End();
+            tableTime += Bench::GetTimeNs() - start;
+
+            start = Bench::GetTimeNs();
+            sample.Begin(&pointerLatency);
+            findCandidatesByPointers(engine, queryPool, queryRefs.data[i], &pointerMatches);
+            sample.End();
+            pointerTime += Bench::GetTimeNs() - start;
+
+            // Name of the last command is found after scanning all rows.
+            TempAllocatorScope scope;
+            const Newstring& name = engine.commandSet->commands.data[engine.commandSet->commands.count - 1]->name;
+            Utf8StringRef nameRef;
+            queryPool.Add(Unicode::FoldCase(name, &g_tempAllocator), &nameRef);
+
+            sample.Begin(&tableLookupLatency);
+            foundCount += engine.FindCommandByName(name) != nullptr;
+            sample.End();
+
+            sample.Begin(&pointerLookupLatency);
+            for (uint32_t c = 0; c < engine.commandSet->commands.count; ++c)
+            {
+                const TableProbeCommand* command = static_cast<const TableProbeCommand*>(engine.commandSet->commands.data[c]);
+                if (engine.commandSet->stringPool.Equals(command->foldedName, queryPool, nameRef))
+                {
+                    ++foundCount;
+                    break;
+                }
+            }
+            sample.End();
+            queryPool.size = nameRef.offset;
+        }
+    }
+
+    checks.Check(foundCount == 2 * iterations * queryCount, "last command is found by name");
+
+    uint64_t rowCount = static_cast<uint64_t>(engine.commandSet->commands.count) * iterations * queryCount;
+    printf("commands: %u, queries: %u, iterations: %d\n", engine.commandSet->commands.count, queryCount, iterations);
+    printf("autocompletion scan: table %.1f M rows/s, pointers %.1f M rows/s\n", rowCount * 1000.0 / tableTime, rowCount * 1000.0 / pointerTime);
+    tableLatency.Print("candidates table");
+    pointerLatency.Print("candidates pointers");
+    tableLookupLatency.Print("lookup table");
+    pointerLookupLatency.Print("lookup pointers");
+
+    return checks.GetExitCode();
+}
+
+/** Returns true if view rejects copy of image that was changed by 'corrupt'. */
+template<typename Corrupt>
+static bool isCorruptImageRejected(const void* image, uint32_t size, Corrupt corrupt)
+{
+    uint8_t* copy = static_cast<uint8_t*>(g_standardAllocator.Allocate(size));
+    if (copy == nullptr)
+        return false;
+    defer(g_standardAllocator.Deallocate(copy));
+
+    memcpy(copy, image, size);
+    corrupt(copy);
+
+    CommandImageView view;
+    return !view.Initialize(copy, size);
+}
+
+/** Destroys commands created by command loader. */
+static void deleteLoadedCommands(Array<Command*>* commands)
+{
+    for (uint32_t i = 0; i < commands->count; ++i)
+        Memdelete(commands->data[i]);
+    commands->Dispose();
+}
+
+/**
+ * Builds command image from generated commands file, writes it to disk and maps it twice, like two processes
+ * would. Compares time it takes to parse commands file with time it takes to map image and find command in it.
+ * Usage: image [commandCount] [iterations] [imagePath]
+ * Exit code is 1 if any check fails.
+ */
+static int runImageBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    int commandCount = argc >= 1 ? atoi(argv[0]) : 100000;
+    if (commandCount < 1)  commandCount = 1;
+    int iterations = argc >= 2 ? atoi(argv[1]) : 5;
+    if (iterations < 1)  iterations = 1;
+    const char* imagePath = argc >= 3 ? argv[2] : "cb_bench_commands.img";
+
+    NewstringBuilder source;
+    defer(source.Dispose());
+    Bench::AppendProbeCommandsSource(&source, commandCount);
+
+    uint32_t imageSize = 0;
+    void* image = BuildCommandImage(source.string, &imageSize);
+    defer(g_standardAllocator.Deallocate(image));
+    checks.Check(image != nullptr, "image is built");
+    if (image == nullptr)
+    {
+        checks.Print();
+        return 1;
+    }
+
+    FILE* file = fopen(imagePath, "wb");
+    bool isWritten = file && fwrite(image, 1, imageSize, file) == imageSize;
+    if (file)  fclose(file);
+    checks.Check(isWritten, "image is written");
+    defer(remove(imagePath));
+
+    Newstring path = Unicode::DecodeString(imagePath, static_cast<uint32_t>(strlen(imagePath)), Encoding::UTF8);
+    defer(path.Dispose());
+
+    // Both mappings share pages of the same file, neither of them is changed.
+    MappedFile firstFile;
+    MappedFile secondFile;
+    defer({
+        firstFile.Close();
+        secondFile.Close();
+    });
+    CommandImageView first;
+    CommandImageView second;
+    checks.Check(firstFile.Open(path) && secondFile.Open(path) && firstFile.size == imageSize, "image is mapped twice");
+    checks.Check(firstFile.data && first.Initialize(firstFile.data, firstFile.size) && secondFile.data && second.Initialize(secondFile.data, secondFile.size),
+        "mapped images are valid");
+    checks.Check(second.GetCommandCount() == static_cast<uint32_t>(commandCount), "image has every command");
+    checks.Check(second.FindCommandByName(Newstring::WrapConstWChar(L"CALC-6")) == (commandCount > 6 ? 6 : -1), "command is found in mapped image");
+    checks.Check(first.FindCommandByName(Newstring::WrapConstWChar(L"calc-7")) == -1, "command with different name is not found");
+
+    if (second.GetCommandCount() > 0)
+    {
+        const CommandImageRecord& record = second.records[0];
+        TempAllocatorScope scope;
+        checks.Check(second.strings.Decode(record.name) == Bench::FormatProbeCommandName(0, &g_tempAllocator) && record.pairCount == 3
+            && second.strings.Decode(second.GetPairs(record)[0].key) == L"path", "record strings are read from mapped image");
+    }
+
+    checks.Check(isCorruptImageRejected(image, imageSize, [](uint8_t* copy) { reinterpret_cast<CommandImageHeader*>(copy)->magic = 0; }),
+        "image with wrong magic is rejected");
+    checks.Check(isCorruptImageRejected(image, imageSize, [](uint8_t* copy) { reinterpret_cast<CommandImageHeader*>(copy)->pairsOffset = UINT32_MAX - 3; }),
+        "image with block out of bounds is rejected");
+    checks.Check(isCorruptImageRejected(image, imageSize, [](uint8_t* copy)
+    {
+        const CommandImageHeader* header = reinterpret_cast<const CommandImageHeader*>(copy);
+        reinterpret_cast<CommandImageRecord*>(copy + header->recordsOffset)->name.size = header->stringsSize;
+    }), "image with string out of bounds is rejected");
+    checks.Check(isCorruptImageRejected(image, imageSize, [](uint8_t* copy)
+    {
+        const CommandImageHeader* header = reinterpret_cast<const CommandImageHeader*>(copy);
+        reinterpret_cast<CommandImageRecord*>(copy + header->recordsOffset)->typeIndex = header->typeCount;
+    }), "image with unknown type index is rejected");
+    {
+        CommandImageView view;
+        checks.Check(!view.Initialize(image, imageSize - 1), "truncated image is rejected");
+    }
+
+    static CommandInfo info(Newstring::WrapConstWChar(L"run_app"), CI_None, pooledApp_createCommand);
+
+    Utf8StringPool stringPool;
+    defer(stringPool.Dispose());
+    CommandLoader loader;
+    defer(loader.commandInfoArray.Dispose());
+    loader.stringPool = &stringPool;
+    loader.commandInfoArray.Append(&info);
+
+    {
+        Array<Command*> parsed = loader.LoadFromString(source.string);
+        defer(deleteLoadedCommands(&parsed));
+        Array<Command*> loaded = loader.LoadFromImage(first);
+        defer(deleteLoadedCommands(&loaded));
+
+        uint32_t mismatchCount = parsed.count == loaded.count ? 0 : 1;
+        for (uint32_t i = 0; i < parsed.count && i < loaded.count; ++i)
+        {
+            const PooledAppCommand* a = static_cast<const PooledAppCommand*>(parsed.data[i]);
+            const PooledAppCommand* b = static_cast<const PooledAppCommand*>(loaded.data[i]);
+            if (a->name != b->name || a->info != b->info || !stringPool.Equals(a->appPath, stringPool, b->appPath)
+                || !stringPool.Equals(a->appArgs, stringPool, b->appArgs) || !stringPool.Equals(a->workDir, stringPool, b->workDir))
+            {
+                ++mismatchCount;
+            }
+        }
+        checks.Check(mismatchCount == 0, "commands loaded from image match commands parsed from source");
+    }
+
+    checks.Print();
+
+    Bench::LatencyHistogram parseLatency;
+    Bench::LatencyHistogram mapLatency;
+    Bench::LatencyHistogram loadLatency;
+    defer({
+        parseLatency.Dispose();
+        mapLatency.Dispose();
+        loadLatency.Dispose();
+    });
+    parseLatency.Reserve(iterations);
+    mapLatency.Reserve(iterations);
+    loadLatency.Reserve(iterations);
+
+    uint32_t foundCount = 0;
+    Newstring lastName = Bench::FormatProbeCommandName(commandCount - 1);
+    defer(lastName.Dispose());
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        Bench::Sample sample;
+
+        // Process without image parses commands file to find command.
+        sample.Begin(&parseLatency);
+        {
+            Array<Command*> parsed = loader.LoadFromString(source.string);
+            for (uint32_t i = 0; i < parsed.count; ++i)
+            {
+                if (parsed.data[i]->name == lastName)
+                {
+                    ++foundCount;
+                    break;
+                }
+            }
+            deleteLoadedCommands(&parsed);
+        }
+        sample.End();
+        stringPool.Clear();
+
+        // Process with image maps and validates it, then finds command in it.
+        sample.Begin(&mapLatency);
+        {
+            MappedFile mappedFile;
+            CommandImageView view;
+            if (mappedFile.Open(path) && view.Initialize(mappedFile.data, mappedFile.size))
+                foundCount += view.FindCommandByName(lastName) >= 0;
+            mappedFile.Close();
+        }
+        sample.End();
+
+        sample.Begin(&loadLatency);
+        {
+            Array<Command*> loaded = loader.LoadFromImage(first);
+            deleteLoadedCommands(&loaded);
+        }
+        sample.End();
+        stringPool.Clear();
+    }
+
+    checks.Check(foundCount == 2 * static_cast<uint32_t>(iterations), "last command is found by parsing and by mapping");
+
+    printf("commands: %d, iterations: %d\n", commandCount, iterations);
+    printf("source: %u UTF-16 code units, image: %u bytes\n", source.string.count, imageSize);
+    parseLatency.Print("parse source");
+    mapLatency.Print("map image");
+    loadLatency.Print("load from image");
+
+    return checks.GetExitCode();
+}
+
+/** Reads done by reader thread. Written only by the reader, read by main thread after reader is joined. */
+struct SnapshotReaderResult
+{
+    uint64_t readCount = 0;
+    uint64_t inconsistentCount = 0;
+    uint64_t maxReadNs = 0;
+};
+
+/**
+ * Reads command set in loop like autocompletion worker would, until 'isStopping' is set. Reader increments 'readyCount'
+ * after its first read. Reader doesn't allocate memory, because global allocators are not thread-safe, queries are
+ * folded and encoded by main thread.
+ */
+template<typename ReadSet>
+static void runSnapshotReader(ReadSet readSet, const Utf8StringPool* queryPool, const Array<Utf8StringRef>* queries,
+    Array<uint32_t>* rows, const std::atomic<bool>* isStopping, std::atomic<int>* readyCount, SnapshotReaderResult* result)
+{
+    for (uint32_t q = 0; !isStopping->load(std::memory_order_relaxed); q = (q + 1) % queries->count)
+    {
+        uint64_t start = Bench::GetTimeNs();
+        readSet([&](const CommandSet* set)
+        {
+            if (set == nullptr)
+                return;
+
+            // Set must not change while it's read: row count, commands and their set stay the same.
+            uint32_t rowCount = set->table.GetRowCount();
+            uint32_t count = set->FindCandidateRows(*queryPool, queries->data[q], rows->data);
+            int row = set->FindRowByName(*queryPool, queries->data[q]);
+
+            bool isConsistent = rowCount == set->GetCommandCount() && count <= rowCount && rowCount <= rows->capacity
+                && (row < 0 || set->commands.data[row]->set == set);
+            for (uint32_t i = 0; i < count && isConsistent; ++i)
+                isConsistent = set->commands.data[rows->data[i]]->set == set;
+
+            result->inconsistentCount += !isConsistent;
+        });
+        uint64_t elapsed = Bench::GetTimeNs() - start;
+
+        ++result->readCount;
+        if (elapsed > result->maxReadNs)
+            result->maxReadNs = elapsed;
+
+        if (result->readCount == 1)
+            readyCount->fetch_add(1);
+    }
+}
+
+/** Waits until every reader has read command set at least once, so reloads happen while readers are running. */
+static void waitForSnapshotReaders(const std::atomic<int>* readyCount, int readerCount)
+{
+    while (readyCount->load() < readerCount)
+        std::this_thread::yield();
+}
+
+/**
+ * Reloads command set while reader threads search it. Command sets published through command engine are compared
+ * with command set that readers lock with mutex while it's rebuilt in place.
+ * Usage: snapshot [commandCount] [readerCount] [reloadCount]
+ * Exit code is 1 if any check fails.
+ */
+static int runSnapshotBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    int commandCount = argc >= 1 ? atoi(argv[0]) : 20000;
+    if (commandCount < 1)  commandCount = 1;
+    int readerCount = argc >= 2 ? atoi(argv[1]) : 4;
+    if (readerCount < 1)  readerCount = 1;
+    if (readerCount > static_cast<int>(CommandSetPublisher::MaxReaderCount))  readerCount = CommandSetPublisher::MaxReaderCount;
+    int reloadCount = argc >= 3 ? atoi(argv[2]) : 50;
+    if (reloadCount < 1)  reloadCount = 1;
+
+    const wchar_t* queryTexts[] = { L"chrome-1", L"gfgrf", L"notepad-7", L"TERMINAL-99", L"zzz", L"c", L"calc-6" };
+    const uint32_t queryCount = sizeof(queryTexts) / sizeof(queryTexts[0]);
+
+    Utf8StringPool queryPool;
+    Array<Utf8StringRef> queries;
+    defer({
+        queryPool.Dispose();
+        queries.Dispose();
+    });
+    for (uint32_t i = 0; i < queryCount; ++i)
+    {
+        TempAllocatorScope scope;
+        Utf8StringRef ref;
+        queryPool.Add(Unicode::FoldCase(Newstring::WrapConstWChar(queryTexts[i]), &g_tempAllocator), &ref);
+        queries.Append(ref);
+    }
+
+    // Every reload adds one command, so rows of every reader have room for the largest set.
+    const uint32_t maxCommandCount = static_cast<uint32_t>(commandCount + reloadCount);
+    Array<Array<uint32_t>> readerRows;
+    defer({
+        for (uint32_t i = 0; i < readerRows.count; ++i)
+            readerRows.data[i].Dispose();
+        readerRows.Dispose();
+    });
+    for (int i = 0; i < readerCount; ++i)
+    {
+        Array<uint32_t> rows;
+        rows.Reserve(maxCommandCount);
+        readerRows.Append(rows);
+    }
+
+    CommandEngine engine;
+    defer(engine.Dispose());
+    engine.AddDefaultKeyboardLayoutMaps();
+
+    SnapshotReaderResult results[CommandSetPublisher::MaxReaderCount];
+    std::thread readers[CommandSetPublisher::MaxReaderCount];
+    std::atomic<bool> isStopping{ false };
+    std::atomic<int> readyCount{ 0 };
+
+    Bench::LatencyHistogram buildLatency;
+    Bench::LatencyHistogram publishLatency;
+    Bench::LatencyHistogram lockedLatency;
+    defer({
+        buildLatency.Dispose();
+        publishLatency.Dispose();
+        lockedLatency.Dispose();
+    });
+    buildLatency.Reserve(reloadCount);
+    publishLatency.Reserve(reloadCount);
+    lockedLatency.Reserve(reloadCount);
+
+    // Published command sets: readers never wait for reload.
+    uintptr_t allocatedBeforeFirstSet = g_standardAllocator.allocated;
+    CommandSet* firstSet = Bench::BuildProbeCommandSet(&engine, commandCount);
+    checks.Check(firstSet != nullptr, "command set is built");
+    if (firstSet == nullptr)
+        return 1;
+    engine.PublishCommandSet(firstSet);
+
+    for (int i = 0; i < readerCount; ++i)
+    {
+        int reader = engine.commandSets.RegisterReader();
+        if (reader < 0)
+        {
+            fprintf(stderr, "unable to register reader\n");
+            readerCount = i;
+            break;
+        }
+
+        auto readSet = [&engine, reader](auto read)
+        {
+            CommandSetReadScope scope(&engine.commandSets, reader);
+            read(scope.set);
+        };
+        readers[i] = std::thread([=, &engine, &queryPool, &queries, &readerRows, &isStopping, &readyCount, &results]
+        {
+            runSnapshotReader(readSet, &queryPool, &queries, &readerRows.data[i], &isStopping, &readyCount, &results[i]);
+            engine.commandSets.UnregisterReader(reader);
+        });
+    }
+
+    waitForSnapshotReaders(&readyCount, readerCount);
+
+    uint32_t failedBuildCount = 0;
+    uint32_t reclaimedCount = 0;
+    uintptr_t lastSetSize = 0;
+    uint64_t start = Bench::GetTimeNs();
+    for (int reload = 1; reload <= reloadCount; ++reload)
+    {
+        uintptr_t allocatedBeforeSet = g_standardAllocator.allocated;
+        Bench::Sample sample;
+        sample.Begin(&buildLatency);
+        CommandSet* set = Bench::BuildProbeCommandSet(&engine, commandCount + reload);
+        sample.End();
+        lastSetSize = g_standardAllocator.allocated - allocatedBeforeSet;
+        if (set == nullptr)
+        {
+            ++failedBuildCount;
+            continue;
+        }
+
+        sample.Begin(&publishLatency);
+        engine.PublishCommandSet(set);
+        sample.End();
+
+        reclaimedCount += engine.commandSets.Reclaim();
+    }
+    uint64_t publishedTime = Bench::GetTimeNs() - start;
+
+    isStopping.store(true);
+    for (int i = 0; i < readerCount; ++i)
+        readers[i].join();
+
+    reclaimedCount += engine.commandSets.Reclaim();
+
+    uint64_t publishedReadCount = 0;
+    uint64_t publishedMaxReadNs = 0;
+    uint64_t inconsistentCount = 0;
+    for (int i = 0; i < readerCount; ++i)
+    {
+        publishedReadCount += results[i].readCount;
+        inconsistentCount += results[i].inconsistentCount;
+        publishedMaxReadNs = std::max(publishedMaxReadNs, results[i].maxReadNs);
+        results[i] = SnapshotReaderResult();
+    }
+
+    checks.Check(failedBuildCount == 0, "every reload builds command set");
+    checks.Check(inconsistentCount == 0, "readers see only consistent command sets");
+    checks.Check(publishedReadCount > 0, "readers read during reloads");
+    checks.Check(reclaimedCount == static_cast<uint32_t>(reloadCount) && engine.commandSets.GetRetiredCount() == 0, "every replaced set is reclaimed");
+    checks.Check(engine.commandSet->GetCommandCount() == maxCommandCount, "the last published set is read by owner");
+    checks.Check(engine.FindCommandByName(Newstring::WrapConstWChar(L"CALC-6")) == engine.commandSet->commands.data[6], "command is found in published set");
+
+    // Only memory of the last published set is kept, slack covers bookkeeping of publisher and engine.
+    const uintptr_t slack = 16 * 1024;
+    uintptr_t allocatedAfterReloads = g_standardAllocator.allocated;
+    checks.Check(allocatedAfterReloads <= allocatedBeforeFirstSet + lastSetSize + slack, "memory of replaced sets is released");
+
+    // Set that is rebuilt in place under mutex: readers wait while reload runs.
+    std::mutex lockedSetMutex;
+    CommandSet* lockedSet = engine.commandSet;
+    isStopping.store(false);
+    readyCount.store(0);
+    for (int i = 0; i < readerCount; ++i)
+    {
+        auto readSet = [&lockedSetMutex, &lockedSet](auto read)
+        {
+            std::lock_guard<std::mutex> lock(lockedSetMutex);
+            read(lockedSet);
+        };
+        readers[i] = std::thread([=, &queryPool, &queries, &readerRows, &isStopping, &readyCount, &results]
+        {
+            runSnapshotReader(readSet, &queryPool, &queries, &readerRows.data[i], &isStopping, &readyCount, &results[i]);
+        });
+    }
+
+    waitForSnapshotReaders(&readyCount, readerCount);
+
+    start = Bench::GetTimeNs();
+    for (int reload = 1; reload <= reloadCount; ++reload)
+    {
+        Bench::Sample sample;
+        std::lock_guard<std::mutex> lock(lockedSetMutex);
+        sample.Begin(&lockedLatency);
+        lockedSet->Dispose();
+        failedBuildCount += !Bench::RegisterProbeCommands(&engine, lockedSet, commandCount + reload);
+        sample.End();
+    }
+    uint64_t lockedTime = Bench::GetTimeNs() - start;
+
+    isStopping.store(true);
+    for (int i = 0; i < readerCount; ++i)
+        readers[i].join();
+
+    uint64_t lockedReadCount = 0;
+    uint64_t lockedMaxReadNs = 0;
+    for (int i = 0; i < readerCount; ++i)
+    {
+        lockedReadCount += results[i].readCount;
+        inconsistentCount += results[i].inconsistentCount;
+        lockedMaxReadNs = std::max(lockedMaxReadNs, results[i].maxReadNs);
+    }
+    checks.Check(failedBuildCount == 0 && inconsistentCount == 0, "readers of locked set see consistent set");
+
+    checks.Print();
+    printf("commands: %d, readers: %d, reloads: %d\n", commandCount, readerCount, reloadCount);
+    printf("published: %8.1f K reads/s, longest read %10.3f us\n", publishedReadCount * 1e6 / publishedTime, publishedMaxReadNs / 1000.0);
+    printf("locked:    %8.1f K reads/s, longest read %10.3f us\n", lockedReadCount * 1e6 / lockedTime, lockedMaxReadNs / 1000.0);
+    buildLatency.Print("build set");
+    publishLatency.Print("publish set");
+    lockedLatency.Print("rebuild locked set");
+
+    return checks.GetExitCode();
+}
+
+/**
+ * Appends outcome of evaluation to builder: result, status and name of every command and error message, so outcomes of
+ * evaluations are compared as strings.
+ */
+static void appendEvaluationOutcome(NewstringBuilder* sb, bool isSucceeded, const ExecuteCommandState& state)
+{
+    sb->Append(isSucceeded ? L"ok|" : L"failed|");
+    for (uint32_t i = 0; i < state.results.count; ++i)
+    {
+        const CommandResult& result = state.results.data[i];
+        sb->Append(result.status == CommandResultStatus::Succeeded ? L'S' : result.status == CommandResultStatus::Failed ? L'F' : L'K');
+        sb->Append(result.commandName);
+        sb->Append(L' ');
+    }
+    sb->Append(L'|');
+    sb->Append(state.errorMessage);
+}
+
+/** Evaluations done by thread. Written only by the thread, read by main thread after thread is joined. */
+struct EvaluateThreadResult
+{
+    uint64_t evaluationCount = 0;
+    uint64_t failedCount = 0;
+    uint64_t mismatchCount = 0;
+    uint64_t time = 0;
+    bool isInitialized = true;
+};
+
+/**
+ * Evaluates expressions on several threads, every thread with its own evaluation context, while command sets are
+ * reloaded. Outcomes are compared with single-threaded evaluation, throughput is compared with evaluations that
+ * share execution state of engine and are serialized by mutex.
+ * Usage: evaluate [commandCount] [threadCount] [evaluationsPerThread]
+ * Exit code is 1 if any check fails.
+ */
+static int runEvaluateBenchmark(int argc, char** argv)
+{
+    Bench::Checks checks;
+
+    int commandCount = argc >= 1 ? atoi(argv[0]) : 2000;
+    if (commandCount < 20)  commandCount = 20;
+    int threadCount = argc >= 2 ? atoi(argv[1]) : 4;
+    if (threadCount < 1)  threadCount = 1;
+    if (threadCount > static_cast<int>(CommandSetPublisher::MaxReaderCount))  threadCount = CommandSetPublisher::MaxReaderCount;
+    int evaluationsPerThread = argc >= 3 ? atoi(argv[2]) : 20000;
+    if (evaluationsPerThread < 1)  evaluationsPerThread = 1;
+
+    // Commands of expressions are in every reloaded set, which has at least commandCount commands.
+    const wchar_t* expressionTexts[] = {
+        L"notepad-0",
+        L"chrome-1 fail",
+        L"terminal-2 ok; calc-6 fail",
+        L"steam-3 fail && explorer-5; chrome-8 \"fail\" x",
+        L"calc-13 \"a b\" && terminal-9 && steam-10 fail",
+        L"zzz-1 && notepad-0",
+        L"notepad-0 &&",
+        L"NOTEPAD-14 ; ; CHROME-15",
+    };
+    const uint32_t expressionCount = sizeof(expressionTexts) / sizeof(expressionTexts[0]);
+    const bool expectedResults[expressionCount] = { true, false, false, false, false, false, false, true };
+
+    CommandEngine engine;
+    defer(engine.Dispose());
+    engine.AddDefaultKeyboardLayoutMaps();
+
+    CommandSet* firstSet = Bench::BuildProbeCommandSet(&engine, commandCount);
+    checks.Check(firstSet != nullptr, "command set is built");
+    if (firstSet == nullptr)
+        return 1;
+    engine.PublishCommandSet(firstSet);
+
+    // Reference outcomes are evaluated by thread that owns engine, in standard memory so threads read them.
+    Array<Newstring> references;
+    defer({
+        for (uint32_t i = 0; i < references.count; ++i)
+            references.data[i].Dispose();
+        references.Dispose();
+    });
+    uint32_t expectedFailedCount = 0;
+    bool isReferenceExpected = true;
+    {
+        EvaluationContext context;
+        defer(context.Dispose());
+        checks.Check(context.Initialize(&engine, false), "owner context is initialized");
+
+        for (uint32_t i = 0; i < expressionCount; ++i)
+        {
+            bool isSucceeded = engine.Evaluate(Newstring::WrapConstWChar(expressionTexts[i]), &context);
+            isReferenceExpected = isReferenceExpected && isSucceeded == expectedResults[i];
+            expectedFailedCount += !isSucceeded;
+
+            NewstringBuilder sb;
+            appendEvaluationOutcome(&sb, isSucceeded, context.state);
+            references.Append(sb.string);
+        }
+    }
+    checks.Check(isReferenceExpected, "expressions evaluate to expected results");
+
+    // Results of context with reader slot don't reference command set, which is reclaimed after evaluation.
+    {
+        EvaluationContext context;
+        defer(context.Dispose());
+        checks.Check(context.Initialize(&engine, true), "reader context is initialized");
+
+        bool isSucceeded = engine.Evaluate(Newstring::WrapConstWChar(expressionTexts[2]), &context);
+        CommandSet* set = Bench::BuildProbeCommandSet(&engine, commandCount);
+        if (set != nullptr)
+            engine.PublishCommandSet(set);
+        uint32_t reclaimedCount = engine.commandSets.Reclaim();
+
+        NewstringBuilder sb;
+        appendEvaluationOutcome(&sb, isSucceeded, context.state);
+        checks.Check(set != nullptr && reclaimedCount == 1 && context.state.command == nullptr && sb.string == references.data[2],
+            "results of reader context stay valid after set is reclaimed");
+        sb.Dispose();
+    }
+
+    // Commands that run only on thread that owns engine fail in reader context without running.
+    {
+        static CommandInfo ownerThreadInfo(Newstring::WrapConstWChar(L"owner"), CI_OwnerThreadOnly, nullptr);
+
+        CommandEngine ownerEngine;
+        defer(ownerEngine.Dispose());
+        Bench::ProbeCommand* command = Memnew(Bench::ProbeCommand);
+        command->name = Newstring::NewFromWChar(L"window");
+        command->info = &ownerThreadInfo;
+        checks.Check(ownerEngine.RegisterCommand(command), "owner thread command is registered");
+
+        EvaluationContext ownerContext;
+        EvaluationContext readerContext;
+        defer({
+            ownerContext.Dispose();
+            readerContext.Dispose();
+        });
+        bool isInitialized = ownerContext.Initialize(&ownerEngine, false) && readerContext.Initialize(&ownerEngine, true);
+
+        bool isOwnerSucceeded = isInitialized && ownerEngine.Evaluate(Newstring::WrapConstWChar(L"window"), &ownerContext);
+        bool isReaderSucceeded = isInitialized && ownerEngine.Evaluate(Newstring::WrapConstWChar(L"window; window fail"), &readerContext);
+        const wchar_t* message = L"Command \"window\" can be run only by command window.";
+        const Array<CommandResult>& results = readerContext.state.results;
+        checks.Check(isOwnerSucceeded && !isReaderSucceeded && results.count == 2
+            && results.data[0].errorMessage == message && results.data[1].errorMessage == message,
+            "owner thread command fails in reader context without running");
+    }
+
+    EvaluateThreadResult results[CommandSetPublisher::MaxReaderCount];
+    std::thread threads[CommandSetPublisher::MaxReaderCount];
+    std::atomic<int> runningCount{ threadCount };
+
+    // Evaluation contexts: threads don't share memory, published sets are reloaded meanwhile.
+    uint64_t totalExpected = 0;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        for (int i = 0; i < evaluationsPerThread; ++i)
+            totalExpected += !expectedResults[(i + t) % expressionCount];
+
+        threads[t] = std::thread([=, &engine, &references, &runningCount, &results]
+        {
+            EvaluateThreadResult& result = results[t];
+            defer(runningCount.fetch_sub(1));
+
+            EvaluationContext context;
+            defer(context.Dispose());
+            if (!context.Initialize(&engine, true))
+            {
+                result.isInitialized = false;
+                return;
+            }
+
+            uint64_t start = Bench::GetTimeNs();
+            for (int i = 0; i < evaluationsPerThread; ++i)
+            {
+                uint32_t e = (i + t) % expressionCount;
+                bool isSucceeded = engine.Evaluate(Newstring::WrapConstWChar(expressionTexts[e]), &context);
+
+                NewstringBuilder sb;
+                sb.allocator = &context.arena;
+                appendEvaluationOutcome(&sb, isSucceeded, context.state);
+
+                result.failedCount += !isSucceeded;
+                result.mismatchCount += sb.string != references.data[e];
+                ++result.evaluationCount;
+            }
+            result.time = Bench::GetTimeNs() - start;
+        });
+    }
+
+    Bench::LatencyHistogram reloadLatency;
+    defer(reloadLatency.Dispose());
+
+    uint32_t reloadCount = 0;
+    uint32_t failedBuildCount = 0;
+    uint32_t reclaimedCount = 0;
+    uint64_t start = Bench::GetTimeNs();
+    while (runningCount.load() > 0)
+    {
+        ++reloadCount;
+        Bench::Sample sample;
+        sample.Begin(&reloadLatency);
+        CommandSet* set = Bench::BuildProbeCommandSet(&engine, commandCount + reloadCount % 8);
+        if (set != nullptr)
+            engine.PublishCommandSet(set);
+        else
+            ++failedBuildCount;
+        sample.End();
+
+        reclaimedCount += engine.commandSets.Reclaim();
+    }
+    uint64_t contextTime = Bench::GetTimeNs() - start;
+
+    for (int t = 0; t < threadCount; ++t)
+        threads[t].join();
+    reclaimedCount += engine.commandSets.Reclaim();
+
+    uint64_t evaluationCount = 0;
+    uint64_t evaluationFailedCount = 0;
+    uint64_t mismatchCount = 0;
+    uint64_t maxThreadTime = 0;
+    bool isInitialized = true;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        evaluationCount += results[t].evaluationCount;
+        evaluationFailedCount += results[t].failedCount;
+        mismatchCount += results[t].mismatchCount;
+        maxThreadTime = std::max(maxThreadTime, results[t].time);
+        isInitialized = isInitialized && results[t].isInitialized;
+        results[t] = EvaluateThreadResult();
+    }
+
+    checks.Check(isInitialized, "every thread context is initialized");
+    checks.Check(evaluationCount == static_cast<uint64_t>(threadCount) * evaluationsPerThread, "every evaluation is done");
+    checks.Check(mismatchCount == 0, "evaluations with contexts match single-threaded evaluation");
+    checks.Check(evaluationFailedCount == totalExpected, "only expected evaluations fail");
+    checks.Check(failedBuildCount == 0 && reloadCount > 0, "command sets are reloaded during evaluations");
+    checks.Check(reclaimedCount == reloadCount && engine.commandSets.GetRetiredCount() == 0, "every replaced set is reclaimed");
+
+    // Execution state of engine: evaluations are serialized, results are copied before mutex is released.
+    std::mutex engineMutex;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads[t] = std::thread([=, &engine, &engineMutex, &references, &results]
+        {
+            EvaluateThreadResult& result = results[t];
+            uint64_t start = Bench::GetTimeNs();
+            for (int i = 0; i < evaluationsPerThread; ++i)
+            {
+                uint32_t e = (i + t) % expressionCount;
+                std::lock_guard<std::mutex> lock(engineMutex);
+                TempAllocatorScope scope;
+                bool isSucceeded = engine.Evaluate(Newstring::WrapConstWChar(expressionTexts[e]));
+
+                NewstringBuilder sb;
+                sb.allocator = &g_tempAllocator;
+                appendEvaluationOutcome(&sb, isSucceeded, *engine.GetExecutionState());
+
+                result.failedCount += !isSucceeded;
+                result.mismatchCount += sb.string != references.data[e];
+                ++result.evaluationCount;
+            }
+            result.time = Bench::GetTimeNs() - start;
+        });
+    }
+
+    start = Bench::GetTimeNs();
+    for (int t = 0; t < threadCount; ++t)
+        threads[t].join();
+    uint64_t lockedTime = Bench::GetTimeNs() - start;
+
+    uint64_t lockedEvaluationCount = 0;
+    mismatchCount = 0;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        lockedEvaluationCount += results[t].evaluationCount;
+        mismatchCount += results[t].mismatchCount;
+    }
+    checks.Check(lockedEvaluationCount == evaluationCount && mismatchCount == 0, "serialized evaluations match single-threaded evaluation");
+
+    checks.Print();
+    printf("commands: %d, threads: %d, evaluations per thread: %d, reloads: %u\n", commandCount, threadCount, evaluationsPerThread, reloadCount);
+    printf("contexts:   %8.1f K evaluations/s, slowest thread %10.3f ms\n", evaluationCount * 1e6 / contextTime, maxThreadTime / 1e6);
+    printf("serialized: %8.1f K evaluations/s\n", lockedEvaluationCount * 1e6 / lockedTime);
+    reloadLatency.Print("reload set");
+
+    return checks.GetExitCode();
+}
+
+#ifdef CB_TRACE
+/**
+ * Replays generated trace with tracing enabled, measures zone recording overhead and writes Chrome trace JSON.
+ * Usage: trace <cmds.ini> <trace.json>
+ */
+static int runTraceBenchmark(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: trace <cmds.ini> <trace.json>\n");
+        return 1;
+    }
+
+    enum { ZoneCount = 1000000 };
+
+    uint64_t start = Bench::GetTimeNs();
+    for (uint32_t i = 0; i < ZoneCount; ++i)
+    {
+        TRACE_ZONE("empty");
+    }
+    uint64_t elapsed = Bench::GetTimeNs() - start;
+    printf("zone overhead: %.2f ns\n", static_cast<double>(elapsed) / ZoneCount);
+
+    Trace::Clear();
+
+    Newstring commandsSource = Bench::ReadTextFile(argv[0]);
+    defer(commandsSource.Dispose());
+
+    HeadlessDriver driver;
+    defer(driver.Dispose());
+
+    if (!driver.Initialize(commandsSource))
+    {
+        fprintf(stderr, "no commands were loaded from \"%s\"\n", argv[0]);
+        return 1;
+    }
+
+    Newstring trace = driver.GenerateTrace(10000);
+    defer(trace.Dispose());
+    driver.RunTrace(trace);
+
+    NewstringBuilder json;
+    defer(json.Dispose());
+    Trace::WriteChromeTrace(&json);
+
+    uint32_t jsonSize = 0;
+    void* jsonData = Unicode::EncodeString(json.string, &jsonSize, Encoding::UTF8);
+    defer(g_standardAllocator.Deallocate(jsonData));
+
+    FILE* file = fopen(argv[1], "wb");
+    if (!file || fwrite(jsonData, 1, jsonSize, file) != jsonSize)
+    {
+        fprintf(stderr, "cannot write \"%s\"\n", argv[1]);
+        if (file)  fclose(file);
+        return 1;
+    }
+    fclose(file);
+
+    printf("trace written to %s (%u bytes)\n", argv[1], jsonSize);
+    return 0;
+}
+#endif
+
+struct BenchSuite
+{
+    const char* name;
+    int (*run)(int argc, char** argv);
+};
+
+static const BenchSuite g_suites[] = {
+    { "engine", runEngineBenchmark },
+    { "textedit", runTextEditBenchmark },
+    { "launch", runLaunchBenchmark },
+    { "cmdline", runCommandLineBenchmark },
+    { "render", runRenderBenchmark },
+    { "animation", runAnimationBenchmark },
+    { "format", runFormatBenchmark },
+    { "parse", runParseBenchmark },
+    { "casefold", runCaseFoldBenchmark },
+    { "layout", runLayoutBenchmark },
+    { "memory", runMemoryBenchmark },
+    { "table", runTableBenchmark },
+    { "image", runImageBenchmark },
+    { "snapshot", runSnapshotBenchmark },
+    { "evaluate", runEvaluateBenchmark },
+#ifdef CB_TRACE
+    { "trace",  runTraceBenchmark },
+#endif
+};
+
+int main(int argc, char** argv)
+{
+    if (!g_tempAllocator.SetSize(4096))
+    {
+        fprintf(stderr, "unable to initialize temporary allocator\n");
+        return 1;
+    }
+    defer(g_tempAllocator.Dispose());
+
+    if (argc >= 2)
+    {
+        for (const BenchSuite& suite : g_suites)
+        {
+            if (strcmp(argv[1], suite.name) == 0)
+                return suite.run(argc - 2, argv + 2);
+        }
+    }
+
+    fprintf(stderr, "usage: %s <suite> [args...]\nsuites:", argv[0]);
+    for (const BenchSuite& suite : g_suites)
+        fprintf(stderr, " %s", suite.name);
+    fprintf(stderr, "\n");
+
+    return 1;
+}
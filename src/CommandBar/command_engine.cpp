@@ -1,17 +1,479 @@
 #include <assert.h>
-#include <stdarg.h>
 
 #include "command_engine.h"
+#include "newstring_builder.h"
+#include "process_launcher.h"
+#include "string_format.h"
+#include "trace.h"
+#include "unicode.h"
 
 
+/** Returns command of set with specified name, name is folded using specified temporary allocator. */
+static Command* findCommandByName(const CommandSet* set, const Newstring& name, TempAllocator* allocator)
+{
+	if (set == nullptr)
+		return nullptr;
+
+	TempAllocatorScope scope(allocator);
+	Newstring foldedName = Unicode::FoldCase(name, allocator);
+	if (foldedName.count == 0 && name.count > 0)
+		return nullptr;
+
+	Utf8StringPool encodedName;
+	encodedName.allocator = allocator;
+	Utf8StringRef encodedNameRef;
+	if (!encodedName.Add(foldedName, &encodedNameRef))
+		return nullptr;
+
+	int row = set->FindRowByName(encodedName, encodedNameRef);
+	return row >= 0 ? set->commands.data[row] : nullptr;
+}
+
+/**
+ * Evaluation that waits for application launches of its commands, see CommandEngine::CompleteLaunch(). Memory of
+ * evaluation is released before launches are completed, so expression, plan and results are copied to standard memory.
+ */
+struct PendingEvaluation
+{
+    /** Copy of expression, arguments of plan reference it. */
+    Newstring expression;
+    ExecutionPlan plan{ &g_standardAllocator };
+
+    /** Results of commands that ran so far, their names and error messages are allocated using standard allocator. */
+    Array<CommandResult> results;
+
+    /** Submitted launches by index of result, null pointer if command didn't launch or launch is completed. */
+    Array<LaunchRequest*> launches;
+
+    /** First command that didn't run, it runs when launch of previous command is completed. */
+    uint32_t nextCommand = 0;
+
+    /** Number of submitted launches that are not completed. */
+    uint32_t launchCount = 0;
+
+    /**
+     * Copies expression and plan, and reserves results for every command of plan, so appending them doesn't fail.
+     * Returns false if memory couldn't be allocated.
+     */
+    bool Initialize(const Newstring& expression, const ExecutionPlan& plan)
+    {
+        this->expression = expression.Clone();
+        bool isAllocated = this->expression.count == expression.count
+            && this->plan.commands.AppendRange(plan.commands.data, plan.commands.count)
+            && this->plan.args.Reserve(plan.args.count)
+            && results.Reserve(plan.commands.count)
+            && launches.Reserve(plan.commands.count);
+        if (!isAllocated)
+            return false;
+
+        // Arguments are moved to copy of expression.
+        for (uint32_t i = 0; i < plan.args.count; ++i)
+        {
+            const Newstring& arg = plan.args.data[i];
+            this->plan.args.Append(Newstring(this->expression.data + (arg.data - expression.data), arg.count));
+        }
+
+        return true;
+    }
+
+    /** Replaces result with specified index, its name and error message are copied. */
+    void SetResult(uint32_t index, const CommandResult& result)
+    {
+        CommandResult& stored = results.data[index];
+        stored.commandName.Dispose();
+        stored.errorMessage.Dispose();
+
+        stored.status = result.status;
+        stored.commandName = result.commandName.Clone();
+        stored.errorMessage = result.errorMessage.Clone();
+    }
+
+    /** Appends copy of result and its launch request. */
+    void AppendResult(const CommandResult& result, LaunchRequest* launch)
+    {
+        assert(results.count < plan.commands.count);
+
+        results.Append(CommandResult());
+        launches.Append(launch);
+        SetResult(results.count - 1, result);
+    }
+
+    /**
+     * Skips commands that didn't run. Called when command set is replaced, because commands belong to replaced set.
+     */
+    void SkipRemainingCommands()
+    {
+        for (; nextCommand < plan.commands.count; ++nextCommand)
+        {
+            CommandResult result;
+            result.commandName = plan.commands.data[nextCommand].command->name;
+            AppendResult(result, nullptr);
+        }
+    }
+
+    void Dispose()
+    {
+        for (uint32_t i = 0; i < results.count; ++i)
+        {
+            results.data[i].commandName.Dispose();
+            results.data[i].errorMessage.Dispose();
+        }
+
+        results.Dispose();
+        launches.Dispose();
+        plan.commands.Dispose();
+        plan.args.Dispose();
+        expression.Dispose();
+    }
+};
+
+/**
+ * Sets error message of state from failed results starting from specified one and result with index 'completedResult',
+ * if it's not null pointer. Message of expression with single command is used as is, otherwise messages are combined
+ * one per line. Returns false if there are such failed results.
+ */
+static bool setCombinedErrorMessage(ExecuteCommandState* state, uint32_t commandCount, uint32_t firstResult, const uint32_t* completedResult)
+{
+    state->errorMessage = Newstring::Empty();
+
+    NewstringBuilder sb;
+    sb.allocator = state->allocator;
+    uint32_t failedCount = 0;
+    for (uint32_t i = 0; i < state->results.count; ++i)
+    {
+        const CommandResult& result = state->results.data[i];
+        bool isReported = i >= firstResult || (completedResult != nullptr && i == *completedResult);
+        if (!isReported || result.status != CommandResultStatus::Failed)
+            continue;
+
+        Newstring message = Newstring::IsNullOrEmpty(result.errorMessage) ? Newstring::WrapConstWChar(L"Unknown error.") : result.errorMessage;
+        if (commandCount == 1)
+        {
+            state->errorMessage = message;
+            return false;
+        }
+
+        if (failedCount++ > 0)  sb.Append(L'\n');
+        sb.Append(result.commandName);
+        sb.Append(L": ");
+        sb.Append(message);
+    }
+
+    state->errorMessage = sb.string;
+    return failedCount == 0;
+}
+
 bool CommandEngine::Evaluate(const Newstring& expression)
 {
+    TRACE_ZONE("CommandEngine::Evaluate");
+
     ClearExecutionState();
+    return Evaluate(expression, commandSet, &executionState, true);
+}
+
+bool CommandEngine::Evaluate(const Newstring& expression, EvaluationContext* context)
+{
+    TRACE_ZONE("CommandEngine::Evaluate");
+    assert(context);
+    assert(context->engine == this);
+
+    // Memory of previous evaluation is released, arena is resized to fit evaluations.
+    context->arena.EndFrame();
+    context->state = ExecuteCommandState();
+    context->state.allocator = &context->arena;
+    context->state.results.allocator = &context->arena;
+
+    if (context->reader < 0)
+        return Evaluate(expression, commandSet, &context->state, true);
+
+    bool isSucceeded = false;
+    {
+        CommandSetReadScope scope(&commandSets, context->reader);
+        isSucceeded = Evaluate(expression, scope.set, &context->state, false);
+    }
+
+    // Set may be reclaimed now, results don't reference it.
+    context->state.command = nullptr;
+    return isSucceeded;
+}
+
+bool CommandEngine::Evaluate(const Newstring& expression, const CommandSet* set, ExecuteCommandState* evaluationState, bool isOwnerThread)
+{
+    assert(evaluationState);
+
+    ExecuteCommandState& state = *evaluationState;
+    ExecutionPlan plan(state.allocator);
+    if (!Parse(expression, set, &state, &plan))
+        return false;
+
+    if (beforeRunCallback != nullptr && isOwnerThread)
+    {
+        beforeRunCallback(this, beforeRunCallbackUserdata);
+    }
+
+    state.results.Reserve(plan.commands.count);
+    state.isLaunchDeferred = isOwnerThread && launcher != nullptr;
+
+    Array<LaunchRequest*> launches{ state.allocator };
+    launches.Reserve(plan.commands.count);
+    uint32_t nextCommand = Run(plan, 0, &state, &launches, isOwnerThread);
+
+    bool hasLaunches = false;
+    for (uint32_t i = 0; i < launches.count; ++i)
+        hasLaunches = hasLaunches || launches.data[i] != nullptr;
+
+    if (hasLaunches)
+    {
+        // Launches are submitted after evaluation is stored, so their completion finds it.
+        PendingEvaluation* evaluation = Memnew(PendingEvaluation);
+        if (evaluation != nullptr && evaluation->Initialize(expression, plan) && pendingEvaluations.Append(evaluation))
+        {
+            evaluation->nextCommand = nextCommand;
+            SubmitLaunches(evaluation, state, launches, 0);
+        }
+        else
+        {
+            if (evaluation != nullptr)
+            {
+                evaluation->Dispose();
+                Memdelete(evaluation);
+            }
+
+            for (uint32_t i = 0; i < launches.count; ++i)
+            {
+                if (launches.data[i] == nullptr)
+                    continue;
+
+                ProcessLauncher::DestroyRequest(launches.data[i]);
+                state.results.data[i].status = CommandResultStatus::Failed;
+                state.results.data[i].errorMessage = Newstring::WrapConstWChar(L"Unable to run application: out of memory.");
+            }
+        }
+    }
+
+    state.isLaunchDeferred = false;
+    return setCombinedErrorMessage(&state, plan.commands.count, 0, nullptr);
+}
+
+uint32_t CommandEngine::Run(const ExecutionPlan& plan, uint32_t firstCommand, ExecuteCommandState* evaluationState, Array<LaunchRequest*>* launches, bool isOwnerThread)
+{
+    assert(evaluationState);
+    assert(launches);
+
+    ExecuteCommandState& state = *evaluationState;
+    for (uint32_t i = firstCommand; i < plan.commands.count; ++i)
+    {
+        const PlannedCommand& planned = plan.commands.data[i];
+
+        CommandResult result;
+        result.commandName = planned.command->name.Clone(state.allocator);
+
+        bool isPreviousSucceeded = i == 0 || state.results.data[i - 1].status == CommandResultStatus::Succeeded;
+        if (planned.chain == CommandChain::IfPreviousSucceeded && !isPreviousSucceeded)
+        {
+            result.status = CommandResultStatus::Skipped;
+            state.results.Append(result);
+            launches->Append(nullptr);
+            continue;
+        }
+
+        {
+            // Temporary memory used by command is reused by the next one, only error message is kept.
+            TempAllocatorScope commandScope(state.allocator);
+
+            Array<Newstring> args{ state.allocator };
+            args.Reserve(planned.argCount);
+            for (uint32_t a = 0; a < planned.argCount; ++a)
+                args.Append(plan.args.data[planned.firstArg + a]);
+
+            state.errorMessage = Newstring::Empty();
+            state.launch = nullptr;
+
+            bool isSucceeded = false;
+            const CommandInfo* info = planned.command->info;
+            if (!isOwnerThread && info != nullptr && (info->flags & CI_OwnerThreadOnly))
+                state.SetErrorMessage(FORMAT_STRING(state.allocator, L"Command \"{}\" can be run only by command window.", planned.command->name));
+            else
+                isSucceeded = planned.command->Execute(&state, args);
+
+            if (isSucceeded)
+            {
+                result.status = state.launch != nullptr ? CommandResultStatus::Pending : CommandResultStatus::Succeeded;
+            }
+            else
+            {
+                assert(state.launch == nullptr);
+                result.status = CommandResultStatus::Failed;
+                result.errorMessage = commandScope.Keep(state.errorMessage);
+                state.errorMessage = result.errorMessage;
+            }
+        }
+
+        state.results.Append(result);
+        launches->Append(state.launch);
+        state.launch = nullptr;
+
+        // Command that depends on launch runs when launch is completed, see CompleteLaunch().
+        bool isLast = i + 1 == plan.commands.count;
+        if (result.status == CommandResultStatus::Pending && !isLast && plan.commands.data[i + 1].chain == CommandChain::IfPreviousSucceeded)
+            return i + 1;
+    }
+
+    return plan.commands.count;
+}
+
+void CommandEngine::SubmitLaunches(PendingEvaluation* evaluation, const ExecuteCommandState& state, const Array<LaunchRequest*>& launches, uint32_t firstResult)
+{
+    assert(evaluation);
+    assert(launcher);
+
+    for (uint32_t i = firstResult; i < state.results.count; ++i)
+        evaluation->AppendResult(state.results.data[i], launches.data[i]);
+
+    for (uint32_t i = firstResult; i < launches.count; ++i)
+    {
+        LaunchRequest* request = launches.data[i];
+        if (request == nullptr)
+            continue;
+
+        request->userdata = evaluation;
+        ++evaluation->launchCount;
+        launcher->Submit(request);
+    }
+}
+
+bool CommandEngine::CompleteLaunch(LaunchRequest* request, const Newstring& launchError)
+{
+    TRACE_ZONE("CommandEngine::CompleteLaunch");
+    assert(request);
+
+    // Evaluation is looked up before it's used, request may be submitted by someone else.
+    uint32_t evaluationIndex = 0;
+    while (evaluationIndex < pendingEvaluations.count && pendingEvaluations.data[evaluationIndex] != request->userdata)
+        ++evaluationIndex;
+
+    if (evaluationIndex == pendingEvaluations.count)
+        return true;
+
+    PendingEvaluation* evaluation = pendingEvaluations.data[evaluationIndex];
+    uint32_t launchIndex = 0;
+    while (launchIndex < evaluation->launches.count && evaluation->launches.data[launchIndex] != request)
+        ++launchIndex;
+
+    if (launchIndex == evaluation->launches.count)
+        return true;
+
+    evaluation->launches.data[launchIndex] = nullptr;
+    --evaluation->launchCount;
+
+    // Results are copied to execution state, evaluation may be deleted before they are read.
+    ClearExecutionState();
+    ExecuteCommandState& state = executionState;
+    const ExecutionPlan& plan = evaluation->plan;
+
+    Array<LaunchRequest*> launches{ state.allocator };
+    if (!state.results.Reserve(plan.commands.count) || !launches.Reserve(plan.commands.count))
+    {
+        state.errorMessage = Newstring::WrapConstWChar(L"Out of memory.");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < evaluation->results.count; ++i)
+    {
+        CommandResult result = evaluation->results.data[i];
+        result.commandName = result.commandName.Clone(state.allocator);
+        result.errorMessage = result.errorMessage.Clone(state.allocator);
+        state.results.Append(result);
+        launches.Append(nullptr);
+    }
+
+    CommandResult& launched = state.results.data[launchIndex];
+    if (request->succeeded)
+    {
+        launched.status = CommandResultStatus::Succeeded;
+    }
+    else
+    {
+        launched.status = CommandResultStatus::Failed;
+        launched.errorMessage = Newstring::IsNullOrEmpty(launchError) ? Newstring::WrapConstWChar(L"Unknown error.") : launchError;
+    }
+    evaluation->SetResult(launchIndex, launched);
+
+    uint32_t firstResult = state.results.count;
+    if (evaluation->nextCommand == launchIndex + 1 && evaluation->nextCommand < plan.commands.count)
+    {
+        state.isLaunchDeferred = true;
+        evaluation->nextCommand = Run(plan, evaluation->nextCommand, &state, &launches, true);
+        state.isLaunchDeferred = false;
+
+        SubmitLaunches(evaluation, state, launches, firstResult);
+    }
+
+    uint32_t commandCount = plan.commands.count;
+    if (evaluation->launchCount == 0 && evaluation->nextCommand == commandCount)
+    {
+        pendingEvaluations.Remove(evaluationIndex);
+        evaluation->Dispose();
+        Memdelete(evaluation);
+    }
+
+    // Only launch that is completed now and commands that ran after it are reported.
+    return setCombinedErrorMessage(&state, commandCount, firstResult, request->succeeded ? nullptr : &launchIndex);
+}
+
+bool CommandEngine::Parse(const Newstring& expression, ExecutionPlan* plan)
+{
+    return Parse(expression, commandSet, &executionState, plan);
+}
+
+bool CommandEngine::Parse(const Newstring& expression, const CommandSet* set, ExecuteCommandState* state, ExecutionPlan* plan)
+{
+    assert(state);
+    assert(plan);
 
-    Array<Newstring> args;
+    Array<Newstring>& args = plan->args;
     bool inQuotes = false;
     uint32_t argStart = 0;
     uint32_t argLength = 0;
+    uint32_t commandStart = 0;
+    CommandChain chain = CommandChain::Always;
+
+    // Called when command separator or end of expression is reached.
+    auto endCommand = [&](CommandChain nextChain) -> bool
+    {
+        if (commandStart == args.count)
+        {
+            // Empty commands are allowed around ';', but '&&' needs command on both sides.
+            if (chain == CommandChain::IfPreviousSucceeded || nextChain == CommandChain::IfPreviousSucceeded)
+            {
+                state->errorMessage = Newstring::WrapConstWChar(L"Invalid input.").Clone(state->allocator);
+                return false;
+            }
+
+            return true;
+        }
+
+        const Newstring& commandName = args.data[commandStart];
+        Command* command = findCommandByName(set, commandName, state->allocator);
+        state->command = command;
+
+        if (command == nullptr)
+        {
+            state->SetErrorMessage(FORMAT_STRING(state->allocator, L"Command \"{}\" is not found.", commandName));
+            return false;
+        }
+
+        PlannedCommand planned;
+        planned.command = command;
+        planned.chain = chain;
+        planned.firstArg = commandStart + 1;
+        planned.argCount = args.count - commandStart - 1;
+        plan->commands.Append(planned);
+
+        commandStart = args.count;
+        chain = nextChain;
+        return true;
+    };
 
     for (uint32_t i = 0; i < expression.count; ++i)
     {
@@ -40,17 +502,24 @@ bool CommandEngine::Evaluate(const Newstring& expression)
         {
             ++argLength;
         }
-        else if (c == L' ')
+        else if (c == L' ' || c == L';' || (c == L'&' && i + 1 < expression.count && expression.data[i + 1] == L'&'))
         {
             if (argLength > 0)
-            {
                 args.Append(Newstring(expression.data + argStart, argLength));
-                argStart = i + 1;
-                argLength = 0;
-            }
-            else
+
+            argStart = i + 1;
+            argLength = 0;
+
+            if (c == L';' && !endCommand(CommandChain::Always))
+                return false;
+
+            if (c == L'&')
             {
-                continue;
+                if (!endCommand(CommandChain::IfPreviousSucceeded))
+                    return false;
+
+                ++i;
+                argStart = i + 1;
             }
         }
         else
@@ -64,32 +533,16 @@ bool CommandEngine::Evaluate(const Newstring& expression)
         args.Append(Newstring(expression.data + argStart, argLength));
     }
 
-    if (args.count == 0)
-    {
-        executionState.errorMessage = Newstring::WrapConstWChar(L"Invalid input.").Clone(&g_tempAllocator);
+    if (!endCommand(CommandChain::Always))
         return false;
-    }
 
-    const Newstring& commandName = args.data[0];
-    Command* command = FindCommandByName(commandName);
-    executionState.command = command;
-
-    if (command == nullptr)
+    if (plan->commands.count == 0)
     {
-        executionState.FormatErrorMessage(L"Command \"%.*s\" is not found.", commandName.count, commandName.data);
+        state->errorMessage = Newstring::WrapConstWChar(L"Invalid input.").Clone(state->allocator);
         return false;
     }
 
-    if (beforeRunCallback != nullptr)
-    {
-        beforeRunCallback(this, beforeRunCallbackUserdata);
-    }
-
-    Array<Newstring> actualArgs;
-    for (uint32_t i = 1; i < args.count; ++i)
-        actualArgs.Append(args.data[i]);
-    
-    return command->Execute(&executionState, actualArgs);
+    return true;
 }
 
 ExecuteCommandState* CommandEngine::GetExecutionState()
@@ -105,40 +558,207 @@ void CommandEngine::SetBeforeRunCallback(CommandBeforeRunCallback callback, void
 
 Command* CommandEngine::FindCommandByName(const Newstring& name)
 {
-	for (uint32_t i = 0; i < commands.count; ++i)
-	{
-		Command* command = commands.data[i];
+	return findCommandByName(commandSet, name, &g_tempAllocator);
+}
 
-		if (name.Equals(command->name, StringComparison::CaseInsensitive))
-			return command;
-	}
+Command* CommandEngine::FindAutocompletionCandidate(const Newstring& text)
+{
+    uint32_t count = 0;
+    Command* const* candidates = FindAutocompletionCandidates(text, &count);
 
-	return nullptr;
+    return count > 0 ? candidates[0] : nullptr;
+}
+
+
+Command* const* CommandEngine::FindAutocompletionCandidates(const Newstring& text, uint32_t* count)
+{
+    assert(count);
+    *count = 0;
+
+    if (Newstring::IsNullOrEmpty(text) || commandSet == nullptr)
+        return nullptr;
+
+    int index = text.IndexOf(L' ');
+
+    Newstring command;
+    command.data  = text.data;
+    command.count = index == -1 ? text.count : index;
+
+    if (command.count == 0)
+        return nullptr;
+
+    // Query is folded once, then compared with names that were folded when commands were registered.
+    foldedQuery.count = 0;
+    if (!Unicode::AppendFoldedCase(&foldedQuery, command))
+    {
+        isAutocompletionCacheValid = false;
+        return nullptr;
+    }
+
+    bool isSameQuery = false;
+    bool isNarrowedQuery = false;
+    if (isAutocompletionCacheValid)
+    {
+        isSameQuery = Unicode::EqualsFolded(foldedQuery.string, autocompletionQuery.string);
+        isNarrowedQuery = !isSameQuery && Unicode::StartsWithFolded(foldedQuery.string, autocompletionQuery.string);
+    }
+
+    Utf8StringRef encodedQueryRef;
+    encodedQuery.Clear();
+    if (!isSameQuery && !encodedQuery.Add(foldedQuery.string, &encodedQueryRef))
+    {
+        isAutocompletionCacheValid = false;
+        return nullptr;
+    }
+
+    if (!isSameQuery)
+    {
+        const Array<Command*>& commands = commandSet->commands;
+        if (!autocompletionRows.Reserve(commands.count) || !autocompletionMatches.Reserve(commands.count))
+        {
+            isAutocompletionCacheValid = false;
+            return nullptr;
+        }
+
+        uint32_t* rows = autocompletionRows.data;
+        uint32_t matchCount = 0;
+
+        if (isNarrowedQuery)
+        {
+            // Commands that don't match query can't match longer query, so only previous matches are checked.
+            // Filtering keeps order, so narrowed matches stay ranked.
+            const CommandTable& table = commandSet->table;
+            uint32_t queryPrefix = CommandTable::GetPrefix(encodedQuery, encodedQueryRef);
+            uint32_t queryMask = CommandTable::GetPrefixMask(encodedQueryRef.size);
+            for (uint32_t i = 0; i < autocompletionRows.count; ++i)
+            {
+                if (table.Matches(rows[i], commandSet->stringPool, encodedQuery, encodedQueryRef, queryPrefix, queryMask))
+                    rows[matchCount++] = rows[i];
+            }
+        }
+        else
+        {
+            matchCount = commandSet->FindCandidateRows(encodedQuery, encodedQueryRef, rows);
+        }
+        autocompletionRows.count = matchCount;
+
+        for (uint32_t i = 0; i < matchCount; ++i)
+            autocompletionMatches.data[i] = commands.data[rows[i]];
+        autocompletionMatches.count = matchCount;
+
+        autocompletionQuery.count = 0;
+        autocompletionQuery.Append(foldedQuery.string);
+        isAutocompletionCacheValid = autocompletionQuery.count == foldedQuery.count;
+    }
+
+    *count = autocompletionMatches.count;
+    return autocompletionMatches.data;
 }
 
 bool CommandEngine::RegisterCommand(Command* command)
 {
     assert(command);
 
-    if (commands.Append(command))
+    if (commandSet == nullptr)
     {
-        command->engine = this;
-        return true;
+        CommandSet* set = Memnew(CommandSet);
+        if (set == nullptr)
+            return false;
+
+        PublishCommandSet(set);
     }
 
-    return false;
+    // Published set is changed in place, that's safe only while nobody else reads it.
+    assert(!commandSets.HasReaders());
+
+    isAutocompletionCacheValid = false;
+    return RegisterCommand(commandSet, command);
+}
+
+bool CommandEngine::RegisterCommand(CommandSet* set, Command* command)
+{
+    assert(set);
+    assert(command);
+
+    if (!set->AddCommand(command, keyboardLayoutMaps))
+        return false;
+
+    command->engine = this;
+    return true;
+}
+
+void CommandEngine::PublishCommandSet(CommandSet* set)
+{
+    // Commands of pending evaluations belong to replaced set, which may be reclaimed before launches are completed.
+    for (uint32_t i = 0; i < pendingEvaluations.count; ++i)
+        pendingEvaluations.data[i]->SkipRemainingCommands();
+
+    commandSets.Publish(set);
+    commandSet = set;
+    InvalidateAutocompletion();
+}
+
+void CommandEngine::ReclaimCommandSets()
+{
+    commandSets.Reclaim();
+}
+
+bool CommandEngine::AddKeyboardLayoutMap(const Newstring& sourceKeys, const Newstring& targetKeys)
+{
+    KeyboardLayoutMap map;
+    if (!map.Initialize(sourceKeys, targetKeys) || !keyboardLayoutMaps.Append(map))
+    {
+        map.Dispose();
+        return false;
+    }
+
+    isAutocompletionCacheValid = false;
+    if (commandSet == nullptr)
+        return true;
+
+    assert(!commandSets.HasReaders());
+    return commandSet->IndexLayoutNames(keyboardLayoutMaps);
+}
+
+bool CommandEngine::AddDefaultKeyboardLayoutMaps()
+{
+    const Newstring qwerty = Newstring::WrapConstWChar(KeyboardLayoutMap::QwertyKeys);
+    const Newstring jcuken = Newstring::WrapConstWChar(KeyboardLayoutMap::JcukenKeys);
+
+    return AddKeyboardLayoutMap(qwerty, jcuken) && AddKeyboardLayoutMap(jcuken, qwerty);
 }
 
 void CommandEngine::UnregisterAllCommands()
 {
-    for (uint32_t i = 0; i < commands.count; ++i)
-        Memdelete(commands.data[i]);
-    commands.Clear();    
+    PublishCommandSet(nullptr);
+    ReclaimCommandSets();
 }
 
 void CommandEngine::Dispose()
 {
     ClearExecutionState();
+
+    // Launches that are still in flight are destroyed by launcher, their completions are ignored.
+    for (uint32_t i = 0; i < pendingEvaluations.count; ++i)
+    {
+        pendingEvaluations.data[i]->Dispose();
+        Memdelete(pendingEvaluations.data[i]);
+    }
+    pendingEvaluations.Dispose();
+
+    commandSets.Dispose();
+    commandSet = nullptr;
+
+    isAutocompletionCacheValid = false;
+    autocompletionMatches.Dispose();
+    autocompletionQuery.Dispose();
+    foldedQuery.Dispose();
+    encodedQuery.Dispose();
+    autocompletionRows.Dispose();
+
+    for (uint32_t i = 0; i < keyboardLayoutMaps.count; ++i)
+        keyboardLayoutMaps.data[i].Dispose();
+    keyboardLayoutMaps.Dispose();
 }
 
 void CommandEngine::ClearExecutionState()
@@ -150,6 +770,43 @@ void CommandEngine::ClearExecutionState()
     e = ExecuteCommandState();
 }
 
+void CommandEngine::InvalidateAutocompletion()
+{
+    isAutocompletionCacheValid = false;
+    autocompletionMatches.Clear();
+    autocompletionRows.Clear();
+}
+
+bool EvaluationContext::Initialize(CommandEngine* engine, bool isReader, uintptr_t arenaSize)
+{
+    assert(engine);
+    assert(this->engine == nullptr);
+
+    if (!arena.SetSize(arenaSize))
+        return false;
+
+    reader = isReader ? engine->commandSets.RegisterReader() : -1;
+    if (isReader && reader < 0)
+    {
+        arena.Dispose();
+        return false;
+    }
+
+    this->engine = engine;
+    return true;
+}
+
+void EvaluationContext::Dispose()
+{
+    if (engine != nullptr && reader >= 0)
+        engine->commandSets.UnregisterReader(reader);
+
+    state = ExecuteCommandState();
+    arena.Dispose();
+    engine = nullptr;
+    reader = -1;
+}
+
 CommandInfo::CommandInfo()
 { }
 
@@ -159,22 +816,14 @@ CommandInfo::CommandInfo(Newstring dataName, CommandInfoFlags flags, CommandInfo
 	, createCommand(command)
 { }
 
-void BaseCommandState::FormatErrorMessage(const wchar_t* format, ...)
+void BaseCommandState::SetErrorMessage(const Newstring& message)
 {
-    assert(format);
-
-    va_list args;
-    va_start(args, format);
-    
-    errorMessage = Newstring::FormatWithAllocator(&g_tempAllocator, format, args, true);
-    
-    va_end(args);
+    errorMessage = message;
 
     if (Newstring::IsNullOrEmpty(errorMessage))
     {
         // @TODO: log error.
-        errorMessage = Newstring::WrapConstWChar(L"Unknown error.").Clone(&g_tempAllocator);
-        assert(!Newstring::IsNullOrEmpty(errorMessage));
+        errorMessage = Newstring::WrapConstWChar(L"Unknown error.");
     }
 }
 
@@ -1,6 +1,11 @@
 #pragma once
 #include "array.h"
 #include "newstring.h"
+#include "newstring_builder.h"
+#include "keyboard_layout.h"
+#include "utf8_string_pool.h"
+#include "command_table.h"
+#include "command_set.h"
 
 
 struct Command;
@@ -9,6 +14,9 @@ struct CommandEngine;
 struct BaseCommandState;
 struct CreateCommandState;
 struct ExecuteCommandState;
+struct ProcessLauncher;
+struct LaunchRequest;
+struct PendingEvaluation;
 
 typedef void(*CommandCallback)(Command& command, const Newstring* args, uint32_t numArgs);
 typedef void(*CommandBeforeRunCallback)(CommandEngine* engine, void* userdata);
@@ -19,6 +27,12 @@ enum CommandInfoFlags
     CI_None = 0,
     //CI_NoArgSplit = 1,
     //CI_IncludeCommandNameToArgs = 2,
+
+    /**
+     * Command uses window or COM objects of thread that owns command engine, so it fails when it's evaluated
+     * by other threads, see CommandEngine::Evaluate(expression, context).
+     */
+    CI_OwnerThreadOnly = 4,
 };
 
 /**
@@ -39,6 +53,10 @@ struct Command
 {
     CommandInfo* info = nullptr;
     CommandEngine* engine = nullptr;
+
+    /** Command set that command was added to, strings of command are stored in its string pool. */
+    CommandSet* set = nullptr;
+
     Newstring name;
 
     virtual ~Command();
@@ -49,25 +67,157 @@ struct Command
 struct BaseCommandState 
 {
     /**
-     * Use temporary allocator for error message, otherwise it wouldn't be deallocated!
-     * This message can be zero-terminated.
+     * Use temporary allocator for error message, otherwise it wouldn't be deallocated! Commands use allocator of
+     * ExecuteCommandState. This message can be zero-terminated.
      */
     Newstring errorMessage;
 
     /**
-     * Formats an error message using specified format string. Result is stored in errorMessage variable.
+     * Sets error message, which is usually formatted with FORMAT_STRING. Empty message, e.g. when formatting ran
+     * out of memory, is replaced with generic one.
      */
-    void FormatErrorMessage(const wchar_t* format, ...);
+    void SetErrorMessage(const Newstring& message);
 };
 
 struct CreateCommandState : public BaseCommandState
 {
+    /**
+     * String pool of command set that command is added to. Strings that command uses only when it's executed,
+     * like paths and arguments, are stored here instead of being allocated for every command.
+     */
+    Utf8StringPool* stringPool = nullptr;
+};
+
+/**
+ * Describes how command in expression is joined with previous command.
+ */
+enum class CommandChain
+{
+    /** Command is first in expression or follows ';', it runs regardless of previous command result. */
+    Always = 0,
+
+    /** Command follows '&&', it runs only if previous command succeeded. */
+    IfPreviousSucceeded
+};
+
+enum class CommandResultStatus
+{
+    Succeeded = 0,
+    Failed,
+
+    /**
+     * Command was not run because it follows '&&' and previous command did not succeed, or because command set was
+     * replaced while previous command waited for its launch.
+     */
+    Skipped,
+
+    /** Command started application launch which is not completed yet, see CommandEngine::CompleteLaunch(). */
+    Pending
+};
+
+/**
+ * Result of single command of evaluated expression.
+ */
+struct CommandResult
+{
+    /**
+     * Name of command, allocated using allocator of ExecuteCommandState. It's a copy, so results stay valid after
+     * command set that command belongs to is reclaimed.
+     */
+    Newstring commandName;
+
+    CommandResultStatus status = CommandResultStatus::Skipped;
+
+    /** Error message of failed command. Allocated using allocator of ExecuteCommandState. */
+    Newstring errorMessage;
 };
 
 struct ExecuteCommandState : public BaseCommandState
 {
-    /** Command that was parsed from expression string. */
+    /**
+     * Temporary allocator of evaluation. Plan, results, error messages and memory that command needs only while it's
+     * executed are allocated from it, so evaluations with different allocators run concurrently.
+     */
+    TempAllocator* allocator = &g_tempAllocator;
+
+    /**
+     * Last command that was parsed from expression string. Null pointer after evaluation with context that has reader
+     * slot, because command set may be reclaimed as soon as evaluation ends.
+     */
+    Command* command = nullptr;
+
+    /**
+     * Set by engine when command may leave application launch to engine instead of launching application before
+     * returning from Execute(): command stores request to 'launch' and returns true. Engine submits it to launcher,
+     * and command result arrives when launch is completed, see CommandEngine::CompleteLaunch().
+     */
+    bool isLaunchDeferred = false;
+
+    /** Launch request left to engine by command that was executed last, see 'isLaunchDeferred'. */
+    LaunchRequest* launch = nullptr;
+
+    /**
+     * Results of every command in expression, in order of appearance. Allocated using allocator of state.
+     */
+    Array<CommandResult> results{ &g_tempAllocator };
+};
+
+/**
+ * Single command of parsed expression.
+ */
+struct PlannedCommand
+{
     Command* command = nullptr;
+    CommandChain chain = CommandChain::Always;
+
+    /** Range of command arguments in ExecutionPlan::args, not including command name. */
+    uint32_t firstArg = 0;
+    uint32_t argCount = 0;
+};
+
+/**
+ * Expression parsed to sequence of commands. Arguments reference expression string.
+ * Allocated using temporary allocator.
+ */
+struct ExecutionPlan
+{
+    Array<PlannedCommand> commands;
+    Array<Newstring> args;
+
+    explicit ExecutionPlan(IAllocator* allocator = &g_tempAllocator)
+        : commands(allocator)
+        , args(allocator)
+    { }
+};
+
+/**
+ * Caller-owned state of evaluation, see CommandEngine::Evaluate(expression, context). Evaluations with different
+ * contexts don't share memory: plan, results and error messages are allocated from arena of context, so every
+ * thread that evaluates expressions has its own context.
+ */
+struct EvaluationContext
+{
+    CommandEngine* engine = nullptr;
+
+    /** Arena of evaluation. Memory of previous evaluation is released when next one starts. */
+    TempAllocator arena;
+
+    /**
+     * Reader slot in command set publisher of engine, commands are read through it. -1 if context is used by thread
+     * that owns command engine.
+     */
+    int reader = -1;
+
+    /** Results and error message of last evaluation, valid until next evaluation with this context. */
+    ExecuteCommandState state;
+
+    /**
+     * Allocates arena of specified size and, if context is used by thread that doesn't own engine, reserves reader
+     * slot. Returns false if memory couldn't be allocated or every reader slot is taken.
+     */
+    bool Initialize(CommandEngine* engine, bool isReader, uintptr_t arenaSize = 4096);
+
+    void Dispose();
 };
 
 struct CommandEngine
@@ -80,14 +230,78 @@ struct CommandEngine
     CommandWindow* window = nullptr;
     CommandBeforeRunCallback beforeRunCallback = nullptr;
     void* beforeRunCallbackUserdata = nullptr;
-    Array<Command*> commands;
+
+    /**
+     * Published command set, null pointer if no commands were registered. Thread that owns command engine reads it
+     * directly, other threads read it through 'commandSets'. Names are matched case-insensitively by folded names in
+     * its command table.
+     */
+    CommandSet* commandSet = nullptr;
+
+    /**
+     * Publishes command sets to reader threads, see CommandSetPublisher. Replaced sets are deleted when no reader
+     * uses them, so reload doesn't wait for readers and readers don't wait for reload.
+     */
+    CommandSetPublisher commandSets;
+
+    /**
+     * Launcher used by commands to start applications without blocking. If null, applications are launched synchronously.
+     */
+    ProcessLauncher* launcher = nullptr;
+
+    /** Keyboard layouts maps that command names are mapped through for autocompletion, see AddKeyboardLayoutMap(). */
+    Array<KeyboardLayoutMap> keyboardLayoutMaps;
+
+    /**
+     * Adds keyboard layout map, see KeyboardLayoutMap::Initialize(). Autocompletion also matches command names
+     * mapped through it, e.g. after adding map from KeyboardLayoutMap::QwertyKeys to KeyboardLayoutMap::JcukenKeys
+     * command "open" is found by text typed in Russian layout. Names are mapped when commands are registered,
+     * so queries are matched as fast as without maps. Commands of published set are mapped again, their previous
+     * names stay in string pool of set. Must not be called while other threads read commands.
+     * Returns false if map is invalid or memory couldn't be allocated.
+     */
+    bool AddKeyboardLayoutMap(const Newstring& sourceKeys, const Newstring& targetKeys);
+
+    /** Adds maps from QWERTY to JCUKEN layout and back. */
+    bool AddDefaultKeyboardLayoutMaps();
 
     /**
      * Evaluates expression, calling command with args parsed from specified expression.
-     * If evaluation failed, or command execution ended with an error, returns false. To get additional information, get execution state by calling GetExecutionState().
+     * Expression may contain several commands separated by ';' (next command runs regardless of result of previous one)
+     * or '&&' (next command runs only if previous one succeeded). If engine has launcher, commands don't wait for
+     * application launches: results of such commands are Pending, and command that follows '&&' runs when launch of
+     * previous command is completed, see CompleteLaunch(). Commands that don't depend on each other launch concurrently.
+     * If evaluation failed, or execution of any command ended with an error, returns false. To get additional information, get execution state by calling GetExecutionState().
      */
     bool Evaluate(const Newstring& expression);
 
+    /**
+     * Evaluates expression like Evaluate(expression), but writes results to caller-owned context, so evaluation doesn't
+     * change state of engine and several evaluations run concurrently on different threads. Commands of context with
+     * reader slot are read from published command set, which stays valid during evaluation even if it's replaced;
+     * results keep copies of command names, so they don't reference the set afterwards. Before run callback is called
+     * and commands with CI_OwnerThreadOnly flag are run only for context without reader slot, because they run on
+     * thread that owns engine.
+     */
+    bool Evaluate(const Newstring& expression, EvaluationContext* context);
+
+    /**
+     * Handles launch that was submitted to launcher by evaluation on thread that owns engine, called by that thread
+     * for every request returned by ProcessLauncher::DrainCompleted(). Error message of failed launch is passed by
+     * caller, which knows how to describe OS error code of request. Result of command that started launch is updated
+     * and, if it's followed by '&&', evaluation continues from the next command. Requests that don't belong to
+     * evaluations of engine are ignored.
+     * Execution state then contains results of evaluation so far. Returns false if launch or any command that ran
+     * after it failed, error message of execution state describes only these failures.
+     */
+    bool CompleteLaunch(LaunchRequest* request, const Newstring& launchError);
+
+    /**
+     * Parses expression to execution plan. Returns false and sets error message of execution state if expression
+     * is invalid or contains unknown command.
+     */
+    bool Parse(const Newstring& expression, ExecutionPlan* plan);
+
     /**
      * Returns execution state for last expression evaluation using Evaluate() method.
      */
@@ -101,13 +315,54 @@ struct CommandEngine
 	Command* FindCommandByName(const Newstring& name);
 
     /**
-     * Registers command within command engine so it can be evaluated.
+     * Returns best ranked command which name starts with command name part of specified text (text before first space).
+     * If there is no such command, returns null pointer.
+     */
+    Command* FindAutocompletionCandidate(const Newstring& text);
+
+    /**
+     * Returns all commands which names start with command name part of specified text, ranked from best to worst:
+     * shorter names first, commands with names of the same length in registration order. Number of commands is
+     * written to 'count'. Returned array is owned by command engine and stays valid until this method is called
+     * with another command name, commands are registered or unregistered or command set is published.
+     *
+     * Commands matching last query are cached: if command name part is the same, cached result is returned, and if
+     * it extends last query (user typed more characters), only cached matches are checked. Otherwise all commands are checked.
+     */
+    Command* const* FindAutocompletionCandidates(const Newstring& text, uint32_t* count);
+
+    /**
+     * Registers command within command engine so it can be evaluated. Command is added to published command set in
+     * place, so it must not be called while other threads read commands; use RegisterCommand(set, command) and
+     * PublishCommandSet() then.
      * If command cannot be registered, returns false, otherwise true.
      *
      * Specified command should be allocated using standard allocator. It will be deallocated by command engine.
      */
     bool RegisterCommand(Command* command);
 
+    /**
+     * Registers command within command set that is not published yet, command names are mapped through keyboard
+     * layout maps of this engine. Returns false if command cannot be registered.
+     */
+    bool RegisterCommand(CommandSet* set, Command* command);
+
+    /**
+     * Replaces published command set with specified one, which is owned by engine from now and must not be changed.
+     * Replaced set is retired: its commands stay valid until ReclaimCommandSets() is called.
+     */
+    void PublishCommandSet(CommandSet* set);
+
+    /**
+     * Deletes retired command sets that are not read by other threads. Thread that owns command engine calls it when
+     * it doesn't keep pointers to commands of replaced sets anymore.
+     */
+    void ReclaimCommandSets();
+
+    /**
+     * Retires published command set and deletes it unless other threads read it, so commands that were created for
+     * its string pool but not registered yet must be created again.
+     */
     void UnregisterAllCommands();
 
     /**
@@ -115,6 +370,50 @@ struct CommandEngine
      */
     void Dispose();
 private:
+    /** Case folded command name part of text passed to last FindAutocompletionCandidates() call. */
+    NewstringBuilder autocompletionQuery;
+
+    /** Case folded command name part of current query, buffer is reused between calls. */
+    NewstringBuilder foldedQuery;
+
+    /** Folded query encoded to UTF-8, it's compared with folded names in string pool. */
+    Utf8StringPool encodedQuery;
+
+    /** Commands which names start with autocompletionQuery, ranked. */
+    Array<Command*> autocompletionMatches;
+
+    /** Rows of autocompletionMatches in command table. */
+    Array<uint32_t> autocompletionRows;
+
+    bool isAutocompletionCacheValid = false;
+
+    /** Evaluations that wait for launches of their commands, see CompleteLaunch(). */
+    Array<PendingEvaluation*> pendingEvaluations;
+
     void ClearExecutionState();
+
+    /**
+     * Evaluates expression with commands of specified set, results are written to specified state. If evaluation
+     * doesn't run on thread that owns engine, commands with CI_OwnerThreadOnly flag fail without running.
+     */
+    bool Evaluate(const Newstring& expression, const CommandSet* set, ExecuteCommandState* state, bool isOwnerThread);
+
+    /**
+     * Runs commands of plan starting from specified one and appends their results to state. Launch requests left to
+     * engine are appended to 'launches', null pointer for every other command. Stops after command which launch is
+     * left to engine if next command follows '&&'. Returns index of first command that didn't run.
+     */
+    uint32_t Run(const ExecutionPlan& plan, uint32_t firstCommand, ExecuteCommandState* state, Array<LaunchRequest*>* launches, bool isOwnerThread);
+
+    /**
+     * Copies results of state starting from specified one to evaluation and submits their launch requests to launcher.
+     */
+    void SubmitLaunches(PendingEvaluation* evaluation, const ExecuteCommandState& state, const Array<LaunchRequest*>& launches, uint32_t firstResult);
+
+    /** Parses expression with commands of specified set, error message is written to specified state. */
+    bool Parse(const Newstring& expression, const CommandSet* set, ExecuteCommandState* state, ExecutionPlan* plan);
+
+    /** Drops autocompletion matches, which are rows of replaced command set. */
+    void InvalidateAutocompletion();
 };
 
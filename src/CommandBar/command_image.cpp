@@ -0,0 +1,290 @@
+#include <assert.h>
+#include <string.h>
+
+#include "command_image.h"
+#include "command_table.h"
+#include "array.h"
+#include "parse_ini.h"
+#include "unicode.h"
+#include "defer.h"
+
+
+/** Command image that is being built, blocks are copied to image when commands file is parsed. */
+struct CommandImageBuilder
+{
+    Utf8StringPool strings;
+    Array<CommandImageRecord> records;
+    Array<uint32_t> nameHashes;
+    Array<CommandImageType> types;
+
+    /** Names of types, they reference commands file source. */
+    Array<Newstring> typeNames;
+
+    /** Key-value pairs of every type. */
+    Array<Array<CommandImagePair>> typePairs;
+
+    void Dispose()
+    {
+        strings.Dispose();
+        records.Dispose();
+        nameHashes.Dispose();
+        types.Dispose();
+        typeNames.Dispose();
+        for (uint32_t i = 0; i < typePairs.count; ++i)
+            typePairs.data[i].Dispose();
+        typePairs.Dispose();
+    }
+
+    /** Returns index of type with specified name, type is added if there is no such type. Returns -1 if memory couldn't be allocated. */
+    int GetTypeIndex(const Newstring& name)
+    {
+        for (uint32_t i = 0; i < typeNames.count; ++i)
+        {
+            if (typeNames.data[i] == name)
+                return static_cast<int>(i);
+        }
+
+        CommandImageType type = {};
+        if (!strings.Add(name, &type.name) || !typeNames.Reserve(typeNames.count + 1)
+            || !types.Reserve(types.count + 1) || !typePairs.Reserve(typePairs.count + 1))
+        {
+            return -1;
+        }
+
+        typeNames.Append(name);
+        types.Append(type);
+        typePairs.Append(Array<CommandImagePair>());
+        return static_cast<int>(types.count - 1);
+    }
+
+    bool SetName(CommandImageRecord* record, const Newstring& name)
+    {
+        TempAllocatorScope scope;
+        Newstring foldedName = Unicode::FoldCase(name, &g_tempAllocator);
+        if (foldedName.count == 0)
+            return false;
+
+        record->nameLength = name.count;
+        return strings.Add(name, &record->name) && strings.Add(foldedName, &record->foldedName)
+            && nameHashes.Append(CommandTable::Hash(strings.GetData(record->foldedName), record->foldedName.size));
+    }
+};
+
+void* BuildCommandImage(const Newstring& source, uint32_t* size, IAllocator* allocator)
+{
+    assert(size);
+    assert(allocator);
+
+    CommandImageBuilder builder;
+    defer(builder.Dispose());
+
+    INIParser p;
+    p.Initialize(source);
+
+    bool hasRecord = false;
+    CommandImageRecord record = {};
+
+    while (p.Next())
+    {
+        switch (p.type)
+        {
+            case INIValueType::Group:
+            {
+                if (hasRecord && (record.name.size == 0 || !builder.records.Append(record)))
+                    return nullptr;
+
+                int typeIndex = builder.GetTypeIndex(p.group);
+                if (typeIndex < 0)
+                    return nullptr;
+
+                hasRecord = true;
+                record = {};
+                record.typeIndex = static_cast<uint32_t>(typeIndex);
+                record.firstPair = builder.typePairs.data[typeIndex].count;
+                break;
+            }
+            case INIValueType::KeyValuePair:
+            {
+                if (!hasRecord)
+                    return nullptr;
+
+                if (p.key == L"name")
+                {
+                    if (record.name.size > 0 || !builder.SetName(&record, p.value))
+                        return nullptr;
+                }
+                else
+                {
+                    CommandImagePair pair;
+                    if (!builder.strings.Add(p.key, &pair.key) || !builder.strings.Add(p.value, &pair.value)
+                        || !builder.typePairs.data[record.typeIndex].Append(pair))
+                    {
+                        return nullptr;
+                    }
+
+                    ++record.pairCount;
+                }
+                break;
+            }
+            case INIValueType::None:
+                break;
+            case INIValueType::Error:
+                return nullptr;
+        }
+    }
+
+    if (hasRecord && (record.name.size == 0 || !builder.records.Append(record)))
+        return nullptr;
+
+    uint32_t pairCount = 0;
+    for (uint32_t i = 0; i < builder.types.count; ++i)
+    {
+        builder.types.data[i].firstPair = pairCount;
+        builder.types.data[i].pairCount = builder.typePairs.data[i].count;
+        pairCount += builder.typePairs.data[i].count;
+    }
+
+    // Every block size is multiple of 4 bytes except strings, which go last.
+    uint64_t offset = sizeof(CommandImageHeader);
+    CommandImageHeader header = {};
+    header.magic = CommandImageHeader::Magic;
+    header.version = CommandImageHeader::Version;
+    header.commandCount = builder.records.count;
+    header.recordsOffset = static_cast<uint32_t>(offset);
+    offset += sizeof(CommandImageRecord) * static_cast<uint64_t>(builder.records.count);
+    header.nameHashesOffset = static_cast<uint32_t>(offset);
+    offset += sizeof(uint32_t) * static_cast<uint64_t>(builder.nameHashes.count);
+    header.typeCount = builder.types.count;
+    header.typesOffset = static_cast<uint32_t>(offset);
+    offset += sizeof(CommandImageType) * static_cast<uint64_t>(builder.types.count);
+    header.pairCount = pairCount;
+    header.pairsOffset = static_cast<uint32_t>(offset);
+    offset += sizeof(CommandImagePair) * static_cast<uint64_t>(pairCount);
+    header.stringsSize = builder.strings.size;
+    header.stringsOffset = static_cast<uint32_t>(offset);
+    offset += builder.strings.size;
+
+    if (offset > UINT32_MAX)
+        return nullptr;
+    header.size = static_cast<uint32_t>(offset);
+
+    uint8_t* image = static_cast<uint8_t*>(allocator->Allocate(header.size));
+    if (image == nullptr)
+        return nullptr;
+
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + header.recordsOffset, builder.records.data, sizeof(CommandImageRecord) * builder.records.count);
+    memcpy(image + header.nameHashesOffset, builder.nameHashes.data, sizeof(uint32_t) * builder.nameHashes.count);
+    memcpy(image + header.typesOffset, builder.types.data, sizeof(CommandImageType) * builder.types.count);
+
+    uint8_t* pairs = image + header.pairsOffset;
+    for (uint32_t i = 0; i < builder.typePairs.count; ++i)
+    {
+        const Array<CommandImagePair>& typePairs = builder.typePairs.data[i];
+        memcpy(pairs, typePairs.data, sizeof(CommandImagePair) * typePairs.count);
+        pairs += sizeof(CommandImagePair) * typePairs.count;
+    }
+
+    memcpy(image + header.stringsOffset, builder.strings.data, builder.strings.size);
+
+    *size = header.size;
+    return image;
+}
+
+/** Returns true if block of 'count' elements of 'elementSize' bytes at 'offset' is aligned and fits into image. */
+static bool isBlockValid(uint32_t offset, uint32_t count, uint32_t elementSize, uint32_t imageSize)
+{
+    return offset % 4 == 0 && offset + static_cast<uint64_t>(count) * elementSize <= imageSize;
+}
+
+/** Returns true if string is inside strings block and is zero-terminated. */
+static bool isStringValid(const Utf8StringPool& strings, Utf8StringRef ref)
+{
+    return static_cast<uint64_t>(ref.offset) + ref.size < strings.size && strings.data[ref.offset + ref.size] == '\0';
+}
+
+bool CommandImageView::Initialize(const void* data, uint32_t size)
+{
+    assert(data);
+    *this = CommandImageView();
+
+    const CommandImageHeader* h = static_cast<const CommandImageHeader*>(data);
+    if (size < sizeof(CommandImageHeader) || h->magic != CommandImageHeader::Magic
+        || h->version != CommandImageHeader::Version || h->size != size)
+    {
+        return false;
+    }
+
+    if (!isBlockValid(h->recordsOffset, h->commandCount, sizeof(CommandImageRecord), size)
+        || !isBlockValid(h->nameHashesOffset, h->commandCount, sizeof(uint32_t), size)
+        || !isBlockValid(h->typesOffset, h->typeCount, sizeof(CommandImageType), size)
+        || !isBlockValid(h->pairsOffset, h->pairCount, sizeof(CommandImagePair), size)
+        || static_cast<uint64_t>(h->stringsOffset) + h->stringsSize > size)
+    {
+        return false;
+    }
+
+    const uint8_t* image = static_cast<const uint8_t*>(data);
+    Utf8StringPool imageStrings;
+    imageStrings.data = const_cast<char*>(reinterpret_cast<const char*>(image + h->stringsOffset));
+    imageStrings.size = imageStrings.capacity = h->stringsSize;
+    imageStrings.allocator = nullptr;
+
+    const CommandImageType* imageTypes = reinterpret_cast<const CommandImageType*>(image + h->typesOffset);
+    for (uint32_t i = 0; i < h->typeCount; ++i)
+    {
+        const CommandImageType& type = imageTypes[i];
+        if (!isStringValid(imageStrings, type.name) || static_cast<uint64_t>(type.firstPair) + type.pairCount > h->pairCount)
+            return false;
+    }
+
+    const CommandImagePair* imagePairs = reinterpret_cast<const CommandImagePair*>(image + h->pairsOffset);
+    for (uint32_t i = 0; i < h->pairCount; ++i)
+    {
+        if (!isStringValid(imageStrings, imagePairs[i].key) || !isStringValid(imageStrings, imagePairs[i].value))
+            return false;
+    }
+
+    const CommandImageRecord* imageRecords = reinterpret_cast<const CommandImageRecord*>(image + h->recordsOffset);
+    for (uint32_t i = 0; i < h->commandCount; ++i)
+    {
+        const CommandImageRecord& record = imageRecords[i];
+        if (!isStringValid(imageStrings, record.name) || !isStringValid(imageStrings, record.foldedName)
+            || record.typeIndex >= h->typeCount
+            || static_cast<uint64_t>(record.firstPair) + record.pairCount > imageTypes[record.typeIndex].pairCount)
+        {
+            return false;
+        }
+    }
+
+    header = h;
+    records = imageRecords;
+    nameHashes = reinterpret_cast<const uint32_t*>(image + h->nameHashesOffset);
+    types = imageTypes;
+    pairs = imagePairs;
+    strings = imageStrings;
+    return true;
+}
+
+int CommandImageView::FindCommandByName(const Newstring& name) const
+{
+    TempAllocatorScope scope;
+    Newstring foldedName = Unicode::FoldCase(name, &g_tempAllocator);
+    if (foldedName.count == 0)
+        return -1;
+
+    Utf8StringPool encodedName;
+    encodedName.allocator = &g_tempAllocator;
+    Utf8StringRef encodedNameRef;
+    if (!encodedName.Add(foldedName, &encodedNameRef))
+        return -1;
+
+    uint32_t hash = CommandTable::Hash(encodedName.GetData(encodedNameRef), encodedNameRef.size);
+    for (uint32_t i = 0; i < GetCommandCount(); ++i)
+    {
+        if (nameHashes[i] == hash && strings.Equals(records[i].foldedName, encodedName, encodedNameRef))
+            return static_cast<int>(i);
+    }
+
+    return -1;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+
+#include "newstring.h"
+#include "utf8_string_pool.h"
+
+
+/**
+ * Header of command image: commands file compiled to single memory block without pointers. Blocks of image are
+ * referenced by 32-bit offsets from the start of image and strings by offsets from the start of strings block, so
+ * image can be written to disk and mapped to memory of several processes (e.g. command window and command line
+ * client), which use it as is, without fixups. Image is read-only and is validated once by CommandImageView.
+ *
+ * Image consists of header, command records, name hashes, types, key-value pairs of commands grouped by type
+ * and UTF-8 strings, in this order. Numbers are little-endian, blocks are aligned to 4 bytes.
+ */
+struct CommandImageHeader
+{
+    static const uint32_t Magic = 0x4D494243; // "CBIM"
+    static const uint32_t Version = 1;
+
+    uint32_t magic;
+    uint32_t version;
+
+    /** Size of whole image in bytes. */
+    uint32_t size;
+
+    /** CommandImageRecord and name hash of every command. */
+    uint32_t commandCount;
+    uint32_t recordsOffset;
+    uint32_t nameHashesOffset;
+
+    uint32_t typeCount;
+    uint32_t typesOffset;
+
+    uint32_t pairCount;
+    uint32_t pairsOffset;
+
+    uint32_t stringsSize;
+    uint32_t stringsOffset;
+};
+
+/** Command type, e.g. "run_app", with block of key-value pairs of all commands of this type. */
+struct CommandImageType
+{
+    Utf8StringRef name;
+    uint32_t firstPair;
+    uint32_t pairCount;
+};
+
+struct CommandImageRecord
+{
+    Utf8StringRef name;
+
+    /** Case folded name, hashed by CommandTable::Hash() to name hashes block. */
+    Utf8StringRef foldedName;
+
+    /** Length of name in UTF-16 code units. */
+    uint32_t nameLength;
+
+    uint32_t typeIndex;
+
+    /** Range of key-value pairs in pairs block of command type. */
+    uint32_t firstPair;
+    uint32_t pairCount;
+};
+
+/** Key-value pair that command was declared with, except the name. */
+struct CommandImagePair
+{
+    Utf8StringRef key;
+    Utf8StringRef value;
+};
+
+/**
+ * Builds command image from commands file source text, image is allocated using specified allocator and its size
+ * is written to 'size'. Returns null pointer if source is invalid or memory couldn't be allocated.
+ */
+void* BuildCommandImage(const Newstring& source, uint32_t* size, IAllocator* allocator = &g_standardAllocator);
+
+/**
+ * Reads command image that is stored in memory, e.g. mapped file. Image memory is not changed and must stay valid
+ * while view is used.
+ */
+struct CommandImageView
+{
+    const CommandImageHeader* header = nullptr;
+    const CommandImageRecord* records = nullptr;
+    const uint32_t* nameHashes = nullptr;
+    const CommandImageType* types = nullptr;
+    const CommandImagePair* pairs = nullptr;
+
+    /** Strings block of image. Pool references image memory, so it must not be changed or disposed. */
+    Utf8StringPool strings;
+
+    /**
+     * Checks that every offset and string of image is in bounds, so image read from untrusted file can be used.
+     * Returns false if image is invalid or was built by another version.
+     */
+    bool Initialize(const void* data, uint32_t size);
+
+    uint32_t GetCommandCount() const { return header ? header->commandCount : 0; }
+
+    /** Returns key-value pairs of command, their number is CommandImageRecord::pairCount. */
+    const CommandImagePair* GetPairs(const CommandImageRecord& record) const
+    {
+        return pairs + types[record.typeIndex].firstPair + record.firstPair;
+    }
+
+    /** Returns index of command with specified name, names are compared case-insensitively. Returns -1 if there is no such command. */
+    int FindCommandByName(const Newstring& name) const;
+};
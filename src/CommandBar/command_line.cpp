@@ -0,0 +1,377 @@
+#include <assert.h>
+#include <string.h>
+
+#include "command_line.h"
+#include "unicode.h"
+#include "tinyutf.h"
+
+
+namespace CommandLine
+{
+
+static bool isArgumentSeparator(wchar_t c)
+{
+    return c == L' ' || c == L'\t';
+}
+
+static bool needsQuotes(const Newstring& arg)
+{
+    if (arg.count == 0)
+        return true;
+
+    for (uint32_t i = 0; i < arg.count; ++i)
+    {
+        wchar_t c = arg.data[i];
+        if (c == L' ' || c == L'\t' || c == L'\n' || c == L'\v' || c == L'"')
+            return true;
+    }
+
+    return false;
+}
+
+uint32_t GetQuotedArgumentLength(const Newstring& arg)
+{
+    if (!needsQuotes(arg))
+        return arg.count;
+
+    uint32_t length = 2; // Quotes.
+    uint32_t backslashCount = 0;
+
+    for (uint32_t i = 0; i < arg.count; ++i)
+    {
+        wchar_t c = arg.data[i];
+        if (c == L'\\')
+        {
+            ++backslashCount;
+            continue;
+        }
+
+        // Backslashes before quote are doubled, and quote itself is escaped.
+        length += c == L'"' ? backslashCount * 2 + 2 : backslashCount + 1;
+        backslashCount = 0;
+    }
+
+    // Backslashes before closing quote are doubled.
+    return length + backslashCount * 2;
+}
+
+static wchar_t* writeBackslashes(wchar_t* dest, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        *dest++ = L'\\';
+    return dest;
+}
+
+wchar_t* WriteQuotedArgument(wchar_t* dest, const Newstring& arg)
+{
+    assert(dest);
+
+    if (!needsQuotes(arg))
+    {
+        if (arg.count > 0)
+            memcpy(dest, arg.data, arg.count * sizeof(wchar_t));
+        return dest + arg.count;
+    }
+
+    *dest++ = L'"';
+    uint32_t backslashCount = 0;
+
+    for (uint32_t i = 0; i < arg.count; ++i)
+    {
+        wchar_t c = arg.data[i];
+        if (c == L'\\')
+        {
+            ++backslashCount;
+            continue;
+        }
+
+        if (c == L'"')
+        {
+            dest = writeBackslashes(dest, backslashCount * 2 + 1);
+        }
+        else
+        {
+            dest = writeBackslashes(dest, backslashCount);
+        }
+
+        *dest++ = c;
+        backslashCount = 0;
+    }
+
+    dest = writeBackslashes(dest, backslashCount * 2);
+    *dest++ = L'"';
+
+    return dest;
+}
+
+Newstring BuildWindowsCommandLine(const Newstring& quotedPrefix, const Newstring* args, uint32_t argCount, IAllocator* allocator)
+{
+    assert(allocator);
+    assert(args || argCount == 0);
+
+    uint32_t length = quotedPrefix.count;
+    for (uint32_t i = 0; i < argCount; ++i)
+    {
+        if (length > 0)  ++length; // Separator.
+        length += GetQuotedArgumentLength(args[i]);
+    }
+
+    if (length == 0)
+        return Newstring::Empty();
+
+    wchar_t* data = static_cast<wchar_t*>(allocator->Allocate(sizeof(wchar_t) * (length + 1)));
+    if (data == nullptr)
+        return Newstring::Empty();
+
+    wchar_t* dest = data;
+    if (quotedPrefix.count > 0)
+    {
+        memcpy(dest, quotedPrefix.data, quotedPrefix.count * sizeof(wchar_t));
+        dest += quotedPrefix.count;
+    }
+
+    for (uint32_t i = 0; i < argCount; ++i)
+    {
+        if (dest != data)  *dest++ = L' ';
+        dest = WriteQuotedArgument(dest, args[i]);
+    }
+
+    assert(dest == data + length);
+    *dest = L'\0';
+
+    return Newstring(data, length);
+}
+
+uint32_t GetProcessCommandLineLength(const Newstring& program, const Newstring& parameters)
+{
+    uint32_t length = program.count + 2; // Quotes.
+    if (parameters.count > 0)
+        length += 1 + parameters.count;
+
+    return length;
+}
+
+wchar_t* WriteProcessCommandLine(wchar_t* dest, const Newstring& program, const Newstring& parameters)
+{
+    assert(dest);
+
+    // Runtime reads quoted program name up to the next quote, so backslashes are not escaped.
+    *dest++ = L'"';
+    if (program.count > 0)
+        memcpy(dest, program.data, program.count * sizeof(wchar_t));
+    dest += program.count;
+    *dest++ = L'"';
+
+    if (parameters.count > 0)
+    {
+        *dest++ = L' ';
+        memcpy(dest, parameters.data, parameters.count * sizeof(wchar_t));
+        dest += parameters.count;
+    }
+
+    *dest = L'\0';
+    return dest;
+}
+
+/** Collects unquoted argument as UTF-16 code units. If 'dest' is null pointer, only counts them. */
+struct WideEmitter
+{
+    wchar_t* dest;
+    uint32_t count;
+
+    void operator()(wchar_t c)
+    {
+        if (dest)  dest[count] = c;
+        ++count;
+    }
+
+    void Finish() { }
+};
+
+/** Collects unquoted argument as UTF-8. If 'dest' is null pointer, only counts bytes. */
+struct Utf8Emitter
+{
+    char* dest;
+    uintptr_t count;
+    uint32_t highSurrogate;
+
+    void operator()(wchar_t c)
+    {
+        uint32_t codepoint = static_cast<uint32_t>(c);
+        if (Unicode::IsHighSurrogate(codepoint))
+        {
+            Finish();
+            highSurrogate = codepoint;
+            return;
+        }
+
+        if (Unicode::IsLowSurrogate(codepoint) && highSurrogate != 0)
+            codepoint = 0x10000 + ((highSurrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+        else if (Unicode::IsLowSurrogate(codepoint))
+            codepoint = 0xFFFD;
+
+        highSurrogate = 0;
+        Write(codepoint);
+    }
+
+    void Write(uint32_t codepoint)
+    {
+        char scratch[4];
+        char* end = tuEncode8(dest ? dest + count : scratch, static_cast<int>(codepoint));
+        count += end - (dest ? dest + count : scratch);
+    }
+
+    void Finish()
+    {
+        // Unpaired high surrogate.
+        if (highSurrogate != 0)
+            Write(0xFFFD);
+        highSurrogate = 0;
+    }
+};
+
+template<typename Emitter>
+static bool readArgument(const wchar_t** cursor, const wchar_t* end, Emitter& emit)
+{
+    const wchar_t* c = *cursor;
+    while (c < end && isArgumentSeparator(*c))
+        ++c;
+
+    if (c == end || *c == L'\0')
+    {
+        *cursor = c;
+        return false;
+    }
+
+    bool inQuotes = false;
+    while (c < end && *c != L'\0' && (inQuotes || !isArgumentSeparator(*c)))
+    {
+        if (*c == L'\\')
+        {
+            uint32_t backslashCount = 0;
+            while (c < end && *c == L'\\')
+            {
+                ++backslashCount;
+                ++c;
+            }
+
+            bool isBeforeQuote = c < end && *c == L'"';
+            uint32_t literalCount = isBeforeQuote ? backslashCount / 2 : backslashCount;
+            for (uint32_t i = 0; i < literalCount; ++i)
+                emit(L'\\');
+
+            if (isBeforeQuote && backslashCount % 2 == 1)
+            {
+                emit(L'"');
+                ++c;
+            }
+        }
+        else if (*c == L'"')
+        {
+            // Two quotes inside quoted group produce literal quote, group continues.
+            if (inQuotes && c + 1 < end && c[1] == L'"')
+            {
+                emit(L'"');
+                ++c;
+            }
+            else
+            {
+                inQuotes = !inQuotes;
+            }
+            ++c;
+        }
+        else
+        {
+            emit(*c);
+            ++c;
+        }
+    }
+
+    emit.Finish();
+    *cursor = c;
+    return true;
+}
+
+bool ReadArgument(const wchar_t** cursor, const wchar_t* end, wchar_t* dest, uint32_t* count)
+{
+    assert(cursor && *cursor);
+    assert(count);
+
+    WideEmitter emit = { dest, 0 };
+    if (!readArgument(cursor, end, emit))
+        return false;
+
+    *count = emit.count;
+    return true;
+}
+
+static uintptr_t getUtf8Length(const Newstring& string)
+{
+    Utf8Emitter emit = { nullptr, 0, 0 };
+    for (uint32_t i = 0; i < string.count; ++i)
+        emit(string.data[i]);
+    emit.Finish();
+
+    return emit.count;
+}
+
+uintptr_t GetPosixArgvSize(const Newstring& program, const Newstring& commandLine)
+{
+    uintptr_t argCount = 1;
+    uintptr_t stringsSize = getUtf8Length(program) + 1;
+
+    if (commandLine.data != nullptr)
+    {
+        const wchar_t* cursor = commandLine.data;
+        const wchar_t* end = commandLine.data + commandLine.count;
+
+        Utf8Emitter emit = { nullptr, 0, 0 };
+        while (readArgument(&cursor, end, emit))
+        {
+            stringsSize += emit.count + 1;
+            emit.count = 0;
+            ++argCount;
+        }
+    }
+
+    return sizeof(char*) * (argCount + 1) + stringsSize;
+}
+
+char** WritePosixArgv(void* buffer, const Newstring& program, const Newstring& commandLine)
+{
+    assert(buffer);
+
+    const wchar_t* end = commandLine.data + commandLine.count;
+
+    // Count arguments first, so strings can be placed right after pointer array.
+    uint32_t argCount = 1;
+    if (commandLine.data != nullptr)
+    {
+        const wchar_t* cursor = commandLine.data;
+        WideEmitter counter = { nullptr, 0 };
+        while (readArgument(&cursor, end, counter))
+            ++argCount;
+    }
+
+    char** argv = static_cast<char**>(buffer);
+    Utf8Emitter emit = { reinterpret_cast<char*>(argv + argCount + 1), 0, 0 };
+
+    argv[0] = emit.dest;
+    for (uint32_t i = 0; i < program.count; ++i)
+        emit(program.data[i]);
+    emit.Finish();
+    emit.dest[emit.count++] = '\0';
+
+    const wchar_t* cursor = commandLine.data;
+    for (uint32_t i = 1; i < argCount; ++i)
+    {
+        argv[i] = emit.dest + emit.count;
+        readArgument(&cursor, end, emit);
+        emit.dest[emit.count++] = '\0';
+    }
+
+    argv[argCount] = nullptr;
+    return argv;
+}
+
+} // namespace CommandLine
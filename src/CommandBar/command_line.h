@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+
+#include "newstring.h"
+
+
+/**
+ * Builds and splits command lines.
+ *
+ * Windows passes command line to process as single string, which is split to argv by C runtime of the process.
+ * Rules of Microsoft C runtime since 2008 are used: arguments are separated by spaces or tabs, double quotes group
+ * spaces, 2n backslashes followed by quote produce n backslashes and start/end a group, 2n+1 backslashes followed by
+ * quote produce n backslashes and literal quote, other backslashes are literal. Two quotes inside group produce
+ * literal quote and group continues (CommandLineToArgvW and older runtimes end the group there). Quoted arguments
+ * are written without such quotes, so they are split the same way by every runtime.
+ *
+ * The first token of command line is program name, which runtime reads differently: up to the next quote if it
+ * starts with quote, otherwise up to whitespace, backslashes are always literal.
+ *
+ * Build functions measure exact result size first and then write it, so they do single allocation.
+ */
+namespace CommandLine
+{
+
+/**
+ * Returns number of characters that argument takes after quoting.
+ */
+uint32_t GetQuotedArgumentLength(const Newstring& arg);
+
+/**
+ * Writes quoted argument to destination, which must have space for GetQuotedArgumentLength(arg) characters.
+ * Arguments that don't contain whitespace or quotes are written as is. Returns pointer past last written character.
+ */
+wchar_t* WriteQuotedArgument(wchar_t* dest, const Newstring& arg);
+
+/**
+ * Builds null-terminated command line from already quoted prefix (copied as is) and arguments which are quoted.
+ * If resulting command line is empty, returns empty string without allocating.
+ */
+Newstring BuildWindowsCommandLine(const Newstring& quotedPrefix, const Newstring* args, uint32_t argCount, IAllocator* allocator = &g_tempAllocator);
+
+/**
+ * Returns number of characters of command line that process is created with: quoted program followed by parameters,
+ * which are already quoted. Program is quoted as is, file paths can't contain quotes.
+ */
+uint32_t GetProcessCommandLineLength(const Newstring& program, const Newstring& parameters);
+
+/**
+ * Writes null-terminated command line of process to destination, which must have space for
+ * GetProcessCommandLineLength() + 1 characters. Returns pointer to terminating zero. Does not allocate.
+ */
+wchar_t* WriteProcessCommandLine(wchar_t* dest, const Newstring& program, const Newstring& parameters);
+
+/**
+ * Reads next argument from command line and unquotes it.
+ * If 'dest' is null pointer, only length of argument is computed. Otherwise 'dest' must have space for it.
+ * Returns false if there are no more arguments. Does not allocate.
+ */
+bool ReadArgument(const wchar_t** cursor, const wchar_t* end, wchar_t* dest, uint32_t* count);
+
+/**
+ * Returns size in bytes of buffer required by WritePosixArgv() for specified program and command line.
+ */
+uintptr_t GetPosixArgvSize(const Newstring& program, const Newstring& commandLine);
+
+/**
+ * Splits command line and writes null-terminated argv array of UTF-8 strings (program is argv[0]) to buffer
+ * of GetPosixArgvSize() bytes. Buffer must be aligned as a pointer. Returns argv. Does not allocate.
+ */
+char** WritePosixArgv(void* buffer, const Newstring& program, const Newstring& commandLine);
+
+} // namespace CommandLine
@@ -2,9 +2,11 @@
 
 #include "command_loader.h"
 #include "parse_ini.h"
-#include "os_utils.h"
 #include "defer.h"
 
+#ifdef _WIN32
+#include "os_utils.h"
+
 Array<Command*> CommandLoader::LoadFromFile(const Newstring& filePath)
 {
     Newstring source = OSUtils::ReadAllText(filePath, Encoding::UTF8);
@@ -12,6 +14,7 @@ Array<Command*> CommandLoader::LoadFromFile(const Newstring& filePath)
 
     if (Newstring::IsNullOrEmpty(source))
     {
+        TempAllocatorScope scope;
         Newstring osError = OSUtils::FormatErrorCode(GetLastError(), 0, &g_tempAllocator);
         
         wchar_t* msg = Newstring::FormatTempCString(
@@ -22,6 +25,33 @@ Array<Command*> CommandLoader::LoadFromFile(const Newstring& filePath)
         MessageBoxW(0, msg, L"Error", MB_ICONERROR);
     }
 
+    return LoadFromString(source);
+}
+#endif
+
+/**
+ * Creates command declared in commands file, temporary memory used by command's createCommand callback is released
+ * afterwards.
+ */
+static Command* createCommand(CommandInfo* info, Utf8StringPool* stringPool, const Newstring& name, Array<Newstring>& keys, Array<Newstring>& values)
+{
+    TempAllocatorScope scope;
+    CreateCommandState state;
+    state.stringPool = stringPool;
+
+    Command* cmd = info->createCommand(&state, keys, values);
+    assert(cmd);
+    assert(!Newstring::IsNullOrEmpty(name));
+    cmd->name = name.Clone();
+    cmd->info = info;
+
+    return cmd;
+}
+
+Array<Command*> CommandLoader::LoadFromString(const Newstring& source)
+{
+    assert(stringPool);
+
     INIParser p;
     Array<Command*> cmds;
     Array<Newstring> keys;
@@ -29,8 +59,6 @@ Array<Command*> CommandLoader::LoadFromFile(const Newstring& filePath)
     CommandInfo* currCmdInfo = nullptr;
     Newstring currCmdName;
 
-    CreateCommandState state;
-
     p.Initialize(source);
 
     while (p.Next())
@@ -40,12 +68,7 @@ Array<Command*> CommandLoader::LoadFromFile(const Newstring& filePath)
             case INIValueType::Group:
                 if (currCmdInfo != nullptr)
                 {
-                    Command* cmd = currCmdInfo->createCommand(&state, keys, values);
-                    assert(!Newstring::IsNullOrEmpty(currCmdName));
-                    cmd->name = currCmdName.Clone();
-                    cmd->info = currCmdInfo;
-                    assert(cmd);
-                    cmds.Append(cmd);
+                    cmds.Append(createCommand(currCmdInfo, stringPool, currCmdName, keys, values));
                     currCmdName = Newstring::Empty();
                 }
 
@@ -77,18 +100,56 @@ Array<Command*> CommandLoader::LoadFromFile(const Newstring& filePath)
 
     if (currCmdInfo != nullptr)
     {
-        Command* cmd = currCmdInfo->createCommand(&state, keys, values);
-        assert(!Newstring::IsNullOrEmpty(currCmdName));
-        cmd->name = currCmdName.Clone();
-        cmd->info = currCmdInfo;
-        assert(cmd);
-        cmds.Append(cmd);
+        cmds.Append(createCommand(currCmdInfo, stringPool, currCmdName, keys, values));
         currCmdName = Newstring::Empty();
     }
 
     return cmds;
 }
 
+Array<Command*> CommandLoader::LoadFromImage(const CommandImageView& image)
+{
+    assert(stringPool);
+
+    Array<Command*> cmds;
+    Array<CommandInfo*> typeInfos;
+    defer(typeInfos.Dispose());
+
+    uint32_t typeCount = image.header ? image.header->typeCount : 0;
+    if (!typeInfos.Reserve(typeCount) || !cmds.Reserve(image.GetCommandCount()))
+        return cmds;
+
+    for (uint32_t i = 0; i < typeCount; ++i)
+    {
+        TempAllocatorScope scope;
+        typeInfos.Append(FindCommandInfoByName(image.strings.Decode(image.types[i].name)));
+    }
+
+    for (uint32_t i = 0; i < image.GetCommandCount(); ++i)
+    {
+        const CommandImageRecord& record = image.records[i];
+        CommandInfo* info = typeInfos.data[record.typeIndex];
+        if (info == nullptr)
+            continue;
+
+        // Strings are decoded to temporary memory, command copies strings it needs.
+        TempAllocatorScope scope;
+        Array<Newstring> keys{ record.pairCount, &g_tempAllocator };
+        Array<Newstring> values{ record.pairCount, &g_tempAllocator };
+
+        const CommandImagePair* pairs = image.GetPairs(record);
+        for (uint32_t p = 0; p < record.pairCount; ++p)
+        {
+            keys.Append(image.strings.Decode(pairs[p].key));
+            values.Append(image.strings.Decode(pairs[p].value));
+        }
+
+        cmds.Append(createCommand(info, stringPool, image.strings.Decode(record.name), keys, values));
+    }
+
+    return cmds;
+}
+
 CommandInfo* CommandLoader::FindCommandInfoByName(const Newstring& name)
 {
     for (uint32_t i = 0; i < commandInfoArray.count; ++i)
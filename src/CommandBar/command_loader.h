@@ -1,13 +1,31 @@
 #pragma once
 #include "command_engine.h"
 #include "newstring.h"
+#include "command_image.h"
 
 
 struct CommandLoader
 {
     Array<CommandInfo*> commandInfoArray;
 
+    /** String pool of command engine that created commands are registered to, see CreateCommandState::stringPool. */
+    Utf8StringPool* stringPool = nullptr;
+
+    /**
+     * Creates commands declared in specified commands file.
+     */
     Array<Command*> LoadFromFile(const Newstring& filePath);
+
+    /**
+     * Creates commands declared in specified commands file source text.
+     */
+    Array<Command*> LoadFromString(const Newstring& source);
+
+    /**
+     * Creates commands stored in command image, see BuildCommandImage(). Commands of types that are not registered
+     * in commandInfoArray are skipped.
+     */
+    Array<Command*> LoadFromImage(const CommandImageView& image);
 private:
     CommandInfo* FindCommandInfoByName(const Newstring& name);
 };
\ No newline at end of file
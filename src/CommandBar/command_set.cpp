@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <assert.h>
+#include <thread>
+
+#include "command_set.h"
+#include "command_engine.h"
+#include "unicode.h"
+
+
+bool CommandSet::AddCommand(Command* command, const Array<KeyboardLayoutMap>& maps)
+{
+    assert(command);
+
+    TempAllocatorScope scope;
+    Newstring foldedName = Unicode::FoldCase(command->name, &g_tempAllocator);
+    if (foldedName.count == 0 && command->name.count > 0)
+        return false;
+
+    Utf8StringRef foldedNameRef;
+    if (!stringPool.Add(foldedName, &foldedNameRef))
+        return false;
+
+    uint32_t row = table.GetRowCount();
+    assert(row == commands.count);
+    if (!table.AppendRow(stringPool, foldedNameRef, command->name.count))
+        return false;
+
+    if (!IndexLayoutNames(row, foldedName, maps) || !commands.Append(command))
+    {
+        table.RemoveLastRow();
+        return false;
+    }
+
+    command->set = this;
+    return true;
+}
+
+bool CommandSet::IndexLayoutNames(const Array<KeyboardLayoutMap>& maps)
+{
+    // Every command is indexed again, so previous layout names are not needed.
+    table.ClearLayoutNames();
+
+    bool isIndexed = true;
+    for (uint32_t row = 0; row < commands.count; ++row)
+    {
+        TempAllocatorScope scope;
+        Newstring foldedName = Unicode::FoldCase(commands.data[row]->name, &g_tempAllocator);
+        isIndexed = (foldedName.count > 0 || commands.data[row]->name.count == 0) && IndexLayoutNames(row, foldedName, maps) && isIndexed;
+    }
+
+    return isIndexed;
+}
+
+bool CommandSet::IndexLayoutNames(uint32_t row, const Newstring& foldedName, const Array<KeyboardLayoutMap>& maps)
+{
+    TempAllocatorScope scope;
+    const Utf8StringRef foldedNameRef = table.foldedNames.data[row];
+
+    for (uint32_t i = 0; i < maps.count; ++i)
+    {
+        NewstringBuilder mapped;
+        mapped.allocator = &g_tempAllocator;
+        if (!maps.data[i].AppendMapped(&mapped, foldedName))
+            return false;
+
+        // Map may have upper case characters.
+        Newstring layoutName = Unicode::FoldCase(mapped.string, &g_tempAllocator);
+        if (layoutName.count == 0 && mapped.count > 0)
+            return false;
+
+        Utf8StringRef layoutNameRef;
+        if (!stringPool.Add(layoutName, &layoutNameRef))
+            return false;
+
+        bool isDuplicate = stringPool.Equals(layoutNameRef, stringPool, foldedNameRef);
+        uint32_t firstLayoutName = table.firstLayoutNames.data[row];
+        for (uint32_t j = 0; j < table.layoutNameCounts.data[row] && !isDuplicate; ++j)
+            isDuplicate = stringPool.Equals(layoutNameRef, stringPool, table.layoutNames.data[firstLayoutName + j]);
+
+        // Duplicate was added last, so it's removed from pool.
+        if (isDuplicate)
+        {
+            stringPool.size = layoutNameRef.offset;
+            continue;
+        }
+
+        if (!table.AppendLayoutName(row, stringPool, layoutNameRef))
+            return false;
+    }
+
+    return true;
+}
+
+int CommandSet::FindRowByName(const Utf8StringPool& namePool, Utf8StringRef foldedName) const
+{
+    uint32_t hash = CommandTable::Hash(namePool.GetData(foldedName), foldedName.size);
+    const uint32_t* hashes = table.nameHashes.data;
+
+    for (uint32_t row = 0; row < table.GetRowCount(); ++row)
+    {
+        if (hashes[row] == hash && stringPool.Equals(table.foldedNames.data[row], namePool, foldedName))
+            return static_cast<int>(row);
+    }
+
+    return -1;
+}
+
+uint32_t CommandSet::FindCandidateRows(const Utf8StringPool& queryPool, Utf8StringRef foldedQuery, uint32_t* rows) const
+{
+    assert(rows || table.GetRowCount() == 0);
+
+    uint32_t queryPrefix = CommandTable::GetPrefix(queryPool, foldedQuery);
+    uint32_t queryMask = CommandTable::GetPrefixMask(foldedQuery.size);
+    uint32_t matchCount = 0;
+
+    for (uint32_t row = 0; row < table.GetRowCount(); ++row)
+    {
+        if (table.Matches(row, stringPool, queryPool, foldedQuery, queryPrefix, queryMask))
+            rows[matchCount++] = row;
+    }
+
+    // Closest matches go first: shorter names need less characters to be typed.
+    const uint32_t* nameLengths = table.nameLengths.data;
+    std::stable_sort(rows, rows + matchCount, [nameLengths](uint32_t a, uint32_t b) { return nameLengths[a] < nameLengths[b]; });
+
+    return matchCount;
+}
+
+void CommandSet::Dispose()
+{
+    for (uint32_t i = 0; i < commands.count; ++i)
+        Memdelete(commands.data[i]);
+    commands.Dispose();
+
+    table.Dispose();
+    stringPool.Dispose();
+}
+
+int CommandSetPublisher::RegisterReader()
+{
+    for (uint32_t i = 0; i < MaxReaderCount; ++i)
+    {
+        bool isRegistered = false;
+        if (readers[i].isRegistered.compare_exchange_strong(isRegistered, true))
+            return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+void CommandSetPublisher::UnregisterReader(int reader)
+{
+    assert(reader >= 0 && static_cast<uint32_t>(reader) < MaxReaderCount);
+    assert(readers[reader].epoch.load(std::memory_order_relaxed) == IdleEpoch);
+
+    readers[reader].isRegistered.store(false);
+}
+
+const CommandSet* CommandSetPublisher::BeginRead(int reader)
+{
+    assert(reader >= 0 && static_cast<uint32_t>(reader) < MaxReaderCount);
+    ReaderSlot& slot = readers[reader];
+    assert(slot.epoch.load(std::memory_order_relaxed) == IdleEpoch);
+
+    // Epoch is announced before set is loaded, so writer that retires loaded set sees that reader may use it.
+    slot.epoch.store(epoch.load());
+    return published.load();
+}
+
+void CommandSetPublisher::EndRead(int reader)
+{
+    assert(reader >= 0 && static_cast<uint32_t>(reader) < MaxReaderCount);
+    readers[reader].epoch.store(IdleEpoch, std::memory_order_release);
+}
+
+bool CommandSetPublisher::HasReaders() const
+{
+    for (uint32_t i = 0; i < MaxReaderCount; ++i)
+    {
+        if (readers[i].isRegistered.load(std::memory_order_relaxed))
+            return true;
+    }
+
+    return false;
+}
+
+void CommandSetPublisher::Publish(CommandSet* set)
+{
+    CommandSet* previous = published.exchange(set);
+    if (previous == nullptr)
+        return;
+
+    // Readers that loaded previous set announced epoch that is not later than this one.
+    RetiredSet retired;
+    retired.set = previous;
+    retired.epoch = epoch.fetch_add(1);
+
+    if (!retiredSets.Append(retired))
+    {
+        // Set can't be remembered, so readers are waited for right away. They never wait for writer, so wait is short.
+        while (GetOldestReaderEpoch() <= retired.epoch)
+            std::this_thread::yield();
+
+        DeleteSet(previous);
+    }
+}
+
+uint32_t CommandSetPublisher::Reclaim()
+{
+    uint64_t oldestReaderEpoch = GetOldestReaderEpoch();
+    uint32_t keptCount = 0;
+    uint32_t deletedCount = 0;
+
+    for (uint32_t i = 0; i < retiredSets.count; ++i)
+    {
+        const RetiredSet& retired = retiredSets.data[i];
+        if (retired.epoch < oldestReaderEpoch)
+        {
+            DeleteSet(retired.set);
+            ++deletedCount;
+        }
+        else
+        {
+            retiredSets.data[keptCount++] = retired;
+        }
+    }
+    retiredSets.count = keptCount;
+
+    return deletedCount;
+}
+
+void CommandSetPublisher::Dispose()
+{
+    assert(!HasReaders());
+
+    Publish(nullptr);
+    Reclaim();
+    assert(retiredSets.count == 0);
+    retiredSets.Dispose();
+}
+
+uint64_t CommandSetPublisher::GetOldestReaderEpoch() const
+{
+    uint64_t oldest = UINT64_MAX;
+    for (uint32_t i = 0; i < MaxReaderCount; ++i)
+    {
+        uint64_t readerEpoch = readers[i].epoch.load();
+        if (readerEpoch != IdleEpoch && readerEpoch < oldest)
+            oldest = readerEpoch;
+    }
+
+    return oldest;
+}
+
+void CommandSetPublisher::DeleteSet(CommandSet* set)
+{
+    set->Dispose();
+    Memdelete(set);
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+#include "array.h"
+#include "newstring.h"
+#include "keyboard_layout.h"
+#include "utf8_string_pool.h"
+#include "command_table.h"
+
+
+struct Command;
+
+/**
+ * Commands with table of their names and their strings. Set is built by one thread, then it's published by
+ * CommandSetPublisher and is not changed anymore, so other threads read it without locks. Commands are owned by set
+ * and are deleted when set is disposed.
+ */
+struct CommandSet
+{
+    /** Registered commands, row of command in table is its index. */
+    Array<Command*> commands;
+
+    CommandTable table;
+
+    /** Folded names and layout names of commands, and strings of commands created by CommandLoader for this set. */
+    Utf8StringPool stringPool;
+
+    uint32_t GetCommandCount() const { return commands.count; }
+
+    /**
+     * Adds command, its folded name is also mapped through specified keyboard layout maps. Command should be
+     * allocated using standard allocator. Returns false if memory couldn't be allocated, command is not added then.
+     */
+    bool AddCommand(Command* command, const Array<KeyboardLayoutMap>& maps);
+
+    /**
+     * Maps names of every command through specified keyboard layout maps again. Previous layout names stay in
+     * string pool. Returns false if memory couldn't be allocated.
+     */
+    bool IndexLayoutNames(const Array<KeyboardLayoutMap>& maps);
+
+    /**
+     * Returns row of command with specified case folded name, which is encoded to UTF-8 in 'namePool'.
+     * Returns -1 if there is no such command.
+     */
+    int FindRowByName(const Utf8StringPool& namePool, Utf8StringRef foldedName) const;
+
+    /**
+     * Writes rows of commands which names start with specified case folded query, ranked from best to worst: shorter
+     * names first, commands with names of the same length in order they were added. 'rows' must have room for
+     * every command. Returns number of written rows. Memory is not allocated, so it's safe to call from any thread.
+     */
+    uint32_t FindCandidateRows(const Utf8StringPool& queryPool, Utf8StringRef foldedQuery, uint32_t* rows) const;
+
+    /** Deletes commands and releases memory. */
+    void Dispose();
+private:
+    /** Appends layout names of row of command table. Returns false if memory couldn't be allocated. */
+    bool IndexLayoutNames(uint32_t row, const Newstring& foldedName, const Array<KeyboardLayoutMap>& maps);
+};
+
+/**
+ * Publishes command sets to reader threads with read-copy-update: reload builds new set, then it replaces published
+ * set by single atomic store. Readers never block and never wait for writer, they just announce the epoch they
+ * started reading in. Replaced set is retired with current epoch and is deleted by Reclaim() only when every reader
+ * that could see it has finished reading.
+ *
+ * Sets are published, retired and reclaimed by single writer thread, usually the thread that owns command engine.
+ */
+struct CommandSetPublisher
+{
+    static const uint32_t MaxReaderCount = 64;
+
+    /** Reserves reader slot for calling thread. Returns -1 if every slot is taken. Safe to call from any thread. */
+    int RegisterReader();
+
+    /** Frees reader slot. Reader must not be reading. */
+    void UnregisterReader(int reader);
+
+    /**
+     * Returns published set, which stays valid until EndRead() even if another set is published meanwhile. Returns
+     * null pointer if no set is published. Reads must not be nested. Published set must be read only.
+     */
+    const CommandSet* BeginRead(int reader);
+    void EndRead(int reader);
+
+    /** Returns true if any reader slot is registered, so published set must not be changed in place. */
+    bool HasReaders() const;
+
+    /** Returns published set. Writer only. */
+    CommandSet* GetPublished() const { return published.load(std::memory_order_relaxed); }
+
+    /** Publishes set, set that was published before is retired. Set may be null pointer. Writer only. */
+    void Publish(CommandSet* set);
+
+    /** Deletes retired sets that no reader can see anymore. Returns number of deleted sets. Writer only. */
+    uint32_t Reclaim();
+
+    uint32_t GetRetiredCount() const { return retiredSets.count; }
+
+    /** Deletes published and retired sets. Every reader must be unregistered. */
+    void Dispose();
+private:
+    /** Epoch of reader that doesn't read. */
+    static const uint64_t IdleEpoch = 0;
+
+    /** Slot is padded to cache line, so readers don't invalidate each other's cache lines. */
+    struct ReaderSlot
+    {
+        std::atomic<uint64_t> epoch{ IdleEpoch };
+        std::atomic<bool> isRegistered{ false };
+        char padding[64 - sizeof(std::atomic<uint64_t>) - sizeof(std::atomic<bool>)];
+    };
+
+    struct RetiredSet
+    {
+        CommandSet* set;
+
+        /** Epoch set was retired in, readers that started reading in later epoch can't see it. */
+        uint64_t epoch;
+    };
+
+    std::atomic<CommandSet*> published{ nullptr };
+    std::atomic<uint64_t> epoch{ 1 };
+    ReaderSlot readers[MaxReaderCount];
+    Array<RetiredSet> retiredSets;
+
+    /** Returns the smallest epoch announced by readers, or UINT64_MAX if nobody reads. */
+    uint64_t GetOldestReaderEpoch() const;
+
+    static void DeleteSet(CommandSet* set);
+};
+
+/** Reads published command set until the end of scope. */
+struct CommandSetReadScope
+{
+    CommandSetPublisher* publisher;
+    int reader;
+    const CommandSet* set;
+
+    CommandSetReadScope(CommandSetPublisher* publisher, int reader)
+        : publisher(publisher)
+        , reader(reader)
+        , set(publisher->BeginRead(reader))
+    { }
+
+    ~CommandSetReadScope()
+    {
+        publisher->EndRead(reader);
+    }
+
+    CommandSetReadScope(const CommandSetReadScope&) = delete;
+    CommandSetReadScope& operator=(const CommandSetReadScope&) = delete;
+};
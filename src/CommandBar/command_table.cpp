@@ -0,0 +1,105 @@
+#include <assert.h>
+
+#include "command_table.h"
+
+
+/** Appends value growing array geometrically, because rows are appended one by one. */
+template<typename T>
+static bool appendValue(Array<T>* array, const T& value)
+{
+    if (array->count == array->capacity && !array->Reserve(array->capacity < 16 ? 16 : array->capacity * 2))
+        return false;
+
+    array->data[array->count++] = value;
+    return true;
+}
+
+bool CommandTable::AppendRow(const Utf8StringPool& pool, Utf8StringRef foldedName, uint32_t nameLength)
+{
+    uint32_t row = GetRowCount();
+
+    bool isAppended = appendValue(&foldedNames, foldedName)
+        && appendValue(&namePrefixes, GetPrefix(pool, foldedName))
+        && appendValue(&nameHashes, Hash(pool.GetData(foldedName), foldedName.size))
+        && appendValue(&nameLengths, nameLength)
+        && appendValue(&firstLayoutNames, layoutNames.count)
+        && appendValue(&layoutNameCounts, 0u);
+
+    if (!isAppended)
+    {
+        // Columns that were appended are truncated back.
+        foldedNames.count = namePrefixes.count = nameHashes.count = nameLengths.count = row;
+        firstLayoutNames.count = layoutNameCounts.count = row;
+    }
+
+    return isAppended;
+}
+
+bool CommandTable::AppendLayoutName(uint32_t row, const Utf8StringPool& pool, Utf8StringRef layoutName)
+{
+    assert(row < GetRowCount());
+    assert(firstLayoutNames.data[row] + layoutNameCounts.data[row] == layoutNames.count || layoutNameCounts.data[row] == 0);
+
+    if (!appendValue(&layoutNames, layoutName))
+        return false;
+
+    if (!appendValue(&layoutNamePrefixes, GetPrefix(pool, layoutName)))
+    {
+        --layoutNames.count;
+        return false;
+    }
+
+    if (layoutNameCounts.data[row] == 0)
+        firstLayoutNames.data[row] = layoutNames.count - 1;
+    ++layoutNameCounts.data[row];
+
+    return true;
+}
+
+void CommandTable::ClearLayoutNames()
+{
+    layoutNames.Clear();
+    layoutNamePrefixes.Clear();
+
+    for (uint32_t row = 0; row < GetRowCount(); ++row)
+    {
+        firstLayoutNames.data[row] = 0;
+        layoutNameCounts.data[row] = 0;
+    }
+}
+
+void CommandTable::RemoveLastRow()
+{
+    assert(GetRowCount() > 0);
+
+    uint32_t row = GetRowCount() - 1;
+    if (layoutNameCounts.data[row] > 0)
+        layoutNames.count = layoutNamePrefixes.count = firstLayoutNames.data[row];
+
+    foldedNames.count = namePrefixes.count = nameHashes.count = nameLengths.count = row;
+    firstLayoutNames.count = layoutNameCounts.count = row;
+}
+
+void CommandTable::Clear()
+{
+    foldedNames.Clear();
+    namePrefixes.Clear();
+    nameHashes.Clear();
+    nameLengths.Clear();
+    firstLayoutNames.Clear();
+    layoutNameCounts.Clear();
+    layoutNames.Clear();
+    layoutNamePrefixes.Clear();
+}
+
+void CommandTable::Dispose()
+{
+    foldedNames.Dispose();
+    namePrefixes.Dispose();
+    nameHashes.Dispose();
+    nameLengths.Dispose();
+    firstLayoutNames.Dispose();
+    layoutNameCounts.Dispose();
+    layoutNames.Dispose();
+    layoutNamePrefixes.Dispose();
+}
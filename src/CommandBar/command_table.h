@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+
+#include "array.h"
+#include "utf8_string_pool.h"
+
+
+/**
+ * Names of registered commands stored column by column, so scans over all commands read only the columns they need
+ * from contiguous memory instead of following pointer to every command object. Row of command is its index in
+ * CommandSet::commands, command objects keep data that is needed only when command is executed or displayed.
+ */
+struct CommandTable
+{
+    /** Case folded names in string pool of command set. */
+    Array<Utf8StringRef> foldedNames;
+
+    /** First bytes of folded names, see GetPrefix(). Most names don't match query by them, so string pool is not read. */
+    Array<uint32_t> namePrefixes;
+
+    /** Hashes of folded names, see Hash(). Command is found by name comparing hashes first. */
+    Array<uint32_t> nameHashes;
+
+    /** Lengths of command names in UTF-16 code units, autocompletion candidates are ranked by them. */
+    Array<uint32_t> nameLengths;
+
+    /** Range of layoutNames of every row. */
+    Array<uint32_t> firstLayoutNames;
+    Array<uint32_t> layoutNameCounts;
+
+    /**
+     * Folded names mapped through keyboard layout maps of command engine, only names that differ from folded name
+     * are kept. Autocompletion matches them too, so name typed in wrong keyboard layout is found.
+     */
+    Array<Utf8StringRef> layoutNames;
+    Array<uint32_t> layoutNamePrefixes;
+
+    uint32_t GetRowCount() const { return foldedNames.count; }
+
+    /** Returns up to 4 first bytes of string, padded with zeroes. UTF-8 string has no zero bytes. */
+    static uint32_t GetPrefix(const Utf8StringPool& pool, Utf8StringRef ref)
+    {
+        uint32_t prefix = 0;
+        memcpy(&prefix, pool.GetData(ref), ref.size < 4 ? ref.size : 4);
+        return prefix;
+    }
+
+    /** Returns mask of bytes that prefix of string of specified size consists of. */
+    static uint32_t GetPrefixMask(uint32_t size)
+    {
+        uint32_t mask = 0;
+        memset(&mask, 0xFF, size < 4 ? size : 4);
+        return mask;
+    }
+
+    /** Returns FNV-1a hash of string. */
+    static uint32_t Hash(const char* data, uint32_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = 0; i < size; ++i)
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+        return hash;
+    }
+
+    /**
+     * Returns true if folded name or one of layout names of row starts with query. Query prefix and mask are
+     * computed once for all rows by GetPrefix() and GetPrefixMask().
+     */
+    bool Matches(uint32_t row, const Utf8StringPool& pool, const Utf8StringPool& queryPool, Utf8StringRef query,
+        uint32_t queryPrefix, uint32_t queryMask) const
+    {
+        // Prefix of query that is not longer than 4 bytes is the whole query.
+        if (((namePrefixes.data[row] ^ queryPrefix) & queryMask) == 0
+            && (query.size <= 4 || pool.StartsWith(foldedNames.data[row], queryPool, query)))
+        {
+            return true;
+        }
+
+        uint32_t end = firstLayoutNames.data[row] + layoutNameCounts.data[row];
+        for (uint32_t i = firstLayoutNames.data[row]; i < end; ++i)
+        {
+            if (((layoutNamePrefixes.data[i] ^ queryPrefix) & queryMask) == 0
+                && (query.size <= 4 || pool.StartsWith(layoutNames.data[i], queryPool, query)))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** Appends row with no layout names. Returns false if memory couldn't be allocated. */
+    bool AppendRow(const Utf8StringPool& pool, Utf8StringRef foldedName, uint32_t nameLength);
+
+    /**
+     * Appends layout name to row. Layout names of row must be appended after layout names of other rows.
+     * Returns false if memory couldn't be allocated.
+     */
+    bool AppendLayoutName(uint32_t row, const Utf8StringPool& pool, Utf8StringRef layoutName);
+
+    /** Removes layout names of every row, so they can be appended again. */
+    void ClearLayoutNames();
+
+    /** Removes the last row and its layout names. */
+    void RemoveLastRow();
+
+    void Clear();
+    void Dispose();
+};
@@ -12,6 +12,7 @@
 #include "command_loader.h"
 #include "basic_commands.h"
 #include "popup_window.h"
+#include "process_launcher.h"
 #include "string_utils.h"
 #include "debug_utils.h"
 #include "clipboard.h"
@@ -19,10 +20,15 @@
 #include "os_utils.h"
 #include "context.h"
 #include "defer.h"
+#include "trace.h"
 #include "utils.h"
 
 
 void beforeRunCallback(CommandEngine* engine, void* userdata);
+static void launchNotifyCallback(void* userdata);
+static void launchCompletedCallback(LaunchRequest* request, void* userdata);
+static void* rowLayouts_createLayout(const Newstring& text, void* userdata);
+static void rowLayouts_releaseLayout(void* layout, void* userdata);
 
 HICON CommandWindow::g_appIcon = 0;
 ATOM CommandWindow::g_windowClass = 0;
@@ -31,6 +37,7 @@ UINT CommandWindow::g_taskbarCreatedMessageId = 0;
 const wchar_t* CommandWindow::g_windowName = L"Command Bar";
 const wchar_t* CommandWindow::g_className = L"CommandWindow";
 const UINT CommandWindow::g_showWindowMessageId = WM_USER + 64;
+const UINT CommandWindow::g_launchCompletedMessageId = WM_USER + 65;
 
 enum
 {
@@ -80,7 +87,7 @@ void CommandWindow::ClearText()
 {
     textEdit.ClearText();
 
-    autocompletionCandidate = nullptr;
+    UpdateAutocompletion();
 
     Redraw();
 }
@@ -89,7 +96,7 @@ bool CommandWindow::SetText(const Newstring& text)
 {
     textEdit.SetText(text);
 
-    autocompletionCandidate = nullptr;
+    UpdateAutocompletion();
 
     Redraw();
 
@@ -98,13 +105,59 @@ bool CommandWindow::SetText(const Newstring& text)
 
 void CommandWindow::Redraw()
 {
-    isTextLayoutDirty = true;
     InvalidateRect(hwnd, nullptr, true);
 }
 
+static RenderColor toRenderColor(const D2D1_COLOR_F& color)
+{
+    return { color.r, color.g, color.b, color.a };
+}
+
+RenderInputs CommandWindow::GetRenderInputs() const
+{
+    RenderInputs inputs;
+    inputs.textRevision = textEdit.revision;
+    inputs.caretPos = textEdit.caretPos;
+    textEdit.GetSelectionStartAndLength(&inputs.selectionStart, &inputs.selectionLength);
+    inputs.isCaretVisible = shouldDrawCaret && !textEdit.IsTextSelected();
+    inputs.candidate = autocompletionCandidate;
+    inputs.dropdownRevision = autocompletionList.revision;
+    return inputs;
+}
+
+float CommandWindow::GetRowHeight() const
+{
+    return static_cast<float>(style->windowHeight - 2 * style->borderSize);
+}
+
+void CommandWindow::UpdateWindowSize()
+{
+    int height = style->windowHeight;
+    if (autocompletionList.rowCount > 0)
+        height += static_cast<int>(autocompletionList.rowCount * GetRowHeight()) + style->borderSize;
+
+    windowRowCount = autocompletionList.rowCount;
+
+    RECT windowRect;
+    GetWindowRect(hwnd, &windowRect);
+    if (windowRect.bottom - windowRect.top == height)
+        return;
+
+    int width = windowRect.right - windowRect.left;
+    SetWindowPos(hwnd, nullptr, 0, 0, width, height, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+
+    if (hwndRenderTarget != nullptr)
+        hwndRenderTarget->Resize(D2D1::SizeU(width, height));
+
+    renderState.Invalidate();
+    Redraw();
+}
+
 void CommandWindow::UpdateTextLayout(bool forced)
 {
-    if (textLayout == nullptr || isTextLayoutDirty || forced)
+    TRACE_ZONE("CommandWindow::UpdateTextLayout");
+
+    if (textLayout == nullptr || textLayoutRevision != textEdit.revision || forced)
     {
         SafeRelease(textLayout);
 
@@ -113,9 +166,11 @@ void CommandWindow::UpdateTextLayout(bool forced)
         float clientWidth  = static_cast<float>(clientRect.right - clientRect.left);
         float clientHeight = static_cast<float>(clientRect.bottom - clientRect.top);
 
+        Newstring text = textEdit.GetText();
+
         HRESULT hr = dwrite->CreateTextLayout(
-            textEdit.buffer.data,
-            textEdit.buffer.count,
+            text.data,
+            text.count,
             textFormat,
             clientWidth,
             clientHeight,
@@ -125,22 +180,55 @@ void CommandWindow::UpdateTextLayout(bool forced)
 
         textLayout->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
 
-        int spaceIndex = textEdit.buffer.string.IndexOf(L' ');
+        int spaceIndex = text.IndexOf(L' ');
 
         DWRITE_TEXT_RANGE range;
         if (spaceIndex != -1)
             range = { 0, static_cast<UINT32>(spaceIndex) };
         else
-            range = { 0, static_cast<UINT32>(textEdit.buffer.count) };
+            range = { 0, static_cast<UINT32>(text.count) };
 
         textLayout->SetFontWeight(DWRITE_FONT_WEIGHT_BOLD, range);
 
-        isTextLayoutDirty = false;
+        textLayoutRevision = textEdit.revision;
+
+        textMetrics.layout = textLayout;
+        textAdvances.Invalidate();
+        textAdvances.Update(&textMetrics, text, textLayoutRevision);
     }
 }
 
+float CommandWindow::GetTextPositionX(uint32_t pos)
+{
+    if (textAdvances.isValid)
+        return textAdvances.GetCaretX(pos);
+
+    float x = 0.0f;
+    float y = 0.0f;
+    DWRITE_HIT_TEST_METRICS metrics;
+    textLayout->HitTestTextPosition(pos, false, &x, &y, &metrics);
+
+    return x;
+}
+
+uint32_t CommandWindow::HitTestTextPosition(float x)
+{
+    if (textAdvances.isValid)
+        return textAdvances.HitTest(x);
+
+    BOOL isInside = false;
+    BOOL isTrailingHit = false;
+    DWRITE_HIT_TEST_METRICS metrics = { 0 };
+    HRESULT hr = textLayout->HitTestPoint(x, 0.0f, &isTrailingHit, &isInside, &metrics);
+    assert(SUCCEEDED(hr));
+
+    return metrics.textPosition + (isTrailingHit ? 1 : 0);
+}
+
 void CommandWindow::UpdateAutocompletionLayout()
 {
+    TRACE_ZONE("CommandWindow::UpdateAutocompletionLayout");
+
     SafeRelease(autocompletionLayout);
 
     auto ac = autocompletionCandidate;
@@ -156,7 +244,7 @@ void CommandWindow::UpdateAutocompletionLayout()
     };
 
     Newstring autocomplText;
-    auto commandText = textEdit.buffer.string;
+    auto commandText = textEdit.GetText();
 
     if (commandText.count < MAX_AUTOCOMPLETE)
     {
@@ -193,6 +281,10 @@ void CommandWindow::UpdateAutocompletionLayout()
 
     DWRITE_TEXT_RANGE range ={ 0, ac->name.count };
     assert(SUCCEEDED(autocompletionLayout->SetFontWeight(DWRITE_FONT_WEIGHT_BOLD, range)));
+
+    DWRITE_HIT_TEST_METRICS metrics;
+    hr = autocompletionLayout->HitTestTextPosition(commandText.count, false, &autocompletionOffsetX, &autocompletionOffsetY, &metrics);
+    assert(SUCCEEDED(hr));
 }
 
 void CommandWindow::TextEditChanged()
@@ -201,6 +293,8 @@ void CommandWindow::TextEditChanged()
 
     shouldDrawCaret = true;
     SetCaretTimer();
+
+    UpdateAutocompletion();
 }
 
 bool CommandWindow::ShouldDrawAutocompletion() const
@@ -210,8 +304,11 @@ bool CommandWindow::ShouldDrawAutocompletion() const
 
 LRESULT CommandWindow::OnChar(wchar_t c)
 {
+    TRACE_ZONE("CommandWindow::OnChar");
+
     textEdit.InsertCharacterAtCaret(c);
-    isTextLayoutDirty = true;
+
+    UpdateAutocompletion();
 
     return 0;
 }
@@ -225,7 +322,7 @@ LRESULT CommandWindow::OnKeyDown(LPARAM lParam, WPARAM vk)
     {
         case VK_ESCAPE:
         {
-            if (IsWindowVisible(hwnd))
+            if (IsShown())
             {
                 HideWindow();
             }
@@ -239,11 +336,19 @@ LRESULT CommandWindow::OnKeyDown(LPARAM lParam, WPARAM vk)
         case VK_UP:
         case VK_DOWN:
         {
+            if (autocompletionList.rowCount > 0)
+            {
+                vk == VK_UP ? autocompletionList.SelectPrev() : autocompletionList.SelectNext();
+                autocompletionCandidate = autocompletionList.GetSelected();
+                break;
+            }
+
             const Newstring* entry = vk == VK_UP ? history.GetPrevEntry() : history.GetNextEntry();
             if (entry == nullptr)  break;
 
             textEdit.SetText(*entry);
             textEdit.SetCaretPos(entry->count);
+            historyTextRevision = textEdit.revision;
 
             break;
         }
@@ -282,6 +387,8 @@ LRESULT CommandWindow::OnKeyDown(LPARAM lParam, WPARAM vk)
             }
             else if (control && vk == 'C')  textEdit.CopySelectionToClipboard(hwnd);
             else if (control && vk == 'V')  textEdit.PasteTextFromClipboard(hwnd);
+            else if (control && vk == 'Z')  shift ? textEdit.Redo() : textEdit.Undo();
+            else if (control && vk == 'Y')  textEdit.Redo();
             break;
         }
     }
@@ -308,18 +415,24 @@ LRESULT CommandWindow::OnLeftMouseButtonDown(LPARAM lParam, WPARAM wParam)
     const float mouseY = static_cast<float>(GET_Y_LPARAM(lParam));
     const float borderSize = static_cast<float>(style->borderSize);
 
-    UpdateTextLayout();
+    // Clicking dropdown row completes its command.
+    if (mouseY >= style->windowHeight)
+    {
+        uint32_t row = static_cast<uint32_t>((mouseY - style->windowHeight) / GetRowHeight());
+        if (autocompletionList.SelectRow(row))
+        {
+            autocompletionCandidate = autocompletionList.GetSelected();
+            OnUserRequestedAutocompletion();
+            TextEditChanged();
+        }
 
-    BOOL isInside = false;
-    BOOL isTrailingHit = false;
-    DWRITE_HIT_TEST_METRICS metrics = { 0 };
-    HRESULT hr = 0;
+        return 0;
+    }
 
-    hr = textLayout->HitTestPoint(mouseX - style->textMarginLeft - borderSize, mouseY, &isTrailingHit, &isInside, &metrics);
-    assert(SUCCEEDED(hr));
+    UpdateTextLayout();
 
     textEdit.ClearSelection();
-    textEdit.SetCaretPos(metrics.textPosition + (isTrailingHit ? 1 : 0));
+    textEdit.SetCaretPos(HitTestTextPosition(mouseX - style->textMarginLeft - borderSize));
 
     mouseSelectionStartPos = textEdit.caretPos;
 
@@ -349,20 +462,11 @@ LRESULT CommandWindow::OnMouseMove(LPARAM lParam, WPARAM wParam)
         return true;
 
     const float mouseX = static_cast<float>(GET_X_LPARAM(lParam));
-    const float mouseY = static_cast<float>(GET_Y_LPARAM(lParam));
     const float borderSize = static_cast<float>(style->borderSize);
 
     UpdateTextLayout();
 
-    BOOL isInside = false;
-    BOOL isTrailingHit = false;
-    DWRITE_HIT_TEST_METRICS metrics = { 0 };
-    HRESULT hr = 0;
-
-    hr = textLayout->HitTestPoint(mouseX - style->textMarginLeft - borderSize, mouseY, &isTrailingHit, &isInside, &metrics);
-    assert(SUCCEEDED(hr));
-
-    uint32_t targetPos = metrics.textPosition + (isTrailingHit ? 1 : 0);
+    uint32_t targetPos = HitTestTextPosition(mouseX - style->textMarginLeft - borderSize);
     
     uint32_t start = mouseSelectionStartPos;
     uint32_t length;
@@ -427,44 +531,47 @@ void CommandWindow::OnUserRequestedAutocompletion()
 
 Command* CommandWindow::FindAutocompletionCandidate()
 {
-    if (textEdit.buffer.count == 0)
-        return nullptr;
+    return commandEngine->FindAutocompletionCandidate(textEdit.GetText());
+}
 
-    const Newstring& buffer = textEdit.buffer.string;
+void CommandWindow::UpdateAutocompletion(bool forced)
+{
+    // Key-down and character messages of one keystroke both get here, so text is searched only once per change.
+    if (autocompletionTextRevision == textEdit.revision && !forced)
+        return;
 
-    int index = buffer.IndexOf(L' ');
+    TRACE_ZONE("CommandWindow::UpdateAutocompletion");
 
-    Newstring command;
-    command.data  = buffer.data;
-    command.count = index == -1 ? buffer.count : index;
+    autocompletionTextRevision = textEdit.revision;
 
-    if (command.count == 0)
-        return nullptr;
+    Newstring text = textEdit.GetText();
+    bool isDropdownShown = style->autocompletionRowCount > 0 && text.count > 0 && text.IndexOf(L' ') == -1
+        && textEdit.revision != historyTextRevision;
 
-    for (uint32_t i = 0; i < commandEngine->commands.count; ++i)
+    Command* newCandidate = nullptr;
+    if (isDropdownShown)
     {
-        Command* candidate = commandEngine->commands.data[i];
-        bool isMatchingCandidate = candidate->name.StartsWith(command, StringComparison::CaseInsensitive);
-
-        if (isMatchingCandidate)
-            return candidate;
+        // Ghost text shows selected row.
+        uint32_t count = 0;
+        Command* const* candidates = commandEngine->FindAutocompletionCandidates(text, &count);
+        autocompletionList.SetCandidates(candidates, count);
+        newCandidate = autocompletionList.GetSelected();
+    }
+    else
+    {
+        autocompletionList.Clear();
+        newCandidate = FindAutocompletionCandidate();
     }
 
-    return nullptr;
-}
+    if (autocompletionList.rowCount != windowRowCount)
+        UpdateWindowSize();
 
-void CommandWindow::UpdateAutocompletion()
-{
-    if (showPreviousCommandAutocompletion)
+    if (showPreviousCommandAutocompletion && text.count == 0)
     {
-        if (textEdit.buffer.count == 0)
-        {
-            autocompletionCandidate = showPreviousCommandAutocompletion_command;
-            return;
-        }
+        autocompletionCandidate = showPreviousCommandAutocompletion_command;
+        return;
     }
-    
-    Command* newCandidate = FindAutocompletionCandidate();
+
     if (autocompletionCandidate != newCandidate)
     {
         autocompletionCandidate = newCandidate;
@@ -491,103 +598,91 @@ void CommandWindow::KillCaretTimer()
 
 LRESULT CommandWindow::OnPaint()
 {
-    ID2D1HwndRenderTarget* rt = this->hwndRenderTarget;
-    assert(rt);
-
-    float clientWidth, clientHeight;
-    GetClientSizeF(&clientWidth, &clientHeight);
-    float cursorUpY = style->borderSize + 3.0f;
-    
-    const float borderSize = static_cast<float>(style->borderSize);
-    float cursorBottomY = clientHeight - borderSize - 3.0f;
+    PaintFrame();
 
-    float marginX = style->textMarginLeft + style->borderSize;
+    return 0;
+}
 
-    UpdateTextLayout();
+bool CommandWindow::PaintFrame()
+{
+    TRACE_ZONE("CommandWindow::PaintFrame");
 
-    D2D1_RECT_F textboxRect = D2D1::RectF(
-        borderSize,
-        borderSize,
-        clientWidth  - borderSize,
-        clientHeight - borderSize
-    );
+    assert(hwndRenderTarget);
 
-    rt->BeginDraw();
-    rt->Clear(style->borderColor);
+    uint32_t changes = renderState.BeginFrame(GetRenderInputs());
+    UpdateTextLayout(RenderState::IsTextLayoutAffected(changes));
 
-    rt->FillRectangle(textboxRect, textboxBackgroundBrush);
+    CommandWindowFrame frame;
+    GetClientSizeF(&frame.width, &frame.height);
+    frame.textboxHeight = static_cast<float>(style->windowHeight);
+    frame.borderSize = static_cast<float>(style->borderSize);
+    frame.textMarginLeft = style->textMarginLeft;
 
-    float cursorRelativeX = 0.0f;
-    float cursorRelativeY = 0.0f;
+    frame.borderColor = toRenderColor(style->borderColor);
+    frame.textboxBackgroundColor = toRenderColor(style->textboxBackgroundColor);
+    frame.selectedTextBackgroundColor = toRenderColor(style->selectedTextBackgroundColor);
+    frame.textColor = toRenderColor(style->textColor);
+    frame.autocompletionTextColor = toRenderColor(style->autocompletionTextColor);
+    frame.dropdownBackgroundColor = toRenderColor(style->dropdownBackgroundColor);
+    frame.selectedRowBackgroundColor = toRenderColor(style->selectedRowBackgroundColor);
 
-    DWRITE_HIT_TEST_METRICS metrics;
-    textLayout->HitTestTextPosition(textEdit.caretPos, false, &cursorRelativeX, &cursorRelativeY, &metrics);
+    frame.text.text = textEdit.GetText();
+    frame.text.layout = textLayout;
 
-    // Draw selection background
-    if (textEdit.IsTextSelected())
+    if (ShouldDrawAutocompletion())
     {
-        uint32_t selectionStart = 0;
-        uint32_t selectionLength = 0;
-        textEdit.GetSelectionStartAndLength(&selectionStart, &selectionLength);
+        if (autocompletionLayout == nullptr || RenderState::IsAutocompletionLayoutAffected(changes))
+            UpdateAutocompletionLayout();
 
-        float unused;
-        float selectionRelativeStartX = 0.0f;
-        float selectionRelativeEndX = 0.0f;
-
-        textLayout->HitTestTextPosition(selectionStart, false, &selectionRelativeStartX, &unused, &metrics);
-        textLayout->HitTestTextPosition(selectionStart + selectionLength, false, &selectionRelativeEndX, &unused, &metrics);
-
-        rt->FillRectangle(
-            D2D1::RectF(
-                marginX + selectionRelativeStartX,
-                borderSize, 
-                marginX + selectionRelativeEndX,
-                clientHeight - borderSize), 
-            selectedTextBrush);
+        frame.hasAutocompletion = true;
+        frame.autocompletion.layout = autocompletionLayout;
+        frame.autocompletionOffsetX = autocompletionOffsetX;
+        frame.autocompletionOffsetY = autocompletionOffsetY;
     }
 
-    float textDrawY = borderSize;
-
-    UpdateAutocompletion();
-    if (ShouldDrawAutocompletion())
+    // Only visible rows are laid out, layouts of rows that stay visible are reused.
+    RenderTextRun rows[AutocompletionList::MaxVisibleRows];
+    if (autocompletionList.rowCount > 0)
     {
-        UpdateAutocompletionLayout();
+        rowLayouts.BeginFrame();
+        for (uint32_t i = 0; i < autocompletionList.rowCount; ++i)
+        {
+            const Command* command = autocompletionList.rows[i];
+            rows[i].text = command->name;
+            rows[i].layout = rowLayouts.GetLayout(command, command->name);
+        }
 
-        DWRITE_HIT_TEST_METRICS acMetrics;
-        float acDrawRelativeX = 0.0f;
-        float acDrawRelativeY = 0.0f;
-        assert(SUCCEEDED(
-            autocompletionLayout->HitTestTextPosition(textEdit.buffer.count, false, &acDrawRelativeX, &acDrawRelativeY, &acMetrics)));
+        frame.rows = rows;
+        frame.rowCount = autocompletionList.rowCount;
+        frame.rowHeight = GetRowHeight();
+        frame.selectedRow = autocompletionList.GetSelectedRow();
+    }
 
-        D2D1_RECT_F acClip = D2D1::RectF(
-            marginX + acDrawRelativeX,
-            borderSize + acDrawRelativeY,
-            clientWidth,
-            clientHeight);
+    frame.isTextSelected = textEdit.IsTextSelected();
+    if (frame.isTextSelected)
+    {
+        uint32_t selectionStart = 0;
+        uint32_t selectionLength = 0;
+        textEdit.GetSelectionStartAndLength(&selectionStart, &selectionLength);
 
-        rt->PushAxisAlignedClip(acClip, D2D1_ANTIALIAS_MODE_ALIASED);
+        frame.selectionStartX = GetTextPositionX(selectionStart);
+        frame.selectionEndX = GetTextPositionX(selectionStart + selectionLength);
+    }
 
-        rt->DrawTextLayout(
-            D2D1::Point2F(marginX, textDrawY),
-            autocompletionLayout,
-            autocompletionTextForegroundBrush,
-            D2D1_DRAW_TEXT_OPTIONS_CLIP);
+    frame.isCaretVisible = shouldDrawCaret && !frame.isTextSelected;
+    frame.caretX = GetTextPositionX(textEdit.caretPos);
 
-        rt->PopAxisAlignedClip();
-    }
+    // Render target retains its contents, so when only caret changed, only areas of previous and current caret are redrawn.
+    frame.isCaretOnly = RenderState::IsCaretOnlyFrame(changes);
+    frame.previousCaretLineX = drawnCaretX;
 
-    // Draw actual user text
-    rt->DrawTextLayout(D2D1::Point2F(marginX, textDrawY), textLayout, textForegroundBrush, D2D1_DRAW_TEXT_OPTIONS_CLIP);
+    renderer.BeginFrame();
+    frame.Paint(&renderer);
+    bool isPresented = renderer.EndFrame();
 
-    if (shouldDrawCaret && !textEdit.IsTextSelected())
-    {
-        // Center cursor X at pixel center to disable anti-aliasing.
-        float cursorActualX = floorf(marginX + cursorRelativeX) + 0.5f;
-        rt->DrawLine(D2D1::Point2F(cursorActualX, cursorUpY), D2D1::Point2F(cursorActualX, cursorBottomY), textForegroundBrush);
-    }
+    drawnCaretX = frame.GetCaretLineX();
 
-    HRESULT hr = rt->EndDraw();
-    if (hr == D2DERR_RECREATE_TARGET)
+    if (!isPresented)
     {
         DiscardGraphicsResources();
         CreateGraphicsResources();
@@ -595,16 +690,64 @@ LRESULT CommandWindow::OnPaint()
     else
     {
         ValidateRect(hwnd, nullptr);
+
+        if (showRequestTicks != 0)
+            RecordShowLatency();
     }
 
-    return 0;
+    return isPresented;
+}
+
+void CommandWindow::RecordShowLatency()
+{
+    uint64_t frequency = 0;
+    uint64_t ticks = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+    QueryPerformanceCounter((LARGE_INTEGER*)&ticks);
+
+    double milliseconds = (ticks - showRequestTicks) * 1000.0 / frequency;
+    showRequestTicks = 0;
+
+    ShowLatencyStatistics& s = showLatency;
+    ++s.showCount;
+    s.lastMilliseconds = milliseconds;
+    s.totalMilliseconds += milliseconds;
+    if (milliseconds > s.maxMilliseconds)
+        s.maxMilliseconds = milliseconds;
+
+#ifdef CB_TRACE
+    Trace::RecordZone("CommandWindow: show to first frame", showRequestTimestamp, Trace::GetTimestamp());
+#endif
+
+    TempAllocatorScope scope;
+    OutputDebugStringW(Newstring::FormatTempCString(L"Show to first frame: %.3f ms (average %.3f ms, max %.3f ms)\n",
+        s.lastMilliseconds, s.totalMilliseconds / s.showCount, s.maxMilliseconds));
+}
+
+void CommandWindow::PrewarmGraphicsResources()
+{
+    TRACE_ZONE("CommandWindow::PrewarmGraphicsResources");
+
+    if (!prewarmGraphicsResources || IsWindowVisible(hwnd))
+        return;
+
+    if (hwndRenderTarget == nullptr && !CreateGraphicsResources())
+        return;
+
+    // ShowWindow() sets the same candidate, so autocompletion layout built now stays valid.
+    if (showPreviousCommandAutocompletion && showPreviousCommandAutocompletion_command != nullptr)
+        autocompletionCandidate = showPreviousCommandAutocompletion_command;
+
+    // Drawing hidden window checks render target: if it was lost, it is recreated and frame is drawn again.
+    if (!PaintFrame())
+        PaintFrame();
 }
 
 LRESULT CommandWindow::OnHotkey(LPARAM lParam, WPARAM wParam)
 {
     if (wParam == SHOW_APP_WINDOW_HOTKEY_ID)
     {
-        if (IsWindowVisible(hwnd))
+        if (IsShown())
         {
             HideWindow();
         }
@@ -669,6 +812,14 @@ LRESULT CommandWindow::OnCursorBlinkTimerElapsed()
     return 0;
 }
 
+LRESULT CommandWindow::OnLaunchCompleted()
+{
+    if (commandEngine->launcher != nullptr)
+        commandEngine->launcher->DrainCompleted(launchCompletedCallback, this);
+
+    return 0;
+}
+
 bool CommandWindow::Initialize(CommandEngine* engine, CommandWindowStyle* style, int nCmdShow)
 {
     if (isInitialized)
@@ -727,20 +878,35 @@ bool CommandWindow::Initialize(CommandEngine* engine, CommandWindowStyle* style,
         return false;
 
     commandEngine->SetBeforeRunCallback(beforeRunCallback, this);
+    if (commandEngine->launcher != nullptr)
+        commandEngine->launcher->SetNotifyCallback(launchNotifyCallback, this);
+
     if (!textEdit.Initialize())
         return false;
 
+    if (style->autocompletionRowCount > 0)
+    {
+        uint32_t rowCount = static_cast<uint32_t>(style->autocompletionRowCount);
+        autocompletionList.visibleRowLimit = rowCount < AutocompletionList::MaxVisibleRows ? rowCount : AutocompletionList::MaxVisibleRows;
+    }
+
     SetCaretTimer();
 
+    // Commands typed while Russian layout is active are still found, layout is switched to English only on show.
+    commandEngine->AddDefaultKeyboardLayoutMaps();
+
+    // Quit commands post quit message to message queue of this thread.
+    static CommandInfo quitInfo(Newstring::WrapConstWChar(L"quit"), CI_OwnerThreadOnly, nullptr);
+
     QuitCommand* quitcmd = Memnew(QuitCommand);
     quitcmd->name = Newstring::NewFromWChar(L"quit");
-    quitcmd->info = nullptr;
+    quitcmd->info = &quitInfo;
     quitcmd->commandWindow = this;
     commandEngine->RegisterCommand(quitcmd);
 
     QuitCommand* exitcmd = Memnew(QuitCommand);
     exitcmd->name = Newstring::NewFromWChar(L"exit");
-    exitcmd->info = nullptr;
+    exitcmd->info = &quitInfo;
     exitcmd->commandWindow = this;
     commandEngine->RegisterCommand(exitcmd);
     
@@ -760,9 +926,23 @@ bool CommandWindow::Initialize(CommandEngine* engine, CommandWindowStyle* style,
 
 void CommandWindow::ShowWindow()
 {
-    if (IsWindowVisible(hwnd))
+    if (IsShown())
         return;
 
+    // Window that is fading out is faded in again from its current alpha, but it's shown with empty text
+    // like hidden window.
+    bool isVisible = IsWindowVisible(hwnd) != 0;
+    if (isHiding)
+    {
+        isHiding = false;
+        ClearText();
+    }
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&showRequestTicks);
+#ifdef CB_TRACE
+    showRequestTimestamp = Trace::GetTimestamp();
+#endif
+
     int desktopWidth  = GetSystemMetrics(SM_CXFULLSCREEN);
     int desktopHeight = GetSystemMetrics(SM_CYFULLSCREEN);
 
@@ -772,7 +952,8 @@ void CommandWindow::ShowWindow()
     int windowWidth = windowRect.right - windowRect.left;
 
     // Change opacity before we display window.
-    SetLayeredWindowAttributes(hwnd, 0, 0, LWA_ALPHA);
+    if (!isVisible)
+        SetLayeredWindowAttributes(hwnd, 0, 0, LWA_ALPHA);
     SetWindowPos(
         hwnd,
         HWND_TOPMOST,
@@ -790,26 +971,56 @@ void CommandWindow::ShowWindow()
         autocompletionCandidate = showPreviousCommandAutocompletion_command;
     }
 
+    // Hidden window doesn't keep its contents, but layouts built before it was hidden or while prewarming are valid.
+    renderState.InvalidateFrame();
+
     WindowAnimationProperties props;
+    props.adjustAnimationDuration = true;
+    props.animationDuration = style->showAnimationDuration;
     props.startAlpha = 0;
     props.endAlpha = 255;
     AnimateWindow(hwnd, props);
 }
 
+static void hideAnimationCompleted(const void* key, void* userdata)
+{
+    static_cast<CommandWindow*>(userdata)->OnHideAnimationCompleted();
+}
+
 void CommandWindow::HideWindow()
 {
+    if (isHiding || !IsWindowVisible(hwnd))
+        return;
+
+    // Window keeps receiving messages while it fades out, it's hidden by OnHideAnimationCompleted().
+    isHiding = true;
+
     WindowAnimationProperties props;
+    props.adjustAnimationDuration = true;
+    props.animationDuration = style->hideAnimationDuration;
     props.startAlpha = 255;
     props.endAlpha = 0;
-    AnimateWindow(hwnd, props);
+    AnimateWindow(hwnd, props, hideAnimationCompleted, this);
+}
+
+void CommandWindow::OnHideAnimationCompleted()
+{
+    isHiding = false;
 
     ::ShowWindow(hwnd, SW_HIDE);
     ClearText();
+
+    PrewarmGraphicsResources();
+}
+
+bool CommandWindow::IsShown() const
+{
+    return !isHiding && IsWindowVisible(hwnd);
 }
 
 void CommandWindow::ToggleVisibility()
 {
-    IsWindowVisible(hwnd) ? HideWindow() : ShowWindow();
+    IsShown() ? HideWindow() : ShowWindow();
 }
 
 void CommandWindow::Exit()
@@ -819,7 +1030,9 @@ void CommandWindow::Exit()
 
 void CommandWindow::Evaluate()
 {
-    const Newstring& input = textEdit.buffer.string;
+    TRACE_ZONE("CommandWindow::Evaluate");
+
+    Newstring input = textEdit.GetText();
     history.SaveEntry(input);
 
     bool success = commandEngine->Evaluate(input);
@@ -862,6 +1075,10 @@ void CommandWindow::GetClientSizeF(float* width, float* height)
 
 bool CommandWindow::CreateGraphicsResources()
 {
+    rowLayouts.createLayout = rowLayouts_createLayout;
+    rowLayouts.releaseLayout = rowLayouts_releaseLayout;
+    rowLayouts.userdata = this;
+
     const auto format = Newstring::FormatTempCString;
 
     HRESULT hr = E_UNEXPECTED;
@@ -871,6 +1088,8 @@ bool CommandWindow::CreateGraphicsResources()
             DiscardGraphicsResources();
         }
     );
+
+    renderState.Invalidate();
     
     auto g = GetGraphicsContext();
     if (g)
@@ -907,28 +1126,14 @@ bool CommandWindow::CreateGraphicsResources()
 
     hr = d2d1->CreateHwndRenderTarget(
         D2D1::RenderTargetProperties(),
-        D2D1::HwndRenderTargetProperties(hwnd, clientPixelSize, D2D1_PRESENT_OPTIONS_IMMEDIATELY),
+        D2D1::HwndRenderTargetProperties(hwnd, clientPixelSize, D2D1_PRESENT_OPTIONS_IMMEDIATELY | D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS),
         &hwndRenderTarget);
     if (FAILED(hr))
     {
         return ShowErrorBox(hwnd, format(L"Cannot create window render target.\n\nError code was 0x%08X.", hr));
     }
 
-    HRESULT brushHr = S_OK;
-    hr = hwndRenderTarget->CreateSolidColorBrush(style->textColor, &textForegroundBrush);
-    if (FAILED(hr))  brushHr = hr;
-
-    hr = hwndRenderTarget->CreateSolidColorBrush(style->autocompletionTextColor, &autocompletionTextForegroundBrush);
-    if (FAILED(hr))  brushHr = hr;
-
-    hr = hwndRenderTarget->CreateSolidColorBrush(style->selectedTextBackgroundColor, &selectedTextBrush);
-    if (FAILED(hr))  brushHr = hr;
-
-    hr = hwndRenderTarget->CreateSolidColorBrush(style->textboxBackgroundColor, &textboxBackgroundBrush);
-    if (FAILED(hr))  brushHr = hr;
-
-    hr = brushHr;
-
+    hr = renderer.Initialize(hwndRenderTarget);
     if (FAILED(hr))
     {
         return ShowErrorBox(hwnd, format(L"Cannot create brushes.\n\nError code was 0x%08X.", hr));
@@ -939,23 +1144,26 @@ bool CommandWindow::CreateGraphicsResources()
 
 void CommandWindow::DiscardGraphicsResources()
 {
-    SafeRelease(textForegroundBrush);
-    SafeRelease(autocompletionTextForegroundBrush);
-    SafeRelease(selectedTextBrush);
-    SafeRelease(textboxBackgroundBrush);
+    rowLayouts.Clear();
+    renderer.Dispose();
     SafeRelease(textFormat);
     SafeRelease(hwndRenderTarget);
 }
 
 void CommandWindow::Dispose()
 {
+    if (commandEngine != nullptr && commandEngine->launcher != nullptr)
+        commandEngine->launcher->SetNotifyCallback(nullptr, nullptr);
+
     tray.Dispose();
     DiscardGraphicsResources();
     textEdit.Dispose();
+    textAdvances.Dispose();
     history.Dispose();
 
     if (hwnd != 0)
     {
+        StopWindowAnimation(hwnd);
         DestroyWindow(hwnd);
         hwnd = 0;
     }
@@ -981,11 +1189,27 @@ LRESULT CommandWindow::WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
         case WM_QUIT:           return this->OnQuit();
         case WM_ACTIVATE:       return this->OnActivate((uint32_t)LOWORD(wParam));
 
+        // Render target may be lost after display mode change or resume from sleep, recreate it while window is hidden.
+        case WM_DISPLAYCHANGE:
+        {
+            PrewarmGraphicsResources();
+            break;
+        }
+        case WM_POWERBROADCAST:
+        {
+            if (wParam == PBT_APMRESUMEAUTOMATIC)
+                PrewarmGraphicsResources();
+            break;
+        }
+
         case CommandWindow::g_showWindowMessageId:
         {
             ShowWindow();
             return 0;
         }
+
+        case CommandWindow::g_launchCompletedMessageId:
+            return this->OnLaunchCompleted();
     }
 
     if (msg == CommandWindow::g_taskbarCreatedMessageId && CommandWindow::g_taskbarCreatedMessageId != 0)
@@ -1000,6 +1224,9 @@ LRESULT CommandWindow::WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
             case TrayMenuAction::ReloadCommandsFile: ReloadCommandsFile(); break;
             case TrayMenuAction::OpenCommandsFile: OpenCommandsFile(); break;
             case TrayMenuAction::Exit: Exit(); break;
+#ifdef CB_TRACE
+            case TrayMenuAction::SaveTrace: SaveTrace(); break;
+#endif
             default:                 break;
         }
     }
@@ -1148,19 +1375,33 @@ Newstring GetCommandsFilePath()
 
 void CommandWindow::ReloadCommandsFile()
 {
-    // @TODO: We have a memory leak here, but who cares?
-
-    autocompletionCandidate = nullptr;
-    showPreviousCommandAutocompletion_command = nullptr;
+    TRACE_ZONE("CommandWindow::ReloadCommandsFile");
 
-    commandEngine->UnregisterAllCommands();
+    // @TODO: We have a memory leak here, but who cares?
 
+    // New set is built while previous one is still published, so readers keep working during reload.
+    CommandSet* set = Memnew(CommandSet);
     CommandLoader commandLoader;
+    commandLoader.stringPool = &set->stringPool;
     RegisterBuiltinCommands(&commandLoader);
 
     Array<Command*> commands = commandLoader.LoadFromFile(GetCommandsFilePath());
     for (uint32_t i = 0; i < commands.count; ++i)
-        commandEngine->RegisterCommand(commands.data[i]);
+    {
+        if (!commandEngine->RegisterCommand(set, commands.data[i]))
+            Memdelete(commands.data[i]);
+    }
+
+    commandEngine->PublishCommandSet(set);
+
+    // Commands of replaced set stay valid until it's reclaimed, so pointers to them are replaced by commands of new set.
+    if (showPreviousCommandAutocompletion_command != nullptr)
+        showPreviousCommandAutocompletion_command = commandEngine->FindCommandByName(showPreviousCommandAutocompletion_command->name);
+    autocompletionList.Clear();
+    rowLayouts.Clear();
+    UpdateAutocompletion(true);
+
+    commandEngine->ReclaimCommandSets();
 }
 
 void CommandWindow::OpenCommandsFile()
@@ -1182,8 +1423,77 @@ void CommandWindow::OpenCommandsFile()
     Memdelete(path.data);
 }
 
+#ifdef CB_TRACE
+void CommandWindow::SaveTrace()
+{
+    NewstringBuilder tracePath;
+    defer(tracePath.Dispose());
+
+    OSUtils::GetApplicationDirectory(&tracePath);
+    tracePath.Append(L"trace.json");
+
+    NewstringBuilder trace;
+    defer(trace.Dispose());
+
+    Trace::WriteChromeTrace(&trace);
+    if (!OSUtils::WriteAllText(tracePath.string, trace.string))
+    {
+        MessageBoxW(hwnd, L"Failed to save trace.", L"Error", MB_ICONERROR);
+    }
+}
+#endif
+
 void beforeRunCallback(CommandEngine* engine, void* userdata)
 {
     if (userdata != nullptr)
         ((CommandWindow*)userdata)->BeforeCommandRun();
 }
+
+/** Called on launcher's worker thread, wakes up UI thread to handle completed launches. */
+static void launchNotifyCallback(void* userdata)
+{
+    CommandWindow* window = static_cast<CommandWindow*>(userdata);
+    PostMessageW(window->hwnd, CommandWindow::g_launchCompletedMessageId, 0, 0);
+}
+
+static void launchCompletedCallback(LaunchRequest* request, void* userdata)
+{
+    CommandWindow* window = static_cast<CommandWindow*>(userdata);
+
+    // Message box runs its own message loop, so temporary allocator is not reset until it is closed.
+    TempAllocatorScope scope;
+    Newstring launchError;
+    if (!request->succeeded)
+    {
+        Newstring osError = OSUtils::FormatErrorCode(request->errorCode, 0, &g_tempAllocator);
+        launchError = Newstring::WrapConstWChar(Newstring::FormatTempCString(L"Unable to run application \"%s\": %.*s", request->path, osError.count, osError.data));
+    }
+
+    // Commands that follow launched command with '&&' run now.
+    if (window->commandEngine->CompleteLaunch(request, launchError))
+        return;
+
+    Newstring message = window->commandEngine->GetExecutionState()->errorMessage;
+    MessageBoxW(window->hwnd, message.CloneAsCString(&g_tempAllocator), L"Error", MB_OK | MB_ICONERROR);
+}
+
+static void* rowLayouts_createLayout(const Newstring& text, void* userdata)
+{
+    CommandWindow* window = static_cast<CommandWindow*>(userdata);
+
+    float clientWidth = static_cast<float>(window->style->windowWidth);
+    float rowHeight = window->GetRowHeight();
+
+    IDWriteTextLayout* layout = nullptr;
+    HRESULT hr = window->dwrite->CreateTextLayout(text.data, text.count, window->textFormat, clientWidth, rowHeight, &layout);
+    if (FAILED(hr))
+        return nullptr;
+
+    layout->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+    return layout;
+}
+
+static void rowLayouts_releaseLayout(void* layout, void* userdata)
+{
+    static_cast<IDWriteTextLayout*>(layout)->Release();
+}
@@ -9,9 +9,27 @@
 #include "command_window_tray.h"
 #include "text_edit.h"
 #include "command_history.h"
+#include "render_state.h"
+#include "dwrite_text_metrics.h"
+#include "d2d_renderer.h"
+#include "command_window_frame.h"
+#include "autocompletion_list.h"
+#include "text_layout_pool.h"
 
 struct CommandWindowStyle;
 
+/**
+ * Time from request to show command window (hotkey, tray menu, message from another instance) until its first
+ * frame is presented.
+ */
+struct ShowLatencyStatistics
+{
+    uint32_t showCount = 0;
+    double lastMilliseconds = 0.0;
+    double maxMilliseconds = 0.0;
+    double totalMilliseconds = 0.0;
+};
+
 struct CommandWindow
 {
 	bool Initialize(CommandEngine* engine, CommandWindowStyle* style, int nCmdShow);
@@ -20,6 +38,9 @@ struct CommandWindow
 	void HideWindow();
 	void ToggleVisibility();
 
+    /** Returns true if window is visible and is not fading out. */
+    bool IsShown() const;
+
 	void Exit();
 
 	HWND hwnd = 0;
@@ -34,13 +55,34 @@ struct CommandWindow
     bool showPreviousCommandAutocompletion = true;
     Command* showPreviousCommandAutocompletion_command = nullptr;
 
+    /**
+     * Keeps render target validated and layouts of the first frame after show built while window is hidden,
+     * so showing window doesn't wait for them.
+     */
+    bool prewarmGraphicsResources = true;
+
+    /**
+     * Recreates render target if it was lost and builds layouts that are drawn right after window is shown
+     * (empty text, previous command autocompletion), by drawing hidden window. Does nothing if window is visible
+     * or prewarmGraphicsResources is false.
+     */
+    void PrewarmGraphicsResources();
+
+    ShowLatencyStatistics showLatency;
+
     void Dispose();
 
 	static const wchar_t* g_className;
 	static const wchar_t* g_windowName;
     static const UINT g_showWindowMessageId;
+
+    /** Posted by process launcher's worker thread when application launch is completed. */
+    static const UINT g_launchCompletedMessageId;
 private:
     bool isInitialized = false;
+
+    /** Set while window fades out, it is hidden when animation completes. */
+    bool isHiding = false;
 	bool shouldCatchInvalidUsageErrors = false;
 	float showWindowYRatio = 0.4f;
 
@@ -66,6 +108,13 @@ public:
     void Redraw();
     void UpdateTextLayout(bool forced = false);
     void UpdateAutocompletionLayout();
+
+    /** Resizes window to fit text box and visible rows of autocompletion dropdown. */
+    void UpdateWindowSize();
+
+    /** Dropdown row count that window was last sized for. */
+    uint32_t windowRowCount = 0;
+
     void TextEditChanged();
     bool ShouldDrawAutocompletion() const;
     void BeforeCommandRun();
@@ -75,11 +124,25 @@ public:
     void ReloadCommandsFile();
     void OpenCommandsFile();
 
+#ifdef CB_TRACE
+    /** Writes recorded trace zones to trace.json in application directory. */
+    void SaveTrace();
+#endif
+
     TextEdit textEdit;
     CommandHistory history;
 
     Command* autocompletionCandidate = nullptr;
 
+    /** Ranked autocompletion candidates shown below text box while command name is typed. */
+    AutocompletionList autocompletionList;
+
+    /** Text layouts of dropdown rows, reused while command stays visible. */
+    TextLayoutPool rowLayouts;
+
+    /** Value of textEdit.revision after text was replaced by history entry, dropdown is hidden while it's unchanged. */
+    uint32_t historyTextRevision = 0xFFFFFFFF;
+
     /**
      * Indicates starting text position of mouse selection.
      * If currently there are no mouse selection, contains value of 0xFFFFFFFF.
@@ -91,11 +154,16 @@ public:
     ID2D1HwndRenderTarget* hwndRenderTarget = nullptr;
     IDWriteTextFormat* textFormat = nullptr;
     IDWriteTextLayout* textLayout = nullptr;
-    ID2D1SolidColorBrush* textboxBackgroundBrush = nullptr;
-    ID2D1SolidColorBrush* textForegroundBrush = nullptr;
-    ID2D1SolidColorBrush* autocompletionTextForegroundBrush = nullptr;
-    ID2D1SolidColorBrush* selectedTextBrush = nullptr;
     IDWriteTextLayout* autocompletionLayout = nullptr;
+    D2DRenderer renderer;
+
+    /** Caret positions of textLayout, used instead of hit-testing the layout. */
+    DWriteTextMetrics textMetrics;
+    GlyphAdvanceCache textAdvances;
+
+    /** Position in autocompletionLayout where typed text ends, autocompletion is drawn from there. */
+    float autocompletionOffsetX = 0.0f;
+    float autocompletionOffsetY = 0.0f;
 
     LRESULT OnChar(wchar_t c);
     LRESULT OnKeyDown(LPARAM lParam, WPARAM wParam);
@@ -106,6 +174,9 @@ public:
     LRESULT OnFocusAcquired();
     LRESULT OnFocusLost();
     LRESULT OnPaint();
+
+    /** Draws frame, returns false if render target was lost and had to be recreated. */
+    bool PaintFrame();
     LRESULT OnHotkey(LPARAM lParam, WPARAM wParam);
     LRESULT OnTimer(LPARAM lParam, WPARAM wParam);
     LRESULT OnShowWindow(LPARAM lParam, WPARAM wParam);
@@ -113,18 +184,54 @@ public:
     LRESULT OnActivate(uint32_t activateState);
 
     LRESULT OnCursorBlinkTimerElapsed();
+    LRESULT OnLaunchCompleted();
+    void OnHideAnimationCompleted();
 
     void OnTextChanged();
     void OnUserRequestedAutocompletion();
     Command* FindAutocompletionCandidate();
 
-    void UpdateAutocompletion();
+    /**
+     * Updates autocompletion candidates for current text. Does nothing if text didn't change since last update, unless
+     * forced (e.g. when commands were reloaded).
+     */
+    void UpdateAutocompletion(bool forced = false);
+
+    /** Value of textEdit.revision that autocompletion candidates were found for. */
+    uint32_t autocompletionTextRevision = 0xFFFFFFFF;
 
     bool shouldDrawCaret = true;
     void SetCaretTimer();
     void KillCaretTimer();
 
-    bool isTextLayoutDirty = false;
+    /** Tracks what changed since last drawn frame. */
+    RenderState renderState;
+
+    /** Value of textEdit.revision that textLayout was built for. */
+    uint32_t textLayoutRevision = 0;
+
+    /** X coordinate of caret line in last drawn frame. */
+    float drawnCaretX = 0.0f;
+
+    /** Performance counter value when window was requested to show, 0 when first frame was already presented. */
+    uint64_t showRequestTicks = 0;
+#ifdef CB_TRACE
+    uint64_t showRequestTimestamp = 0;
+#endif
+
+    /** Updates showLatency when first frame after show is presented. */
+    void RecordShowLatency();
+
+    RenderInputs GetRenderInputs() const;
+
+    /** Returns height of single row of autocompletion dropdown. */
+    float GetRowHeight() const;
+
+    /** Returns X coordinate of caret placed at specified text position, relative to text origin. */
+    float GetTextPositionX(uint32_t pos);
+
+    /** Returns text position nearest to specified X coordinate, relative to text origin. */
+    uint32_t HitTestTextPosition(float x);
 };
 
 /**
@@ -138,6 +245,8 @@ struct CommandWindowStyle
     D2D1_COLOR_F autocompletionTextColor = D2D1::ColorF(D2D1::ColorF::Gray);
     D2D1_COLOR_F selectedTextBackgroundColor = D2D1::ColorF(D2D1::ColorF::Aqua);
     D2D1_COLOR_F textboxBackgroundColor = D2D1::ColorF(D2D1::ColorF::White);
+    D2D1_COLOR_F dropdownBackgroundColor = D2D1::ColorF(D2D1::ColorF::White);
+    D2D1_COLOR_F selectedRowBackgroundColor = D2D1::ColorF(0xD9D9D9);
     Newstring fontFamily = Newstring::WrapConstWChar(L"Segoe UI");
     float fontHeight = 22.0f;
     DWRITE_FONT_WEIGHT fontWeight = DWRITE_FONT_WEIGHT_REGULAR;
@@ -148,4 +257,13 @@ struct CommandWindowStyle
     int textHeight = 0;
     int windowWidth = 400;
     int windowHeight = 40;
+
+    /** Maximum number of rows of autocompletion dropdown, 0 disables dropdown. */
+    int autocompletionRowCount = 8;
+
+    /** Duration of fade in when window is shown, in seconds. */
+    double showAnimationDuration = 0.05;
+
+    /** Duration of fade out when window is hidden, in seconds. */
+    double hideAnimationDuration = 0.05;
 };
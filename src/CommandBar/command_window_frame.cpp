@@ -0,0 +1,95 @@
+#include <assert.h>
+#include <math.h>
+
+#include "command_window_frame.h"
+#include "trace.h"
+
+
+float CommandWindowFrame::GetCaretLineX() const
+{
+    return floorf(borderSize + textMarginLeft + caretX) + 0.5f;
+}
+
+void CommandWindowFrame::Paint(IRenderer* renderer) const
+{
+    TRACE_ZONE("CommandWindowFrame::Paint");
+    assert(renderer);
+
+    float marginX = textMarginLeft + borderSize;
+    float caretTopY = borderSize + 3.0f;
+    float caretBottomY = textboxHeight - borderSize - 3.0f;
+    float caretLineX = GetCaretLineX();
+
+    if (isCaretOnly)
+    {
+        RenderRect caretClip = {
+            floorf(fminf(previousCaretLineX, caretLineX)) - 1.0f,
+            caretTopY - 1.0f,
+            ceilf(fmaxf(previousCaretLineX, caretLineX)) + 1.0f,
+            caretBottomY + 1.0f
+        };
+        renderer->PushClip(caretClip);
+    }
+
+    // Surface may be larger than frame, e.g. window that is being resized, so only frame area is filled.
+    RenderRect frameRect = { 0.0f, 0.0f, width, height };
+    renderer->FillRect(frameRect, borderColor);
+
+    RenderRect textboxRect = { borderSize, borderSize, width - borderSize, textboxHeight - borderSize };
+    renderer->FillRect(textboxRect, textboxBackgroundColor);
+
+    if (isTextSelected)
+    {
+        RenderRect selectionRect = { marginX + selectionStartX, borderSize, marginX + selectionEndX, textboxHeight - borderSize };
+        renderer->FillRect(selectionRect, selectedTextBackgroundColor);
+    }
+
+    float textY = borderSize;
+
+    if (hasAutocompletion)
+    {
+        // Only part of candidate name that wasn't typed yet is visible.
+        RenderRect autocompletionClip = { marginX + autocompletionOffsetX, borderSize + autocompletionOffsetY, width, textboxHeight };
+        renderer->PushClip(autocompletionClip);
+        renderer->DrawTextRun(marginX, textY, autocompletion, autocompletionTextColor);
+        renderer->PopClip();
+    }
+
+    renderer->DrawTextRun(marginX, textY, text, textColor);
+
+    if (rowCount > 0 && !isCaretOnly)
+        PaintDropdown(renderer);
+
+    if (isCaretVisible)
+        renderer->DrawLine(caretLineX, caretTopY, caretLineX, caretBottomY, textColor);
+
+    if (isCaretOnly)
+        renderer->PopClip();
+}
+
+void CommandWindowFrame::PaintDropdown(IRenderer* renderer) const
+{
+    assert(rows);
+
+    float marginX = textMarginLeft + borderSize;
+    float rowLeft = borderSize;
+    float rowRight = width - borderSize;
+
+    RenderRect dropdownRect = { rowLeft, textboxHeight, rowRight, height - borderSize };
+    renderer->FillRect(dropdownRect, dropdownBackgroundColor);
+    renderer->PushClip(dropdownRect);
+
+    for (uint32_t i = 0; i < rowCount; ++i)
+    {
+        float rowTop = textboxHeight + i * rowHeight;
+        if (i == selectedRow)
+        {
+            RenderRect rowRect = { rowLeft, rowTop, rowRight, rowTop + rowHeight };
+            renderer->FillRect(rowRect, selectedRowBackgroundColor);
+        }
+
+        renderer->DrawTextRun(marginX, rowTop, rows[i], textColor);
+    }
+
+    renderer->PopClip();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "renderer.h"
+
+
+/**
+ * Everything that is needed to draw one frame of command window, independently of window and graphics API.
+ * Text coordinates (caret, selection, autocompletion offset) are relative to text origin.
+ */
+struct CommandWindowFrame
+{
+    float width = 0.0f;
+    float height = 0.0f;
+
+    /**
+     * Height of text box part of frame, including border. Autocompletion dropdown is drawn below it.
+     */
+    float textboxHeight = 0.0f;
+    float borderSize = 0.0f;
+    float textMarginLeft = 0.0f;
+
+    RenderColor borderColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+    RenderColor textboxBackgroundColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+    RenderColor selectedTextBackgroundColor = { 0.0f, 1.0f, 1.0f, 1.0f };
+    RenderColor textColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+    RenderColor autocompletionTextColor = { 0.5f, 0.5f, 0.5f, 1.0f };
+    RenderColor dropdownBackgroundColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+    RenderColor selectedRowBackgroundColor = { 0.85f, 0.85f, 0.85f, 1.0f };
+
+    RenderTextRun text;
+
+    /**
+     * Typed text followed by rest of autocompletion candidate name. Part after autocompletionOffsetX is drawn.
+     */
+    RenderTextRun autocompletion;
+    bool hasAutocompletion = false;
+    float autocompletionOffsetX = 0.0f;
+    float autocompletionOffsetY = 0.0f;
+
+    /**
+     * Visible rows of autocompletion dropdown, only these are drawn.
+     */
+    const RenderTextRun* rows = nullptr;
+    uint32_t rowCount = 0;
+    float rowHeight = 0.0f;
+
+    /** Index of highlighted row, or 0xFFFFFFFF if no row is highlighted. */
+    uint32_t selectedRow = 0xFFFFFFFF;
+
+    bool isCaretVisible = false;
+    float caretX = 0.0f;
+
+    bool isTextSelected = false;
+    float selectionStartX = 0.0f;
+    float selectionEndX = 0.0f;
+
+    /**
+     * If true, only area of previous and current caret is redrawn. Renderer must retain contents of previous frame.
+     */
+    bool isCaretOnly = false;
+
+    /**
+     * Value of GetCaretLineX() of previous frame.
+     */
+    float previousCaretLineX = 0.0f;
+
+    /**
+     * Returns X coordinate of caret line in window, centered at pixel center to disable anti-aliasing.
+     */
+    float GetCaretLineX() const;
+
+    /**
+     * Draws frame using specified renderer. Doesn't call BeginFrame() or EndFrame().
+     */
+    void Paint(IRenderer* renderer) const;
+private:
+    void PaintDropdown(IRenderer* renderer) const;
+};
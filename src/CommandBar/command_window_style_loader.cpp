@@ -1,10 +1,114 @@
 #include "command_window_style_loader.h"
 #include "parse_ini.h"
+#include "parse_utils.h"
 #include "os_utils.h"
-#include "string_utils.h"
 #include "newstring.h"
 
 
+static bool loadInt(const Newstring& value, int minValue, int maxValue, int* result)
+{
+    int32_t parsed;
+    ParseResult parseResult = ParseUtils::ParseInt32(value, &parsed);
+    if (!parseResult.IsComplete(value) || parsed < minValue || parsed > maxValue)
+        return false;
+
+    *result = parsed;
+    return true;
+}
+
+static bool loadFloat(const Newstring& value, float minValue, float maxValue, float* result)
+{
+    float parsed;
+    ParseResult parseResult = ParseUtils::ParseFloat(value, &parsed);
+    if (!parseResult.IsComplete(value) || parsed < minValue || parsed > maxValue)
+        return false;
+
+    *result = parsed;
+    return true;
+}
+
+static bool loadDuration(const Newstring& value, double* result)
+{
+    double seconds;
+    if (!ParseUtils::ParseDuration(value, &seconds).IsComplete(value) || seconds > 10.0)
+        return false;
+
+    *result = seconds;
+    return true;
+}
+
+static bool loadColor(const Newstring& value, D2D1_COLOR_F* result)
+{
+    uint32_t rgba;
+    if (!ParseUtils::ParseColor(value, &rgba).IsComplete(value))
+        return false;
+
+    *result = D2D1::ColorF(
+        ((rgba >> 24) & 0xFF) / 255.0f,
+        ((rgba >> 16) & 0xFF) / 255.0f,
+        ((rgba >> 8) & 0xFF) / 255.0f,
+        (rgba & 0xFF) / 255.0f);
+    return true;
+}
+
+static bool loadColorRef(const Newstring& value, COLORREF* result)
+{
+    uint32_t rgba;
+    if (!ParseUtils::ParseColor(value, &rgba).IsComplete(value))
+        return false;
+
+    // COLORREF has no alpha.
+    *result = RGB((rgba >> 24) & 0xFF, (rgba >> 16) & 0xFF, (rgba >> 8) & 0xFF);
+    return true;
+}
+
+/** Loads font weight as number from 1 to 999 or as one of common names. */
+static bool loadFontWeight(const Newstring& value, DWRITE_FONT_WEIGHT* result)
+{
+    if (value.Equals(L"normal", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_WEIGHT_NORMAL;
+    else if (value.Equals(L"light", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_WEIGHT_LIGHT;
+    else if (value.Equals(L"semibold", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_WEIGHT_SEMI_BOLD;
+    else if (value.Equals(L"bold", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_WEIGHT_BOLD;
+    else
+    {
+        int weight;
+        if (!loadInt(value, 1, 999, &weight))
+            return false;
+        *result = static_cast<DWRITE_FONT_WEIGHT>(weight);
+    }
+
+    return true;
+}
+
+static bool loadFontStyle(const Newstring& value, DWRITE_FONT_STYLE* result)
+{
+    if (value.Equals(L"normal", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_STYLE_NORMAL;
+    else if (value.Equals(L"oblique", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_STYLE_OBLIQUE;
+    else if (value.Equals(L"italic", StringComparison::CaseInsensitive))
+        *result = DWRITE_FONT_STYLE_ITALIC;
+    else
+        return false;
+
+    return true;
+}
+
+/** Loads font stretch as number from 1 (ultra condensed) to 9 (ultra expanded), 5 is normal. */
+static bool loadFontStretch(const Newstring& value, DWRITE_FONT_STRETCH* result)
+{
+    int stretch;
+    if (!loadInt(value, DWRITE_FONT_STRETCH_ULTRA_CONDENSED, DWRITE_FONT_STRETCH_ULTRA_EXPANDED, &stretch))
+        return false;
+
+    *result = static_cast<DWRITE_FONT_STRETCH>(stretch);
+    return true;
+}
+
 bool CommandWindowStyleLoader::LoadFromFile(const Newstring& filePath, CommandWindowStyle* style)
 {
     if (Newstring::IsNullOrEmpty(filePath) || style == nullptr)
@@ -23,18 +127,61 @@ bool CommandWindowStyleLoader::LoadFromFile(const Newstring& filePath, CommandWi
         {
             case INIValueType::KeyValuePair:
             {
-                if (p.key == L"border_size")
-                {
-                    int borderSize;
-                    if (!StringUtils::ParseInt32(p.value, &borderSize, 0))
-                        return false;
-                    style->borderSize = borderSize;
-                }
+                const Newstring& value = p.value;
+                bool ok = true;
+
+                if (p.key == L"margin_color")
+                    ok = loadColorRef(value, &style->marginColor);
+                else if (p.key == L"border_color")
+                    ok = loadColor(value, &style->borderColor);
+                else if (p.key == L"text_color")
+                    ok = loadColor(value, &style->textColor);
+                else if (p.key == L"autocompletion_text_color")
+                    ok = loadColor(value, &style->autocompletionTextColor);
+                else if (p.key == L"selected_text_background_color")
+                    ok = loadColor(value, &style->selectedTextBackgroundColor);
+                else if (p.key == L"textbox_background_color")
+                    ok = loadColor(value, &style->textboxBackgroundColor);
+                else if (p.key == L"dropdown_background_color")
+                    ok = loadColor(value, &style->dropdownBackgroundColor);
+                else if (p.key == L"selected_row_background_color")
+                    ok = loadColor(value, &style->selectedRowBackgroundColor);
                 else if (p.key == L"font_family")
                 {
-                    fontFamily.Dispose();
-                    style->fontFamily = fontFamily = p.value.Clone();
+                    ok = !Newstring::IsNullOrEmpty(value);
+                    if (ok)
+                    {
+                        fontFamily.Dispose();
+                        style->fontFamily = fontFamily = value.Clone();
+                    }
                 }
+                else if (p.key == L"font_height")
+                    ok = loadFloat(value, 1.0f, 500.0f, &style->fontHeight);
+                else if (p.key == L"font_weight")
+                    ok = loadFontWeight(value, &style->fontWeight);
+                else if (p.key == L"font_style")
+                    ok = loadFontStyle(value, &style->fontStyle);
+                else if (p.key == L"font_stretch")
+                    ok = loadFontStretch(value, &style->fontStretch);
+                else if (p.key == L"text_margin_left")
+                    ok = loadFloat(value, 0.0f, 1000.0f, &style->textMarginLeft);
+                else if (p.key == L"border_size")
+                    ok = loadInt(value, 0, 1000, &style->borderSize);
+                else if (p.key == L"text_height")
+                    ok = loadInt(value, 0, 1000, &style->textHeight);
+                else if (p.key == L"window_width")
+                    ok = loadInt(value, 1, 10000, &style->windowWidth);
+                else if (p.key == L"window_height")
+                    ok = loadInt(value, 1, 10000, &style->windowHeight);
+                else if (p.key == L"autocompletion_rows")
+                    ok = loadInt(value, 0, 100, &style->autocompletionRowCount);
+                else if (p.key == L"show_animation_duration")
+                    ok = loadDuration(value, &style->showAnimationDuration);
+                else if (p.key == L"hide_animation_duration")
+                    ok = loadDuration(value, &style->hideAnimationDuration);
+
+                if (!ok)
+                    return false;
             }
         }
     }
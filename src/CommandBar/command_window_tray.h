@@ -11,6 +11,7 @@ enum class TrayMenuAction
     ReloadCommandsFile = 2,
     Exit = 3,
     OpenCommandsFile = 4,
+    SaveTrace = 5,
 };
 
 struct CommandWindowTray
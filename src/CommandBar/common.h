@@ -1,6 +1,41 @@
 #pragma once
 #include <stdint.h>
+
+#ifdef _WIN32
 #include <Windows.h>
+#else
+// Small subset of Win32 definitions used by platform-independent code (allocators, strings, text editing,
+// command engine), so it can be compiled into the headless benchmark on other platforms.
+#include <signal.h>
+#include <malloc.h>
+#include <wchar.h>
+#include <errno.h>
+
+#define __forceinline inline __attribute__((always_inline))
+#define __debugbreak() raise(SIGTRAP)
+#define _msize malloc_usable_size
+#define _wcsnicmp wcsncasecmp
+
+typedef uint32_t DWORD;
+
+enum
+{
+    NO_ERROR = 0,
+    ERROR_OUTOFMEMORY = 14,
+    ERROR_INVALID_PARAMETER = 87,
+    ERROR_CANCELLED = 1223,
+};
+
+inline void SetLastError(DWORD error) { errno = (int)error; }
+inline DWORD GetLastError() { return (DWORD)errno; }
+
+inline int wmemcpy_s(wchar_t* dest, size_t destCount, const wchar_t* source, size_t count)
+{
+    if (count > destCount)  return ERANGE;
+    wmemcpy(dest, source, count);
+    return 0;
+}
+#endif
 
 template<typename T>
 void SafeRelease(T*& com_ptr)
@@ -11,4 +46,3 @@ void SafeRelease(T*& com_ptr)
         com_ptr = nullptr;
     }
 }
-
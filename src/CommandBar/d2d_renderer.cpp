@@ -0,0 +1,79 @@
+#include <assert.h>
+
+#include "d2d_renderer.h"
+#include "common.h"
+
+
+static D2D1_COLOR_F toColor(const RenderColor& color)
+{
+    return D2D1::ColorF(color.r, color.g, color.b, color.a);
+}
+
+static D2D1_RECT_F toRect(const RenderRect& rect)
+{
+    return D2D1::RectF(rect.left, rect.top, rect.right, rect.bottom);
+}
+
+HRESULT D2DRenderer::Initialize(ID2D1RenderTarget* target)
+{
+    assert(target);
+
+    this->target = target;
+    return target->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), &brush);
+}
+
+void D2DRenderer::Dispose()
+{
+    SafeRelease(brush);
+    target = nullptr;
+}
+
+ID2D1SolidColorBrush* D2DRenderer::GetBrush(const RenderColor& color)
+{
+    brush->SetColor(toColor(color));
+    return brush;
+}
+
+void D2DRenderer::BeginFrame()
+{
+    target->BeginDraw();
+}
+
+bool D2DRenderer::EndFrame()
+{
+    return target->EndDraw() != D2DERR_RECREATE_TARGET;
+}
+
+void D2DRenderer::Clear(const RenderColor& color)
+{
+    target->Clear(toColor(color));
+}
+
+void D2DRenderer::FillRect(const RenderRect& rect, const RenderColor& color)
+{
+    target->FillRectangle(toRect(rect), GetBrush(color));
+}
+
+void D2DRenderer::DrawLine(float x0, float y0, float x1, float y1, const RenderColor& color)
+{
+    target->DrawLine(D2D1::Point2F(x0, y0), D2D1::Point2F(x1, y1), GetBrush(color));
+}
+
+void D2DRenderer::DrawTextRun(float x, float y, const RenderTextRun& run, const RenderColor& color)
+{
+    IDWriteTextLayout* layout = static_cast<IDWriteTextLayout*>(run.layout);
+    if (layout == nullptr)
+        return;
+
+    target->DrawTextLayout(D2D1::Point2F(x, y), layout, GetBrush(color), D2D1_DRAW_TEXT_OPTIONS_CLIP);
+}
+
+void D2DRenderer::PushClip(const RenderRect& rect)
+{
+    target->PushAxisAlignedClip(toRect(rect), D2D1_ANTIALIAS_MODE_ALIASED);
+}
+
+void D2DRenderer::PopClip()
+{
+    target->PopAxisAlignedClip();
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <d2d1.h>
+#include <dwrite.h>
+
+#include "renderer.h"
+
+
+/**
+ * Renderer that draws with Direct2D render target. Text runs must have IDWriteTextLayout as layout.
+ */
+struct D2DRenderer : public IRenderer
+{
+    /**
+     * Render target to draw on. Target is not owned by this instance.
+     */
+    ID2D1RenderTarget* target = nullptr;
+
+    /**
+     * Creates brush for specified render target.
+     */
+    HRESULT Initialize(ID2D1RenderTarget* target);
+    void Dispose();
+
+    virtual void BeginFrame() override;
+    virtual bool EndFrame() override;
+    virtual void Clear(const RenderColor& color) override;
+    virtual void FillRect(const RenderRect& rect, const RenderColor& color) override;
+    virtual void DrawLine(float x0, float y0, float x1, float y1, const RenderColor& color) override;
+    virtual void DrawTextRun(float x, float y, const RenderTextRun& run, const RenderColor& color) override;
+    virtual void PushClip(const RenderRect& rect) override;
+    virtual void PopClip() override;
+private:
+    /** Single brush which color is changed before every drawing operation. */
+    ID2D1SolidColorBrush* brush = nullptr;
+
+    ID2D1SolidColorBrush* GetBrush(const RenderColor& color);
+};
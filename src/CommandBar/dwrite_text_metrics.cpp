@@ -0,0 +1,40 @@
+#include <assert.h>
+
+#include "dwrite_text_metrics.h"
+#include "allocators.h"
+
+
+bool DWriteTextMetrics::GetAdvances(const Newstring& text, float* advances)
+{
+    assert(layout);
+    assert(advances || text.count == 0);
+
+    UINT32 clusterCount = 0;
+    HRESULT hr = layout->GetClusterMetrics(nullptr, 0, &clusterCount);
+    if (FAILED(hr) && hr != E_NOT_SUFFICIENT_BUFFER)
+        return false;
+
+    DWRITE_CLUSTER_METRICS* clusters = static_cast<DWRITE_CLUSTER_METRICS*>(
+        g_tempAllocator.Allocate(sizeof(DWRITE_CLUSTER_METRICS) * clusterCount));
+    if (clusters == nullptr && clusterCount > 0)
+        return false;
+
+    hr = layout->GetClusterMetrics(clusters, clusterCount, &clusterCount);
+    if (FAILED(hr))
+        return false;
+
+    uint32_t index = 0;
+    for (UINT32 i = 0; i < clusterCount; ++i)
+    {
+        const DWRITE_CLUSTER_METRICS& cluster = clusters[i];
+        if (cluster.length == 0 || index + cluster.length > text.count)
+            return false;
+
+        // Width of cluster goes to its last code unit, so caret never lands inside of cluster.
+        for (uint32_t k = 0; k + 1 < cluster.length; ++k)
+            advances[index++] = 0.0f;
+        advances[index++] = cluster.width;
+    }
+
+    return index == text.count;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <dwrite.h>
+
+#include "text_metrics.h"
+
+
+/**
+ * Measures text using cluster metrics of DirectWrite text layout.
+ */
+struct DWriteTextMetrics : public ITextMetrics
+{
+    /**
+     * Layout of text that is measured. Layout is not owned by this instance.
+     */
+    IDWriteTextLayout* layout = nullptr;
+
+    virtual bool GetAdvances(const Newstring& text, float* advances) override;
+};
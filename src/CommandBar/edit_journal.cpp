@@ -0,0 +1,276 @@
+#include <assert.h>
+
+#include "edit_journal.h"
+
+
+static_assert((EditJournal::MaxEntries & (EditJournal::MaxEntries - 1)) == 0, "MaxEntries must be power of two.");
+static_assert((EditJournal::TextCapacity & (EditJournal::TextCapacity - 1)) == 0, "TextCapacity must be power of two.");
+
+static bool isWordSeparator(wchar_t c)
+{
+    return c == L' ' || c == L'\t';
+}
+
+bool EditJournal::Initialize(IAllocator* allocator)
+{
+    assert(allocator);
+    assert(entries == nullptr && text == nullptr);
+
+    this->allocator = allocator;
+    entries = static_cast<Entry*>(allocator->Allocate(sizeof(Entry) * MaxEntries));
+    text = static_cast<wchar_t*>(allocator->Allocate(sizeof(wchar_t) * TextCapacity));
+
+    if (entries == nullptr || text == nullptr)
+    {
+        Dispose();
+        return false;
+    }
+
+    Clear();
+    return true;
+}
+
+EditJournal::Entry& EditJournal::GetEntry(uint32_t sequence) const
+{
+    return entries[sequence & (MaxEntries - 1)];
+}
+
+void EditJournal::AppendText(wchar_t c)
+{
+    text[textEnd & (TextCapacity - 1)] = c;
+    ++textEnd;
+}
+
+bool EditJournal::ReserveText(uint32_t count, uint32_t keepEntry)
+{
+    if (count > TextCapacity)
+        return false;
+
+    // Forget oldest entries until there is enough space, but never the entry that is being coalesced into.
+    while (TextCapacity - (textEnd - textStart) < count)
+    {
+        if (firstEntry == keepEntry || firstEntry == lastEntry)
+            return false;
+
+        ++firstEntry;
+        textStart = firstEntry == lastEntry ? textEnd : GetEntry(firstEntry).textOffset;
+    }
+
+    return true;
+}
+
+bool EditJournal::TryCoalesce(EditKind kind, const GapBuffer& buffer, uint32_t position, uint32_t removeCount, const Newstring& inserted)
+{
+    if (isLastEntrySealed || currentEntry != lastEntry || firstEntry == lastEntry)
+        return false;
+
+    uint32_t last = lastEntry - 1;
+    Entry& entry = GetEntry(last);
+    if (entry.kind != kind)
+        return false;
+
+    switch (kind)
+    {
+        case EditKind::Type:
+        {
+            if (removeCount != 0 || inserted.count != 1 || position != entry.position + entry.insertedCount)
+                return false;
+
+            // Typing space after word starts new entry, so words are undone one by one.
+            wchar_t prev = text[(textEnd - 1) & (TextCapacity - 1)];
+            if (entry.insertedCount > 0 && isWordSeparator(inserted.data[0]) && !isWordSeparator(prev))
+                return false;
+
+            if (!ReserveText(1, last))
+                return false;
+
+            AppendText(inserted.data[0]);
+            ++entry.insertedCount;
+            return true;
+        }
+
+        case EditKind::Backspace:
+        {
+            if (removeCount != 1 || inserted.count != 0 || position + 1 != entry.position)
+                return false;
+
+            if (!ReserveText(1, last))
+                return false;
+
+            // Characters are stored in order they were removed, i.e. reversed.
+            AppendText(buffer.At(position));
+            ++entry.removedCount;
+            entry.position = position;
+            return true;
+        }
+
+        case EditKind::Delete:
+        {
+            if (removeCount != 1 || inserted.count != 0 || position != entry.position)
+                return false;
+
+            if (!ReserveText(1, last))
+                return false;
+
+            AppendText(buffer.At(position));
+            ++entry.removedCount;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+void EditJournal::Record(EditKind kind, const GapBuffer& buffer, uint32_t position, uint32_t removeCount, const Newstring& inserted,
+                         uint32_t caretBefore, uint32_t selectionBefore)
+{
+    if (entries == nullptr)
+        return;
+
+    uint32_t textCount = buffer.GetCount();
+    if (position > textCount)
+        position = textCount;
+    if (removeCount > textCount - position)
+        removeCount = textCount - position;
+
+    if (removeCount == 0 && inserted.count == 0)
+        return;
+
+    // New edit makes undone entries unreachable.
+    if (currentEntry != lastEntry)
+    {
+        textEnd = GetEntry(currentEntry).textOffset;
+        lastEntry = currentEntry;
+        isLastEntrySealed = true;
+    }
+
+    if (TryCoalesce(kind, buffer, position, removeCount, inserted))
+        return;
+
+    if (lastEntry - firstEntry == MaxEntries)
+    {
+        ++firstEntry;
+        textStart = GetEntry(firstEntry).textOffset;
+    }
+
+    // Edit that doesn't fit into the journal can't be undone, and neither can edits before it.
+    if (!ReserveText(removeCount + inserted.count, lastEntry))
+    {
+        Clear();
+        return;
+    }
+
+    Entry& entry = GetEntry(lastEntry);
+    entry.textOffset = textEnd;
+    entry.position = position;
+    entry.removedCount = removeCount;
+    entry.insertedCount = inserted.count;
+    entry.caretBefore = caretBefore;
+    entry.selectionBefore = selectionBefore;
+    entry.kind = kind;
+
+    for (uint32_t i = 0; i < removeCount; ++i)
+        AppendText(buffer.At(position + i));
+    for (uint32_t i = 0; i < inserted.count; ++i)
+        AppendText(inserted.data[i]);
+
+    currentEntry = ++lastEntry;
+    isLastEntrySealed = kind == EditKind::Paste || kind == EditKind::Replace;
+}
+
+void EditJournal::Seal()
+{
+    isLastEntrySealed = true;
+}
+
+bool EditJournal::CanUndo() const
+{
+    return currentEntry != firstEntry;
+}
+
+bool EditJournal::CanRedo() const
+{
+    return currentEntry != lastEntry;
+}
+
+void EditJournal::InsertText(GapBuffer* buffer, uint32_t position, uint32_t offset, uint32_t count, bool isReversed) const
+{
+    if (isReversed)
+    {
+        // Each character was removed before the previous one, so inserting them in removal order
+        // at the same position restores original order.
+        for (uint32_t i = 0; i < count; ++i)
+            buffer->Insert(position, text[(offset + i) & (TextCapacity - 1)]);
+        return;
+    }
+
+    // Text may wrap around the end of the ring.
+    uint32_t start = offset & (TextCapacity - 1);
+    uint32_t firstCount = TextCapacity - start < count ? TextCapacity - start : count;
+
+    buffer->Insert(position, Newstring(text + start, firstCount));
+    if (firstCount < count)
+        buffer->Insert(position + firstCount, Newstring(text, count - firstCount));
+}
+
+bool EditJournal::Undo(GapBuffer* buffer, uint32_t* caretPos, uint32_t* selectionStartPos)
+{
+    assert(buffer);
+    assert(caretPos);
+    assert(selectionStartPos);
+
+    if (!CanUndo())
+        return false;
+
+    const Entry& entry = GetEntry(--currentEntry);
+    buffer->Remove(entry.position, entry.insertedCount);
+    InsertText(buffer, entry.position, entry.textOffset, entry.removedCount, entry.kind == EditKind::Backspace);
+
+    *caretPos = entry.caretBefore;
+    *selectionStartPos = entry.selectionBefore;
+    isLastEntrySealed = true;
+
+    return true;
+}
+
+bool EditJournal::Redo(GapBuffer* buffer, uint32_t* caretPos)
+{
+    assert(buffer);
+    assert(caretPos);
+
+    if (!CanRedo())
+        return false;
+
+    const Entry& entry = GetEntry(currentEntry++);
+    buffer->Remove(entry.position, entry.removedCount);
+    InsertText(buffer, entry.position, entry.textOffset + entry.removedCount, entry.insertedCount, false);
+
+    *caretPos = entry.position + entry.insertedCount;
+    isLastEntrySealed = true;
+
+    return true;
+}
+
+void EditJournal::Clear()
+{
+    firstEntry = 0;
+    currentEntry = 0;
+    lastEntry = 0;
+    textStart = 0;
+    textEnd = 0;
+    isLastEntrySealed = true;
+}
+
+void EditJournal::Dispose()
+{
+    if (allocator)
+    {
+        allocator->Deallocate(entries);
+        allocator->Deallocate(text);
+    }
+
+    entries = nullptr;
+    text = nullptr;
+    Clear();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <stdint.h>
+
+#include "gap_buffer.h"
+
+
+/**
+ * Kind of text edit recorded in EditJournal.
+ */
+enum class EditKind : uint8_t
+{
+    /** Typed characters. Consecutive typing within one word is coalesced into one entry. */
+    Type = 0,
+
+    /** Characters removed before caret. Consecutive removals are coalesced into one entry. */
+    Backspace,
+
+    /** Characters removed after caret. Consecutive removals are coalesced into one entry. */
+    Delete,
+
+    /** Pasted text. */
+    Paste,
+
+    /** Selection or whole text replaced with other text. */
+    Replace
+};
+
+/**
+ * Records text edits as operations (position, removed text, inserted text) so they can be undone and redone.
+ *
+ * Entries and their text are stored in two rings of fixed size which are allocated once, so memory use stays
+ * constant: when rings are full, oldest entries are forgotten. Undo and redo only touch text of the edit itself.
+ */
+struct EditJournal
+{
+    /** Maximum number of entries that can be undone. Must be power of two. */
+    enum { MaxEntries = 256 };
+
+    /** Maximum number of removed and inserted characters of all entries. Must be power of two. */
+    enum { TextCapacity = 8192 };
+
+    struct Entry
+    {
+        /** Offset of entry text in text ring: removed characters followed by inserted characters. */
+        uint32_t textOffset;
+        uint32_t position;
+        uint32_t removedCount;
+        uint32_t insertedCount;
+
+        /** Caret and selection before edit, restored by undo. */
+        uint32_t caretBefore;
+        uint32_t selectionBefore;
+
+        EditKind kind;
+    };
+
+    /**
+     * Allocates entry and text rings.
+     */
+    bool Initialize(IAllocator* allocator = &g_standardAllocator);
+
+    /**
+     * Records edit that is about to be applied to buffer: removal of specified amount of characters at specified
+     * position and insertion of specified text there. Must be called before buffer is modified.
+     * If edit is too big to fit into journal, journal is cleared.
+     */
+    void Record(EditKind kind, const GapBuffer& buffer, uint32_t position, uint32_t removeCount, const Newstring& inserted,
+                uint32_t caretBefore, uint32_t selectionBefore);
+
+    /**
+     * Prevents next edit from being coalesced with last recorded one. Called when caret is moved.
+     */
+    void Seal();
+
+    bool CanUndo() const;
+    bool CanRedo() const;
+
+    /**
+     * Reverts last applied edit in buffer and returns caret and selection that were before edit.
+     * Returns false if there is nothing to undo.
+     */
+    bool Undo(GapBuffer* buffer, uint32_t* caretPos, uint32_t* selectionStartPos);
+
+    /**
+     * Applies last undone edit to buffer again and returns caret position after edit.
+     * Returns false if there is nothing to redo.
+     */
+    bool Redo(GapBuffer* buffer, uint32_t* caretPos);
+
+    /**
+     * Forgets all entries.
+     */
+    void Clear();
+
+    /**
+     * Deallocates rings.
+     */
+    void Dispose();
+private:
+    Entry* entries = nullptr;
+    wchar_t* text = nullptr;
+    IAllocator* allocator = nullptr;
+
+    /** Sequence numbers of first remembered entry, first undone entry and end of entries. */
+    uint32_t firstEntry = 0;
+    uint32_t currentEntry = 0;
+    uint32_t lastEntry = 0;
+
+    /** Offsets of first and past-the-last character in text ring. */
+    uint32_t textStart = 0;
+    uint32_t textEnd = 0;
+
+    bool isLastEntrySealed = true;
+
+    Entry& GetEntry(uint32_t sequence) const;
+    bool TryCoalesce(EditKind kind, const GapBuffer& buffer, uint32_t position, uint32_t removeCount, const Newstring& inserted);
+    bool ReserveText(uint32_t count, uint32_t keepEntry);
+    void AppendText(wchar_t c);
+    void InsertText(GapBuffer* buffer, uint32_t position, uint32_t offset, uint32_t count, bool isReversed) const;
+};
@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <string.h>
+
+#include "gap_buffer.h"
+
+
+Newstring GapBuffer::GetText()
+{
+    uint32_t count = GetCount();
+    MoveGap(count);
+
+    // Gap is never empty after data is allocated, so text can be zero-terminated for free.
+    if (data != nullptr)
+        data[count] = L'\0';
+
+    return Newstring(data, count);
+}
+
+void GapBuffer::GetSpans(Newstring* before, Newstring* after) const
+{
+    assert(before);
+    assert(after);
+
+    *before = Newstring(data, gapStart);
+    *after = Newstring(data ? data + gapEnd : nullptr, capacity - gapEnd);
+}
+
+bool GapBuffer::Insert(uint32_t pos, wchar_t c)
+{
+    if (!ReserveGap(1))
+        return false;
+
+    uint32_t count = GetCount();
+    MoveGap(pos < count ? pos : count);
+    data[gapStart++] = c;
+
+    return true;
+}
+
+bool GapBuffer::Insert(uint32_t pos, const Newstring& string)
+{
+    if (Newstring::IsNullOrEmpty(string))
+        return true;
+
+    if (!ReserveGap(string.count))
+        return false;
+
+    uint32_t count = GetCount();
+    MoveGap(pos < count ? pos : count);
+    memcpy(data + gapStart, string.data, string.count * sizeof(wchar_t));
+    gapStart += string.count;
+
+    return true;
+}
+
+void GapBuffer::Remove(uint32_t pos, uint32_t count)
+{
+    uint32_t textCount = GetCount();
+    if (pos >= textCount || count == 0)
+        return;
+
+    if (count > textCount - pos)
+        count = textCount - pos;
+
+    // Removed characters become part of the gap.
+    if (pos + count == gapStart)
+    {
+        gapStart -= count;
+    }
+    else
+    {
+        MoveGap(pos);
+        gapEnd += count;
+    }
+}
+
+bool GapBuffer::SetText(const Newstring& text)
+{
+    Clear();
+    return Insert(0, text);
+}
+
+void GapBuffer::Clear()
+{
+    gapStart = 0;
+    gapEnd = capacity;
+}
+
+bool GapBuffer::Reserve(uint32_t newCapacity)
+{
+    if (newCapacity <= capacity)
+        return true;
+
+    uint32_t afterGapCount = capacity - gapEnd;
+
+    wchar_t* newData = static_cast<wchar_t*>(allocator->Reallocate(data, newCapacity * sizeof(wchar_t)));
+    if (newData == nullptr)
+        return false;
+
+    // Keep text after the gap at the end of data.
+    uint32_t newGapEnd = newCapacity - afterGapCount;
+    if (afterGapCount > 0)
+        memmove(newData + newGapEnd, newData + gapEnd, afterGapCount * sizeof(wchar_t));
+
+    data = newData;
+    gapEnd = newGapEnd;
+    capacity = newCapacity;
+
+    return true;
+}
+
+void GapBuffer::Dispose()
+{
+    allocator->Deallocate(data);
+    data = nullptr;
+    capacity = 0;
+    gapStart = 0;
+    gapEnd = 0;
+}
+
+void GapBuffer::MoveGap(uint32_t pos)
+{
+    assert(pos <= GetCount());
+    if (pos == gapStart)
+        return;
+
+    uint32_t gapSize = gapEnd - gapStart;
+    if (pos < gapStart)
+    {
+        // Move characters between pos and gap to the end of gap.
+        uint32_t moveCount = gapStart - pos;
+        memmove(data + gapEnd - moveCount, data + pos, moveCount * sizeof(wchar_t));
+    }
+    else
+    {
+        // Move characters between gap and pos to the start of gap.
+        uint32_t moveCount = pos - gapStart;
+        memmove(data + gapStart, data + gapEnd, moveCount * sizeof(wchar_t));
+    }
+
+    gapStart = pos;
+    gapEnd = pos + gapSize;
+}
+
+bool GapBuffer::ReserveGap(uint32_t count)
+{
+    // Keep at least one character of gap, so GetText() can zero-terminate text.
+    if (gapEnd - gapStart > count)
+        return true;
+
+    uint32_t required = GetCount() + count + 1;
+    uint32_t newCapacity = capacity < 16 ? 16 : capacity;
+    while (newCapacity < required)
+        newCapacity *= 2;
+
+    return Reserve(newCapacity);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "newstring.h"
+
+
+/**
+ * Text storage with a gap of unused characters at the last edit position.
+ *
+ * Text before the gap is stored at the start of the data, text after the gap is stored at the end of the data.
+ * Inserting or removing characters at the gap position doesn't move other characters, and moving the gap
+ * costs as much as the distance it moves, so editing near the caret is O(1) amortised regardless of text length.
+ */
+struct GapBuffer
+{
+    /**
+     * Characters before and after the gap.
+     */
+    wchar_t* data = nullptr;
+
+    /**
+     * Number of characters that data can hold, including the gap.
+     */
+    uint32_t capacity = 0;
+
+    /**
+     * Index of first character of the gap.
+     */
+    uint32_t gapStart = 0;
+
+    /**
+     * Index of first character after the gap.
+     */
+    uint32_t gapEnd = 0;
+
+    /**
+     * Allocator that is used to allocate data.
+     */
+    IAllocator* allocator = &g_standardAllocator;
+
+    /**
+     * Returns number of characters in the text.
+     */
+    inline uint32_t GetCount() const
+    {
+        return capacity - (gapEnd - gapStart);
+    }
+
+    /**
+     * Returns character at specified index. Index must be less than GetCount().
+     */
+    inline wchar_t At(uint32_t index) const
+    {
+        return index < gapStart ? data[index] : data[index + (gapEnd - gapStart)];
+    }
+
+    /**
+     * Returns text as contiguous string. Moves the gap to the end of the text, so it's cheap when
+     * text is edited at the end. Returned string is valid until next modification.
+     */
+    Newstring GetText();
+
+    /**
+     * Returns text before and after the gap without moving it.
+     */
+    void GetSpans(Newstring* before, Newstring* after) const;
+
+    /**
+     * Inserts character at specified position. If position is out of range, character is appended.
+     * If failed to reserve storage, then does nothing and returns false.
+     */
+    bool Insert(uint32_t pos, wchar_t c);
+
+    /**
+     * Inserts string at specified position. If position is out of range, string is appended.
+     * If failed to reserve storage, then does nothing and returns false.
+     */
+    bool Insert(uint32_t pos, const Newstring& string);
+
+    /**
+     * Removes specified amount of characters starting at specified position.
+     * If position is out of range, then does nothing. Count is clamped to end of the text.
+     */
+    void Remove(uint32_t pos, uint32_t count);
+
+    /**
+     * Replaces text with specified string.
+     */
+    bool SetText(const Newstring& text);
+
+    /**
+     * Removes all text without deallocating data.
+     */
+    void Clear();
+
+    /**
+     * Reserves storage for specified amount of characters.
+     */
+    bool Reserve(uint32_t newCapacity);
+
+    /**
+     * Deallocates data.
+     */
+    void Dispose();
+private:
+    void MoveGap(uint32_t pos);
+    bool ReserveGap(uint32_t count);
+};
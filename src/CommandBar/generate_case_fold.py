@@ -0,0 +1,135 @@
+"""
+Generates unicode_case_fold.h, two-level full case folding table used by Unicode::FoldCase.
+
+Folding is taken from Python's str.casefold(), which implements full case folding (C + F mappings of
+CaseFolding.txt), so Unicode version of the table is the one of Python that runs this script.
+
+Usage: python3 generate_case_fold.py > unicode_case_fold.h
+"""
+import sys
+import unicodedata
+
+BLOCK_SHIFT = 7
+BLOCK_SIZE = 1 << BLOCK_SHIFT
+
+
+def is_surrogate(codepoint):
+    return 0xD800 <= codepoint <= 0xDFFF
+
+
+def collect_foldings():
+    foldings = {}
+    for codepoint in range(0x110000):
+        if is_surrogate(codepoint):
+            continue
+
+        folded = chr(codepoint).casefold()
+        if folded != chr(codepoint):
+            foldings[codepoint] = [ord(c) for c in folded]
+
+    return foldings
+
+
+def build_tables(foldings):
+    # Mapping 0 is identity. Single codepoint foldings are stored as deltas, so e.g. all of A-Z share one mapping.
+    mappings = [(0, ())]
+    mapping_indices = {mappings[0]: 0}
+    expansions = []
+    expansion_indices = {}
+
+    def get_mapping_index(codepoint, folded):
+        if len(folded) == 1:
+            key = (folded[0] - codepoint, ())
+        else:
+            key = (0, tuple(folded))
+            if key[1] not in expansion_indices:
+                expansion_indices[key[1]] = len(expansions)
+                expansions.extend(folded)
+
+        if key not in mapping_indices:
+            mapping_indices[key] = len(mappings)
+            mappings.append(key)
+
+        return mapping_indices[key]
+
+    max_codepoint = max(foldings)
+    block_count = (max_codepoint >> BLOCK_SHIFT) + 1
+
+    blocks = []
+    block_indices = {}
+    stage1 = []
+    for block in range(block_count):
+        entries = []
+        for offset in range(BLOCK_SIZE):
+            codepoint = (block << BLOCK_SHIFT) + offset
+            folded = foldings.get(codepoint)
+            entries.append(get_mapping_index(codepoint, folded) if folded else 0)
+
+        entries = tuple(entries)
+        if entries not in block_indices:
+            block_indices[entries] = len(blocks)
+            blocks.append(entries)
+
+        stage1.append(block_indices[entries])
+
+    assert len(blocks) <= 256
+    assert len(mappings) <= 65536
+    assert max(len(folded) for folded in foldings.values()) <= 3
+
+    return max_codepoint, stage1, blocks, mappings, expansions, expansion_indices
+
+
+def write_array(out, declaration, values, per_line):
+    out.write("%s = {\n" % declaration)
+    for i in range(0, len(values), per_line):
+        out.write("    " + " ".join("%s," % v for v in values[i:i + per_line]) + "\n")
+    out.write("};\n\n")
+
+
+def main():
+    foldings = collect_foldings()
+    max_codepoint, stage1, blocks, mappings, expansions, expansion_indices = build_tables(foldings)
+    out = sys.stdout
+
+    out.write("#pragma once\n")
+    out.write("// Generated by generate_case_fold.py from Unicode %s, don't edit.\n" % unicodedata.unidata_version)
+    out.write("// %d codepoints fold, %d of them to several codepoints.\n" % (
+        len(foldings), sum(1 for f in foldings.values() if len(f) > 1)))
+    out.write("#include <stdint.h>\n\n\n")
+    out.write("namespace Unicode\n{\n\n")
+
+    out.write("/** Codepoints after this one don't change when case folded. */\n")
+    out.write("static const uint32_t CaseFoldMaxCodepoint = 0x%X;\n\n" % max_codepoint)
+    out.write("static const uint32_t CaseFoldBlockShift = %d;\n\n" % BLOCK_SHIFT)
+
+    out.write("struct CaseFoldMapping\n{\n")
+    out.write("    /** Added to codepoint if it folds to single codepoint. */\n")
+    out.write("    int32_t delta;\n\n")
+    out.write("    /** Index in g_caseFoldExpansions if codepoint folds to several codepoints. */\n")
+    out.write("    uint16_t expansionIndex;\n")
+    out.write("    uint16_t expansionCount;\n")
+    out.write("};\n\n")
+
+    write_array(out, "/** Block index for every block of codepoints. */\nstatic const uint8_t g_caseFoldBlocks[%d]" % len(stage1),
+                stage1, 32)
+
+    entries = [entry for block in blocks for entry in block]
+    write_array(out, "/** Mapping index for every codepoint of block. */\nstatic const uint16_t g_caseFoldBlockMappings[%d]" % len(entries),
+                entries, 32)
+
+    mapping_values = []
+    for delta, expansion in mappings:
+        if expansion:
+            mapping_values.append("{ 0, %d, %d }" % (expansion_indices[expansion], len(expansion)))
+        else:
+            mapping_values.append("{ %d, 0, 0 }" % delta)
+    write_array(out, "static const CaseFoldMapping g_caseFoldMappings[%d]" % len(mappings), mapping_values, 8)
+
+    write_array(out, "static const uint32_t g_caseFoldExpansions[%d]" % len(expansions),
+                ["0x%04X" % e for e in expansions], 12)
+
+    out.write("} // namespace Unicode\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,610 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "headless_driver.h"
+#include "command_loader.h"
+#include "newstring_builder.h"
+#include "parse_utils.h"
+#include "string_format.h"
+#include "trace.h"
+
+
+/**
+ * Command that is created instead of real command, execution always succeeds and does nothing.
+ */
+struct StubCommand : public Command
+{
+    virtual bool Execute(ExecuteCommandState*, Array<Newstring>&) override
+    {
+        return true;
+    }
+};
+
+static Command* stub_createCommand(CreateCommandState*, Array<Newstring>&, Array<Newstring>&)
+{
+    return Memnew(StubCommand);
+}
+
+static void registerStubCommands(CommandLoader* loader)
+{
+    assert(loader != nullptr);
+
+    static CommandInfo infos[] = {
+        CommandInfo(Newstring::WrapConstWChar(L"open_dir"), CI_None, stub_createCommand),
+        CommandInfo(Newstring::WrapConstWChar(L"run_app"),  CI_None, stub_createCommand)
+    };
+
+    for (uint32_t i = 0; i < sizeof(infos) / sizeof(infos[0]); ++i)
+        loader->commandInfoArray.Append(&infos[i]);
+}
+
+static void* rowLayouts_createLayout(const Newstring& text, void*)
+{
+    return text.data;
+}
+
+static void rowLayouts_releaseLayout(void*, void*)
+{
+}
+
+bool HeadlessDriver::Initialize(const Newstring& commandsSource)
+{
+    if (!textEdit.Initialize())
+        return false;
+
+    rowLayouts.createLayout = rowLayouts_createLayout;
+    rowLayouts.releaseLayout = rowLayouts_releaseLayout;
+
+    if (!engine.AddDefaultKeyboardLayoutMaps())
+        return false;
+
+    CommandSet* set = Memnew(CommandSet);
+    CommandLoader loader;
+    loader.stringPool = &set->stringPool;
+    registerStubCommands(&loader);
+
+    Array<Command*> commands = loader.LoadFromString(commandsSource);
+    for (uint32_t i = 0; i < commands.count; ++i)
+    {
+        if (!engine.RegisterCommand(set, commands.data[i]))
+            Memdelete(commands.data[i]);
+    }
+
+    commands.Dispose();
+    loader.commandInfoArray.Dispose();
+    engine.PublishCommandSet(set);
+
+    return set->GetCommandCount() > 0;
+}
+
+float HeadlessDriver::GetMaxFrameHeight() const
+{
+    return frameHeight + autocompletionList.visibleRowLimit * rowHeight + 5.0f;
+}
+
+bool HeadlessDriver::RunTrace(const Newstring& trace)
+{
+    Newstring rest = trace;
+    while (!Newstring::IsNullOrEmpty(rest))
+    {
+        Newstring line;
+        int lineBreakLength;
+        ParseUtils::GetLine(rest, &line, &lineBreakLength);
+
+        uint32_t consumed = line.count + lineBreakLength;
+        rest = consumed < rest.count ? Newstring(rest.data + consumed, rest.count - consumed) : Newstring::Empty();
+
+        if (!RunInstruction(line))
+            return false;
+    }
+
+    return true;
+}
+
+bool HeadlessDriver::RunInstruction(const Newstring& instruction)
+{
+    static const Newstring TypePrefix  = Newstring::WrapConstWChar(L"type ");
+    static const Newstring PastePrefix = Newstring::WrapConstWChar(L"paste ");
+    static const Newstring KeyPrefix   = Newstring::WrapConstWChar(L"key ");
+    static const Newstring CaretPrefix = Newstring::WrapConstWChar(L"caret ");
+
+    Newstring line = instruction.TrimmedRight();
+    if (Newstring::IsNullOrEmpty(line) || line.data[0] == L'#')
+        return true;
+
+    if (line.StartsWith(TypePrefix))
+    {
+        for (uint32_t i = TypePrefix.count; i < line.count; ++i)
+            TypeCharacter(line.data[i]);
+    }
+    else if (line.StartsWith(PastePrefix))
+    {
+        Paste(Newstring(line.data + PastePrefix.count, line.count - PastePrefix.count));
+    }
+    else if (line.StartsWith(KeyPrefix))
+    {
+        return PressKey(Newstring(line.data + KeyPrefix.count, line.count - KeyPrefix.count).Trimmed());
+    }
+    else if (line.StartsWith(CaretPrefix))
+    {
+        Newstring index = Newstring(line.data + CaretPrefix.count, line.count - CaretPrefix.count).Trimmed();
+        int32_t value;
+        if (!ParseUtils::ParseInt32(index, &value).IsComplete(index) || value < 0)
+            return false;
+
+        PlaceCaret(static_cast<uint32_t>(value));
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void HeadlessDriver::TypeCharacter(wchar_t c)
+{
+    TRACE_ZONE("HeadlessDriver::TypeCharacter");
+
+    Bench::Sample keystroke;
+    keystroke.Begin(&stages[Stage_Keystroke]);
+    {
+        Bench::Sample edit;
+        edit.Begin(&stages[Stage_TextEdit]);
+        textEdit.InsertCharacterAtCaret(c);
+        edit.End();
+
+        OnTextChanged();
+    }
+    keystroke.End();
+
+    DrawFrame();
+    g_tempAllocator.EndFrame();
+}
+
+void HeadlessDriver::Paste(const Newstring& text)
+{
+    Bench::Sample keystroke;
+    keystroke.Begin(&stages[Stage_Keystroke]);
+    {
+        Bench::Sample edit;
+        edit.Begin(&stages[Stage_TextEdit]);
+        textEdit.InsertTextAtCaret(text);
+        edit.End();
+
+        OnTextChanged();
+    }
+    keystroke.End();
+
+    DrawFrame();
+    g_tempAllocator.EndFrame();
+}
+
+void HeadlessDriver::PlaceCaret(uint32_t index)
+{
+    Bench::Sample keystroke;
+    keystroke.Begin(&stages[Stage_Keystroke]);
+    {
+        Bench::Sample edit;
+        edit.Begin(&stages[Stage_TextEdit]);
+        textEdit.ClearSelection(index);
+        edit.End();
+
+        OnTextChanged();
+    }
+    keystroke.End();
+
+    DrawFrame();
+    g_tempAllocator.EndFrame();
+}
+
+bool HeadlessDriver::PressKey(const Newstring& key)
+{
+    TRACE_ZONE("HeadlessDriver::PressKey");
+
+    Bench::Sample keystroke;
+    keystroke.Begin(&stages[Stage_Keystroke]);
+
+    bool isKnownKey = true;
+
+    if (key == L"enter")
+    {
+        Evaluate();
+    }
+    else if (key == L"tab")
+    {
+        OnTextChanged();
+        if (autocompletionCandidate != nullptr)
+        {
+            Bench::Sample edit;
+            edit.Begin(&stages[Stage_TextEdit]);
+            textEdit.SetText(autocompletionCandidate->name);
+            textEdit.SetCaretPos(autocompletionCandidate->name.count);
+            textEdit.InsertCharacterAtCaret(L' ');
+            edit.End();
+        }
+    }
+    else if ((key == L"up" || key == L"down") && autocompletionList.rowCount > 0)
+    {
+        key == L"up" ? autocompletionList.SelectPrev() : autocompletionList.SelectNext();
+        autocompletionCandidate = autocompletionList.GetSelected();
+    }
+    else if (key == L"up" || key == L"down")
+    {
+        Bench::Sample historySample;
+        historySample.Begin(&stages[Stage_History]);
+        const Newstring* entry = key == L"up" ? history.GetPrevEntry() : history.GetNextEntry();
+        historySample.End();
+
+        if (entry != nullptr)
+        {
+            Bench::Sample edit;
+            edit.Begin(&stages[Stage_TextEdit]);
+            textEdit.SetText(*entry);
+            textEdit.SetCaretPos(entry->count);
+            edit.End();
+
+            historyTextRevision = textEdit.revision;
+        }
+    }
+    else
+    {
+        Bench::Sample edit;
+        edit.Begin(&stages[Stage_TextEdit]);
+        isKnownKey = ApplyEditKey(key);
+        edit.End();
+    }
+
+    if (isKnownKey && key != L"enter")
+        OnTextChanged();
+
+    keystroke.End();
+
+    DrawFrame();
+
+    if (key == L"escape")
+    {
+        Bench::Sample show;
+        show.Begin(&stages[Stage_Show]);
+        renderState.InvalidateFrame();
+        DrawFrame();
+        show.End();
+    }
+
+    g_tempAllocator.EndFrame();
+    return isKnownKey;
+}
+
+bool HeadlessDriver::ApplyEditKey(const Newstring& key)
+{
+    if (key == L"back" || key == L"delete")
+    {
+        if (textEdit.IsTextSelected())  textEdit.RemoveSelectedText();
+        else  key == L"back" ? textEdit.RemovePrevCharacter() : textEdit.RemoveNextCharacter();
+    }
+    else if (key == L"left")
+    {
+        textEdit.IsTextSelected() ? textEdit.ClearSelection(textEdit.GetSelectionStart()) : textEdit.MoveCaretLeft();
+    }
+    else if (key == L"right")
+    {
+        textEdit.IsTextSelected() ? textEdit.ClearSelection(textEdit.GetSelectionEnd()) : textEdit.MoveCaretRight();
+    }
+    else if (key == L"shift+left")   textEdit.AddPrevCharacterToSelection();
+    else if (key == L"shift+right")  textEdit.AddNextCharacterToSelection();
+    else if (key == L"select_all")   textEdit.SelectAll();
+    else if (key == L"undo")         textEdit.Undo();
+    else if (key == L"redo")         textEdit.Redo();
+    else if (key == L"escape")
+    {
+        textEdit.ClearText();
+        autocompletionCandidate = nullptr;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void HeadlessDriver::Evaluate()
+{
+    Newstring input = textEdit.GetText();
+
+    Bench::Sample historySample;
+    historySample.Begin(&stages[Stage_History]);
+    history.SaveEntry(input);
+    historySample.End();
+
+    Bench::Sample evaluate;
+    evaluate.Begin(&stages[Stage_Evaluate]);
+    bool success = engine.Evaluate(input);
+    evaluate.End();
+
+    ++evaluationCount;
+    if (!success)
+    {
+        ++failedEvaluationCount;
+        return;
+    }
+
+    textEdit.ClearText();
+    autocompletionCandidate = nullptr;
+    history.ResetCurrentEntryIndex();
+}
+
+void HeadlessDriver::OnTextChanged()
+{
+    if (autocompletionTextRevision == textEdit.revision)
+        return;
+
+    TRACE_ZONE("HeadlessDriver::UpdateAutocompletion");
+
+    Bench::Sample sample;
+    sample.Begin(&stages[Stage_Autocompletion]);
+
+    // Same rules as CommandWindow::UpdateAutocompletion.
+    autocompletionTextRevision = textEdit.revision;
+    Newstring text = textEdit.GetText();
+    if (text.count > 0 && text.IndexOf(L' ') == -1 && textEdit.revision != historyTextRevision)
+    {
+        uint32_t count = 0;
+        Command* const* candidates = engine.FindAutocompletionCandidates(text, &count);
+        autocompletionList.SetCandidates(candidates, count);
+        autocompletionCandidate = autocompletionList.GetSelected();
+    }
+    else
+    {
+        autocompletionList.Clear();
+        autocompletionCandidate = engine.FindAutocompletionCandidate(text);
+    }
+
+    sample.End();
+}
+
+void HeadlessDriver::DrawFrame()
+{
+    RenderInputs inputs;
+    inputs.textRevision = textEdit.revision;
+    inputs.caretPos = textEdit.caretPos;
+    textEdit.GetSelectionStartAndLength(&inputs.selectionStart, &inputs.selectionLength);
+    inputs.isCaretVisible = !textEdit.IsTextSelected();
+    inputs.candidate = autocompletionCandidate;
+    inputs.dropdownRevision = autocompletionList.revision;
+
+    uint32_t changes = renderState.BeginFrame(inputs);
+    if (RenderState::IsTextLayoutAffected(changes))
+        textAdvances.Update(&textMetrics, textEdit.GetText(), textEdit.revision);
+
+    caretX = textAdvances.GetCaretX(inputs.caretPos);
+    selectionStartX = textAdvances.GetCaretX(inputs.selectionStart);
+    selectionEndX = textAdvances.GetCaretX(inputs.selectionStart + inputs.selectionLength);
+
+    if (renderer != nullptr)
+        PaintFrame(changes);
+}
+
+void HeadlessDriver::PaintFrame(uint32_t changes)
+{
+    TRACE_ZONE("HeadlessDriver::PaintFrame");
+
+    Bench::Sample sample;
+    sample.Begin(&stages[Stage_Paint]);
+
+    CommandWindowFrame frame;
+    frame.width = frameWidth;
+    frame.height = frameHeight;
+    frame.textboxHeight = frameHeight;
+    frame.borderSize = 5.0f;
+    frame.textMarginLeft = 4.0f;
+
+    frame.text.text = textEdit.GetText();
+
+    if (autocompletionCandidate != nullptr)
+    {
+        // Same text as CommandWindow::UpdateAutocompletionLayout builds.
+        const Newstring& name = autocompletionCandidate->name;
+        if (RenderState::IsAutocompletionLayoutAffected(changes))
+        {
+            autocompletionText.count = 0;
+            autocompletionText.Append(frame.text.text);
+            if (name.count > frame.text.text.count)
+                autocompletionText.Append(name.RefSubstring(frame.text.text.count, name.count - frame.text.text.count));
+        }
+
+        frame.hasAutocompletion = true;
+        frame.autocompletion.text = autocompletionText.string;
+        frame.autocompletionOffsetX = textAdvances.GetCaretX(frame.text.text.count);
+    }
+
+    RenderTextRun rows[AutocompletionList::MaxVisibleRows];
+    if (autocompletionList.rowCount > 0)
+    {
+        rowLayouts.BeginFrame();
+        for (uint32_t i = 0; i < autocompletionList.rowCount; ++i)
+        {
+            const Command* command = autocompletionList.rows[i];
+            rows[i].text = command->name;
+            rows[i].layout = rowLayouts.GetLayout(command, command->name);
+        }
+
+        frame.rows = rows;
+        frame.rowCount = autocompletionList.rowCount;
+        frame.rowHeight = rowHeight;
+        frame.selectedRow = autocompletionList.GetSelectedRow();
+        frame.height = frameHeight + frame.rowCount * rowHeight + frame.borderSize;
+    }
+
+    frame.isTextSelected = textEdit.IsTextSelected();
+    frame.selectionStartX = selectionStartX;
+    frame.selectionEndX = selectionEndX;
+    frame.isCaretVisible = !frame.isTextSelected;
+    frame.caretX = caretX;
+    frame.isCaretOnly = RenderState::IsCaretOnlyFrame(changes);
+    frame.previousCaretLineX = caretLineX;
+
+    renderer->BeginFrame();
+    frame.Paint(renderer);
+    renderer->EndFrame();
+
+    caretLineX = frame.GetCaretLineX();
+
+    sample.End();
+}
+
+Newstring HeadlessDriver::GenerateTrace(uint32_t keystrokeCount)
+{
+    NewstringBuilder sb;
+    if (engine.commandSet == nullptr || engine.commandSet->commands.count == 0)
+        return Newstring::Empty();
+
+    uint32_t keystrokes = 0;
+    for (uint32_t i = 0; keystrokes < keystrokeCount; ++i)
+    {
+        const Command* command = engine.commandSet->commands.data[i % engine.commandSet->commands.count];
+
+        // Type command name with a typo, fix it, then type an argument and evaluate.
+        sb.Append(L"type ");
+        sb.Append(command->name);
+        sb.Append(L"x\nkey back\ntype  D:\\Some Folder\\file.txt\n");
+        keystrokes += command->name.count + 2 + 23;
+
+        if (i % 4 == 0)
+        {
+            sb.Append(L"key shift+left\nkey shift+left\nkey back\nkey left\nkey right\n");
+            keystrokes += 5;
+        }
+        if (i % 8 == 0)
+        {
+            sb.Append(L"key up\nkey down\nkey escape\ntype ");
+            sb.Append(command->name.RefSubstring(0, 1));
+            sb.Append(L"\nkey down\nkey tab\n");
+            keystrokes += 6;
+        }
+
+        sb.Append(L"key enter\n");
+        keystrokes += 1;
+    }
+
+    return sb.TransferToString();
+}
+
+Newstring HeadlessDriver::GenerateEditingTrace(uint32_t keystrokeCount, uint32_t lineLength)
+{
+    NewstringBuilder sb;
+    if (engine.commandSet == nullptr || engine.commandSet->commands.count == 0)
+        return Newstring::Empty();
+
+    // Command name followed by long argument list.
+    uint32_t textLength = engine.commandSet->commands.data[0]->name.count;
+    sb.Append(L"paste ");
+    sb.Append(engine.commandSet->commands.data[0]->name);
+    for (; textLength < lineLength; textLength += 8)
+        sb.Append(L" arg_val");
+    sb.Append(L'\n');
+
+    // Every edit keeps text length, so caret positions stay inside of text.
+    uint32_t keystrokes = 1;
+    for (uint32_t i = 0; keystrokes < keystrokeCount; ++i)
+    {
+        // Edit at the start, in the middle and near the end of the line in turn.
+        uint32_t caretPos = textLength > 8 ? textLength - 8 : textLength;
+        if (i % 3 == 0)       caretPos = 0;
+        else if (i % 3 == 1)  caretPos = textLength / 2;
+        bool isAtStart = caretPos == 0;
+        FORMAT_APPEND(&sb, L"caret {}\n", caretPos);
+
+        // Type a word and erase it.
+        sb.Append(L"type word\n");
+        for (uint32_t k = 0; k < 4; ++k)  sb.Append(L"key back\n");
+        keystrokes += 1 + 4 + 4;
+
+        if (i % 4 == 0)
+        {
+            // Hold backspace (or delete at the start), then type erased amount of text again.
+            for (uint32_t k = 0; k < 32; ++k)  sb.Append(isAtStart ? L"key delete\n" : L"key back\n");
+            sb.Append(L"type  arg_val arg_val arg_val arg_val\n");
+            keystrokes += 32 + 32;
+        }
+        if (i % 16 == 0)
+        {
+            // Select word next to caret and replace it with pasted text.
+            for (uint32_t k = 0; k < 7; ++k)  sb.Append(isAtStart ? L"key shift+right\n" : L"key shift+left\n");
+            sb.Append(L"paste arg_val\n");
+            keystrokes += 7 + 1;
+        }
+    }
+
+    return sb.TransferToString();
+}
+
+void HeadlessDriver::ClearStatistics()
+{
+    for (uint32_t i = 0; i < Stage_Count; ++i)
+        stages[i].Clear();
+
+    evaluationCount = 0;
+    failedEvaluationCount = 0;
+    renderState.statistics = RenderStatistics();
+    rowLayouts.createdCount = 0;
+    rowLayouts.reusedCount = 0;
+    g_tempAllocator.statistics = TempAllocatorStatistics();
+}
+
+void HeadlessDriver::PrintReport()
+{
+    for (uint32_t i = 0; i < Stage_Count; ++i)
+    {
+        if (i == Stage_Paint && renderer == nullptr)
+            continue;
+
+        stages[i].Print(GetStageName(static_cast<Stage>(i)));
+    }
+
+    printf("evaluations: %u (%u failed)\n", evaluationCount, failedEvaluationCount);
+
+    const RenderStatistics& render = renderState.statistics;
+    printf("frames: %u full, %u caret only; layout rebuilds: %u text, %u autocompletion\n",
+        render.fullFrameCount, render.caretFrameCount, render.textLayoutBuildCount, render.autocompletionLayoutBuildCount);
+
+    if (renderer != nullptr)
+        printf("dropdown rows: %u layouts built, %u reused\n", rowLayouts.createdCount, rowLayouts.reusedCount);
+
+    const TempAllocatorStatistics& temp = g_tempAllocator.statistics;
+    printf("temp arena: %llu bytes, high-water %llu bytes; %llu spills (%llu bytes) in %llu of %llu frames, %u resizes\n",
+        (unsigned long long)g_tempAllocator.GetSize(), (unsigned long long)temp.highWaterMark,
+        (unsigned long long)temp.spillCount, (unsigned long long)temp.spillBytes,
+        (unsigned long long)temp.spilledFrameCount, (unsigned long long)temp.frameCount, temp.resizeCount);
+}
+
+void HeadlessDriver::Dispose()
+{
+    for (uint32_t i = 0; i < Stage_Count; ++i)
+        stages[i].Dispose();
+
+    autocompletionCandidate = nullptr;
+    autocompletionList.Clear();
+    rowLayouts.Clear();
+    engine.UnregisterAllCommands();
+    engine.Dispose();
+    textEdit.Dispose();
+    textAdvances.Dispose();
+    autocompletionText.Dispose();
+    history.Dispose();
+}
+
+const char* HeadlessDriver::GetStageName(Stage stage)
+{
+    switch (stage)
+    {
+        case Stage_TextEdit:        return "text_edit";
+        case Stage_Autocompletion:  return "autocompletion";
+        case Stage_History:         return "history";
+        case Stage_Evaluate:        return "evaluate";
+        case Stage_Keystroke:       return "keystroke";
+        case Stage_Paint:           return "paint";
+        case Stage_Show:            return "show";
+        default:                    return "unknown";
+    }
+}
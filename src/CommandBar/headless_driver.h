@@ -0,0 +1,153 @@
+#pragma once
+#include "bench.h"
+#include "command_engine.h"
+#include "command_history.h"
+#include "text_edit.h"
+#include "render_state.h"
+#include "text_metrics.h"
+#include "command_window_frame.h"
+#include "autocompletion_list.h"
+#include "text_layout_pool.h"
+
+
+/**
+ * Replays scripted keystroke traces through TextEdit, autocompletion lookup, CommandHistory and
+ * CommandEngine::Evaluate the same way CommandWindow does, but without a window.
+ *
+ * Commands are created from commands file source, but every command is a stub which execution does nothing,
+ * so only command bar's own logic is measured. After every keystroke a frame is "drawn" through RenderState,
+ * so report shows how many frames would rebuild layouts or redraw only caret. Caret and selection positions are
+ * looked up in GlyphAdvanceCache filled by fixed pitch text metrics. If renderer is set, frames are also painted
+ * the same way CommandWindow paints them, including autocompletion dropdown.
+ *
+ * Escape key hides CommandWindow, so after it the driver also draws a frame as if window was shown again: whole
+ * frame is redrawn, but layouts built while window was hidden are reused.
+ *
+ * Like in CommandWindow, up and down keys move selection of autocompletion dropdown while it is shown (command name
+ * is typed), and navigate history otherwise.
+ *
+ * Trace is a text with one instruction per line:
+ *   # comment
+ *   type <text>    types each character of text as separate keystroke
+ *   paste <text>   inserts text at caret as single edit
+ *   key <name>     presses key: back, delete, left, right, shift+left, shift+right, select_all,
+ *                  undo, redo, tab, enter, escape, up, down
+ *   caret <index>  places caret before character with specified index, like mouse click does
+ */
+struct HeadlessDriver
+{
+    enum Stage
+    {
+        Stage_TextEdit = 0,
+        Stage_Autocompletion,
+        Stage_History,
+        Stage_Evaluate,
+        Stage_Keystroke, // Whole keystroke processing, including all stages above.
+        Stage_Paint,     // Painting frame after keystroke, only if renderer is set.
+        Stage_Show,      // First frame after window is shown again following escape key.
+
+        Stage_Count
+    };
+
+    CommandEngine engine;
+    TextEdit textEdit;
+    CommandHistory history;
+    Command* autocompletionCandidate = nullptr;
+    AutocompletionList autocompletionList;
+
+    /** Value of textEdit.revision after text was replaced by history entry, dropdown is hidden while it's unchanged. */
+    uint32_t historyTextRevision = 0xFFFFFFFF;
+
+    /** Value of textEdit.revision that autocompletion candidates were found for. */
+    uint32_t autocompletionTextRevision = 0xFFFFFFFF;
+
+    RenderState renderState;
+    FixedPitchTextMetrics textMetrics;
+    GlyphAdvanceCache textAdvances;
+
+    /** Caret and selection coordinates of last drawn frame. */
+    float caretX = 0.0f;
+    float selectionStartX = 0.0f;
+    float selectionEndX = 0.0f;
+
+    /**
+     * Renderer to paint frames with, or null pointer to only track frame changes.
+     */
+    IRenderer* renderer = nullptr;
+    float frameWidth = 400.0f;
+    float frameHeight = 40.0f;
+    float rowHeight = 30.0f;
+    float caretLineX = 0.0f;
+
+    /**
+     * Layouts of dropdown rows. Software renderer lays out text itself, so layouts only show when rows are built.
+     */
+    TextLayoutPool rowLayouts;
+
+    /** Typed text followed by rest of autocompletion candidate name. */
+    NewstringBuilder autocompletionText;
+
+    Bench::LatencyHistogram stages[Stage_Count];
+
+    uint32_t evaluationCount = 0;
+    uint32_t failedEvaluationCount = 0;
+
+    /**
+     * Creates stub commands declared in specified commands file source.
+     * Returns false if no commands were created.
+     */
+    bool Initialize(const Newstring& commandsSource);
+
+    /**
+     * Returns height of frame with autocompletion dropdown showing maximum number of rows.
+     */
+    float GetMaxFrameHeight() const;
+
+    /**
+     * Replays specified trace. Returns false if trace contains invalid instruction.
+     */
+    bool RunTrace(const Newstring& trace);
+
+    /**
+     * Generates trace of approximately specified amount of keystrokes which types registered commands,
+     * corrects typos, navigates history and evaluates commands.
+     * Resulting string is allocated using standard allocator.
+     */
+    Newstring GenerateTrace(uint32_t keystrokeCount);
+
+    /**
+     * Generates trace of approximately specified amount of keystrokes which pastes a line of specified length
+     * and then edits it at the start, in the middle and near the end in turn: types, holds backspace or delete and
+     * replaces selection, without evaluating.
+     * Resulting string is allocated using standard allocator.
+     */
+    Newstring GenerateEditingTrace(uint32_t keystrokeCount, uint32_t lineLength);
+
+    /**
+     * Resets recorded statistics without touching text or history state.
+     */
+    void ClearStatistics();
+
+    /**
+     * Prints latency histograms of every stage to standard output.
+     */
+    void PrintReport();
+
+    /**
+     * Releases resources used by the driver.
+     */
+    void Dispose();
+
+    static const char* GetStageName(Stage stage);
+private:
+    bool RunInstruction(const Newstring& instruction);
+    bool PressKey(const Newstring& key);
+    bool ApplyEditKey(const Newstring& key);
+    void TypeCharacter(wchar_t c);
+    void Paste(const Newstring& text);
+    void PlaceCaret(uint32_t index);
+    void Evaluate();
+    void OnTextChanged();
+    void DrawFrame();
+    void PaintFrame(uint32_t changes);
+};
@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <algorithm>
+
+#include "keyboard_layout.h"
+
+
+const wchar_t* const KeyboardLayoutMap::QwertyKeys = L"`qwertyuiop[]asdfghjkl;'zxcvbnm,./";
+const wchar_t* const KeyboardLayoutMap::JcukenKeys =
+    L"\u0451\u0439\u0446\u0443\u043A\u0435\u043D\u0433\u0448\u0449\u0437\u0445\u044A" // row of "`qwertyuiop[]"
+    L"\u0444\u044B\u0432\u0430\u043F\u0440\u043E\u043B\u0434\u0436\u044D" // row of "asdfghjkl;'"
+    L"\u044F\u0447\u0441\u043C\u0438\u0442\u044C\u0431\u044E."; // row of "zxcvbnm,./"
+
+bool KeyboardLayoutMap::Initialize(const Newstring& sourceKeys, const Newstring& targetKeys)
+{
+    if (sourceKeys.count != targetKeys.count)
+        return false;
+
+    keys.Clear();
+    if (!keys.Reserve(sourceKeys.count))
+        return false;
+
+    for (uint32_t i = 0; i < sourceKeys.count; ++i)
+    {
+        KeyPair pair;
+        pair.source = sourceKeys.data[i];
+        pair.target = targetKeys.data[i];
+        keys.Append(pair);
+    }
+
+    // Stable sort keeps the first pair of repeated source character first, duplicates are removed after it.
+    std::stable_sort(keys.data, keys.data + keys.count, [](const KeyPair& a, const KeyPair& b) { return a.source < b.source; });
+
+    uint32_t uniqueCount = 0;
+    for (uint32_t i = 0; i < keys.count; ++i)
+    {
+        if (uniqueCount == 0 || keys.data[uniqueCount - 1].source != keys.data[i].source)
+            keys.data[uniqueCount++] = keys.data[i];
+    }
+    keys.count = uniqueCount;
+
+    return true;
+}
+
+wchar_t KeyboardLayoutMap::Map(wchar_t c) const
+{
+    const KeyPair* begin = keys.data;
+    const KeyPair* end = keys.data + keys.count;
+    const KeyPair* pair = std::lower_bound(begin, end, c, [](const KeyPair& a, wchar_t c) { return a.source < c; });
+
+    return pair != end && pair->source == c ? pair->target : c;
+}
+
+bool KeyboardLayoutMap::AppendMapped(NewstringBuilder* builder, const Newstring& text) const
+{
+    assert(builder);
+
+    if (Newstring::IsNullOrEmpty(text))
+        return true;
+
+    if (!builder->Reserve(builder->count + text.count))
+        return false;
+
+    for (uint32_t i = 0; i < text.count; ++i)
+        builder->data[builder->count++] = Map(text.data[i]);
+
+    return true;
+}
+
+void KeyboardLayoutMap::Dispose()
+{
+    keys.Dispose();
+}
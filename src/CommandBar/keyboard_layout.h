@@ -0,0 +1,42 @@
+#pragma once
+#include "array.h"
+#include "newstring.h"
+#include "newstring_builder.h"
+
+
+/**
+ * Maps characters of one keyboard layout to characters at the same keys of another layout, so text typed while
+ * wrong layout was active can be matched, e.g. "open" typed in Russian layout is "\u0449\u0437\u0443\u0442".
+ */
+struct KeyboardLayoutMap
+{
+    /** Lower case keys of US QWERTY layout, in the same order as JcukenKeys. */
+    static const wchar_t* const QwertyKeys;
+
+    /** Lower case keys of Russian JCUKEN layout, in the same order as QwertyKeys. */
+    static const wchar_t* const JcukenKeys;
+
+    struct KeyPair
+    {
+        wchar_t source;
+        wchar_t target;
+    };
+
+    /** Key pairs sorted by source character. */
+    Array<KeyPair> keys;
+
+    /**
+     * Initializes map from characters of source layout to characters of target layout, character of target keys
+     * replaces character at the same index of source keys. If source character is repeated, first pair is used.
+     * Returns false if strings have different lengths or memory couldn't be allocated.
+     */
+    bool Initialize(const Newstring& sourceKeys, const Newstring& targetKeys);
+
+    /** Returns character at the same key in target layout, or the same character if source layout doesn't have it. */
+    wchar_t Map(wchar_t c) const;
+
+    /** Appends text with every character mapped to target layout. Returns false if memory couldn't be allocated. */
+    bool AppendMapped(NewstringBuilder* builder, const Newstring& text) const;
+
+    void Dispose();
+};
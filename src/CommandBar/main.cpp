@@ -11,6 +11,7 @@
 #include "single_instance.h"
 #include "basic_commands.h"
 #include "command_loader.h"
+#include "process_launcher.h"
 #include "unicode.h"
 #include "hint_window.h"
 #include "newstring.h"
@@ -61,7 +62,14 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, wchar_t* lpCmd
 	}
 #endif
 
+    ProcessLauncher launcher;
+    defer(launcher.Dispose());
+
+    // Without worker threads applications are launched synchronously.
+    launcher.Initialize();
+
 	CommandEngine commandEngine;
+    commandEngine.launcher = &launcher;
     defer(commandEngine.Dispose());
 
 	CommandWindowStyle windowStyle;
@@ -85,11 +93,17 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, wchar_t* lpCmd
     if (!initialized)  return 1;
 
     commandWindow.ReloadCommandsFile();
+    commandWindow.PrewarmGraphicsResources();
+
+    // Maximum number of messages dispatched between temporary allocator resets, so temporary memory stays
+    // bounded if message queue never drains.
+    const uint32_t maxMessagesPerFrame = 64;
 
     MSG msg;
     uint32_t ret;
+    bool isQuitting = false;
 
-    while ((ret = GetMessageW(&msg, 0, 0, 0)) != 0)
+    while (!isQuitting && (ret = GetMessageW(&msg, 0, 0, 0)) != 0)
     {
         if (ret == -1)
         {
@@ -99,7 +113,21 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, wchar_t* lpCmd
         TranslateMessage(&msg);
         DispatchMessageW(&msg);
 
-        g_tempAllocator.Reset();
+        // Temporary allocations are released after message queue is drained instead of after every message,
+        // so burst of input messages is a single frame of temporary allocator.
+        for (uint32_t i = 1; i < maxMessagesPerFrame && PeekMessageW(&msg, 0, 0, 0, PM_REMOVE); ++i)
+        {
+            if (msg.message == WM_QUIT)
+            {
+                isQuitting = true;
+                break;
+            }
+
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+
+        g_tempAllocator.EndFrame();
     }
 
     return static_cast<int>(msg.wParam);
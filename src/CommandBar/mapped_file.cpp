@@ -0,0 +1,108 @@
+#include <assert.h>
+
+#include "mapped_file.h"
+#include "utf8_string_pool.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+bool MappedFile::Open(const Newstring& path)
+{
+    assert(data == nullptr);
+
+    TempAllocatorScope scope;
+    HANDLE fileHandle = CreateFileW(path.CloneAsCString(&g_tempAllocator), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0 || fileSize.QuadPart > UINT32_MAX)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr)
+    {
+        if (mappingHandle)  CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    file = fileHandle;
+    mapping = mappingHandle;
+    data = view;
+    size = static_cast<uint32_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data == nullptr)
+        return;
+
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    CloseHandle(file);
+
+    file = nullptr;
+    mapping = nullptr;
+    data = nullptr;
+    size = 0;
+}
+#else
+bool MappedFile::Open(const Newstring& path)
+{
+    assert(data == nullptr);
+
+    // Path is encoded to zero-terminated UTF-8.
+    Utf8StringPool encodedPath;
+    encodedPath.allocator = &g_tempAllocator;
+    TempAllocatorScope scope;
+    Utf8StringRef pathRef;
+    if (!encodedPath.Add(path, &pathRef))
+        return false;
+
+    int fd = open(encodedPath.GetData(pathRef), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || static_cast<uint64_t>(st.st_size) > UINT32_MAX)
+    {
+        close(fd);
+        return false;
+    }
+
+    // Mapping stays valid after file is closed.
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    data = view;
+    size = static_cast<uint32_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data == nullptr)
+        return;
+
+    munmap(const_cast<void*>(data), size);
+    data = nullptr;
+    size = 0;
+}
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+
+#include "newstring.h"
+
+
+/**
+ * Whole file mapped to memory for reading. Pages of file are shared with other processes that map the same file,
+ * so several processes can read one copy of e.g. command image.
+ */
+struct MappedFile
+{
+    const void* data = nullptr;
+    uint32_t size = 0;
+
+    /** Maps file to memory. Returns false if file can't be opened, is empty or is larger than 4 GB. */
+    bool Open(const Newstring& path);
+
+    void Close();
+
+private:
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
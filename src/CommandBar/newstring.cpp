@@ -1,4 +1,5 @@
 #include "newstring.h"
+#include "unicode.h"
 #include <wchar.h>
 #include <stdarg.h>
 
@@ -34,9 +35,10 @@ bool Newstring::Equals(const Newstring& rhs, StringComparison comparison) const
 {
     if (IsNullOrEmpty(this) && IsNullOrEmpty(rhs))  return true;
 
-    auto compareProcedure = comparison == StringComparison::CaseSensitive ? wcsncmp : _wcsnicmp;
+    if (comparison == StringComparison::CaseInsensitive)
+        return Unicode::EqualsIgnoreCase(*this, rhs);
 
-    return count == rhs.count && compareProcedure(data, rhs.data, count) == 0;
+    return count == rhs.count && wcsncmp(data, rhs.data, count) == 0;
 }
 
 bool Newstring::Equals(const wchar_t* rhs, StringComparison comparison) const
@@ -75,12 +77,13 @@ bool Newstring::StartsWith(const Newstring& string, StringComparison comparison)
     if (IsNullOrEmpty(string))
         return false;
 
+    if (comparison == StringComparison::CaseInsensitive)
+        return Unicode::StartsWithIgnoreCase(*this, string);
+
     if (string.count > this->count)
         return false;
 
-    auto compareProc = comparison == StringComparison::CaseSensitive ? wcsncmp : _wcsnicmp;
-
-    return compareProc(this->data, string.data, string.count) == 0;
+    return wcsncmp(this->data, string.data, string.count) == 0;
 }
 
 uint32_t Newstring::CopyTo(Newstring* dest, uint32_t fromIndex, uint32_t destIndex, uint32_t copyCount) const
@@ -370,7 +373,13 @@ Newstring Newstring::FormatWithAllocator(IAllocator* allocator, const wchar_t* f
     va_copy(argsCopy, args);
 
     // Number of characters required to format specified string, **without terminating null**.
+#ifdef _WIN32
     int charCount = _vscwprintf(format, argsCopy);
+#else
+    // vswprintf does not report required length, so format into scratch buffer first.
+    wchar_t scratch[1024];
+    int charCount = vswprintf(scratch, sizeof(scratch) / sizeof(scratch[0]), format, argsCopy);
+#endif
     assert(charCount != -1);
 
     va_end(argsCopy);
@@ -380,7 +389,14 @@ Newstring Newstring::FormatWithAllocator(IAllocator* allocator, const wchar_t* f
     Newstring result = New(allocCount, allocator);
     if (IsNullOrEmpty(result))  return Empty();
 
+#ifdef _WIN32
     int written = _vsnwprintf(result.data, allocCount, format, args);  // @TODO: Check out why _vsnwprintf_s doesn't work (has 'buffer too small' error)!
+#else
+    // vswprintf always writes terminating null, so it needs one more character than we may have allocated.
+    int written = charCount;
+    wmemcpy(result.data, scratch, charCount);
+    if (includeTerminatingNull)  result.data[charCount] = L'\0';
+#endif
     assert(written == charCount);
 
     result.count = written;
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "newstring_builder.h"
 
 NewstringBuilder::NewstringBuilder()
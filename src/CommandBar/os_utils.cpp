@@ -137,6 +137,7 @@ bool WriteFileContents(const Newstring& fileName, void* contents, uint32_t conte
     if (Newstring::IsNullOrEmpty(fileName))
         return false;
 
+    TempAllocatorScope scope;
     wchar_t* actualFileName = fileName.CloneAsTempCString();
     if (!actualFileName)
         return false;
@@ -171,6 +172,9 @@ Newstring ReadAllText(const Newstring& fileName, Encoding encoding, IAllocator*
         return Newstring::Empty();
     }
 
+    // File contents are only needed until they are decoded.
+    TempAllocatorScope scope;
+
     uint32_t fileSize = 0;
     void* data = ReadFileContents(fileName, &fileSize, &g_tempAllocator);
 
@@ -178,6 +182,8 @@ Newstring ReadAllText(const Newstring& fileName, Encoding encoding, IAllocator*
         return Newstring::Empty();
 
     Newstring result = Unicode::DecodeString(data, fileSize, encoding, allocator);
+    if (allocator == &g_tempAllocator)
+        result = scope.Keep(result);
 
     return result;
 }
@@ -239,6 +245,7 @@ void TruncateFileNameToDirectory(Newstring* fileName)
 
 bool FileExists(const Newstring& fileName)
 {
+    TempAllocatorScope scope;
     return FileExists(fileName.CloneAsTempCString());
 }
 
@@ -254,6 +261,7 @@ bool FileExists(const wchar_t* fileName)
 
 bool DirectoryExists(const Newstring& fileName)
 {
+    TempAllocatorScope scope;
     return DirectoryExists(fileName.CloneAsTempCString());
 }
 
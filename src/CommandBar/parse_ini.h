@@ -12,18 +12,13 @@ enum class INIValueType
 struct INIParser
 {
     INIValueType type;
-    union
-    {
-        struct
-        {
-            Newstring key;
-            Newstring value;
-        };
-        struct
-        {
-            Newstring group;
-        };
-    };
+
+    // Set when type is KeyValuePair.
+    Newstring key;
+    Newstring value;
+
+    // Set when type is Group.
+    Newstring group;
 
     INIParser();
     INIParser(Newstring source);
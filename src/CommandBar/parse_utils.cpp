@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <float.h>
+#include <math.h>
 
 
 #include "array.h"
@@ -35,34 +37,348 @@ void ParseUtils::GetLine(const Newstring& str, Newstring* lineSubstr, int* lineB
     *lineBreakLength = 0;
 }
 
-bool ParseUtils::StringToBool(const Newstring& str, bool* value)
+static inline bool isDigit(wchar_t c)
+{
+    return c >= L'0' && c <= L'9';
+}
+
+/** Returns value of hexadecimal digit or -1 if character is not hexadecimal digit. */
+static inline int hexDigitValue(wchar_t c)
+{
+    if (c >= L'0' && c <= L'9')  return c - L'0';
+    if (c >= L'a' && c <= L'f')  return c - L'a' + 10;
+    if (c >= L'A' && c <= L'F')  return c - L'A' + 10;
+    return -1;
+}
+
+static inline wchar_t toLowerAscii(wchar_t c)
+{
+    return (c >= L'A' && c <= L'Z') ? c + (L'a' - L'A') : c;
+}
+
+/** Returns true if string starts with specified lower case ASCII keyword, case-insensitive. */
+static bool startsWithKeyword(const wchar_t* c, const wchar_t* end, const wchar_t* keyword, uint32_t keywordLength)
+{
+    if (static_cast<uint32_t>(end - c) < keywordLength)
+        return false;
+
+    for (uint32_t i = 0; i < keywordLength; ++i)
+    {
+        if (toLowerAscii(c[i]) != keyword[i])
+            return false;
+    }
+
+    return true;
+}
+
+static ParseResult makeResult(const Newstring& str, const wchar_t* end, ParseError error)
+{
+    ParseResult result;
+    result.count = error == ParseError::InvalidValue ? 0 : static_cast<uint32_t>(end - str.data);
+    result.error = error;
+    return result;
+}
+
+ParseResult ParseUtils::ParseInt32(const Newstring& str, int32_t* value)
 {
     assert(value);
 
-    if (Newstring::IsNullOrEmpty(str)) return false;
+    const wchar_t* c = str.data;
+    const wchar_t* end = str.data + str.count;
 
-    switch (str.count)
+    bool isNegative = false;
+    if (c < end && (*c == L'-' || *c == L'+'))
     {
-        case 1:
-            switch (towlower(str.data[0]))
+        isNegative = *c == L'-';
+        ++c;
+    }
+
+    uint32_t base = 10;
+    if (end - c >= 3 && c[0] == L'0' && (c[1] == L'x' || c[1] == L'X') && hexDigitValue(c[2]) >= 0)
+    {
+        base = 16;
+        c += 2;
+    }
+
+    // Digits past the limit are still consumed, so out of range value is reported as a whole.
+    const uint64_t limit = isNegative ? 2147483648ull : 2147483647ull;
+    const wchar_t* digits = c;
+    uint64_t magnitude = 0;
+    bool isOutOfRange = false;
+
+    for (; c < end; ++c)
+    {
+        int digit = base == 16 ? hexDigitValue(*c) : (isDigit(*c) ? *c - L'0' : -1);
+        if (digit < 0)
+            break;
+
+        magnitude = magnitude * base + digit;
+        if (magnitude > limit)
+        {
+            isOutOfRange = true;
+            magnitude = limit;
+        }
+    }
+
+    if (c == digits)
+        return makeResult(str, c, ParseError::InvalidValue);
+
+    if (isOutOfRange)
+        return makeResult(str, c, ParseError::OutOfRange);
+
+    *value = isNegative ? static_cast<int32_t>(0 - magnitude) : static_cast<int32_t>(magnitude);
+    return makeResult(str, c, ParseError::None);
+}
+
+ParseResult ParseUtils::ParseDouble(const Newstring& str, double* value)
+{
+    assert(value);
+
+    // Powers of 10 that are exactly representable as double.
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    const wchar_t* c = str.data;
+    const wchar_t* end = str.data + str.count;
+
+    bool isNegative = false;
+    if (c < end && (*c == L'-' || *c == L'+'))
+    {
+        isNegative = *c == L'-';
+        ++c;
+    }
+
+    // Up to 18 significant digits are accumulated, the rest only change exponent.
+    const uint64_t maxMantissa = 100000000000000000ull;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    uint32_t digitCount = 0;
+
+    for (; c < end && isDigit(*c); ++c, ++digitCount)
+    {
+        if (mantissa < maxMantissa)
+            mantissa = mantissa * 10 + (*c - L'0');
+        else
+            ++exponent;
+    }
+
+    if (c < end && *c == L'.')
+    {
+        for (++c; c < end && isDigit(*c); ++c, ++digitCount)
+        {
+            if (mantissa < maxMantissa)
             {
-                case L'0': goto setFalse;
-                case L'1': goto setTrue;
-                case L'n': goto setFalse;
-                case L'y': goto setTrue;
+                mantissa = mantissa * 10 + (*c - L'0');
+                --exponent;
             }
-            break;
-        case 2: if (0 == wcsncmp(str.data, L"no", 2)) goto setFalse;
-        case 3: if (0 == wcsncmp(str.data, L"yes", 3)) goto setTrue;
-        case 4: if (0 == wcsncmp(str.data, L"true", 4)) goto setTrue;
-        case 5: if (0 == wcsncmp(str.data, L"false", 5)) goto setFalse;
+        }
     }
 
-    return false;
-setTrue:
-    *value = true;
-    return true;
-setFalse:
-    *value = false;
+    if (digitCount == 0)
+        return makeResult(str, c, ParseError::InvalidValue);
+
+    // Exponent is consumed only if it has digits, so "2em" is parsed as 2.
+    if (c < end && (*c == L'e' || *c == L'E'))
+    {
+        const wchar_t* e = c + 1;
+        bool isExponentNegative = false;
+        if (e < end && (*e == L'-' || *e == L'+'))
+        {
+            isExponentNegative = *e == L'-';
+            ++e;
+        }
+
+        if (e < end && isDigit(*e))
+        {
+            int explicitExponent = 0;
+            for (; e < end && isDigit(*e); ++e)
+            {
+                if (explicitExponent < 100000)
+                    explicitExponent = explicitExponent * 10 + (*e - L'0');
+            }
+
+            exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+            c = e;
+        }
+    }
+
+    double result;
+    if (mantissa == 0)
+    {
+        result = 0.0;
+    }
+    else if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // Both operands are exact, so result is correctly rounded.
+        result = exponent >= 0 ? mantissa * powersOf10[exponent] : mantissa / powersOf10[-exponent];
+    }
+    else if (exponent < -300)
+    {
+        // Scaled in two steps, otherwise power of 10 alone underflows.
+        result = mantissa * pow(10.0, exponent + 300) * 1e-300;
+    }
+    else
+    {
+        result = mantissa * pow(10.0, exponent);
+    }
+
+    if (isinf(result))
+        return makeResult(str, c, ParseError::OutOfRange);
+
+    *value = isNegative ? -result : result;
+    return makeResult(str, c, ParseError::None);
+}
+
+ParseResult ParseUtils::ParseFloat(const Newstring& str, float* value)
+{
+    assert(value);
+
+    double result;
+    ParseResult parseResult = ParseDouble(str, &result);
+    if (parseResult.error != ParseError::None)
+        return parseResult;
+
+    if (fabs(result) > FLT_MAX)
+    {
+        parseResult.error = ParseError::OutOfRange;
+        return parseResult;
+    }
+
+    *value = static_cast<float>(result);
+    return parseResult;
+}
+
+ParseResult ParseUtils::ParseBool(const Newstring& str, bool* value)
+{
+    assert(value);
+
+    struct Keyword
+    {
+        const wchar_t* text;
+        uint32_t length;
+        bool value;
+    };
+
+    // Longer keywords go first, so "no" is not parsed as "n".
+    static const Keyword keywords[] = {
+        { L"false", 5, false },
+        { L"true", 4, true },
+        { L"yes", 3, true },
+        { L"off", 3, false },
+        { L"no", 2, false },
+        { L"on", 2, true },
+        { L"y", 1, true },
+        { L"n", 1, false },
+        { L"1", 1, true },
+        { L"0", 1, false },
+    };
+
+    const wchar_t* end = str.data + str.count;
+    for (const Keyword& keyword : keywords)
+    {
+        if (startsWithKeyword(str.data, end, keyword.text, keyword.length))
+        {
+            *value = keyword.value;
+            return makeResult(str, str.data + keyword.length, ParseError::None);
+        }
+    }
+
+    return makeResult(str, str.data, ParseError::InvalidValue);
+}
+
+bool ParseUtils::StringToBool(const Newstring& str, bool* value)
+{
+    assert(value);
+
+    bool result;
+    if (!ParseBool(str, &result).IsComplete(str))
+        return false;
+
+    *value = result;
     return true;
 }
+
+ParseResult ParseUtils::ParseColor(const Newstring& str, uint32_t* rgba)
+{
+    assert(rgba);
+
+    const wchar_t* c = str.data;
+    const wchar_t* end = str.data + str.count;
+    if (c == end || *c != L'#')
+        return makeResult(str, c, ParseError::InvalidValue);
+
+    ++c;
+    uint32_t packed = 0;
+    uint32_t digitCount = 0;
+    for (; c < end && digitCount < 9; ++c, ++digitCount)
+    {
+        int digit = hexDigitValue(*c);
+        if (digit < 0)
+            break;
+        packed = packed << 4 | digit;
+    }
+
+    switch (digitCount)
+    {
+        case 3:
+            packed = packed << 4 | 0xF;
+            // Fallthrough.
+        case 4:
+            // Every digit is repeated, #RGBA is #RRGGBBAA.
+            packed = (packed & 0xF000) << 12 | (packed & 0x0F00) << 8 | (packed & 0x00F0) << 4 | (packed & 0x000F);
+            packed |= packed << 4;
+            break;
+        case 6:
+            packed = packed << 8 | 0xFF;
+            break;
+        case 8:
+            break;
+        default:
+            return makeResult(str, c, ParseError::InvalidValue);
+    }
+
+    *rgba = packed;
+    return makeResult(str, c, ParseError::None);
+}
+
+ParseResult ParseUtils::ParseDuration(const Newstring& str, double* seconds)
+{
+    assert(seconds);
+
+    double value;
+    ParseResult result = ParseDouble(str, &value);
+    if (result.error != ParseError::None)
+        return result;
+
+    const wchar_t* c = str.data + result.count;
+    const wchar_t* end = str.data + str.count;
+
+    double scale;
+    if (startsWithKeyword(c, end, L"ms", 2))
+    {
+        scale = 0.001;
+        c += 2;
+    }
+    else if (startsWithKeyword(c, end, L"min", 3))
+    {
+        scale = 60.0;
+        c += 3;
+    }
+    else if (startsWithKeyword(c, end, L"s", 1))
+    {
+        scale = 1.0;
+        c += 1;
+    }
+    else
+    {
+        return makeResult(str, c, ParseError::InvalidValue);
+    }
+
+    if (value < 0.0 || isinf(value * scale))
+        return makeResult(str, c, ParseError::OutOfRange);
+
+    *seconds = value * scale;
+    return makeResult(str, c, ParseError::None);
+}
@@ -1,8 +1,58 @@
 #pragma once
 #include "newstring.h"
 
+enum class ParseError
+{
+    None = 0,
+
+    /** String doesn't start with a value of requested type. */
+    InvalidValue,
+
+    /** String starts with a value that doesn't fit into requested type or allowed range. */
+    OutOfRange,
+};
+
+/**
+ * Result of parsing value at the start of string. Like std::from_chars, parsing stops at the first character
+ * that is not part of value, so caller decides whether rest of string is allowed.
+ */
+struct ParseResult
+{
+    /** Number of characters that were parsed. Zero if value is invalid. */
+    uint32_t count = 0;
+    ParseError error = ParseError::None;
+
+    /** Returns true if whole string is a valid value. */
+    bool IsComplete(const Newstring& str) const { return error == ParseError::None && count == str.count; }
+};
+
+/**
+ * Numeric parsing functions don't allocate memory, don't skip whitespace and don't depend on current locale,
+ * decimal separator is always '.'.
+ */
 struct ParseUtils
 {
     static void GetLine(const Newstring& str, Newstring* lineSubstr, int* lineBreakLength);
+
+    /** Returns true if whole string is a boolean value, see ParseBool. */
     static bool StringToBool(const Newstring& str, bool* value);
-};
\ No newline at end of file
+
+    /** Parses decimal integer with optional sign, or hexadecimal integer prefixed with "0x". */
+    static ParseResult ParseInt32(const Newstring& str, int32_t* value);
+
+    /** Parses decimal number with optional sign, fraction and exponent, e.g. "-1.5e3". */
+    static ParseResult ParseFloat(const Newstring& str, float* value);
+    static ParseResult ParseDouble(const Newstring& str, double* value);
+
+    /** Parses "true", "false", "yes", "no", "on", "off", "y", "n", "1" or "0", case-insensitive. */
+    static ParseResult ParseBool(const Newstring& str, bool* value);
+
+    /**
+     * Parses hexadecimal color "#RRGGBBAA", "#RRGGBB", "#RGBA" or "#RGB" to 0xRRGGBBAA. Alpha is 0xFF if it is
+     * not specified.
+     */
+    static ParseResult ParseColor(const Newstring& str, uint32_t* rgba);
+
+    /** Parses non-negative duration with unit "ms", "s" or "min", e.g. "150ms" or "0.5s", to seconds. */
+    static ParseResult ParseDuration(const Newstring& str, double* seconds);
+};
@@ -8,8 +8,6 @@ using namespace WindowManagement;
 
 ATOM PopupWindow::g_windowClass = 0;
 const UINT_PTR DismissTimerId = 123;
-const int ShowAnimationFilter = 0;
-const int DismissAnimationFilter = 1;
 
 
 /**
@@ -129,6 +127,11 @@ void PopupWindow::Show(int dismissMilliseconds)
     OnPaint();
 }
 
+static void dismissAnimationCompleted(const void* key, void* userdata)
+{
+    static_cast<PopupWindow*>(userdata)->OnDismissAnimationCompleted();
+}
+
 void PopupWindow::Dismiss()
 {
     if (dismissing)
@@ -140,34 +143,21 @@ void PopupWindow::Dismiss()
 
     WindowAnimationProperties props;
     props.animationDuration = 0.5;
-    props.allowToStopAnimation = true;
     props.adjustAnimationDuration = true;
     props.startAlpha = 255;
     props.endAlpha = 0;
-    props.stopAnimationMessageFilter = DismissAnimationFilter;
 
-    SendStopAnimationMessage(hwnd, ShowAnimationFilter);
-
-    animatingDismiss = true;
+    // Replaces show animation if it is still running. If popup is shown again before dismiss animation completes,
+    // dismiss animation is replaced and window is not destroyed.
     OutputDebugStringW(L"Begin dismiss animation.\n");
-    if (!AnimateWindow(hwnd, props))
-    {
-        OutputDebugStringW(L"End dismiss animation.\n");
-        animatingDismiss = false;
-        OutputDebugStringW(L"Dismiss animation was stopped\n");
-        // Animation was stopped by application.
-        dismissing = false;
-        return;
-    }
-    OutputDebugStringW(L"End dismiss animation.\n");
-    animatingDismiss = false;
-
-    // AnimateWindow dispatches window messages, so something could have changed.
-    if (!dismissing)
-        return;
+    AnimateWindow(hwnd, props, dismissAnimationCompleted, this);
+}
 
+void PopupWindow::OnDismissAnimationCompleted()
+{
     OutputDebugStringW(L"Dismiss & destroy window!\n");
 
+    dismissing = false;
     UninstallDismissTimer();
     ::ShowWindow(hwnd, SW_HIDE);
     DestroyWindow(hwnd);
@@ -188,23 +178,12 @@ void PopupWindow::ShowContinue()
     WindowAnimationProperties props;
     props.animationDuration = 3;
     props.adjustAnimationDuration = true;
-    props.allowToStopAnimation = true;
     props.startAlpha = 0;
     props.endAlpha = 255;
-    props.stopAnimationMessageFilter = ShowAnimationFilter;
-
-    //StopAnyWindowAnimation();
 
-    SendStopAnimationMessage(hwnd, DismissAnimationFilter);
-
-    animatingShow = true;
+    // Replaces dismiss animation if it is still running.
     OutputDebugStringW(L"Begin show animation.\n");
-    if (!AnimateWindow(hwnd, props))
-    {
-        OutputDebugStringW(L"Show animation was stopped\n");
-    }
-    OutputDebugStringW(L"End show animation.\n");
-    animatingShow = false;
+    AnimateWindow(hwnd, props);
 }
 
 void PopupWindow::InstallDismissTimer()
@@ -230,7 +209,6 @@ void PopupWindow::OnMouseEnter()
 
     if (dismissing)
     {
-        SendStopAnimationMessage(hwnd, DismissAnimationFilter);
         dismissing = false;
         ShowContinue();
     }
@@ -259,8 +237,8 @@ void PopupWindow::OnDismissTimerExpired()
         // Don't dismiss if we have cursor on window.
         if (dismissing)
         {
-            SendStopAnimationMessage(hwnd, DismissAnimationFilter);
             dismissing = false;
+            ShowContinue();
         }
         UninstallDismissTimer();
         return;
@@ -271,13 +249,8 @@ void PopupWindow::OnDismissTimerExpired()
 
 void PopupWindow::StopAnyWindowAnimation()
 {
-    //if (animatingShow || animatingDismiss)
-    //{
-    //    OutputDebugStringW(L"Stopped some animation.\n");
-    //    SendStopAnimationMessage(hwnd);
-    //    animatingShow = false;
-    //    animatingDismiss = false;
-    //}
+    if (hwnd != 0)
+        StopWindowAnimation(hwnd);
 }
 
 void PopupWindow::CreateGraphicsResources()
@@ -43,6 +43,9 @@ struct PopupWindow
     bool Initialize(HWND parentWindow);
     void Show(int dismissMilliseconds);
     void Dismiss();
+
+    /** Hides and destroys window after it faded out. */
+    void OnDismissAnimationCompleted();
 private:
     ID2D1HwndRenderTarget* renderTarget = nullptr;
     IDWriteTextLayout* headerTextLayout = nullptr;
@@ -69,8 +72,6 @@ private:
     int dismissMilliseconds = 3000;
     bool dismissing = false;
 
-    bool animatingDismiss = false;
-    bool animatingShow = false;
     void StopAnyWindowAnimation();
 
     int windowMargin = 15;
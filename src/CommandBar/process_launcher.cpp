@@ -0,0 +1,467 @@
+#include <assert.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "process_launcher.h"
+#include "allocators.h"
+#include "command_line.h"
+#include "trace.h"
+
+#ifdef _WIN32
+#include <shellapi.h>
+#include <stdlib.h>
+#else
+#include <errno.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <mutex>
+#include "tinyutf.h"
+
+extern char** environ;
+#endif
+
+
+#ifdef _WIN32
+static void win32_launch(LaunchRequest* request)
+{
+    assert(request->path);
+
+    SetLastError(0);
+    if (request->shellExec)
+    {
+        TRACE_ZONE("shellExecute");
+
+        SHELLEXECUTEINFOW info = { 0 };
+        info.cbSize = sizeof(info);
+        info.lpVerb = request->asAdmin ? L"runas" : nullptr;
+        info.lpFile = request->path;
+        info.hwnd = 0;
+        info.lpParameters = request->parameters;
+        info.nShow = request->nShow;
+        info.lpDirectory = request->workDir;
+
+        request->succeeded = !!ShellExecuteExW(&info);
+    }
+    else
+    {
+        TRACE_ZONE("runProcess");
+
+        // Runtime of process takes the first token of command line as argv[0], so command line starts with program.
+        // Launch runs on worker thread, so command line is built on stack, or in malloc'ed memory if it doesn't fit there.
+        wchar_t commandLineStorage[1024];
+
+        Newstring path(request->path, static_cast<uint32_t>(wcslen(request->path)));
+        Newstring parameters = request->parameters
+            ? Newstring(request->parameters, static_cast<uint32_t>(wcslen(request->parameters)))
+            : Newstring::Empty();
+
+        uintptr_t commandLineLength = CommandLine::GetProcessCommandLineLength(path, parameters) + 1;
+        wchar_t* commandLine = commandLineLength <= _countof(commandLineStorage)
+            ? commandLineStorage
+            : static_cast<wchar_t*>(::malloc(sizeof(wchar_t) * commandLineLength));
+        if (commandLine == nullptr)
+        {
+            request->succeeded = false;
+            request->errorCode = ERROR_NOT_ENOUGH_MEMORY;
+            return;
+        }
+        CommandLine::WriteProcessCommandLine(commandLine, path, parameters);
+
+        STARTUPINFOW startupInfo = { sizeof(startupInfo), 0 };
+        PROCESS_INFORMATION processInfo = { 0 };
+
+        request->succeeded = 0 != CreateProcessW(
+            request->path,
+            commandLine,
+            nullptr,
+            nullptr,
+            true,
+            NORMAL_PRIORITY_CLASS,
+            nullptr,
+            request->workDir,
+            &startupInfo,
+            &processInfo);
+
+        if (commandLine != commandLineStorage)
+        {
+            // Error of CreateProcessW is reported below.
+            DWORD error = GetLastError();
+            ::free(commandLine);
+            SetLastError(error);
+        }
+
+        if (request->succeeded)
+        {
+            CloseHandle(processInfo.hThread);
+            CloseHandle(processInfo.hProcess);
+        }
+    }
+
+    request->errorCode = request->succeeded ? NO_ERROR : GetLastError();
+
+    // User declined elevation prompt, that's not an error.
+    if (request->errorCode == ERROR_CANCELLED)
+    {
+        request->succeeded = true;
+        request->errorCode = NO_ERROR;
+    }
+}
+
+static void win32_initializeThread()
+{
+    // ShellExecuteEx may use COM to resolve shell extensions.
+    CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+}
+
+static void win32_disposeThread()
+{
+    CoUninitialize();
+}
+
+static const ProcessLauncherBackend g_defaultBackend = { win32_launch, win32_initializeThread, win32_disposeThread };
+#else
+/**
+ * Converts UTF-16 string to null-terminated UTF-8 string. Returns false if buffer is too small.
+ */
+static bool posix_encode(const wchar_t* string, char* buffer, uint32_t bufferSize)
+{
+    char* dest = buffer;
+    char* end = buffer + bufferSize;
+
+    while (*string != L'\0')
+    {
+        if (end - dest < 5)  return false; // Longest UTF-8 sequence and terminating zero.
+
+        int codepoint;
+        string = tuDecode16(string, &codepoint);
+        dest = tuEncode8(dest, codepoint);
+    }
+    *dest = '\0';
+
+    return true;
+}
+
+/**
+ * Processes spawned by launcher that were not reaped yet. Launches run on several worker threads, so list is locked.
+ * Memory is allocated by malloc, because launch must not use allocators of command bar.
+ */
+struct PosixSpawnedProcesses
+{
+    std::mutex mutex;
+    pid_t* pids = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+};
+
+static PosixSpawnedProcesses g_spawnedProcesses;
+
+/**
+ * Reaps exited processes that were spawned by launcher, so they don't stay zombies, then remembers specified process.
+ * Only launcher's own processes are waited for, children of other code are left to it. Process that can't be
+ * remembered (out of memory) is not reaped.
+ */
+static void posix_trackSpawned(pid_t pid)
+{
+    PosixSpawnedProcesses& spawned = g_spawnedProcesses;
+    std::lock_guard<std::mutex> lock(spawned.mutex);
+
+    uint32_t runningCount = 0;
+    for (uint32_t i = 0; i < spawned.count; ++i)
+    {
+        pid_t result = waitpid(spawned.pids[i], nullptr, WNOHANG);
+        if (result == 0 || (result < 0 && errno == EINTR))
+            spawned.pids[runningCount++] = spawned.pids[i];
+    }
+    spawned.count = runningCount;
+
+    if (spawned.count == spawned.capacity)
+    {
+        uint32_t capacity = spawned.capacity == 0 ? 16 : spawned.capacity * 2;
+        pid_t* pids = static_cast<pid_t*>(::realloc(spawned.pids, sizeof(pid_t) * capacity));
+        if (pids == nullptr)
+            return;
+
+        spawned.pids = pids;
+        spawned.capacity = capacity;
+    }
+
+    spawned.pids[spawned.count++] = pid;
+}
+
+static void posix_launch(LaunchRequest* request)
+{
+    TRACE_ZONE("posixSpawn");
+    assert(request->path);
+
+    // Launch runs on worker thread, so argv is built on stack, or in malloc'ed memory if it doesn't fit there.
+    void* argvStorage[512];
+
+    Newstring path(request->path, static_cast<uint32_t>(wcslen(request->path)));
+    Newstring parameters = request->parameters
+        ? Newstring(request->parameters, static_cast<uint32_t>(wcslen(request->parameters)))
+        : Newstring::Empty();
+
+    uintptr_t argvSize = CommandLine::GetPosixArgvSize(path, parameters);
+    void* argvBuffer = argvSize <= sizeof(argvStorage) ? argvStorage : ::malloc(argvSize);
+    if (argvBuffer == nullptr)
+    {
+        request->succeeded = false;
+        request->errorCode = ENOMEM;
+        return;
+    }
+
+    char** argv = CommandLine::WritePosixArgv(argvBuffer, path, parameters);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    int error = 0;
+    if (request->workDir)
+    {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+        char workDir[4096];
+        error = posix_encode(request->workDir, workDir, sizeof(workDir))
+            ? posix_spawn_file_actions_addchdir_np(&actions, workDir)
+            : ENAMETOOLONG;
+#else
+        error = ENOTSUP;
+#endif
+    }
+
+    pid_t pid;
+    if (error == 0)
+        error = posix_spawnp(&pid, argv[0], &actions, nullptr, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    if (argvBuffer != argvStorage)
+        ::free(argvBuffer);
+
+    // Launched processes are not waited for, but exited ones must be reaped so they don't stay zombies.
+    if (error == 0)
+        posix_trackSpawned(pid);
+
+    request->succeeded = error == 0;
+    request->errorCode = static_cast<DWORD>(error);
+}
+
+static const ProcessLauncherBackend g_defaultBackend = { posix_launch, nullptr, nullptr };
+#endif
+
+const ProcessLauncherBackend* GetDefaultProcessLauncherBackend()
+{
+    return &g_defaultBackend;
+}
+
+void LaunchProcess(LaunchRequest* request)
+{
+    assert(request);
+    g_defaultBackend.launch(request);
+}
+
+bool ProcessLauncher::Initialize(uint32_t workerCount, const ProcessLauncherBackend* backend)
+{
+    assert(backend && backend->launch);
+    assert(this->workerCount == 0);
+
+    if (workerCount > MaxWorkerCount)
+        workerCount = MaxWorkerCount;
+
+    this->backend = backend;
+    isStopping = false;
+
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        try
+        {
+            workers[i] = std::thread(&ProcessLauncher::WorkerMain, this);
+        }
+        catch (...)
+        {
+            break;
+        }
+        ++this->workerCount;
+    }
+
+    return this->workerCount > 0;
+}
+
+void ProcessLauncher::SetNotifyCallback(LaunchNotifyCallback callback, void* userdata)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    notifyCallback = callback;
+    notifyCallbackUserdata = userdata;
+}
+
+static wchar_t* copyString(const wchar_t* source, uint32_t length, wchar_t** dest)
+{
+    wchar_t* result = *dest;
+    memcpy(result, source, length * sizeof(wchar_t));
+    result[length] = L'\0';
+    *dest += length + 1;
+    return result;
+}
+
+LaunchRequest* ProcessLauncher::CreateRequest(const wchar_t* path, const wchar_t* parameters, const wchar_t* workDir)
+{
+    assert(path);
+
+    uint32_t pathLength = static_cast<uint32_t>(wcslen(path));
+    uint32_t parametersLength = parameters ? static_cast<uint32_t>(wcslen(parameters)) : 0;
+    uint32_t workDirLength = workDir ? static_cast<uint32_t>(wcslen(workDir)) : 0;
+
+    uintptr_t size = sizeof(LaunchRequest) + sizeof(wchar_t) * (pathLength + 1 + parametersLength + 1 + workDirLength + 1);
+    void* memory = g_standardAllocator.Allocate(size);
+    if (memory == nullptr)
+        return nullptr;
+
+    LaunchRequest* request = new (memory) LaunchRequest();
+    wchar_t* strings = reinterpret_cast<wchar_t*>(request + 1);
+
+    request->path = copyString(path, pathLength, &strings);
+    if (parametersLength > 0)  request->parameters = copyString(parameters, parametersLength, &strings);
+    if (workDirLength > 0)     request->workDir = copyString(workDir, workDirLength, &strings);
+
+    return request;
+}
+
+void ProcessLauncher::DestroyRequest(LaunchRequest* request)
+{
+    if (request == nullptr)  return;
+
+    request->~LaunchRequest();
+    g_standardAllocator.Deallocate(request);
+}
+
+void ProcessLauncher::Submit(LaunchRequest* request)
+{
+    assert(request);
+    request->next = nullptr;
+
+    if (workerCount == 0)
+    {
+        backend ? backend->launch(request) : LaunchProcess(request);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pendingCount;
+        Complete(request);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (lastQueued)  lastQueued->next = request;
+        else             firstQueued = request;
+        lastQueued = request;
+        ++pendingCount;
+    }
+
+    queueChanged.notify_one();
+}
+
+void ProcessLauncher::Complete(LaunchRequest* request)
+{
+    // Must be called with locked mutex.
+    request->next = nullptr;
+    if (lastCompleted)  lastCompleted->next = request;
+    else                firstCompleted = request;
+    lastCompleted = request;
+
+    assert(pendingCount > 0);
+    --pendingCount;
+
+    requestCompleted.notify_all();
+}
+
+uint32_t ProcessLauncher::DrainCompleted(LaunchCompletedCallback callback, void* userdata)
+{
+    LaunchRequest* request;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request = firstCompleted;
+        firstCompleted = nullptr;
+        lastCompleted = nullptr;
+    }
+
+    uint32_t count = 0;
+    while (request)
+    {
+        LaunchRequest* next = request->next;
+        if (callback)
+            callback(request, userdata);
+
+        DestroyRequest(request);
+        request = next;
+        ++count;
+    }
+
+    return count;
+}
+
+uint32_t ProcessLauncher::GetPendingCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pendingCount;
+}
+
+void ProcessLauncher::WaitForPending()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    requestCompleted.wait(lock, [this] { return pendingCount == 0; });
+}
+
+void ProcessLauncher::WorkerMain()
+{
+    if (backend->initializeThread)
+        backend->initializeThread();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        queueChanged.wait(lock, [this] { return firstQueued != nullptr || isStopping; });
+        if (firstQueued == nullptr)
+            break;
+
+        LaunchRequest* request = firstQueued;
+        firstQueued = request->next;
+        if (firstQueued == nullptr)
+            lastQueued = nullptr;
+
+        lock.unlock();
+        backend->launch(request);
+        lock.lock();
+
+        Complete(request);
+
+        LaunchNotifyCallback notify = notifyCallback;
+        void* notifyUserdata = notifyCallbackUserdata;
+        if (notify)
+        {
+            lock.unlock();
+            notify(notifyUserdata);
+            lock.lock();
+        }
+    }
+    lock.unlock();
+
+    if (backend->disposeThread)
+        backend->disposeThread();
+}
+
+void ProcessLauncher::Dispose()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    queueChanged.notify_all();
+
+    for (uint32_t i = 0; i < workerCount; ++i)
+        workers[i].join();
+    workerCount = 0;
+
+    DrainCompleted(nullptr, nullptr);
+
+    notifyCallback = nullptr;
+    notifyCallbackUserdata = nullptr;
+}
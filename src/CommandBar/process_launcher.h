@@ -0,0 +1,155 @@
+#pragma once
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+
+
+/**
+ * Describes single application launch. Requests are created by ProcessLauncher::CreateRequest(),
+ * all strings are stored in the same memory block as request itself.
+ */
+struct LaunchRequest
+{
+    /** Path to application or document to launch. Never null. */
+    wchar_t* path = nullptr;
+
+    /** Command line parameters, or null pointer if there are none. */
+    wchar_t* parameters = nullptr;
+
+    /** Working directory, or null pointer to inherit working directory of command bar. */
+    wchar_t* workDir = nullptr;
+
+    /** Launch using shell (ShellExecuteEx) instead of creating process directly. */
+    bool shellExec = false;
+
+    /** Ask for elevation when launching using shell. */
+    bool asAdmin = false;
+
+    /** Window show type passed to shell, see ShowWindow. */
+    int nShow = 1;
+
+    /** User data, not used by launcher. */
+    void* userdata = nullptr;
+
+    /** Set by launcher when request is completed. */
+    bool succeeded = false;
+
+    /** OS error code, set by launcher when request failed. */
+    DWORD errorCode = 0;
+
+    LaunchRequest* next = nullptr;
+};
+
+/**
+ * Platform part of launcher. Launch function must be thread-safe and must not use allocators of command bar.
+ */
+struct ProcessLauncherBackend
+{
+    /** Launches application described by request, sets 'succeeded' and 'errorCode'. */
+    void (*launch)(LaunchRequest* request);
+
+    /** Called by every worker thread before first launch. May be null. */
+    void (*initializeThread)();
+
+    /** Called by every worker thread before it exits. May be null. */
+    void (*disposeThread)();
+};
+
+/**
+ * Returns backend for current platform: CreateProcess/ShellExecuteEx on Windows, posix_spawn otherwise.
+ */
+const ProcessLauncherBackend* GetDefaultProcessLauncherBackend();
+
+/**
+ * Launches application on calling thread using default backend.
+ */
+void LaunchProcess(LaunchRequest* request);
+
+typedef void(*LaunchCompletedCallback)(LaunchRequest* request, void* userdata);
+typedef void(*LaunchNotifyCallback)(void* userdata);
+
+/**
+ * Launches applications on worker threads, so slow launches (elevation prompts, network paths) do not block UI.
+ *
+ * Submit() queues request and returns immediately. When worker thread finishes launch, it moves request to
+ * completed list and calls notify callback, which should wake up owning thread (for example, post window message).
+ * Owning thread then calls DrainCompleted() to handle results.
+ *
+ * Requests are created and destroyed only by owning thread, so worker threads never touch allocators.
+ */
+struct ProcessLauncher
+{
+    enum { MaxWorkerCount = 8 };
+
+    /**
+     * Starts specified amount of worker threads. Amount of workers is the amount of launches that can be in flight.
+     * Returns false if no worker thread could be started.
+     */
+    bool Initialize(uint32_t workerCount = 2, const ProcessLauncherBackend* backend = GetDefaultProcessLauncherBackend());
+
+    /**
+     * Sets callback that is called on worker thread every time a request is completed.
+     */
+    void SetNotifyCallback(LaunchNotifyCallback callback, void* userdata);
+
+    /**
+     * Creates launch request, copying specified strings. Parameters and working directory may be null.
+     * Returns null pointer if out of memory.
+     */
+    static LaunchRequest* CreateRequest(const wchar_t* path, const wchar_t* parameters, const wchar_t* workDir);
+
+    /**
+     * Destroys request created by CreateRequest().
+     */
+    static void DestroyRequest(LaunchRequest* request);
+
+    /**
+     * Queues request for launch. Launcher takes ownership of request until it is returned by DrainCompleted().
+     * If launcher is not initialized, request is launched synchronously and completed immediately.
+     */
+    void Submit(LaunchRequest* request);
+
+    /**
+     * Calls callback for every completed request in order of completion, then destroys them.
+     * Returns number of handled requests.
+     */
+    uint32_t DrainCompleted(LaunchCompletedCallback callback, void* userdata);
+
+    /**
+     * Returns number of requests that are submitted, but not yet completed.
+     */
+    uint32_t GetPendingCount();
+
+    /**
+     * Waits until all submitted requests are completed.
+     */
+    void WaitForPending();
+
+    /**
+     * Waits for queued launches to finish, stops worker threads and destroys completed requests.
+     */
+    void Dispose();
+private:
+    void WorkerMain();
+    void Complete(LaunchRequest* request);
+
+    const ProcessLauncherBackend* backend = nullptr;
+    LaunchNotifyCallback notifyCallback = nullptr;
+    void* notifyCallbackUserdata = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::condition_variable requestCompleted;
+    std::thread workers[MaxWorkerCount];
+    uint32_t workerCount = 0;
+    bool isStopping = false;
+
+    LaunchRequest* firstQueued = nullptr;
+    LaunchRequest* lastQueued = nullptr;
+    LaunchRequest* firstCompleted = nullptr;
+    LaunchRequest* lastCompleted = nullptr;
+    uint32_t pendingCount = 0;
+};
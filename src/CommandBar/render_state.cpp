@@ -0,0 +1,70 @@
+#include "render_state.h"
+
+
+uint32_t RenderState::GetChanges(const RenderInputs& inputs) const
+{
+    if (isInvalidated)
+        return RC_Text | RC_Selection | RC_Caret | RC_Candidate | RC_Surface | RC_Dropdown | RC_Frame;
+
+    uint32_t changes = isFrameInvalidated ? RC_Frame : RC_None;
+
+    if (inputs.textRevision != drawn.textRevision)
+        changes |= RC_Text;
+
+    if (inputs.selectionStart != drawn.selectionStart || inputs.selectionLength != drawn.selectionLength)
+        changes |= RC_Selection;
+
+    if (inputs.caretPos != drawn.caretPos || inputs.isCaretVisible != drawn.isCaretVisible)
+        changes |= RC_Caret;
+
+    if (inputs.candidate != drawn.candidate)
+        changes |= RC_Candidate;
+
+    if (inputs.dropdownRevision != drawn.dropdownRevision)
+        changes |= RC_Dropdown;
+
+    return changes;
+}
+
+uint32_t RenderState::BeginFrame(const RenderInputs& inputs)
+{
+    uint32_t changes = GetChanges(inputs);
+
+    drawn = inputs;
+    isInvalidated = false;
+    isFrameInvalidated = false;
+
+    if (IsCaretOnlyFrame(changes))  ++statistics.caretFrameCount;
+    else                            ++statistics.fullFrameCount;
+
+    if (IsTextLayoutAffected(changes))            ++statistics.textLayoutBuildCount;
+    if (IsAutocompletionLayoutAffected(changes))  ++statistics.autocompletionLayoutBuildCount;
+
+    return changes;
+}
+
+void RenderState::Invalidate()
+{
+    isInvalidated = true;
+}
+
+void RenderState::InvalidateFrame()
+{
+    isFrameInvalidated = true;
+}
+
+bool RenderState::IsCaretOnlyFrame(uint32_t changes)
+{
+    return changes == RC_Caret;
+}
+
+bool RenderState::IsTextLayoutAffected(uint32_t changes)
+{
+    return (changes & (RC_Text | RC_Surface)) != 0;
+}
+
+bool RenderState::IsAutocompletionLayoutAffected(uint32_t changes)
+{
+    // Autocompletion layout contains typed text followed by rest of candidate name.
+    return (changes & (RC_Text | RC_Candidate | RC_Surface)) != 0;
+}
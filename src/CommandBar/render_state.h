@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+
+
+/**
+ * Parts of command window that changed since last drawn frame.
+ */
+enum RenderChangeFlags : uint32_t
+{
+    RC_None = 0,
+
+    /** Text changed, so text and autocompletion layouts must be rebuilt. */
+    RC_Text = 0x1,
+
+    /** Selection range changed. */
+    RC_Selection = 0x2,
+
+    /** Caret moved, appeared or disappeared. */
+    RC_Caret = 0x4,
+
+    /** Autocompletion candidate changed, so autocompletion layout must be rebuilt. */
+    RC_Candidate = 0x8,
+
+    /** Render target was recreated or window was shown, everything must be rebuilt and redrawn. */
+    RC_Surface = 0x10,
+
+    /** Rows or selection of autocompletion dropdown changed. */
+    RC_Dropdown = 0x20,
+
+    /** Window contents were lost (e.g. window was hidden), so whole frame must be redrawn, but layouts stay valid. */
+    RC_Frame = 0x40,
+};
+
+/**
+ * State of command window that affects drawn frame.
+ */
+struct RenderInputs
+{
+    /** Incremented every time text is modified, see TextEdit::revision. */
+    uint32_t textRevision = 0;
+    uint32_t caretPos = 0;
+    uint32_t selectionStart = 0;
+    uint32_t selectionLength = 0;
+    bool isCaretVisible = false;
+    const void* candidate = nullptr;
+
+    /** See AutocompletionList::revision. */
+    uint32_t dropdownRevision = 0;
+};
+
+/**
+ * Counts frames by kind of work they required.
+ */
+struct RenderStatistics
+{
+    /** Frames which redrew whole window. */
+    uint32_t fullFrameCount = 0;
+
+    /** Frames which redrew only caret area. */
+    uint32_t caretFrameCount = 0;
+
+    uint32_t textLayoutBuildCount = 0;
+    uint32_t autocompletionLayoutBuildCount = 0;
+};
+
+/**
+ * Tracks what changed between drawn frames, so renderer only rebuilds affected layouts and
+ * redraws caret area when nothing else changed. Doesn't depend on any graphics API.
+ */
+struct RenderState
+{
+    /** Inputs of last drawn frame. */
+    RenderInputs drawn;
+
+    RenderStatistics statistics;
+
+    /**
+     * Returns changes between last drawn frame and specified inputs, combination of RenderChangeFlags values.
+     */
+    uint32_t GetChanges(const RenderInputs& inputs) const;
+
+    /**
+     * Returns changes between last drawn frame and specified inputs, and remembers inputs as drawn.
+     * Must be called once per drawn frame.
+     */
+    uint32_t BeginFrame(const RenderInputs& inputs);
+
+    /**
+     * Makes next frame redraw and rebuild everything.
+     */
+    void Invalidate();
+
+    /**
+     * Makes next frame redraw everything without rebuilding layouts.
+     */
+    void InvalidateFrame();
+
+    /** Returns true if frame with specified changes only needs to redraw caret area. */
+    static bool IsCaretOnlyFrame(uint32_t changes);
+
+    /** Returns true if frame with specified changes must rebuild text layout. */
+    static bool IsTextLayoutAffected(uint32_t changes);
+
+    /** Returns true if frame with specified changes must rebuild autocompletion layout. */
+    static bool IsAutocompletionLayoutAffected(uint32_t changes);
+private:
+    bool isInvalidated = true;
+    bool isFrameInvalidated = false;
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include "newstring.h"
+
+
+/**
+ * Color with components in 0..1 range. Has the same layout as D2D1_COLOR_F.
+ */
+struct RenderColor
+{
+    float r;
+    float g;
+    float b;
+    float a;
+};
+
+struct RenderRect
+{
+    float left;
+    float top;
+    float right;
+    float bottom;
+};
+
+/**
+ * Single line of text to draw.
+ */
+struct RenderTextRun
+{
+    Newstring text;
+
+    /**
+     * Backend specific layout of text, e.g. IDWriteTextLayout for Direct2D renderer.
+     * Renderers that lay out text themselves ignore it.
+     */
+    void* layout = nullptr;
+};
+
+/**
+ * Minimal set of drawing operations that command window needs, so painting is not tied to specific graphics API.
+ */
+struct IRenderer
+{
+    virtual void BeginFrame() = 0;
+
+    /**
+     * Finishes and presents frame. Returns false if graphics resources were lost and must be recreated.
+     */
+    virtual bool EndFrame() = 0;
+
+    /**
+     * Fills whole frame, or current clip if it is set, with specified color.
+     */
+    virtual void Clear(const RenderColor& color) = 0;
+    virtual void FillRect(const RenderRect& rect, const RenderColor& color) = 0;
+
+    /**
+     * Draws line which is one pixel wide.
+     */
+    virtual void DrawLine(float x0, float y0, float x1, float y1, const RenderColor& color) = 0;
+
+    /**
+     * Draws text with top-left corner at specified position.
+     */
+    virtual void DrawTextRun(float x, float y, const RenderTextRun& run, const RenderColor& color) = 0;
+
+    /**
+     * Restricts drawing to intersection of specified rect and current clip until matching PopClip() call.
+     */
+    virtual void PushClip(const RenderRect& rect) = 0;
+    virtual void PopClip() = 0;
+};
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "software_renderer.h"
+#include "defer.h"
+#include "trace.h"
+
+
+static uint32_t toPixel(const RenderColor& color)
+{
+    uint32_t r = static_cast<uint32_t>(fminf(fmaxf(color.r, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t g = static_cast<uint32_t>(fminf(fmaxf(color.g, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t b = static_cast<uint32_t>(fminf(fmaxf(color.b, 0.0f), 1.0f) * 255.0f + 0.5f);
+    return (r << 16) | (g << 8) | b;
+}
+
+/** Returns first pixel which center is not less than specified coordinate. */
+static int toPixelEdge(float coordinate)
+{
+    return static_cast<int>(ceilf(coordinate - 0.5f));
+}
+
+bool SoftwareRenderer::Initialize(uint32_t width, uint32_t height, ITextMetrics* metrics)
+{
+    assert(metrics);
+    assert(pixels == nullptr);
+
+    pixels = static_cast<uint32_t*>(allocator->Allocate(sizeof(uint32_t) * width * height));
+    if (pixels == nullptr)
+        return false;
+
+    this->width = width;
+    this->height = height;
+    this->metrics = metrics;
+
+    for (uint32_t i = 0; i < width * height; ++i)
+        pixels[i] = 0;
+
+    return true;
+}
+
+void SoftwareRenderer::Dispose()
+{
+    allocator->Deallocate(pixels);
+    pixels = nullptr;
+    width = 0;
+    height = 0;
+    advances.Dispose();
+}
+
+void SoftwareRenderer::BeginFrame()
+{
+    clips[0] = { 0, 0, static_cast<int>(width), static_cast<int>(height) };
+    clipDepth = 0;
+}
+
+bool SoftwareRenderer::EndFrame()
+{
+    assert(clipDepth == 0);
+    return true;
+}
+
+const SoftwareRenderer::ClipRect& SoftwareRenderer::GetClip() const
+{
+    return clips[clipDepth];
+}
+
+void SoftwareRenderer::PushClip(const RenderRect& rect)
+{
+    assert(clipDepth < MaxClipDepth);
+
+    const ClipRect& current = GetClip();
+    ClipRect clip;
+    clip.left   = std::max(current.left,   toPixelEdge(rect.left));
+    clip.top    = std::max(current.top,    toPixelEdge(rect.top));
+    clip.right  = std::min(current.right,  toPixelEdge(rect.right));
+    clip.bottom = std::min(current.bottom, toPixelEdge(rect.bottom));
+
+    clips[++clipDepth] = clip;
+}
+
+void SoftwareRenderer::PopClip()
+{
+    assert(clipDepth > 0);
+    --clipDepth;
+}
+
+void SoftwareRenderer::BlendPixel(int x, int y, const RenderColor& color)
+{
+    uint32_t& pixel = pixels[y * width + x];
+    if (color.a >= 1.0f)
+    {
+        pixel = toPixel(color);
+        return;
+    }
+
+    RenderColor blended;
+    blended.r = ((pixel >> 16) & 0xFF) / 255.0f * (1.0f - color.a) + color.r * color.a;
+    blended.g = ((pixel >> 8)  & 0xFF) / 255.0f * (1.0f - color.a) + color.g * color.a;
+    blended.b = ( pixel        & 0xFF) / 255.0f * (1.0f - color.a) + color.b * color.a;
+    blended.a = 1.0f;
+    pixel = toPixel(blended);
+}
+
+void SoftwareRenderer::FillPixels(int left, int top, int right, int bottom, const RenderColor& color)
+{
+    const ClipRect& clip = GetClip();
+    left   = std::max(left,   clip.left);
+    top    = std::max(top,    clip.top);
+    right  = std::min(right,  clip.right);
+    bottom = std::min(bottom, clip.bottom);
+
+    if (color.a >= 1.0f)
+    {
+        uint32_t value = toPixel(color);
+        for (int y = top; y < bottom; ++y)
+        {
+            uint32_t* row = pixels + y * width;
+            for (int x = left; x < right; ++x)
+                row[x] = value;
+        }
+        return;
+    }
+
+    for (int y = top; y < bottom; ++y)
+        for (int x = left; x < right; ++x)
+            BlendPixel(x, y, color);
+}
+
+void SoftwareRenderer::Clear(const RenderColor& color)
+{
+    FillPixels(0, 0, static_cast<int>(width), static_cast<int>(height), color);
+}
+
+void SoftwareRenderer::FillRect(const RenderRect& rect, const RenderColor& color)
+{
+    FillPixels(toPixelEdge(rect.left), toPixelEdge(rect.top), toPixelEdge(rect.right), toPixelEdge(rect.bottom), color);
+}
+
+void SoftwareRenderer::DrawLine(float x0, float y0, float x1, float y1, const RenderColor& color)
+{
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    int steps = static_cast<int>(ceilf(fmaxf(fabsf(dx), fabsf(dy))));
+    if (steps == 0)  steps = 1;
+
+    const ClipRect& clip = GetClip();
+    for (int i = 0; i <= steps; ++i)
+    {
+        int x = static_cast<int>(floorf(x0 + dx * i / steps));
+        int y = static_cast<int>(floorf(y0 + dy * i / steps));
+
+        if (x >= clip.left && x < clip.right && y >= clip.top && y < clip.bottom)
+            BlendPixel(x, y, color);
+    }
+}
+
+void SoftwareRenderer::DrawTextRun(float x, float y, const RenderTextRun& run, const RenderColor& color)
+{
+    TRACE_ZONE("SoftwareRenderer::DrawTextRun");
+
+    if (run.text.count == 0 || !advances.Reserve(run.text.count))
+        return;
+
+    if (!metrics->GetAdvances(run.text, advances.data))
+        return;
+
+    // Character is drawn as 3x5 block pattern taken from bits of its code, with one pixel gap around it.
+    enum { PatternColumns = 3, PatternRows = 5 };
+    float glyphTop = y + lineHeight * 0.2f;
+    float cellHeight = lineHeight * 0.6f / PatternRows;
+
+    float penX = x;
+    for (uint32_t i = 0; i < run.text.count; ++i)
+    {
+        float advance = advances.data[i];
+        wchar_t c = run.text.data[i];
+        if (advance <= 0.0f)
+            continue;
+
+        if (c != L' ' && c != L'\t')
+        {
+            uint32_t pattern = (static_cast<uint32_t>(c) * 2654435761u) >> 17;
+            pattern |= 0x2; // Top center cell is always set, so every character is visible.
+
+            float cellWidth = (advance - 2.0f) / PatternColumns;
+            for (uint32_t bit = 0; bit < PatternColumns * PatternRows; ++bit)
+            {
+                if ((pattern & (1u << bit)) == 0)
+                    continue;
+
+                float cellX = penX + 1.0f + (bit % PatternColumns) * cellWidth;
+                float cellY = glyphTop + (bit / PatternColumns) * cellHeight;
+                RenderRect cell = { cellX, cellY, cellX + cellWidth, cellY + cellHeight };
+                FillRect(cell, color);
+            }
+        }
+
+        penX += advance;
+    }
+}
+
+bool SoftwareRenderer::SaveImage(const char* fileName) const
+{
+    assert(fileName);
+
+    FILE* file = fopen(fileName, "wb");
+    if (!file)  return false;
+    defer(fclose(file));
+
+    if (fprintf(file, "P6\n%u %u\n255\n", width, height) < 0)
+        return false;
+
+    for (uint32_t i = 0; i < width * height; ++i)
+    {
+        uint8_t rgb[3] = {
+            static_cast<uint8_t>(pixels[i] >> 16),
+            static_cast<uint8_t>(pixels[i] >> 8),
+            static_cast<uint8_t>(pixels[i])
+        };
+        if (fwrite(rgb, 1, 3, file) != 3)
+            return false;
+    }
+
+    return true;
+}
+
+bool SoftwareRenderer::CompareWithImage(const char* fileName, uint32_t* differentPixelCount) const
+{
+    assert(fileName);
+    assert(differentPixelCount);
+
+    FILE* file = fopen(fileName, "rb");
+    if (!file)  return false;
+    defer(fclose(file));
+
+    unsigned imageWidth = 0;
+    unsigned imageHeight = 0;
+    unsigned maxValue = 0;
+    if (fscanf(file, "P6 %u %u %u", &imageWidth, &imageHeight, &maxValue) != 3 || fgetc(file) == EOF)
+        return false;
+
+    if (imageWidth != width || imageHeight != height || maxValue != 255)
+        return false;
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < width * height; ++i)
+    {
+        uint8_t rgb[3];
+        if (fread(rgb, 1, 3, file) != 3)
+            return false;
+
+        uint32_t pixel = (static_cast<uint32_t>(rgb[0]) << 16) | (static_cast<uint32_t>(rgb[1]) << 8) | rgb[2];
+        if (pixel != pixels[i])
+            ++count;
+    }
+
+    *differentPixelCount = count;
+    return true;
+}
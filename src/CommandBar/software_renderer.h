@@ -0,0 +1,76 @@
+#pragma once
+#include "renderer.h"
+#include "text_metrics.h"
+
+
+/**
+ * Renderer that rasterises frames on CPU into memory buffer, used to benchmark painting and to compare
+ * frames with reference images without a window.
+ *
+ * Text is not rendered with real fonts: every character is drawn as a block pattern derived from its code,
+ * placed using advances of specified text metrics, so output is deterministic on every platform.
+ */
+struct SoftwareRenderer : public IRenderer
+{
+    enum { MaxClipDepth = 8 };
+
+    /**
+     * Pixels in 0x00RRGGBB format, row by row from the top.
+     */
+    uint32_t* pixels = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    /**
+     * Metrics used to place characters. Must be the same metrics that caret positions were computed with.
+     */
+    ITextMetrics* metrics = nullptr;
+
+    /**
+     * Height of character blocks, drawn from the top of text run.
+     */
+    float lineHeight = 22.0f;
+
+    IAllocator* allocator = &g_standardAllocator;
+
+    /**
+     * Allocates pixel buffer of specified size. Buffer contents are retained between frames.
+     */
+    bool Initialize(uint32_t width, uint32_t height, ITextMetrics* metrics);
+    void Dispose();
+
+    /**
+     * Writes pixels to binary PPM image file.
+     */
+    bool SaveImage(const char* fileName) const;
+
+    /**
+     * Compares pixels with PPM image file. Returns false if image couldn't be read or has different size.
+     */
+    bool CompareWithImage(const char* fileName, uint32_t* differentPixelCount) const;
+
+    virtual void BeginFrame() override;
+    virtual bool EndFrame() override;
+    virtual void Clear(const RenderColor& color) override;
+    virtual void FillRect(const RenderRect& rect, const RenderColor& color) override;
+    virtual void DrawLine(float x0, float y0, float x1, float y1, const RenderColor& color) override;
+    virtual void DrawTextRun(float x, float y, const RenderTextRun& run, const RenderColor& color) override;
+    virtual void PushClip(const RenderRect& rect) override;
+    virtual void PopClip() override;
+private:
+    struct ClipRect
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    ClipRect clips[MaxClipDepth + 1];
+    uint32_t clipDepth = 0;
+    Array<float> advances;
+
+    const ClipRect& GetClip() const;
+    void FillPixels(int left, int top, int right, int bottom, const RenderColor& color);
+    void BlendPixel(int x, int y, const RenderColor& color);
+};
@@ -0,0 +1,395 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "string_format.h"
+
+
+namespace StringFormat
+{
+    /** Default number of digits after decimal point, same as in printf. */
+    static const uint32_t DefaultPrecision = 6;
+
+    /** Maximum precision of floating point numbers, greater precision is clamped. */
+    static const uint32_t MaxPrecision = 17;
+
+    /** Space reserved for each number argument when length of formatted string is estimated. */
+    static const uint32_t EstimatedNumberLength = 24;
+
+    static const uint64_t g_powersOf10[MaxPrecision + 1] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    };
+
+    /** Placeholder specification, e.g. {:08x} */
+    struct Specification
+    {
+        uint32_t width = 0;
+        uint32_t precision = DefaultPrecision;
+        bool zeroPad = false;
+        bool hexadecimal = false;
+        bool uppercase = false;
+    };
+
+    Argument ArgumentTraits<const wchar_t*>::Make(const wchar_t* value)
+    {
+        Argument a;
+        a.type = Type;
+        a.string.data = value;
+        a.string.count = value ? static_cast<uint32_t>(wcslen(value)) : 0;
+        return a;
+    }
+
+    Argument ArgumentTraits<Newstring>::Make(const Newstring& value)
+    {
+        Argument a;
+        a.type = Type;
+        a.string.data = value.data;
+        a.string.count = value.data ? value.count : 0;
+        return a;
+    }
+
+    /**
+     * Reserves space for specified number of characters. Capacity is at least doubled, so appending many short
+     * pieces doesn't reallocate builder every time.
+     */
+    static bool reserve(NewstringBuilder* builder, uint32_t count)
+    {
+        uint32_t required = builder->count + count;
+        if (builder->data && required <= builder->capacity)
+            return true;
+
+        uint32_t newCapacity = builder->capacity * 2;
+        return builder->Reserve(newCapacity > required ? newCapacity : required);
+    }
+
+    static void write(NewstringBuilder* builder, const wchar_t* data, uint32_t count)
+    {
+        if (count == 0 || !reserve(builder, count))
+            return;
+
+        memcpy(builder->data + builder->count, data, count * sizeof(wchar_t));
+        builder->count += count;
+    }
+
+    /** Writes value to the end of buffer, returns pointer to the first digit. */
+    static wchar_t* writeUnsigned(wchar_t* end, uint64_t value, bool hexadecimal, bool uppercase)
+    {
+        wchar_t* c = end;
+
+        if (hexadecimal)
+        {
+            const char* digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+            do
+            {
+                *--c = static_cast<wchar_t>(digits[value & 0xF]);
+                value >>= 4;
+            } while (value != 0);
+        }
+        else
+        {
+            do
+            {
+                *--c = static_cast<wchar_t>(L'0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+        }
+
+        return c;
+    }
+
+    /**
+     * Writes fixed point representation of value, rounded half away from zero. Returns number of characters
+     * written, buffer must hold 352 characters, which fits any double.
+     */
+    static uint32_t formatFloat(wchar_t* buffer, uint32_t bufferSize, double value, uint32_t precision)
+    {
+        if (isnan(value))
+        {
+            wcscpy(buffer, L"nan");
+            return 3;
+        }
+
+        if (isinf(value))
+        {
+            wcscpy(buffer, value < 0.0 ? L"-inf" : L"inf");
+            return value < 0.0 ? 4 : 3;
+        }
+
+        bool isNegative = signbit(value) != 0;
+        double magnitude = fabs(value);
+        double scaled = magnitude * static_cast<double>(g_powersOf10[precision]) + 0.5;
+
+        if (scaled >= 1.8e19)
+        {
+            // Doesn't fit into 64-bit integer, rare enough to use CRT.
+            int count = swprintf(buffer, bufferSize, L"%.*f", static_cast<int>(precision), value);
+            return count > 0 ? static_cast<uint32_t>(count) : 0;
+        }
+
+        uint64_t fixed = static_cast<uint64_t>(scaled);
+        uint64_t integerPart = fixed / g_powersOf10[precision];
+        uint64_t fractionPart = fixed % g_powersOf10[precision];
+
+        wchar_t digits[48];
+        wchar_t* end = digits + 48;
+        wchar_t* c = end;
+
+        if (precision > 0)
+        {
+            for (uint32_t i = 0; i < precision; ++i)
+            {
+                *--c = static_cast<wchar_t>(L'0' + fractionPart % 10);
+                fractionPart /= 10;
+            }
+            *--c = L'.';
+        }
+
+        c = writeUnsigned(c, integerPart, false, false);
+        if (isNegative && fixed != 0)
+            *--c = L'-';
+
+        uint32_t count = static_cast<uint32_t>(end - c);
+        assert(count < bufferSize);
+        memcpy(buffer, c, count * sizeof(wchar_t));
+        return count;
+    }
+
+    /** Writes value padded to specification width. Zero padding goes after sign. */
+    static void writePadded(NewstringBuilder* builder, const wchar_t* value, uint32_t count, const Specification& spec)
+    {
+        if (spec.width <= count)
+        {
+            write(builder, value, count);
+            return;
+        }
+
+        uint32_t padding = spec.width - count;
+        if (!reserve(builder, spec.width))
+            return;
+
+        if (spec.zeroPad && count > 0 && value[0] == L'-')
+        {
+            builder->data[builder->count++] = L'-';
+            ++value;
+            --count;
+        }
+
+        wchar_t fill = spec.zeroPad ? L'0' : L' ';
+        for (uint32_t i = 0; i < padding; ++i)
+            builder->data[builder->count++] = fill;
+
+        memcpy(builder->data + builder->count, value, count * sizeof(wchar_t));
+        builder->count += count;
+    }
+
+    static void writeArgument(NewstringBuilder* builder, const Argument& argument, const Specification& spec)
+    {
+        wchar_t buffer[352];
+        wchar_t* end = buffer + 352;
+
+        switch (argument.type)
+        {
+            case ArgumentType::Integer:
+            {
+                int64_t value = argument.integer;
+                uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+                // Hexadecimal negative numbers are written as two's complement of argument size, like printf does.
+                if (spec.hexadecimal)
+                {
+                    magnitude = static_cast<uint64_t>(value);
+                    if (argument.size < sizeof(uint64_t))
+                        magnitude &= (1ull << (argument.size * 8)) - 1;
+                }
+
+                wchar_t* c = writeUnsigned(end, magnitude, spec.hexadecimal, spec.uppercase);
+                if (value < 0 && !spec.hexadecimal)
+                    *--c = L'-';
+
+                writePadded(builder, c, static_cast<uint32_t>(end - c), spec);
+                break;
+            }
+            case ArgumentType::UnsignedInteger:
+            {
+                wchar_t* c = writeUnsigned(end, argument.unsignedInteger, spec.hexadecimal, spec.uppercase);
+                writePadded(builder, c, static_cast<uint32_t>(end - c), spec);
+                break;
+            }
+            case ArgumentType::Float:
+            {
+                uint32_t count = formatFloat(buffer, 352, argument.floatingPoint, spec.precision);
+                writePadded(builder, buffer, count, spec);
+                break;
+            }
+            case ArgumentType::Boolean:
+            {
+                writePadded(builder, argument.boolean ? L"true" : L"false", argument.boolean ? 4 : 5, spec);
+                break;
+            }
+            case ArgumentType::Character:
+            {
+                writePadded(builder, &argument.character, 1, spec);
+                break;
+            }
+            case ArgumentType::String:
+            {
+                if (argument.string.data == nullptr)
+                    writePadded(builder, L"(null)", 6, spec);
+                else
+                    writePadded(builder, argument.string.data, argument.string.count, spec);
+                break;
+            }
+            case ArgumentType::Pointer:
+            {
+                wchar_t* c = writeUnsigned(end, reinterpret_cast<uintptr_t>(argument.pointer), true, spec.uppercase);
+                while (end - c < static_cast<ptrdiff_t>(sizeof(void*) * 2))
+                    *--c = L'0';
+
+                *--c = L'x';
+                *--c = L'0';
+                writePadded(builder, c, static_cast<uint32_t>(end - c), spec);
+                break;
+            }
+            default:
+                assert(false);
+                break;
+        }
+    }
+
+    /**
+     * Parses placeholder that starts at c, which points after '{'. Returns pointer after closing '}'
+     * or nullptr if placeholder is invalid.
+     */
+    static const wchar_t* parseSpecification(const wchar_t* c, Specification* spec)
+    {
+        if (*c == L':')
+        {
+            ++c;
+            if (*c == L'0')
+            {
+                spec->zeroPad = true;
+                ++c;
+            }
+
+            while (*c >= L'0' && *c <= L'9')
+                spec->width = spec->width * 10 + (*c++ - L'0');
+
+            if (*c == L'.')
+            {
+                ++c;
+                if (!(*c >= L'0' && *c <= L'9'))
+                    return nullptr;
+
+                uint32_t precision = 0;
+                while (*c >= L'0' && *c <= L'9')
+                {
+                    if (precision <= MaxPrecision)
+                        precision = precision * 10 + (*c - L'0');
+                    ++c;
+                }
+
+                spec->precision = precision < MaxPrecision ? precision : MaxPrecision;
+            }
+
+            if (*c == L'x' || *c == L'X')
+            {
+                spec->hexadecimal = true;
+                spec->uppercase = *c == L'X';
+                ++c;
+            }
+        }
+
+        return *c == L'}' ? c + 1 : nullptr;
+    }
+
+    static uint32_t estimateLength(const wchar_t* format, const Argument* arguments, uint32_t argumentCount)
+    {
+        uint32_t length = static_cast<uint32_t>(wcslen(format));
+        for (uint32_t i = 0; i < argumentCount; ++i)
+        {
+            const Argument& argument = arguments[i];
+            length += argument.type == ArgumentType::String ? argument.string.count : EstimatedNumberLength;
+        }
+
+        return length;
+    }
+
+    void AppendArguments(NewstringBuilder* builder, const wchar_t* format, const Argument* arguments, uint32_t argumentCount)
+    {
+        assert(builder);
+        assert(format);
+        assert(argumentCount == 0 || arguments);
+
+        if (!reserve(builder, estimateLength(format, arguments, argumentCount)))
+            return;
+
+        uint32_t argumentIndex = 0;
+        const wchar_t* literal = format;
+        const wchar_t* c = format;
+
+        while (*c != L'\0')
+        {
+            if (*c != L'{' && *c != L'}')
+            {
+                ++c;
+                continue;
+            }
+
+            write(builder, literal, static_cast<uint32_t>(c - literal));
+
+            if (c[0] == c[1])
+            {
+                // Escaped brace.
+                write(builder, c, 1);
+                c += 2;
+                literal = c;
+                continue;
+            }
+
+            Specification spec;
+            const wchar_t* next = *c == L'{' ? parseSpecification(c + 1, &spec) : nullptr;
+
+            if (next == nullptr || argumentIndex >= argumentCount)
+            {
+                assert(false);
+                // Appended as is, so mistake is visible in output.
+                literal = c;
+                ++c;
+                continue;
+            }
+
+            writeArgument(builder, arguments[argumentIndex++], spec);
+            c = next;
+            literal = c;
+        }
+
+        write(builder, literal, static_cast<uint32_t>(c - literal));
+        assert(argumentIndex == argumentCount);
+    }
+
+    Newstring FormatArguments(IAllocator* allocator, const wchar_t* format, const Argument* arguments, uint32_t argumentCount)
+    {
+        assert(allocator);
+
+        NewstringBuilder builder;
+        builder.allocator = allocator;
+
+        if (!builder.Reserve(estimateLength(format, arguments, argumentCount) + 1))
+            return Newstring::Empty();
+
+        AppendArguments(&builder, format, arguments, argumentCount);
+
+        if (!reserve(&builder, 1))
+        {
+            builder.Dispose();
+            return Newstring::Empty();
+        }
+
+        builder.data[builder.count] = L'\0';
+        return builder.TransferToString();
+    }
+}
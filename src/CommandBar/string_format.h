@@ -0,0 +1,263 @@
+#pragma once
+#include <stdint.h>
+#include <type_traits>
+
+#include "newstring.h"
+#include "newstring_builder.h"
+
+
+/**
+ * Type-safe string formatting. Arguments are substituted into placeholders of format string in order:
+ *
+ *   {}       argument formatted by its type
+ *   {:8}     right-aligned in field of 8 characters, padded with spaces
+ *   {:08x}   padded with zeros; x and X format integers and pointers as lower and upper case hexadecimal
+ *   {:.3}    floating point number with 3 digits after decimal point (6 by default)
+ *   {{ }}    literal braces
+ *
+ * Supported arguments are integers, bool, float and double, wchar_t, zero-terminated wide strings, Newstring
+ * and pointers. Unlike printf family, string arguments don't need "%.*s" with separate length, and result
+ * is formatted in single pass, without measuring it first.
+ *
+ * FORMAT_APPEND, FORMAT_STRING and FORMAT_TEMP macros check format string literal against types of arguments
+ * at compile time, so a missing argument or hexadecimal float doesn't compile.
+ */
+namespace StringFormat
+{
+
+enum class ArgumentType : uint8_t
+{
+    None = 0,
+    Integer,
+    UnsignedInteger,
+    Float,
+    Boolean,
+    Character,
+    String,
+    Pointer,
+};
+
+/**
+ * Type-erased argument, formatting code is not instantiated for every combination of argument types.
+ */
+struct Argument
+{
+    ArgumentType type = ArgumentType::None;
+
+    /** Size of integer argument in bytes, negative numbers are formatted as hexadecimal of this size. */
+    uint8_t size = 0;
+
+    union
+    {
+        int64_t integer;
+        uint64_t unsignedInteger;
+        double floatingPoint;
+        bool boolean;
+        wchar_t character;
+        const void* pointer;
+        struct
+        {
+            const wchar_t* data;
+            uint32_t count;
+        } string;
+    };
+
+    Argument() : unsignedInteger(0) { }
+};
+
+/** Describes how values of type T are formatted. Types without specialization are not supported. */
+template<typename T>
+struct ArgumentTraits;
+
+#define STRING_FORMAT_INTEGER_TRAITS(m_type, m_argumentType, m_field) \
+    template<> struct ArgumentTraits<m_type> \
+    { \
+        static const ArgumentType Type = ArgumentType::m_argumentType; \
+        static Argument Make(m_type value) { Argument a; a.type = Type; a.size = sizeof(m_type); a.m_field = value; return a; } \
+    };
+
+STRING_FORMAT_INTEGER_TRAITS(signed char, Integer, integer)
+STRING_FORMAT_INTEGER_TRAITS(short, Integer, integer)
+STRING_FORMAT_INTEGER_TRAITS(int, Integer, integer)
+STRING_FORMAT_INTEGER_TRAITS(long, Integer, integer)
+STRING_FORMAT_INTEGER_TRAITS(long long, Integer, integer)
+STRING_FORMAT_INTEGER_TRAITS(unsigned char, UnsignedInteger, unsignedInteger)
+STRING_FORMAT_INTEGER_TRAITS(unsigned short, UnsignedInteger, unsignedInteger)
+STRING_FORMAT_INTEGER_TRAITS(unsigned int, UnsignedInteger, unsignedInteger)
+STRING_FORMAT_INTEGER_TRAITS(unsigned long, UnsignedInteger, unsignedInteger)
+STRING_FORMAT_INTEGER_TRAITS(unsigned long long, UnsignedInteger, unsignedInteger)
+STRING_FORMAT_INTEGER_TRAITS(float, Float, floatingPoint)
+STRING_FORMAT_INTEGER_TRAITS(double, Float, floatingPoint)
+STRING_FORMAT_INTEGER_TRAITS(bool, Boolean, boolean)
+STRING_FORMAT_INTEGER_TRAITS(wchar_t, Character, character)
+STRING_FORMAT_INTEGER_TRAITS(const void*, Pointer, pointer)
+STRING_FORMAT_INTEGER_TRAITS(void*, Pointer, pointer)
+
+#undef STRING_FORMAT_INTEGER_TRAITS
+
+template<>
+struct ArgumentTraits<const wchar_t*>
+{
+    static const ArgumentType Type = ArgumentType::String;
+    static Argument Make(const wchar_t* value);
+};
+
+template<>
+struct ArgumentTraits<wchar_t*> : ArgumentTraits<const wchar_t*> { };
+
+template<>
+struct ArgumentTraits<Newstring>
+{
+    static const ArgumentType Type = ArgumentType::String;
+    static Argument Make(const Newstring& value);
+};
+
+template<>
+struct ArgumentTraits<NewstringBuilder>
+{
+    static const ArgumentType Type = ArgumentType::String;
+    static Argument Make(const NewstringBuilder& value) { return ArgumentTraits<Newstring>::Make(value.string); }
+};
+
+template<typename T>
+using ArgumentTraitsOf = ArgumentTraits<typename std::decay<T>::type>;
+
+enum class FormatError
+{
+    None = 0,
+    UnmatchedBrace,
+    InvalidSpecification,
+    NotEnoughArguments,
+    TooManyArguments,
+    HexadecimalRequiresInteger,
+    PrecisionRequiresFloat,
+};
+
+/**
+ * Checks format string against types of arguments. Can be evaluated at compile time.
+ */
+constexpr FormatError Validate(const wchar_t* format, const ArgumentType* types, uint32_t typeCount)
+{
+    uint32_t argumentIndex = 0;
+
+    for (const wchar_t* c = format; *c != L'\0'; ++c)
+    {
+        if (*c == L'}')
+        {
+            if (c[1] != L'}')  return FormatError::UnmatchedBrace;
+            ++c;
+            continue;
+        }
+
+        if (*c != L'{')
+            continue;
+
+        if (c[1] == L'{')
+        {
+            ++c;
+            continue;
+        }
+
+        if (argumentIndex >= typeCount)
+            return FormatError::NotEnoughArguments;
+
+        ArgumentType type = types[argumentIndex++];
+        ++c;
+
+        if (*c == L':')
+        {
+            ++c;
+            while (*c >= L'0' && *c <= L'9')  ++c;
+
+            if (*c == L'.')
+            {
+                if (type != ArgumentType::Float)  return FormatError::PrecisionRequiresFloat;
+
+                ++c;
+                if (!(*c >= L'0' && *c <= L'9'))  return FormatError::InvalidSpecification;
+                while (*c >= L'0' && *c <= L'9')  ++c;
+            }
+
+            if (*c == L'x' || *c == L'X')
+            {
+                if (type != ArgumentType::Integer && type != ArgumentType::UnsignedInteger && type != ArgumentType::Pointer)
+                    return FormatError::HexadecimalRequiresInteger;
+                ++c;
+            }
+        }
+
+        if (*c != L'}')
+            return *c == L'\0' ? FormatError::UnmatchedBrace : FormatError::InvalidSpecification;
+    }
+
+    return argumentIndex == typeCount ? FormatError::None : FormatError::TooManyArguments;
+}
+
+template<typename... Args>
+struct TypeList { };
+
+/** Used in unevaluated context only, to get types of macro arguments. */
+template<typename... Args>
+TypeList<Args...> TypesOf(const Args&...);
+
+template<typename... Args>
+constexpr FormatError Validate(const wchar_t* format, TypeList<Args...>)
+{
+    const ArgumentType types[] = { ArgumentTraitsOf<Args>::Type..., ArgumentType::None };
+    return Validate(format, types, sizeof...(Args));
+}
+
+/** Fails compilation if error is not FormatError::None. */
+template<FormatError error>
+constexpr int Check()
+{
+    static_assert(error != FormatError::UnmatchedBrace, "Format string has unmatched brace, use {{ and }} for literal braces.");
+    static_assert(error != FormatError::InvalidSpecification, "Format string has invalid placeholder.");
+    static_assert(error != FormatError::NotEnoughArguments, "Format string has more placeholders than arguments.");
+    static_assert(error != FormatError::TooManyArguments, "Format string has less placeholders than arguments.");
+    static_assert(error != FormatError::HexadecimalRequiresInteger, "Hexadecimal format is used for argument that is not integer or pointer.");
+    static_assert(error != FormatError::PrecisionRequiresFloat, "Precision is specified for argument that is not floating point.");
+    return 0;
+}
+
+/**
+ * Appends formatted arguments to string builder. Invalid placeholders are appended as is.
+ */
+void AppendArguments(NewstringBuilder* builder, const wchar_t* format, const Argument* arguments, uint32_t argumentCount);
+
+/**
+ * Returns zero-terminated formatted string allocated using specified allocator, count doesn't include terminating
+ * null. Returns empty string if memory couldn't be allocated.
+ */
+Newstring FormatArguments(IAllocator* allocator, const wchar_t* format, const Argument* arguments, uint32_t argumentCount);
+
+template<typename... Args>
+inline void Append(NewstringBuilder* builder, const wchar_t* format, const Args&... args)
+{
+    const Argument arguments[] = { ArgumentTraitsOf<Args>::Make(args)..., Argument() };
+    AppendArguments(builder, format, arguments, sizeof...(Args));
+}
+
+template<typename... Args>
+inline Newstring Format(IAllocator* allocator, const wchar_t* format, const Args&... args)
+{
+    const Argument arguments[] = { ArgumentTraitsOf<Args>::Make(args)..., Argument() };
+    return FormatArguments(allocator, format, arguments, sizeof...(Args));
+}
+
+} // namespace StringFormat
+
+/** Fails compilation if format string literal doesn't match types of arguments. */
+#define FORMAT_CHECK(m_format, ...) \
+    StringFormat::Check<StringFormat::Validate(m_format, decltype(StringFormat::TypesOf(__VA_ARGS__))())>()
+
+/** Appends formatted arguments to NewstringBuilder, format string is checked at compile time. */
+#define FORMAT_APPEND(m_builder, m_format, ...) \
+    ((void)FORMAT_CHECK(m_format, __VA_ARGS__), StringFormat::Append(m_builder, m_format, ##__VA_ARGS__))
+
+/** Returns zero-terminated formatted Newstring allocated using specified allocator. */
+#define FORMAT_STRING(m_allocator, m_format, ...) \
+    ((void)FORMAT_CHECK(m_format, __VA_ARGS__), StringFormat::Format(m_allocator, m_format, ##__VA_ARGS__))
+
+/** Returns zero-terminated formatted Newstring allocated using temporary allocator. */
+#define FORMAT_TEMP(m_format, ...) FORMAT_STRING(&g_tempAllocator, m_format, ##__VA_ARGS__)
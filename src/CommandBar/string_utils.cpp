@@ -1,16 +1,18 @@
 #include <assert.h>
 #include "string_utils.h"
-#include <stdio.h>
+#include "parse_utils.h"
 
 bool StringUtils::ParseInt32(const Newstring& string, int* result, int defaultValue)
 {
     assert(result);
 
-    if (Newstring::IsNullOrEmpty(string) || 1 != _snwscanf_s(string.data, string.count, L"%i", result))
+    int32_t value;
+    if (!ParseUtils::ParseInt32(string, &value).IsComplete(string))
     {
         *result = defaultValue;
         return false;
     }
 
+    *result = value;
     return true;
 }
@@ -1,40 +1,120 @@
+#include <string.h>
+#include <wctype.h>
+
 #include "text_edit.h"
-#include "clipboard.h"
 #include "defer.h"
+#ifdef _WIN32
+#include "clipboard.h"
+#endif
 
 
 bool TextEdit::Initialize()
 {
-    return buffer.Reserve(512);
+    return buffer.Reserve(512) && textCopy.Reserve(512) && journal.Initialize();
 }
 
 void TextEdit::SelectAll()
 {
-    selectionStartPos = buffer.count != 0 ? 0 : NoSelection;
-    caretPos = buffer.count;
+    journal.Seal();
+    selectionStartPos = buffer.GetCount() != 0 ? 0 : NoSelection;
+    caretPos = buffer.GetCount();
 }
 
 void TextEdit::Select(uint32_t start, uint32_t length)
 {
-    selectionStartPos = start <= buffer.count ? start : buffer.count;
+    selectionStartPos = start <= buffer.GetCount() ? start : buffer.GetCount();
     SetCaretPos(selectionStartPos);
     AddCaretPos(length);
 }
 
+Newstring TextEdit::GetText()
+{
+    // Text edited at the end is already contiguous, and the gap after it leaves room for terminator.
+    uint32_t count = buffer.GetCount();
+    if (buffer.gapStart == count && buffer.gapEnd > buffer.gapStart)
+    {
+        buffer.data[count] = L'\0';
+        return Newstring(buffer.data, count);
+    }
+
+    if (textCopyRevision == revision && textCopy.data != nullptr)
+        return Newstring(textCopy.data, textCopy.count);
+
+    if (textCopy.capacity < count + 1)
+    {
+        // Without a copy text is made contiguous in the buffer itself, which moves the gap away from the caret.
+        uint32_t newCapacity = textCopy.capacity * 2 > count + 1 ? textCopy.capacity * 2 : count + 1;
+        if (!textCopy.Reserve(newCapacity))
+            return buffer.GetText();
+    }
+
+    Newstring before;
+    Newstring after;
+    buffer.GetSpans(&before, &after);
+    if (before.count > 0)
+        memcpy(textCopy.data, before.data, before.count * sizeof(wchar_t));
+    if (after.count > 0)
+        memcpy(textCopy.data + before.count, after.data, after.count * sizeof(wchar_t));
+
+    textCopy.data[count] = L'\0';
+    textCopy.count = count;
+    textCopyRevision = revision;
+
+    return Newstring(textCopy.data, textCopy.count);
+}
+
+uint32_t TextEdit::GetTextLength() const
+{
+    return buffer.GetCount();
+}
+
 void TextEdit::ClearText()
 {
-    buffer.count = 0;
+    ReplaceText(EditKind::Replace, 0, buffer.GetCount(), Newstring::Empty());
+}
+
+void TextEdit::SetText(const Newstring & text)
+{
+    ReplaceText(EditKind::Replace, 0, buffer.GetCount(), text);
     caretPos = 0;
+}
 
+bool TextEdit::Undo()
+{
+    uint32_t newCaretPos;
+    uint32_t newSelectionStartPos;
+    if (!journal.Undo(&buffer, &newCaretPos, &newSelectionStartPos))
+        return false;
+
+    ++revision;
+    SetCaretPos(newCaretPos);
+    selectionStartPos = newSelectionStartPos <= buffer.GetCount() ? newSelectionStartPos : NoSelection;
+    return true;
+}
+
+bool TextEdit::Redo()
+{
+    uint32_t newCaretPos;
+    if (!journal.Redo(&buffer, &newCaretPos))
+        return false;
+
+    ++revision;
     ClearSelection();
+    SetCaretPos(newCaretPos);
+    return true;
 }
 
-void TextEdit::SetText(const Newstring & text)
+void TextEdit::ReplaceText(EditKind kind, uint32_t start, uint32_t length, const Newstring& text)
 {
-    ClearText();
+    journal.Record(kind, buffer, start, length, text, caretPos, selectionStartPos);
+
+    buffer.Remove(start, length);
+    buffer.Insert(start, text);
+    ++revision;
 
-    buffer.Append(text);
-}   
+    caretPos = start + text.count;
+    ClearSelection();
+}
 
 void TextEdit::ClearSelection()
 {
@@ -43,6 +123,7 @@ void TextEdit::ClearSelection()
 
 void TextEdit::ClearSelection(uint32_t newCaretPos)
 {
+    journal.Seal();
     ClearSelection();
     SetCaretPos(newCaretPos);
 }
@@ -89,19 +170,24 @@ void TextEdit::GetSelectionStartAndLength(uint32_t* start, uint32_t* length) con
 
 void TextEdit::Dispose()
 {
+    journal.Dispose();
     buffer.Dispose();
+    textCopy.Dispose();
+    textCopyRevision = 0xFFFFFFFF;
 }
 
 void TextEdit::SetCaretPos(uint32_t pos)
 {
+    journal.Seal();
+
     // @TODO: Find or write clamp procedure.
     if (pos < 0)
     {
         caretPos = 0;
     }
-    else if (pos > buffer.count)
+    else if (pos > buffer.GetCount())
     {
-        caretPos = buffer.count;
+        caretPos = buffer.GetCount();
     }
     else
     {
@@ -129,23 +215,17 @@ void TextEdit::InsertCharacterAtCaret(wchar_t c)
 
     if (IsTextSelected())
     {
-        buffer.Remove(GetSelectionStart(), GetSelectionLength());
-        buffer.Insert(GetSelectionStart(), c);
-        
-        SetCaretPos(GetSelectionStart());
-        AddCaretPos(+1);
-
-        ClearSelection();
+        ReplaceText(EditKind::Type, GetSelectionStart(), GetSelectionLength(), Newstring(&c, 1));
     }
     else
     {
-        buffer.Insert(caretPos, c);
-        AddCaretPos(+1);
+        ReplaceText(EditKind::Type, caretPos, 0, Newstring(&c, 1));
     }
 }
 
 void TextEdit::MoveCaretLeft()
 {
+    journal.Seal();
     if (IsTextSelected())  ClearSelection();
 
     if (caretPos > 0)
@@ -154,6 +234,7 @@ void TextEdit::MoveCaretLeft()
 
 void TextEdit::MoveCaretRight()
 {
+    journal.Seal();
     if (IsTextSelected())  ClearSelection();
 
     if (caretPos < UINT32_MAX)
@@ -162,7 +243,7 @@ void TextEdit::MoveCaretRight()
 
 void TextEdit::AddNextCharacterToSelection()
 {
-    if (caretPos >= buffer.count)
+    if (caretPos >= buffer.GetCount())
         return;
 
     if (!IsTextSelected())
@@ -170,6 +251,7 @@ void TextEdit::AddNextCharacterToSelection()
         selectionStartPos = caretPos;
     }
 
+    journal.Seal();
     AddCaretPos(+1);
 }
 
@@ -183,6 +265,7 @@ void TextEdit::AddPrevCharacterToSelection()
         selectionStartPos = caretPos;
     }
 
+    journal.Seal();
     AddCaretPos(-1);
 }
 
@@ -194,30 +277,41 @@ void TextEdit::RemoveSelectedText()
     uint32_t length;
     GetSelectionStartAndLength(&start, &length);
 
-    ClearSelection();
-
-    buffer.Remove(start, length);
-
-    SetCaretPos(start);
+    ReplaceText(EditKind::Replace, start, length, Newstring::Empty());
 }
 
 void TextEdit::RemovePrevCharacter()
 {
     if (caretPos != 0)
     {
-        buffer.Remove(caretPos - 1, 1);
-        AddCaretPos(-1);
+        ReplaceText(EditKind::Backspace, caretPos - 1, 1, Newstring::Empty());
     }
 }
 
 void TextEdit::RemoveNextCharacter()
 {
-    if (caretPos < buffer.count)
+    if (caretPos < buffer.GetCount())
     {
-        buffer.Remove(caretPos, 1);
+        ReplaceText(EditKind::Delete, caretPos, 1, Newstring::Empty());
     }
 }
 
+void TextEdit::InsertTextAtCaret(const Newstring& text)
+{
+    if (Newstring::IsNullOrEmpty(text))
+        return;
+
+    if (IsTextSelected())
+    {
+        ReplaceText(EditKind::Paste, GetSelectionStart(), GetSelectionLength(), text);
+    }
+    else
+    {
+        ReplaceText(EditKind::Paste, caretPos, 0, text);
+    }
+}
+
+#ifdef _WIN32
 void TextEdit::CopySelectionToClipboard(HWND hwnd)
 {
     if (!IsTextSelected())
@@ -229,7 +323,7 @@ void TextEdit::CopySelectionToClipboard(HWND hwnd)
         return;
     }
 
-    Newstring copyStr = buffer.string.RefSubstring(GetSelectionStart(), GetSelectionLength());
+    Newstring copyStr = GetText().RefSubstring(GetSelectionStart(), GetSelectionLength());
     bool copied = Clipboard::CopyText(copyStr);
     assert(copied);
 
@@ -250,20 +344,6 @@ void TextEdit::PasteTextFromClipboard(HWND hwnd)
 
     Clipboard::Close();
 
-    if (Newstring::IsNullOrEmpty(textToCopy))
-        return;
-
-    if (IsTextSelected())
-    {
-        buffer.Remove(GetSelectionStart(), GetSelectionLength());
-        buffer.Insert(GetSelectionStart(), textToCopy);
-
-        AddCaretPos(textToCopy.count);
-        ClearSelection();
-    }
-    else
-    {
-        buffer.Insert(caretPos, textToCopy);
-        AddCaretPos(textToCopy.count);
-    }
+    InsertTextAtCaret(textToCopy);
 }
+#endif
@@ -1,8 +1,10 @@
 #pragma once
-#include <Windows.h>
+#include "common.h"
 
+#include "array.h"
 #include "newstring.h"
-#include "newstring_builder.h"
+#include "gap_buffer.h"
+#include "edit_journal.h"
 
 
 /**
@@ -16,11 +18,11 @@ struct TextEdit
     enum : uint32_t { NoSelection = 0xFFFFFFFF };
 
     /**
-     * Resizeable string buffer to store control text.
+     * Gap buffer to store control text, the gap follows the caret.
      * Don't change any text of this buffer to avoid breaking control internal state, use
-     * SetText(), ClearText() instead.
+     * SetText(), ClearText() instead. Use GetText() to get text as contiguous string.
      */
-    NewstringBuilder buffer;
+    GapBuffer buffer;
 
     /**
      * Current caret position.
@@ -34,6 +36,27 @@ struct TextEdit
      */
     uint32_t selectionStartPos = NoSelection;
 
+    /**
+     * Incremented every time text is modified, so users can detect text changes without comparing text.
+     */
+    uint32_t revision = 0;
+
+    /**
+     * Journal of text edits used to undo and redo them.
+     */
+    EditJournal journal;
+
+    /**
+     * Contiguous zero-terminated copy of text returned by GetText(), copied from both spans of the buffer once per
+     * revision, so reading text never moves the gap away from the caret.
+     */
+    Array<wchar_t> textCopy;
+
+    /**
+     * Value of revision that textCopy was copied for.
+     */
+    uint32_t textCopyRevision = 0xFFFFFFFF;
+
     /**
      * Initializes resources for this instance.
      */
@@ -54,6 +77,17 @@ struct TextEdit
      */
     void Select(uint32_t start, uint32_t length);
 
+    /**
+     * Returns control text as contiguous zero-terminated string.
+     * Returned string is valid until text is modified.
+     */
+    Newstring GetText();
+
+    /**
+     * Returns number of characters in control text.
+     */
+    uint32_t GetTextLength() const;
+
     /**
      * Removes all text from text buffer.
      */
@@ -64,6 +98,18 @@ struct TextEdit
      */
     void SetText(const Newstring& text);
 
+    /**
+     * Reverts last text edit and restores caret and selection that were before it.
+     * Returns false if there is nothing to undo.
+     */
+    bool Undo();
+
+    /**
+     * Applies last undone text edit again.
+     * Returns false if there is nothing to redo.
+     */
+    bool Redo();
+
     /**
      * Clears currently selected text.
      */
@@ -132,6 +178,13 @@ struct TextEdit
      */
     void MoveCaretRight();
 
+    /**
+     * If text is not selected, inserts specified text at caret position.
+     * If text is selected, then replaces selected text with specified text.
+     */
+    void InsertTextAtCaret(const Newstring& text);
+
+#ifdef _WIN32
     /**
      * Copies selected text to the clipboard.
      * If text is not selected, then does nothing.
@@ -143,6 +196,7 @@ struct TextEdit
      * If there is no text in clipboard, then does nothing.
      */
     void PasteTextFromClipboard(HWND hwnd);
+#endif
 
     /**
      * Adds character that is next to the caret to current selection.
@@ -170,4 +224,6 @@ struct TextEdit
      * Removes character that is next to the caret.
      */
     void RemoveNextCharacter();
+private:
+    void ReplaceText(EditKind kind, uint32_t start, uint32_t length, const Newstring& text);
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include <assert.h>
+
+#include "text_layout_pool.h"
+#include "newstring.h"
+
+
+void TextLayoutPool::BeginFrame()
+{
+    ++frame;
+}
+
+void* TextLayoutPool::GetLayout(const void* key, const Newstring& text)
+{
+    assert(key);
+    assert(createLayout && releaseLayout);
+
+    uint32_t leastRecentlyUsed = 0;
+    for (uint32_t i = 0; i < entryCount; ++i)
+    {
+        Entry& entry = entries[i];
+        if (entry.key == key)
+        {
+            entry.lastUsedFrame = frame;
+            ++reusedCount;
+            return entry.layout;
+        }
+
+        if (entry.lastUsedFrame < entries[leastRecentlyUsed].lastUsedFrame)
+            leastRecentlyUsed = i;
+    }
+
+    void* layout = createLayout(text, userdata);
+    if (layout == nullptr)
+        return nullptr;
+
+    ++createdCount;
+
+    uint32_t index = entryCount;
+    if (entryCount < Capacity)
+    {
+        ++entryCount;
+    }
+    else
+    {
+        index = leastRecentlyUsed;
+        assert(entries[index].lastUsedFrame != frame);
+        releaseLayout(entries[index].layout, userdata);
+    }
+
+    entries[index] = { key, layout, frame };
+    return layout;
+}
+
+void TextLayoutPool::Clear()
+{
+    for (uint32_t i = 0; i < entryCount; ++i)
+        releaseLayout(entries[i].layout, userdata);
+
+    entryCount = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+
+
+struct Newstring;
+
+typedef void*(*TextLayoutCreateCallback)(const Newstring& text, void* userdata);
+typedef void(*TextLayoutReleaseCallback)(void* layout, void* userdata);
+
+/**
+ * Keeps text layouts of recently drawn strings, e.g. rows of autocompletion dropdown, so a layout is built once
+ * while its string keeps being drawn. Layouts are looked up by key, which identifies the string (for example, command
+ * the row shows). Least recently used layouts are released when pool is full, but layouts used since last BeginFrame()
+ * call are never released while frame has less than Capacity layouts.
+ *
+ * Layouts are created and released by callbacks, so pool doesn't depend on graphics API.
+ */
+struct TextLayoutPool
+{
+    static const uint32_t Capacity = 32;
+
+    TextLayoutCreateCallback createLayout = nullptr;
+    TextLayoutReleaseCallback releaseLayout = nullptr;
+    void* userdata = nullptr;
+
+    /** Number of layouts that were created and that were found in the pool. */
+    uint32_t createdCount = 0;
+    uint32_t reusedCount = 0;
+
+    /**
+     * Starts new frame: layouts that are not requested during the frame become candidates for release.
+     */
+    void BeginFrame();
+
+    /**
+     * Returns layout of specified text identified by specified key, creating it if it is not in the pool.
+     * Returns null pointer if layout couldn't be created.
+     */
+    void* GetLayout(const void* key, const Newstring& text);
+
+    /**
+     * Releases all layouts, e.g. when keys become invalid or graphics resources are recreated.
+     */
+    void Clear();
+private:
+    struct Entry
+    {
+        const void* key;
+        void* layout;
+        uint32_t lastUsedFrame;
+    };
+
+    Entry entries[Capacity];
+    uint32_t entryCount = 0;
+    uint32_t frame = 0;
+};
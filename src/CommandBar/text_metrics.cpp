@@ -0,0 +1,114 @@
+#include <assert.h>
+
+#include "text_metrics.h"
+#include "unicode.h"
+#include "trace.h"
+
+
+static bool isCombiningMark(wchar_t c)
+{
+    return (c >= 0x0300 && c <= 0x036F) || (c >= 0x1AB0 && c <= 0x1AFF) || (c >= 0x1DC0 && c <= 0x1DFF) ||
+           (c >= 0x20D0 && c <= 0x20FF) || (c >= 0xFE20 && c <= 0xFE2F);
+}
+
+bool FixedPitchTextMetrics::GetAdvances(const Newstring& text, float* advances)
+{
+    assert(advances || text.count == 0);
+
+    for (uint32_t i = 0; i < text.count; ++i)
+    {
+        // Width of cluster goes to its last code unit.
+        bool isClusterEnd = i + 1 == text.count
+            || !(Unicode::IsLowSurrogate(text.data[i + 1]) || isCombiningMark(text.data[i + 1]));
+
+        advances[i] = isClusterEnd ? advance : 0.0f;
+    }
+
+    return true;
+}
+
+bool GlyphAdvanceCache::Update(ITextMetrics* metrics, const Newstring& text, uint32_t revision)
+{
+    TRACE_ZONE("GlyphAdvanceCache::Update");
+    assert(metrics);
+
+    if (isValid && this->revision == revision)
+        return true;
+
+    isValid = false;
+    if (!positions.Reserve(text.count + 1))
+        return false;
+
+    // Advances are written shifted by one, then accumulated in place.
+    positions.data[0] = 0.0f;
+    if (!metrics->GetAdvances(text, positions.data + 1))
+        return false;
+
+    for (uint32_t i = 1; i <= text.count; ++i)
+        positions.data[i] += positions.data[i - 1];
+
+    positions.count = text.count + 1;
+    this->revision = revision;
+    isValid = true;
+
+    return true;
+}
+
+float GlyphAdvanceCache::GetCaretX(uint32_t index) const
+{
+    if (positions.count == 0)
+        return 0.0f;
+
+    return positions.data[index < positions.count ? index : positions.count - 1];
+}
+
+/** Returns first index which position is not less than specified X coordinate. */
+static uint32_t lowerBound(const float* positions, uint32_t count, float x)
+{
+    uint32_t first = 0;
+    while (count > 0)
+    {
+        uint32_t half = count / 2;
+        if (positions[first + half] < x)
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+
+    return first;
+}
+
+uint32_t GlyphAdvanceCache::HitTest(float x) const
+{
+    if (positions.count == 0)
+        return 0;
+
+    uint32_t next = lowerBound(positions.data, positions.count, x);
+    if (next == 0)
+        return 0;
+    if (next == positions.count)
+        return positions.count - 1;
+
+    float prevX = positions.data[next - 1];
+    if (x - prevX >= positions.data[next] - x)
+        return next;
+
+    // Code units inside of cluster share position with cluster start, return cluster start.
+    return lowerBound(positions.data, next, prevX);
+}
+
+void GlyphAdvanceCache::Invalidate()
+{
+    isValid = false;
+}
+
+void GlyphAdvanceCache::Dispose()
+{
+    positions.Dispose();
+    isValid = false;
+}
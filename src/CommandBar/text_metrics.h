@@ -0,0 +1,73 @@
+#pragma once
+#include "array.h"
+#include "newstring.h"
+
+
+/**
+ * Measures single line of text, independently of the graphics API that lays it out.
+ */
+struct ITextMetrics
+{
+    /**
+     * Writes advance width of every UTF-16 code unit of specified text to 'advances'.
+     * Characters that are drawn as single cluster (surrogate pairs, combining marks) must report whole cluster width
+     * at the last code unit of the cluster and zero for others, so caret never lands inside a cluster.
+     * Returns false if text couldn't be measured.
+     */
+    virtual bool GetAdvances(const Newstring& text, float* advances) = 0;
+};
+
+/**
+ * Text metrics where every character has the same advance. Low surrogates and combining marks are joined with
+ * previous character. Used where real text layout is not available, e.g. in benchmarks.
+ */
+struct FixedPitchTextMetrics : public ITextMetrics
+{
+    float advance = 10.0f;
+
+    virtual bool GetAdvances(const Newstring& text, float* advances) override;
+};
+
+/**
+ * Caret positions of every UTF-16 index of laid out text, computed once per text change, so caret and
+ * selection X coordinates are array lookups and mapping X coordinate to text index is binary search.
+ * Assumes single left-to-right line.
+ */
+struct GlyphAdvanceCache
+{
+    /**
+     * X coordinate of caret before every code unit, plus one more for caret at the end of text.
+     */
+    Array<float> positions;
+
+    /**
+     * Text revision that positions were computed for, see TextEdit::revision.
+     */
+    uint32_t revision = 0;
+
+    bool isValid = false;
+
+    /**
+     * Recomputes positions using specified metrics if they were not computed for specified text revision.
+     * Returns false if text couldn't be measured.
+     */
+    bool Update(ITextMetrics* metrics, const Newstring& text, uint32_t revision);
+
+    /**
+     * Returns X coordinate of caret placed before code unit with specified index.
+     * If index is out of range, returns X coordinate of the end of text.
+     */
+    float GetCaretX(uint32_t index) const;
+
+    /**
+     * Returns index of caret position which is nearest to specified X coordinate.
+     */
+    uint32_t HitTest(float x) const;
+
+    /**
+     * Forces next Update() call to recompute positions.
+     */
+    void Invalidate();
+
+    void Dispose();
+};
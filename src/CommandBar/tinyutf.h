@@ -146,7 +146,7 @@ const wchar_t* tuDecode16(const wchar_t* text, int* cp)
 {
     int in = *text++;
     if (in < 0xD800 || in > 0xDFFF) *cp = in;
-    else if (in > 0xD800 && in < 0xDBFF) *cp = ((in & 0x03FF) << 10) | (*text++ & 0x03FF);
+    else if (in <= 0xDBFF && *text >= 0xDC00 && *text <= 0xDFFF) *cp = 0x10000 + (((in & 0x03FF) << 10) | (*text++ & 0x03FF));
     else *cp = 0xFFFD;
     return text;
 }
@@ -0,0 +1,219 @@
+#include "trace.h"
+
+#ifdef CB_TRACE
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAS_RDTSC 1
+#endif
+
+
+namespace Trace
+{
+
+struct ZoneRecord
+{
+    const char* name;
+    uint64_t startTimestamp;
+    uint64_t endTimestamp;
+};
+
+struct ThreadBuffer
+{
+    /** Number of zones ever written to this buffer. Only owning thread writes it. */
+    std::atomic<uint64_t> head;
+
+    /** Value of 'head' when buffer was cleared last time. Zones before it are not written to trace. */
+    std::atomic<uint64_t> clearedHead;
+
+    uint32_t threadIndex;
+    ZoneRecord zones[ZonesPerThread];
+};
+
+static_assert((ZonesPerThread & (ZonesPerThread - 1)) == 0, "ZonesPerThread must be power of two.");
+
+static std::atomic<ThreadBuffer*> g_buffers[MaxThreads];
+static std::atomic<uint32_t> g_bufferCount{ 0 };
+static thread_local ThreadBuffer* t_buffer = nullptr;
+static thread_local bool t_isBufferUnavailable = false;
+
+static uint64_t getClockNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+uint64_t GetTimestamp()
+{
+#ifdef TRACE_HAS_RDTSC
+    return __rdtsc();
+#else
+    return getClockNs();
+#endif
+}
+
+/** Pair of timestamp and clock time taken at startup, used to convert timestamps to microseconds. */
+static const uint64_t g_originTimestamp = GetTimestamp();
+static const uint64_t g_originClockNs = getClockNs();
+
+static ThreadBuffer* getThreadBuffer()
+{
+    if (t_buffer != nullptr || t_isBufferUnavailable)
+        return t_buffer;
+
+    uint32_t index = g_bufferCount.fetch_add(1);
+    if (index >= MaxThreads)
+    {
+        t_isBufferUnavailable = true;
+        return nullptr;
+    }
+
+    // Not using g_standardAllocator so tracing does not show up in allocation statistics.
+    ThreadBuffer* buffer = static_cast<ThreadBuffer*>(calloc(1, sizeof(ThreadBuffer)));
+    if (buffer == nullptr)
+    {
+        t_isBufferUnavailable = true;
+        return nullptr;
+    }
+
+    buffer->threadIndex = index;
+    g_buffers[index].store(buffer, std::memory_order_release);
+
+    t_buffer = buffer;
+    return buffer;
+}
+
+void RecordZone(const char* name, uint64_t startTimestamp, uint64_t endTimestamp)
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+    if (buffer == nullptr)  return;
+
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+
+    ZoneRecord& zone = buffer->zones[head & (ZonesPerThread - 1)];
+    zone.name = name;
+    zone.startTimestamp = startTimestamp;
+    zone.endTimestamp = endTimestamp;
+
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+static void appendUInt64(NewstringBuilder* sb, uint64_t value)
+{
+    wchar_t digits[20];
+    uint32_t count = 0;
+
+    do
+    {
+        digits[count++] = static_cast<wchar_t>(L'0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (count > 0)
+        sb->Append(digits[--count]);
+}
+
+/** Appends nanoseconds as microseconds with three decimal places. */
+static void appendMicroseconds(NewstringBuilder* sb, uint64_t ns)
+{
+    appendUInt64(sb, ns / 1000);
+    sb->Append(L'.');
+
+    uint64_t fraction = ns % 1000;
+    sb->Append(static_cast<wchar_t>(L'0' + fraction / 100));
+    sb->Append(static_cast<wchar_t>(L'0' + fraction / 10 % 10));
+    sb->Append(static_cast<wchar_t>(L'0' + fraction % 10));
+}
+
+static void appendJsonString(NewstringBuilder* sb, const char* string)
+{
+    sb->Append(L'"');
+    for (const char* c = string; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            sb->Append(L'\\');
+        sb->Append(static_cast<wchar_t>(static_cast<unsigned char>(*c)));
+    }
+    sb->Append(L'"');
+}
+
+void WriteChromeTrace(NewstringBuilder* sb)
+{
+    assert(sb);
+
+    // Timestamps may be time stamp counter ticks, find out how many of them are in a nanosecond.
+    double ticksPerNs = 1.0;
+    uint64_t elapsedNs = getClockNs() - g_originClockNs;
+    uint64_t elapsedTicks = GetTimestamp() - g_originTimestamp;
+    if (elapsedNs > 0 && elapsedTicks > 0)
+        ticksPerNs = static_cast<double>(elapsedTicks) / elapsedNs;
+
+    sb->Append(L"{\"traceEvents\":[");
+
+    bool isFirstEvent = true;
+    uint32_t bufferCount = g_bufferCount.load();
+    if (bufferCount > MaxThreads)
+        bufferCount = MaxThreads;
+
+    for (uint32_t i = 0; i < bufferCount; ++i)
+    {
+        const ThreadBuffer* buffer = g_buffers[i].load(std::memory_order_acquire);
+        if (buffer == nullptr)  continue;
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = buffer->clearedHead.load(std::memory_order_relaxed);
+        if (head - first > ZonesPerThread)
+            first = head - ZonesPerThread;
+
+        for (uint64_t z = first; z < head; ++z)
+        {
+            const ZoneRecord& zone = buffer->zones[z & (ZonesPerThread - 1)];
+            if (zone.startTimestamp < g_originTimestamp || zone.endTimestamp < zone.startTimestamp)
+                continue;
+
+            uint64_t startNs = static_cast<uint64_t>((zone.startTimestamp - g_originTimestamp) / ticksPerNs);
+            uint64_t durationNs = static_cast<uint64_t>((zone.endTimestamp - zone.startTimestamp) / ticksPerNs);
+
+            if (!isFirstEvent)  sb->Append(L',');
+            isFirstEvent = false;
+
+            sb->Append(L"\n{\"name\":");
+            appendJsonString(sb, zone.name);
+            sb->Append(L",\"ph\":\"X\",\"pid\":1,\"tid\":");
+            appendUInt64(sb, buffer->threadIndex);
+            sb->Append(L",\"ts\":");
+            appendMicroseconds(sb, startNs);
+            sb->Append(L",\"dur\":");
+            appendMicroseconds(sb, durationNs);
+            sb->Append(L'}');
+        }
+    }
+
+    sb->Append(L"\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+void Clear()
+{
+    uint32_t bufferCount = g_bufferCount.load();
+    if (bufferCount > MaxThreads)
+        bufferCount = MaxThreads;
+
+    for (uint32_t i = 0; i < bufferCount; ++i)
+    {
+        ThreadBuffer* buffer = g_buffers[i].load(std::memory_order_acquire);
+        if (buffer == nullptr)  continue;
+
+        buffer->clearedHead.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+} // namespace Trace
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+
+#include "newstring_builder.h"
+
+
+/**
+ * Hot path tracing.
+ *
+ * TRACE_ZONE(name) records time spent in enclosing scope. Every thread writes zones to its own
+ * lock-free ring buffer, so recording never blocks; when ring buffer is full, oldest zones are overwritten.
+ * Recorded zones can be written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) with
+ * Trace::WriteChromeTrace().
+ *
+ * Tracing is enabled by defining CB_TRACE. Otherwise TRACE_ZONE expands to nothing.
+ */
+#ifdef CB_TRACE
+
+#define TRACE_ZONE_1(x, y) x##y
+#define TRACE_ZONE_2(x, y) TRACE_ZONE_1(x, y)
+#define TRACE_ZONE(name)   Trace::Zone TRACE_ZONE_2(_traceZone_, __COUNTER__)(name)
+
+namespace Trace
+{
+
+/**
+ * Maximum number of threads which can record zones.
+ * Zones recorded by threads beyond this limit are dropped.
+ */
+enum { MaxThreads = 64 };
+
+/**
+ * Number of zones that each thread's ring buffer can store. Must be power of two.
+ */
+enum { ZonesPerThread = 1 << 16 };
+
+/**
+ * Returns current timestamp in ticks. Uses time stamp counter when available.
+ */
+uint64_t GetTimestamp();
+
+/**
+ * Records zone with specified name and timestamps to ring buffer of calling thread.
+ * Name must point to string which lives until trace is written, usually a string literal.
+ */
+void RecordZone(const char* name, uint64_t startTimestamp, uint64_t endTimestamp);
+
+/**
+ * Writes zones recorded by all threads to string builder as Chrome trace JSON.
+ * Zones that are being recorded during this call may be missing or partially written.
+ */
+void WriteChromeTrace(NewstringBuilder* sb);
+
+/**
+ * Discards recorded zones of all threads.
+ */
+void Clear();
+
+/**
+ * Records time spent between construction and destruction.
+ */
+struct Zone
+{
+    const char* name;
+    uint64_t startTimestamp;
+
+    __forceinline explicit Zone(const char* name)
+        : name(name)
+        , startTimestamp(GetTimestamp())
+    { }
+
+    __forceinline ~Zone()
+    {
+        RecordZone(name, startTimestamp, GetTimestamp());
+    }
+};
+
+} // namespace Trace
+
+#else
+
+#define TRACE_ZONE(name)
+
+#endif
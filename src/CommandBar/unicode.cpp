@@ -1,11 +1,20 @@
 #include <assert.h>
-#include <Windows.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "common.h"
 
 #include "unicode.h"
 #define TINY_UTF_IMPLEMENTATION
 #include "tinyutf.h"
 
 #include "array.h"
+#include "unicode_case_fold.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define UNICODE_USE_SSE2
+#endif
 
 Newstring Unicode::DecodeString(const void* data, uint32_t dataSize, Encoding encoding, IAllocator* allocator)
 {
@@ -102,6 +111,7 @@ void* Unicode::EncodeString(const Newstring& string, uint32_t* encodedStringByte
             char* data = (char*)allocator->Allocate(dataSize);
             if (!data)  return nullptr;
 
+#ifdef _WIN32
             int nwritten = WideCharToMultiByte(
                 CP_UTF8,
                 0,
@@ -111,6 +121,18 @@ void* Unicode::EncodeString(const Newstring& string, uint32_t* encodedStringByte
                 (int)dataSize,
                 0,
                 0);
+#else
+            const wchar_t* source = string.data;
+            const wchar_t* sourceEnd = string.data + string.count;
+            char* dest = data;
+            while (source < sourceEnd)
+            {
+                int codepoint;
+                source = tuDecode16(source, &codepoint);
+                dest = tuEncode8(dest, codepoint);
+            }
+            int nwritten = static_cast<int>(dest - data);
+#endif
 
             assert(nwritten != 0); // @TODO
             
@@ -130,3 +152,265 @@ const wchar_t* Unicode::Decode16(const wchar_t* text, uint32_t* codepoint)
 
     return tuDecode16(text, reinterpret_cast<int*>(codepoint));
 }
+
+const wchar_t* Unicode::Decode16(const wchar_t* text, const wchar_t* end, uint32_t* codepoint)
+{
+    assert(text && text < end);
+    assert(codepoint);
+
+    uint32_t c = static_cast<uint32_t>(*text++);
+    if (IsHighSurrogate(c) && text < end && IsLowSurrogate(static_cast<uint32_t>(*text)))
+    {
+        *codepoint = 0x10000 + (((c & 0x03FF) << 10) | (static_cast<uint32_t>(*text++) & 0x03FF));
+        return text;
+    }
+
+    *codepoint = c;
+    return text;
+}
+
+static inline uint32_t foldAscii(uint32_t c)
+{
+    return c - L'A' < 26 ? c + (L'a' - L'A') : c;
+}
+
+uint32_t Unicode::FoldCase(uint32_t codepoint, uint32_t folded[MaxCaseFoldLength])
+{
+    if (codepoint < 0x80 || codepoint > CaseFoldMaxCodepoint)
+    {
+        folded[0] = codepoint < 0x80 ? foldAscii(codepoint) : codepoint;
+        return 1;
+    }
+
+    uint32_t block = g_caseFoldBlocks[codepoint >> CaseFoldBlockShift];
+    uint32_t offset = codepoint & ((1 << CaseFoldBlockShift) - 1);
+    const CaseFoldMapping& mapping = g_caseFoldMappings[g_caseFoldBlockMappings[(block << CaseFoldBlockShift) | offset]];
+
+    if (mapping.expansionCount == 0)
+    {
+        folded[0] = static_cast<uint32_t>(static_cast<int32_t>(codepoint) + mapping.delta);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < mapping.expansionCount; ++i)
+        folded[i] = g_caseFoldExpansions[mapping.expansionIndex + i];
+
+    return mapping.expansionCount;
+}
+
+/** Writes codepoint as one or two UTF-16 code units, or as single code unit if wchar_t is 32-bit. */
+static inline wchar_t* encodeCodepoint(wchar_t* text, uint32_t codepoint)
+{
+#if WCHAR_MAX > 0xFFFF
+    *text++ = static_cast<wchar_t>(codepoint);
+#else
+    if (codepoint < 0x10000)
+    {
+        *text++ = static_cast<wchar_t>(codepoint);
+    }
+    else
+    {
+        codepoint -= 0x10000;
+        *text++ = static_cast<wchar_t>(0xD800 | (codepoint >> 10));
+        *text++ = static_cast<wchar_t>(0xDC00 | (codepoint & 0x03FF));
+    }
+#endif
+    return text;
+}
+
+bool Unicode::AppendFoldedCase(NewstringBuilder* builder, const Newstring& string)
+{
+    assert(builder);
+
+    if (Newstring::IsNullOrEmpty(string))
+        return true;
+
+    // Folded string has the same length unless some codepoints are folded to several ones.
+    if (!builder->Reserve(builder->count + string.count))
+        return false;
+
+    const wchar_t* c = string.data;
+    const wchar_t* end = string.data + string.count;
+
+    while (c < end)
+    {
+        // Each codepoint may expand to MaxCaseFoldLength codepoints of 2 code units.
+        if (builder->capacity - builder->count < MaxCaseFoldLength * 2)
+        {
+            uint32_t required = builder->count + static_cast<uint32_t>(end - c) + MaxCaseFoldLength * 2;
+            if (!builder->Reserve(required > builder->capacity * 2 ? required : builder->capacity * 2))
+                return false;
+        }
+
+        wchar_t* out = builder->data + builder->count;
+        uint32_t available = builder->capacity - builder->count - MaxCaseFoldLength * 2;
+        const wchar_t* asciiEnd = end - c > available ? c + available : end;
+
+        // ASCII doesn't need table lookup.
+        while (c < asciiEnd && static_cast<uint32_t>(*c) < 0x80)
+            *out++ = static_cast<wchar_t>(foldAscii(static_cast<uint32_t>(*c++)));
+
+        if (c < end && static_cast<uint32_t>(*c) >= 0x80)
+        {
+            uint32_t codepoint;
+            c = Decode16(c, end, &codepoint);
+
+            uint32_t folded[MaxCaseFoldLength];
+            uint32_t foldedCount = FoldCase(codepoint, folded);
+            for (uint32_t i = 0; i < foldedCount; ++i)
+                out = encodeCodepoint(out, folded[i]);
+        }
+
+        builder->count = static_cast<uint32_t>(out - builder->data);
+    }
+
+    return true;
+}
+
+Newstring Unicode::FoldCase(const Newstring& string, IAllocator* allocator)
+{
+    assert(allocator);
+
+    NewstringBuilder builder;
+    builder.allocator = allocator;
+
+    if (!AppendFoldedCase(&builder, string))
+    {
+        builder.Dispose();
+        return Newstring::Empty();
+    }
+
+    return builder.TransferToString();
+}
+
+/** Compares memory blocks, short blocks are compared by several overlapping loads instead of a loop. */
+static inline bool equalMemory(const void* a, const void* b, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(a);
+    const uint8_t* q = static_cast<const uint8_t*>(b);
+
+#ifdef UNICODE_USE_SSE2
+    if (size >= 16)
+    {
+        size_t last = size - 16;
+        for (size_t i = 0; i < last; i += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF)
+                return false;
+        }
+
+        // Last 16 bytes may overlap with already compared ones.
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + last));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + last));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+    }
+#endif
+
+    if (size >= 8)
+    {
+        uint64_t x0, y0, x1, y1;
+        memcpy(&x0, p, 8);
+        memcpy(&y0, q, 8);
+        memcpy(&x1, p + size - 8, 8);
+        memcpy(&y1, q + size - 8, 8);
+        return ((x0 ^ y0) | (x1 ^ y1)) == 0 && (size <= 16 || memcmp(p + 8, q + 8, size - 16) == 0);
+    }
+
+    if (size >= 4)
+    {
+        uint32_t x0, y0, x1, y1;
+        memcpy(&x0, p, 4);
+        memcpy(&y0, q, 4);
+        memcpy(&x1, p + size - 4, 4);
+        memcpy(&y1, q + size - 4, 4);
+        return ((x0 ^ y0) | (x1 ^ y1)) == 0;
+    }
+
+    return size == 0 || memcmp(p, q, size) == 0;
+}
+
+bool Unicode::EqualsFolded(const Newstring& a, const Newstring& b)
+{
+    return a.count == b.count && equalMemory(a.data, b.data, a.count * sizeof(wchar_t));
+}
+
+bool Unicode::StartsWithFolded(const Newstring& string, const Newstring& prefix)
+{
+    return prefix.count <= string.count && equalMemory(string.data, prefix.data, prefix.count * sizeof(wchar_t));
+}
+
+/** Reads case folded codepoints of string one by one. */
+struct CaseFoldReader
+{
+    const wchar_t* c;
+    const wchar_t* end;
+    uint32_t folded[Unicode::MaxCaseFoldLength];
+    uint32_t foldedIndex = 0;
+    uint32_t foldedCount = 0;
+
+    explicit CaseFoldReader(const Newstring& string)
+        : c(string.data)
+        , end(string.data + string.count)
+    { }
+
+    bool Next(uint32_t* codepoint)
+    {
+        if (foldedIndex < foldedCount)
+        {
+            *codepoint = folded[foldedIndex++];
+            return true;
+        }
+
+        if (c >= end)
+            return false;
+
+        if (static_cast<uint32_t>(*c) < 0x80)
+        {
+            *codepoint = foldAscii(static_cast<uint32_t>(*c++));
+            return true;
+        }
+
+        uint32_t decoded;
+        c = Unicode::Decode16(c, end, &decoded);
+        foldedCount = Unicode::FoldCase(decoded, folded);
+        foldedIndex = 1;
+        *codepoint = folded[0];
+        return true;
+    }
+};
+
+bool Unicode::EqualsIgnoreCase(const Newstring& a, const Newstring& b)
+{
+    CaseFoldReader readerA(a);
+    CaseFoldReader readerB(b);
+
+    while (true)
+    {
+        uint32_t codepointA, codepointB;
+        bool hasA = readerA.Next(&codepointA);
+        bool hasB = readerB.Next(&codepointB);
+
+        if (!hasA || !hasB)
+            return hasA == hasB;
+        if (codepointA != codepointB)
+            return false;
+    }
+}
+
+bool Unicode::StartsWithIgnoreCase(const Newstring& string, const Newstring& prefix)
+{
+    CaseFoldReader stringReader(string);
+    CaseFoldReader prefixReader(prefix);
+
+    uint32_t prefixCodepoint;
+    while (prefixReader.Next(&prefixCodepoint))
+    {
+        uint32_t codepoint;
+        if (!stringReader.Next(&codepoint) || codepoint != prefixCodepoint)
+            return false;
+    }
+
+    return true;
+}
@@ -2,6 +2,7 @@
 #include <stdint.h>
 
 #include "newstring.h"
+#include "newstring_builder.h"
 
 
 namespace Unicode
@@ -24,6 +25,46 @@ void* EncodeString(const Newstring& string, uint32_t* encodedStringByteSize, Enc
  */
 const wchar_t* Decode16(const wchar_t* text, uint32_t* codepoint);
 
+/**
+ * Decodes single codepoint of string that ends at specified pointer, so surrogate pair is not read past the end.
+ * Unpaired surrogate is decoded as is. Returns pointer to the next codepoint.
+ */
+const wchar_t* Decode16(const wchar_t* text, const wchar_t* end, uint32_t* codepoint);
+
+/** Maximum number of codepoints that single codepoint is folded to, e.g. U+00DF is folded to "ss". */
+const uint32_t MaxCaseFoldLength = 3;
+
+/**
+ * Writes full case folding of codepoint, e.g. both "A" and "a" are folded to "a" and German sharp s (U+00DF)
+ * is folded to "ss". Returns number of written codepoints. Folding doesn't depend on locale, so Turkish dotless i
+ * is not folded to i.
+ */
+uint32_t FoldCase(uint32_t codepoint, uint32_t folded[MaxCaseFoldLength]);
+
+/**
+ * Appends case folded string to string builder. Folded strings are compared with EqualsFolded and
+ * StartsWithFolded. Returns false if memory couldn't be allocated.
+ */
+bool AppendFoldedCase(NewstringBuilder* builder, const Newstring& string);
+
+/** Returns case folded copy of string. Returns empty string if memory couldn't be allocated. */
+Newstring FoldCase(const Newstring& string, IAllocator* allocator = &g_standardAllocator);
+
+/** Compares case folded strings. */
+bool EqualsFolded(const Newstring& a, const Newstring& b);
+
+/** Returns true if case folded string starts with case folded prefix. */
+bool StartsWithFolded(const Newstring& string, const Newstring& prefix);
+
+/**
+ * Compares strings as if they were case folded, without allocating memory. If strings are compared several
+ * times, it's faster to fold them once and use EqualsFolded.
+ */
+bool EqualsIgnoreCase(const Newstring& a, const Newstring& b);
+
+/** Returns true if string starts with prefix as if they were case folded, without allocating memory. */
+bool StartsWithIgnoreCase(const Newstring& string, const Newstring& prefix);
+
 inline bool IsHighSurrogate(uint32_t lowpart)
 {
     return lowpart >= 0xD800 && lowpart <= 0xDBFF;
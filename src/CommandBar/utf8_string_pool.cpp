@@ -0,0 +1,105 @@
+#include <assert.h>
+#include <wchar.h>
+
+#include "utf8_string_pool.h"
+#include "unicode.h"
+#include "tinyutf.h"
+
+
+bool Utf8StringPool::Add(const Newstring& string, Utf8StringRef* ref)
+{
+    assert(ref);
+
+    // Every UTF-16 code unit takes at most 3 bytes (surrogate pair takes 4), codepoint of UTF-32 at most 4 bytes.
+    const uint64_t maxSize = static_cast<uint64_t>(size) + string.count * (sizeof(wchar_t) == 2 ? 3 : 4) + 1;
+    if (maxSize > UINT32_MAX || !Reserve(static_cast<uint32_t>(maxSize)))
+        return false;
+
+    char* start = data + size;
+    char* out = start;
+
+    const wchar_t* text = string.data;
+    const wchar_t* end = string.data + string.count;
+    while (text < end)
+    {
+        uint32_t codepoint;
+        text = Unicode::Decode16(text, end, &codepoint);
+        out = tuEncode8(out, static_cast<int>(codepoint));
+    }
+    *out = '\0';
+
+    ref->offset = size;
+    ref->size = static_cast<uint32_t>(out - start);
+    size += ref->size + 1;
+
+    return true;
+}
+
+Newstring Utf8StringPool::Decode(Utf8StringRef ref, IAllocator* allocator) const
+{
+    assert(allocator);
+    assert(ref.offset + ref.size <= size);
+
+    if (ref.size == 0)
+        return Newstring::Empty();
+
+    // Every byte is decoded to at most one UTF-16 code unit: 4 byte sequence is decoded to surrogate pair.
+    wchar_t* result = static_cast<wchar_t*>(allocator->Allocate(sizeof(wchar_t) * (ref.size + 1)));
+    if (result == nullptr)
+        return Newstring::Empty();
+
+    const char* text = GetData(ref);
+    const char* end = text + ref.size;
+    wchar_t* out = result;
+    while (text < end)
+    {
+        int codepoint;
+        text = tuDecode8(text, &codepoint);
+#if WCHAR_MAX > 0xFFFF
+        *out++ = static_cast<wchar_t>(codepoint);
+#else
+        out = tuEncode16(out, codepoint);
+#endif
+    }
+    *out = L'\0';
+
+    return Newstring(result, static_cast<uint32_t>(out - result));
+}
+
+bool Utf8StringPool::Reserve(uint32_t newCapacity)
+{
+    if (newCapacity <= capacity)
+        return true;
+
+    // Pool grows geometrically, because commands add their strings one by one.
+    uint64_t grownCapacity = capacity < 256 ? 256 : capacity + capacity / 2;
+    if (grownCapacity < newCapacity)
+        grownCapacity = newCapacity;
+    if (grownCapacity > UINT32_MAX)
+        grownCapacity = UINT32_MAX;
+
+    char* newData = static_cast<char*>(allocator->Reallocate(data, static_cast<uintptr_t>(grownCapacity)));
+    if (newData == nullptr)
+        return false;
+
+    data = newData;
+    capacity = static_cast<uint32_t>(grownCapacity);
+    return true;
+}
+
+void Utf8StringPool::Clear()
+{
+    size = 0;
+}
+
+void Utf8StringPool::Dispose()
+{
+    if (data != nullptr)
+    {
+        allocator->Deallocate(data);
+        data = nullptr;
+    }
+
+    size = 0;
+    capacity = 0;
+}
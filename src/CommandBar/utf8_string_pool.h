@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#include "allocators.h"
+#include "newstring.h"
+
+
+/**
+ * Reference to string stored in Utf8StringPool. Offset stays valid when pool data is reallocated, unlike pointer.
+ */
+struct Utf8StringRef
+{
+    /** Offset of first byte of string from the start of pool data. */
+    uint32_t offset = 0;
+
+    /** Number of bytes in string, without terminating zero. */
+    uint32_t size = 0;
+};
+
+/**
+ * Stores UTF-8 strings one after another in single buffer, so mostly ASCII strings take half of memory they take
+ * as UTF-16 and there are no allocations per string. Strings are decoded to UTF-16 only when they are passed to OS.
+ * Strings can't be removed one by one, whole pool is cleared at once.
+ */
+struct Utf8StringPool
+{
+    /** String data, strings are zero-terminated. */
+    char* data = nullptr;
+
+    /** Number of bytes in use. */
+    uint32_t size = 0;
+
+    /** Number of bytes pool is able to store without reallocating data. */
+    uint32_t capacity = 0;
+
+    IAllocator* allocator = &g_standardAllocator;
+
+    /**
+     * Encodes UTF-16 string to UTF-8 and adds it to pool. Unpaired surrogates are kept, so string is decoded back
+     * as is. Returns false if memory couldn't be allocated.
+     */
+    bool Add(const Newstring& string, Utf8StringRef* ref);
+
+    /** Returns pointer to zero-terminated string data, it's valid until pool is changed. */
+    const char* GetData(Utf8StringRef ref) const { return data + ref.offset; }
+
+    /** Compares string of this pool with string of another or the same pool byte by byte. */
+    bool Equals(Utf8StringRef ref, const Utf8StringPool& otherPool, Utf8StringRef otherRef) const
+    {
+        return ref.size == otherRef.size && memcmp(GetData(ref), otherPool.GetData(otherRef), ref.size) == 0;
+    }
+
+    /**
+     * Returns true if string of this pool starts with string of another or the same pool. Strings are compared
+     * byte by byte, that gives the same result as comparing UTF-16 strings because UTF-8 sequence of codepoint
+     * doesn't start with sequence of other codepoint.
+     */
+    bool StartsWith(Utf8StringRef ref, const Utf8StringPool& prefixPool, Utf8StringRef prefixRef) const
+    {
+        return ref.size >= prefixRef.size && memcmp(GetData(ref), prefixPool.GetData(prefixRef), prefixRef.size) == 0;
+    }
+
+    /**
+     * Decodes string to zero-terminated UTF-16 string, which is usually passed to OS right away, so temporary
+     * allocator is used by default. Returns empty string if string is empty or memory couldn't be allocated.
+     */
+    Newstring Decode(Utf8StringRef ref, IAllocator* allocator = &g_tempAllocator) const;
+
+    /** Reserves storage for specified number of bytes. Returns false if memory couldn't be allocated. */
+    bool Reserve(uint32_t newCapacity);
+
+    /** Removes all strings, references to them become invalid. Memory is kept for new strings. */
+    void Clear();
+
+    void Dispose();
+};
@@ -1,110 +1,98 @@
+#include <assert.h>
+
 #include "window_management.h"
-#include <stdio.h>
+
 
 namespace WindowManagement
 {
-    void debug(const char* format, ...)
+    /** Interval of animation timer, about 60 frames per second. */
+    static const UINT AnimationTimerInterval = 16;
+
+    static AnimationScheduler g_windowAnimations;
+    static UINT_PTR g_animationTimerId = 0;
+
+    static double getCurrentTime()
+    {
+        uint64_t frequency = 0;
+        uint64_t ticks = 0;
+        QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+        QueryPerformanceCounter((LARGE_INTEGER*)&ticks);
+
+        return ticks / (double)frequency;
+    }
+
+    static void tickAnimations();
+
+    static void CALLBACK animationTimerProc(HWND hwnd, UINT msg, UINT_PTR timerId, DWORD time)
     {
-        char buf[2048];
-        va_list args;
-        va_start(args, format);
-        int nchars = vsprintf_s(buf, format, args);
-        va_end(args);
-        buf[nchars] = '\n';
-        buf[nchars+1] = '\0';
-        OutputDebugStringA(buf);
+        tickAnimations();
     }
 
-    // 0 -> 255.
-    // 
+    static void tickAnimations()
+    {
+        bool isAnimating = g_windowAnimations.Tick(getCurrentTime());
+
+        if (isAnimating && g_animationTimerId == 0)
+        {
+            g_animationTimerId = SetTimer(nullptr, 0, AnimationTimerInterval, animationTimerProc);
+        }
+        else if (!isAnimating && g_animationTimerId != 0)
+        {
+            KillTimer(nullptr, g_animationTimerId);
+            g_animationTimerId = 0;
+        }
+    }
 
-    bool AnimateWindow(HWND hwnd, const WindowAnimationProperties& properties)
+    static void applyWindowAlpha(const void* key, float value, void* userdata)
     {
-        uint64_t clockFrequency = 0;
-        uint64_t clockCurrTick = 0;
-        QueryPerformanceFrequency((LARGE_INTEGER*)&clockFrequency);
-        QueryPerformanceCounter((LARGE_INTEGER*)&clockCurrTick);
+        BYTE alpha = static_cast<BYTE>(value < 0.0f ? 0 : (value > 255.0f ? 255 : value + 0.5f));
+        SetLayeredWindowAttributes((HWND)key, 0, alpha, LWA_ALPHA);
+    }
 
-        BYTE currAlpha = 0;
-        GetLayeredWindowAttributes(hwnd, nullptr, &currAlpha, nullptr);
+    bool AnimateWindow(HWND hwnd, const WindowAnimationProperties& properties, AnimationCompletedCallback completed, void* userdata)
+    {
+        assert(hwnd);
 
-        BYTE startAlpha = properties.startAlpha;
-        BYTE endAlpha = properties.endAlpha;
+        double now = getCurrentTime();
+        float startAlpha = properties.startAlpha;
+        float endAlpha = properties.endAlpha;
 
-        double animDuration = properties.animationDuration;
+        bool isStarted;
         if (properties.adjustAnimationDuration)
         {
-            BYTE alphaStartDiff = startAlpha > currAlpha
-                ? startAlpha - currAlpha
-                : currAlpha - startAlpha;
-            BYTE alphaEndDiff = endAlpha > currAlpha
-                ? endAlpha - currAlpha
-                : currAlpha - endAlpha;
-            double unadjusted = animDuration;
-            BYTE alphaDiff = endAlpha > startAlpha
-                ? endAlpha - startAlpha
-                : startAlpha - endAlpha;
-            double progressCoeff = 1.0 - (double)alphaEndDiff / alphaDiff;
-            animDuration -= animDuration * progressCoeff;
-            startAlpha = currAlpha;
+            isStarted = g_windowAnimations.AnimateTo(hwnd, startAlpha, endAlpha, properties.animationDuration,
+                properties.easing, applyWindowAlpha, completed, userdata, now);
+        }
+        else
+        {
+            AnimationTrack track;
+            track.AddKeyframe(0.0, startAlpha);
+            track.AddKeyframe(properties.animationDuration, endAlpha, properties.easing);
+
+            isStarted = g_windowAnimations.Start(hwnd, track, applyWindowAlpha, completed, userdata, now);
         }
-        
-        double currSecs = clockCurrTick / (double)clockFrequency;
-        double targetSecs = currSecs + animDuration;
-        BYTE alphaDiff = endAlpha > startAlpha
-            ? endAlpha - startAlpha
-            : startAlpha - endAlpha;
-
-        MSG msg;
-        while (currSecs < targetSecs)
+
+        if (!isStarted)
         {
-            while (PeekMessageW(&msg, hwnd, 0, 0, PM_REMOVE) != 0)
-            {
-                if (msg.message == StopWindowAnimationMessageId && properties.allowToStopAnimation && (int)msg.lParam == properties.stopAnimationMessageFilter)
-                    return false;
-                TranslateMessage(&msg);
-                DispatchMessageW(&msg);
-            }
-
-            QueryPerformanceCounter((LARGE_INTEGER*)&clockCurrTick);
-            currSecs = clockCurrTick / (double)clockFrequency;
-
-            if (currSecs >= targetSecs)
-            {
-                debug("End - set alpha to: %d", endAlpha);
-                SetLayeredWindowAttributes(hwnd, 0, endAlpha, LWA_ALPHA);
-                break;
-            }
-            else
-            {
-                double diff = ((targetSecs - currSecs) / animDuration);
-                BYTE alpha;
-                if (endAlpha > startAlpha)
-                {
-                    diff = 1.0 - diff; 
-                    alpha = startAlpha + (BYTE)(diff * alphaDiff);
-                }
-                else
-                {
-                    alpha = endAlpha + (BYTE)(diff * alphaDiff);
-                }
-
-                if (alpha != currAlpha)
-                {
-                    currAlpha = alpha;
-                    //debug("Current alpha: %d  diff: %g", alpha, diff);
-                    SetLayeredWindowAttributes(hwnd, 0, alpha, LWA_ALPHA);
-                }
-            }
-
-            Sleep(1);
+            applyWindowAlpha(hwnd, endAlpha, nullptr);
+            if (completed != nullptr)
+                completed(hwnd, userdata);
+
+            return false;
         }
+
+        // Start value is applied right away, so window is not shown with alpha of previous animation.
+        tickAnimations();
         return true;
     }
-    
-    void SendStopAnimationMessage(HWND hwnd, int filter)
+
+    void StopWindowAnimation(HWND hwnd)
+    {
+        g_windowAnimations.Stop(hwnd);
+    }
+
+    bool IsWindowAnimated(HWND hwnd)
     {
-        // Must be PostMessage, doesn't work with SendMessage.
-        PostMessageW(hwnd, StopWindowAnimationMessageId, 0, filter);
+        return g_windowAnimations.IsAnimating(hwnd);
     }
 }
@@ -1,33 +1,44 @@
 #pragma once
 #include "common.h"
+#include "animation.h"
 
 
 /** Contains various utilities for window management. */
 namespace WindowManagement
 {
-    const UINT StopWindowAnimationMessageId = WM_USER + 123;
-
     struct WindowAnimationProperties
     {
         double animationDuration = 0.05;
-        bool allowToStopAnimation = false;
-        int stopAnimationMessageFilter = 0;
+        Easing easing = Easing::Linear;
 
-        /** Use current window alpha value to modify animation duration. */
+        /**
+         * Start animation from current window alpha and shorten its duration by distance that is already covered.
+         * Otherwise animation starts from startAlpha.
+         */
         bool adjustAnimationDuration = false;
 
         BYTE startAlpha = 0; // Alpha at the start of animation.
         BYTE endAlpha = 255; // Alpha at the end of animation.
-        //BYTE targetShowAlpha
     };
 
     /**
-     * Creates new message loop and does specified window animation.
+     * Starts animating alpha of specified layered window and returns immediately. Animations of all windows are
+     * advanced by single thread timer, which runs only while any window is animated, so thread must dispatch messages.
+     *
+     * If window is already animated, its animation is replaced without calling its completion callback,
+     * e.g. window can be faded in again while it is fading out.
      *
-     * If animation was stopped by a stop message, returns false, true otherwise.
-     **/
-    bool AnimateWindow(HWND hwnd, const WindowAnimationProperties& properties = WindowAnimationProperties());
+     * Completion callback is called when window reaches endAlpha, it may be called before this function returns
+     * if animation has zero duration. Returns false if animation couldn't be started, in this case endAlpha is set
+     * and completion callback is called right away.
+     */
+    bool AnimateWindow(HWND hwnd, const WindowAnimationProperties& properties = WindowAnimationProperties(),
+        AnimationCompletedCallback completed = nullptr, void* userdata = nullptr);
+
+    /**
+     * Stops animation of specified window at its current alpha, without calling completion callback.
+     */
+    void StopWindowAnimation(HWND hwnd);
 
-    /** Sends stop animation message to specified window. */
-    void SendStopAnimationMessage(HWND hwnd, int filter);
+    bool IsWindowAnimated(HWND hwnd);
 }